@@ -0,0 +1,135 @@
+// Gmsh - Copyright (C) 1997-2013 C. Geuzaine, J.-F. Remacle
+//
+// See the LICENSE.txt file for license information. Please report all
+// bugs and problems to the public mailing list <gmsh@geuz.org>.
+
+#include <float.h>
+#include <algorithm>
+#include "BoundingVolumeHierarchy.h"
+
+class centerLessThan {
+ private:
+  const std::vector<double> &_centers;
+  int _axis;
+ public:
+  centerLessThan(const std::vector<double> &centers, int axis)
+    : _centers(centers), _axis(axis) {}
+  bool operator()(int a, int b) const
+  {
+    return _centers[3 * a + _axis] < _centers[3 * b + _axis];
+  }
+};
+
+boundingVolumeHierarchy::boundingVolumeHierarchy(int n, const double *boxes)
+{
+  if(n <= 0) return;
+  std::vector<double> b(boxes, boxes + 6 * n), centers(3 * n);
+  for(int i = 0; i < n; i++)
+    for(int j = 0; j < 3; j++)
+      centers[3 * i + j] = 0.5 * (b[6 * i + j] + b[6 * i + 3 + j]);
+  _items.resize(n);
+  for(int i = 0; i < n; i++) _items[i] = i;
+  _nodes.push_back(node());
+  _fill(0, 0, n, b, centers);
+  _boxes.resize(6 * n);
+  for(int i = 0; i < n; i++)
+    for(int j = 0; j < 6; j++)
+      _boxes[6 * i + j] = b[6 * _items[i] + j];
+}
+
+void boundingVolumeHierarchy::_fill(int n, int begin, int end,
+                                    const std::vector<double> &boxes,
+                                    const std::vector<double> &centers)
+{
+  // split the items in up to 4 ranges, by splitting the largest range in
+  // two until there are 4 of them or until they all fit in a leaf
+  int ranges[5] = {begin, end, end, end, end}, numRanges = 1;
+  while(numRanges < 4){
+    int r = -1;
+    for(int i = 0; i < numRanges; i++)
+      if(ranges[i + 1] - ranges[i] > leafSize &&
+         (r < 0 || ranges[i + 1] - ranges[i] > ranges[r + 1] - ranges[r]))
+        r = i;
+    if(r < 0) break;
+    double cmin[3] = {DBL_MAX, DBL_MAX, DBL_MAX};
+    double cmax[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+    for(int i = ranges[r]; i < ranges[r + 1]; i++){
+      for(int j = 0; j < 3; j++){
+        cmin[j] = std::min(cmin[j], centers[3 * _items[i] + j]);
+        cmax[j] = std::max(cmax[j], centers[3 * _items[i] + j]);
+      }
+    }
+    int axis = 0;
+    for(int j = 1; j < 3; j++)
+      if(cmax[j] - cmin[j] > cmax[axis] - cmin[axis]) axis = j;
+    int mid = (ranges[r] + ranges[r + 1]) / 2;
+    std::nth_element(_items.begin() + ranges[r], _items.begin() + mid,
+                     _items.begin() + ranges[r + 1],
+                     centerLessThan(centers, axis));
+    for(int i = numRanges; i > r; i--) ranges[i + 1] = ranges[i];
+    ranges[r + 1] = mid;
+    numRanges++;
+  }
+
+  for(int k = 0; k < 4; k++){
+    double min[3] = {DBL_MAX, DBL_MAX, DBL_MAX};
+    double max[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+    int child = -1, count = 0;
+    if(k < numRanges){
+      for(int i = ranges[k]; i < ranges[k + 1]; i++){
+        for(int j = 0; j < 3; j++){
+          min[j] = std::min(min[j], boxes[6 * _items[i] + j]);
+          max[j] = std::max(max[j], boxes[6 * _items[i] + 3 + j]);
+        }
+      }
+      if(ranges[k + 1] - ranges[k] > leafSize){
+        // (_nodes can be reallocated by the recursive call)
+        child = _nodes.size();
+        _nodes.push_back(node());
+        _fill(child, ranges[k], ranges[k + 1], boxes, centers);
+      }
+      else{
+        child = -1 - ranges[k];
+        count = ranges[k + 1] - ranges[k];
+      }
+    }
+    for(int j = 0; j < 3; j++){
+      _nodes[n].min[j][k] = min[j];
+      _nodes[n].max[j][k] = max[j];
+    }
+    _nodes[n].child[k] = child;
+    _nodes[n].count[k] = count;
+  }
+}
+
+void boundingVolumeHierarchy::search(const double p[3],
+                                     std::vector<int> &found) const
+{
+  if(_nodes.empty()) return;
+  // the tree is balanced: its depth is at most 16 for 2^32 boxes, and each
+  // level adds at most 3 nodes to the stack
+  int stack[64], size = 0;
+  stack[size++] = 0;
+  while(size){
+    const node &nd = _nodes[stack[--size]];
+    int hit[4];
+    for(int k = 0; k < 4; k++)
+      hit[k] = (p[0] >= nd.min[0][k]) & (p[0] <= nd.max[0][k]) &
+        (p[1] >= nd.min[1][k]) & (p[1] <= nd.max[1][k]) &
+        (p[2] >= nd.min[2][k]) & (p[2] <= nd.max[2][k]);
+    for(int k = 0; k < 4; k++){
+      if(!hit[k]) continue;
+      if(nd.child[k] >= 0){
+        stack[size++] = nd.child[k];
+        continue;
+      }
+      int first = -1 - nd.child[k];
+      for(int i = first; i < first + nd.count[k]; i++){
+        const double *b = &_boxes[6 * i];
+        if(p[0] >= b[0] && p[0] <= b[3] && p[1] >= b[1] && p[1] <= b[4] &&
+           p[2] >= b[2] && p[2] <= b[5])
+          found.push_back(_items[i]);
+      }
+    }
+  }
+}
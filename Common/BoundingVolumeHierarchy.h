@@ -0,0 +1,42 @@
+// Gmsh - Copyright (C) 1997-2013 C. Geuzaine, J.-F. Remacle
+//
+// See the LICENSE.txt file for license information. Please report all
+// bugs and problems to the public mailing list <gmsh@geuz.org>.
+
+#ifndef _BOUNDING_VOLUME_HIERARCHY_H_
+#define _BOUNDING_VOLUME_HIERARCHY_H_
+
+#include <vector>
+
+// A bounding volume hierarchy over a set of axis-aligned boxes, to find
+// all the boxes containing a given point. The tree is built by recursive
+// median splits along the largest extent of the box centers, so that it
+// is balanced whatever the distribution of the boxes. Each node stores the
+// boxes of its (up to) 4 children as arrays of coordinates, so that the 4
+// box tests are done at once (they are vectorized by the compiler); the
+// leaves contain up to 4 boxes.
+class boundingVolumeHierarchy {
+ private:
+  enum { leafSize = 4 };
+  struct node {
+    double min[3][4], max[3][4];
+    // child node (if >= 0) or leaf starting at -1 - child in _items
+    int child[4], count[4];
+  };
+  std::vector<node> _nodes;
+  // the box indices and the boxes, in the order of the leaves
+  std::vector<int> _items;
+  std::vector<double> _boxes;
+  void _fill(int n, int begin, int end, const std::vector<double> &boxes,
+             const std::vector<double> &centers);
+ public:
+  // build the hierarchy for "n" boxes, stored as xmin ymin zmin xmax ymax
+  // zmax
+  boundingVolumeHierarchy(int n, const double *boxes);
+  int getNumBoxes() const { return _items.size(); }
+  // append the indices of all the boxes containing "p" to "found", in no
+  // particular order
+  void search(const double p[3], std::vector<int> &found) const;
+};
+
+#endif
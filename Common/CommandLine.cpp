@@ -60,8 +60,8 @@ std::vector<std::pair<std::string, std::string> > GetUsage()
   s.push_back(mp("-1, -2, -3",         "Perform 1D, 2D or 3D mesh generation, then exit"));
   s.push_back(mp("-o file",            "Specify output file name"));
   s.push_back(mp("-format string",     "Select output mesh format (auto (default), msh, "
-                                       "msh1, msh2, unv, vrml, ply2, stl, mesh, bdf, cgns, "
-                                       "p3d, diff, med, ...)"));
+                                       "msh1, msh2, mshb, unv, vrml, ply2, stl, mesh, bdf, "
+                                       "cgns, p3d, diff, med, ...)"));
   s.push_back(mp("-bin",               "Use binary format when available"));
   s.push_back(mp("-refine",            "Perform uniform mesh refinement, then exit"));
   s.push_back(mp("-part int",          "Partition after batch mesh generation"));
@@ -50,6 +50,7 @@ struct contextMeshOptions {
   int saveElementTagType;
   int switchElementTags;
   int multiplePasses;
+  int maxNumThreads2D, maxNumThreads3D, deterministic3D, canonicalNumbering;
   int cgnsImportOrder;
   std::map<int,int> algo2d_per_face;
   std::map<int,int> curvature_control_per_face;
@@ -230,8 +231,8 @@ class CTX {
   struct{
     int draw, link, horizontalScales;
     int smooth, animCycle, animStep, combineTime, combineRemoveOrig;
-    int fileFormat, plugins, forceNodeData;
-    double animDelay;
+    int fileFormat, plugins, forceNodeData, saveIncremental;
+    double animDelay, memoryLimit, deltaTolerance;
   }post;
   // solver options
   struct{
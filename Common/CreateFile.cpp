@@ -50,6 +50,7 @@ int GetFileFormatFromExtension(const std::string &ext)
   else if(ext == ".inp")  return FORMAT_INP;
   else if(ext == ".celum")return FORMAT_CELUM;
   else if(ext == ".su2")  return FORMAT_SU2;
+  else if(ext == ".mshb") return FORMAT_MSHB;
   else if(ext == ".nas")  return FORMAT_BDF;
   else if(ext == ".p3d")  return FORMAT_P3D;
   else if(ext == ".wrl")  return FORMAT_VRML;
@@ -105,6 +106,7 @@ std::string GetDefaultFileName(int format)
   case FORMAT_INP:  name += ".inp"; break;
   case FORMAT_CELUM:name += ".celum"; break;
   case FORMAT_SU2:  name += ".su2"; break;
+  case FORMAT_MSHB: name += ".mshb"; break;
   case FORMAT_P3D:  name += ".p3d"; break;
   case FORMAT_VRML: name += ".wrl"; break;
   case FORMAT_PLY2: name += ".ply2"; break;
@@ -341,6 +343,11 @@ void CreateOutputFile(const std::string &fileName, int format,
       (name, CTX::instance()->mesh.saveAll, CTX::instance()->mesh.scalingFactor);
     break;
 
+  case FORMAT_MSHB:
+    GModel::current()->writeMSHB
+      (name, CTX::instance()->mesh.saveAll, CTX::instance()->mesh.scalingFactor);
+    break;
+
   case FORMAT_P3D:
     GModel::current()->writeP3D
       (name, CTX::instance()->mesh.saveAll, CTX::instance()->mesh.scalingFactor);
@@ -886,6 +886,9 @@ StringXNumber MeshOptions_Number[] = {
   { F|O, "SmoothCrossField" , opt_mesh_smooth_cross_field , 0. ,
     "Apply n barycentric smoothing passes to the cross field" },
 
+  { F|O, "CanonicalNumbering" , opt_mesh_canonical_numbering , 0. ,
+    "Renumber the mesh vertices and elements by entity and by creation order "
+    "after meshing (makes the numbering independent of the number of threads)" },
   { F|O, "CgnsImportOrder" , opt_mesh_cgns_import_order , 1. ,
    "Enable the creation of high-order mesh from CGNS structured meshes"
    "(1, 2, 4, 8, ...)" },
@@ -950,6 +953,10 @@ StringXNumber MeshOptions_Number[] = {
   { F,   "CpuTime" , opt_mesh_cpu_time , 0. ,
     "CPU time (in seconds) for the generation of the current mesh (read-only)" },
 
+  { F|O, "Deterministic3D" , opt_mesh_deterministic_3d , 1. ,
+    "Make the parallel 3D Delaunay point insertion deterministic, i.e. "
+    "independent of the thread scheduling and of the number of threads (if "
+    "larger than 1)" },
   { F|O, "DrawSkinOnly" , opt_mesh_draw_skin_only , 0. ,
     "Draw only the skin of 3D meshes?" },
   { F|O, "Dual" , opt_mesh_dual , 0. ,
@@ -965,7 +972,7 @@ StringXNumber MeshOptions_Number[] = {
     "Allow transfinite contraints to be modified for Blossom or by global mesh size factor" },
   { F|O, "Format" , opt_mesh_file_format , FORMAT_AUTO ,
     "Mesh output format (1=msh, 2=unv, 10=automatic, 19=vrml, 27=stl, 30=mesh, 31=bdf, "
-    "32=cgns, 33=med, 40=ply2)" },
+    "32=cgns, 33=med, 40=ply2, 44=mshb)" },
 
   { F|O, "Hexahedra" , opt_mesh_hexahedra , 1. ,
     "Display mesh hexahedra?" },
@@ -1003,6 +1010,12 @@ StringXNumber MeshOptions_Number[] = {
   { F|O, "LineWidth" , opt_mesh_line_width , 1.0 ,
     "Display width of mesh lines (in pixels)" },
 
+  { F|O, "MaxNumThreads2D" , opt_mesh_max_num_threads_2d, 1. ,
+    "Maximum number of threads used for meshing surfaces concurrently "
+    "(requires OpenMP)" },
+  { F|O, "MaxNumThreads3D" , opt_mesh_max_num_threads_3d, 1. ,
+    "Maximum number of threads used for 3D Delaunay point insertion (requires "
+    "OpenMP)" },
   { F|O, "MeshOnlyVisible" , opt_mesh_mesh_only_visible, 0. ,
     "Mesh only visible entities (experimental: use with caution!)" },
   { F|O, "MetisAlgorithm" , opt_mesh_partition_metis_algorithm, 1. ,
@@ -1232,6 +1245,12 @@ StringXNumber PostProcessingOptions_Number[] = {
   { F|O, "ForceNodeData" , opt_post_force_node_data , 0. ,
     "Try to force saving datasets as NodeData" },
 
+  { F|O, "DeltaTolerance" , opt_post_delta_tolerance , 0. ,
+    "Quantization step used to save the time steps of views incrementally "
+    "(see SaveIncremental) as differences with respect to a previous step: "
+    "steps close to that step are then stored as small integers (0=always save "
+    "full steps)" },
+
   { F|O, "Format" , opt_post_file_format , 10. ,
     "Default file format for post-processing views (0=ASCII view, 1=binary "
     "view, 2=parsed view, 3=STL triangulation, 4=raw text, 5=Gmsh mesh, 6=MED file, "
@@ -1244,12 +1263,21 @@ StringXNumber PostProcessingOptions_Number[] = {
     "Post-processing view links (0=apply next option changes to selected views, "
     "1=force same options for all selected views)" },
 
+  { F|O, "MemoryLimit" , opt_post_memory_limit , 0. ,
+    "Maximum memory (in Mb) used by the post-processing data read from mesh "
+    "files; above this limit the least recently used time steps are unloaded, "
+    "and reloaded from the files when needed (0=no limit)" },
+
   { F,   "NbViews" , opt_post_nb_views , 0. ,
     "Current number of views merged (read-only)" },
 
   { F|O, "Plugins" , opt_post_plugins , 1. ,
     "Enable default post-processing plugins?" },
 
+  { F|O, "SaveIncremental" , opt_post_save_incremental , 0. ,
+    "Only append the new time steps when saving a view in a mesh file that "
+    "already contains its previous steps" },
+
   { F|O, "Smoothing" , opt_post_smooth , 0. ,
     "Apply (non-reversible) smoothing to post-processing view when merged" },
 
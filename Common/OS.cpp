@@ -29,6 +29,7 @@
 #include <unistd.h>
 #include <sys/time.h>
 #include <sys/resource.h>
+#include <sys/mman.h>
 #endif
 
 #if defined(WIN32)
@@ -170,6 +171,46 @@ FILE *Fopen(const char *f, const char *mode)
 #endif
 }
 
+char *MapFile(FILE *fp, size_t &size)
+{
+#if defined(WIN32) && !defined(__CYGWIN__)
+  // simply read the file in memory
+  long pos = ftell(fp);
+  if(pos < 0 || fseek(fp, 0, SEEK_END)) return 0;
+  long end = ftell(fp);
+  if(end <= 0){
+    fseek(fp, pos, SEEK_SET);
+    return 0;
+  }
+  size = end;
+  char *data = (char*)malloc(size);
+  rewind(fp);
+  if(data && fread(data, 1, size, fp) != size){
+    free(data);
+    data = 0;
+  }
+  fseek(fp, pos, SEEK_SET);
+  return data;
+#else
+  struct stat st;
+  if(fstat(fileno(fp), &st) || st.st_size <= 0) return 0;
+  size = st.st_size;
+  void *data = mmap(0, size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+  if(data == MAP_FAILED) return 0;
+  return (char*)data;
+#endif
+}
+
+void UnmapFile(char *data, size_t size)
+{
+  if(!data) return;
+#if defined(WIN32) && !defined(__CYGWIN__)
+  free(data);
+#else
+  munmap(data, size);
+#endif
+}
+
 const char *GetEnvironmentVar(const char *var)
 {
 #if defined(WIN32) && !defined(__CYGWIN__)
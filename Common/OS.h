@@ -27,5 +27,9 @@ int SystemCall(const std::string &command, bool blocking=false);
 std::string GetCurrentWorkdir();
 void RedirectIOToConsole();
 FILE *Fopen(const char* f, const char *mode);
+// read-only view of the whole content of an open file (memory mapped if
+// possible); returns 0 on failure
+char *MapFile(FILE *fp, size_t &size);
+void UnmapFile(char *data, size_t size);
 
 #endif
@@ -333,6 +333,9 @@ int MergeFile(const std::string &fileName, bool warnIfMissing, bool setWindowTit
   else if(ext == ".sat" || ext == ".SAT"){
     status = GModel::current()->readACISSAT(fileName);
   }
+  else if(ext == ".mshb" || ext == ".MSHB"){
+    status = GModel::current()->readMSHB(fileName);
+  }
   else if(ext == ".unv" || ext == ".UNV"){
     status = GModel::current()->readUNV(fileName);
   }
@@ -5572,6 +5572,27 @@ double opt_mesh_mesh_only_visible(OPT_ARGS_NUM)
   return CTX::instance()->mesh.meshOnlyVisible;
 }
 
+double opt_mesh_canonical_numbering(OPT_ARGS_NUM)
+{
+  if(action & GMSH_SET)
+    CTX::instance()->mesh.canonicalNumbering = (int)val;
+  return CTX::instance()->mesh.canonicalNumbering;
+}
+
+double opt_mesh_max_num_threads_2d(OPT_ARGS_NUM)
+{
+  if(action & GMSH_SET)
+    CTX::instance()->mesh.maxNumThreads2D = std::max(1, (int)val);
+  return CTX::instance()->mesh.maxNumThreads2D;
+}
+
+double opt_mesh_max_num_threads_3d(OPT_ARGS_NUM)
+{
+  if(action & GMSH_SET)
+    CTX::instance()->mesh.maxNumThreads3D = std::max(1, (int)val);
+  return CTX::instance()->mesh.maxNumThreads3D;
+}
+
 double opt_mesh_min_circ_points(OPT_ARGS_NUM)
 {
   if(action & GMSH_SET)
@@ -5707,6 +5728,13 @@ double opt_mesh_cgns_import_order(OPT_ARGS_NUM)
   return CTX::instance()->mesh.cgnsImportOrder;
 }
 
+double opt_mesh_deterministic_3d(OPT_ARGS_NUM)
+{
+  if(action & GMSH_SET)
+    CTX::instance()->mesh.deterministic3D = (int)val;
+  return CTX::instance()->mesh.deterministic3D;
+}
+
 double opt_mesh_dual(OPT_ARGS_NUM)
 {
   if(action & GMSH_SET) {
@@ -6277,6 +6305,27 @@ double opt_post_combine_remove_orig(OPT_ARGS_NUM)
   return CTX::instance()->post.combineRemoveOrig;
 }
 
+double opt_post_memory_limit(OPT_ARGS_NUM)
+{
+  if(action & GMSH_SET)
+    CTX::instance()->post.memoryLimit = val;
+  return CTX::instance()->post.memoryLimit;
+}
+
+double opt_post_save_incremental(OPT_ARGS_NUM)
+{
+  if(action & GMSH_SET)
+    CTX::instance()->post.saveIncremental = (int)val;
+  return CTX::instance()->post.saveIncremental;
+}
+
+double opt_post_delta_tolerance(OPT_ARGS_NUM)
+{
+  if(action & GMSH_SET)
+    CTX::instance()->post.deltaTolerance = val;
+  return CTX::instance()->post.deltaTolerance;
+}
+
 double opt_post_plugins(OPT_ARGS_NUM)
 {
   if(action & GMSH_SET)
@@ -0,0 +1,40 @@
+// Gmsh - Copyright (C) 1997-2013 C. Geuzaine, J.-F. Remacle
+//
+// See the LICENSE.txt file for license information. Please report all
+// bugs and problems to the public mailing list <gmsh@geuz.org>.
+
+#include <stdarg.h>
+#include "OutputBuffer.h"
+
+void outputBuffer::putDouble(double val)
+{
+  // snprintf is used (instead of a custom formatter) to get exactly the same
+  // digits as with fprintf; it does not lock the stream
+  char *p = _reserve(32);
+  int n = snprintf(p, 32, "%.16g", val);
+  if(n > 0) _size += n;
+}
+
+void outputBuffer::format(const char *fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  char *p = _reserve(256);
+  int n = vsnprintf(p, 256, fmt, args);
+  va_end(args);
+  if(n >= 256){
+    p = _reserve(n + 1);
+    va_start(args, fmt);
+    vsnprintf(p, n + 1, fmt, args);
+    va_end(args);
+  }
+  if(n > 0) _size += n;
+}
+
+bool outputBuffer::write(FILE *fp)
+{
+  bool ok = true;
+  if(_size) ok = (fwrite(&_data[0], 1, _size, fp) == _size);
+  _size = 0;
+  return ok;
+}
@@ -0,0 +1,91 @@
+// Gmsh - Copyright (C) 1997-2013 C. Geuzaine, J.-F. Remacle
+//
+// See the LICENSE.txt file for license information. Please report all
+// bugs and problems to the public mailing list <gmsh@geuz.org>.
+
+#ifndef _OUTPUT_BUFFER_H_
+#define _OUTPUT_BUFFER_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include "GmshMessage.h"
+
+// Memory buffer used to format (ASCII) or pack (binary) mesh and
+// post-processing data before writing it to a file in large blocks, which
+// avoids the overhead of one fprintf/fwrite call per value. Several
+// buffers can be filled concurrently, e.g. one per block of entities, and
+// then written to the file in order.
+class outputBuffer {
+ private:
+  std::vector<char> _data;
+  size_t _size;
+  inline char *_reserve(size_t n)
+  {
+    if(_size + n > _data.size()) _data.resize(2 * (_size + n));
+    return &_data[_size];
+  }
+ public:
+  outputBuffer() : _size(0) {}
+  size_t size() const { return _size; }
+  void clear(){ _size = 0; }
+  // raw bytes (binary files)
+  inline void put(const void *data, size_t n)
+  {
+    if(!n) return;
+    memcpy(_reserve(n), data, n);
+    _size += n;
+  }
+  inline void put(char c)
+  {
+    *_reserve(1) = c;
+    _size++;
+  }
+  inline void put(const char *str){ put(str, strlen(str)); }
+  // same output as fprintf(fp, "%d", val)
+  inline void putInt(int val)
+  {
+    char tmp[16];
+    int n = 0;
+    unsigned int u = (val < 0) ? -(unsigned int)val : val;
+    do{ tmp[n++] = '0' + u % 10; u /= 10; } while(u);
+    char *p = _reserve(n + 1);
+    if(val < 0) *p++ = '-';
+    while(n) *p++ = tmp[--n];
+    _size = p - &_data[0];
+  }
+  // same output as fprintf(fp, "%.16g", val)
+  void putDouble(double val);
+  // same output as fprintf(fp, fmt, ...)
+  void format(const char *fmt, ...);
+  // write the content of the buffer to the file and clear it
+  bool write(FILE *fp);
+};
+
+// Format the items 0 to n - 1 with f(buf, i) and write them to fp in order:
+// blocks of consecutive items are formatted concurrently in separate
+// buffers, and the buffers are written one after the other
+template <class F>
+bool writeInBlocks(FILE *fp, int n, F &f, int blockSize = 4096)
+{
+  const int numThreads = Msg::GetMaxThreads();
+  const int numBuffers = 4 * numThreads;
+  std::vector<outputBuffer> bufs(numBuffers);
+  bool ok = true;
+  for(int start = 0; start < n; start += numBuffers * blockSize){
+    const int nb = std::min(numBuffers, (n - start + blockSize - 1) / blockSize);
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic) num_threads(std::min(numThreads, nb))
+#endif
+    for(int b = 0; b < nb; b++){
+      const int end = std::min(n, start + (b + 1) * blockSize);
+      for(int i = start + b * blockSize; i < end; i++) f(bufs[b], i);
+    }
+    for(int b = 0; b < nb; b++)
+      if(!bufs[b].write(fp)) ok = false;
+  }
+  return ok;
+}
+
+#endif
@@ -0,0 +1,180 @@
+// Gmsh - Copyright (C) 1997-2013 C. Geuzaine, J.-F. Remacle
+//
+// See the LICENSE.txt file for license information. Please report all
+// bugs and problems to the public mailing list <gmsh@geuz.org>.
+
+#include <stdlib.h>
+#include <new>
+#include "SlabAllocator.h"
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+slabAllocator::threadCache *slabAllocator::_threadCaches = 0;
+
+slabAllocator::threadCache *slabAllocator::_getCache()
+{
+  for(threadCache *c = _threadCaches; c; c = c->nextInThread)
+    if(c->owner == this) return c;
+  threadCache *c = (threadCache*)calloc(1, sizeof(threadCache));
+  if(!c) throw std::bad_alloc();
+  c->owner = this;
+  c->nextInThread = _threadCaches;
+  _threadCaches = c;
+#if defined(_OPENMP)
+#pragma omp critical (slabAllocator)
+#endif
+  {
+    c->nextInAllocator = _caches;
+    _caches = c;
+  }
+  return c;
+}
+
+void slabAllocator::_refill(size_t n, threadClass &t)
+{
+  sizeClass &c = _classes[n];
+#if defined(_OPENMP)
+#pragma omp critical (slabAllocator)
+#endif
+  {
+    if(c.freeList){
+      // take a batch of the objects given back by the threads
+      void *last = c.freeList;
+      size_t k = 1;
+      while(k < batchSize && *(void**)last){
+        last = *(void**)last;
+        k++;
+      }
+      t.freeList = c.freeList;
+      t.numFree = k;
+      c.freeList = *(void**)last;
+      *(void**)last = 0;
+    }
+    else{
+      // the first "align" bytes of each slab link it to the previous one
+      char *s = (char*)malloc(slabSize);
+      if(s){
+        *(char**)s = c.slabs;
+        c.slabs = s;
+        c.numSlabs++;
+        t.next = s + align;
+        t.end = s + slabSize;
+      }
+    }
+  }
+}
+
+void slabAllocator::_flush(size_t n, threadClass &t)
+{
+  // give a batch of free objects back, for the other threads
+  void *first = t.freeList, *last = first;
+  for(size_t k = 1; k < batchSize; k++) last = *(void**)last;
+  t.freeList = *(void**)last;
+  t.numFree -= batchSize;
+  sizeClass &c = _classes[n];
+#if defined(_OPENMP)
+#pragma omp critical (slabAllocator)
+#endif
+  {
+    *(void**)last = c.freeList;
+    c.freeList = first;
+  }
+}
+
+void *slabAllocator::allocate(size_t size)
+{
+  if(size > maxSize) return ::operator new(size);
+  const size_t n = (size + align - 1) / align;
+  const size_t slot = n * align;
+  threadClass &t = _getCache()->classes[n];
+  if(!t.freeList && (size_t)(t.end - t.next) < slot) _refill(n, t);
+  void *p;
+  if(t.freeList){
+    p = t.freeList;
+    t.freeList = *(void**)p;
+    t.numFree--;
+  }
+  else if((size_t)(t.end - t.next) >= slot){
+    p = t.next;
+    t.next += slot;
+  }
+  else
+    throw std::bad_alloc();
+  t.numObjects++;
+  return p;
+}
+
+void slabAllocator::deallocate(void *p, size_t size)
+{
+  if(!p) return;
+  if(size > maxSize){
+    ::operator delete(p);
+    return;
+  }
+  const size_t n = (size + align - 1) / align;
+  threadClass &t = _getCache()->classes[n];
+  *(void**)p = t.freeList;
+  t.freeList = p;
+  t.numFree++;
+  t.numObjects--;
+  if(t.numFree >= 2 * batchSize) _flush(n, t);
+  // the objects can be allocated and deleted by different threads: the
+  // counts of all the threads are only checked outside of parallel regions
+#if defined(_OPENMP)
+  if(t.numObjects <= 0 && !omp_in_parallel()) _release(n, t);
+#else
+  if(t.numObjects <= 0) _release(n, t);
+#endif
+}
+
+void slabAllocator::_release(size_t n, threadClass &t)
+{
+  // no other thread is running: gather the counts of all the threads, so
+  // that this is only done again when all the objects have been deleted
+  long num = 0;
+  for(threadCache *c = _caches; c; c = c->nextInAllocator){
+    num += c->classes[n].numObjects;
+    c->classes[n].numObjects = 0;
+  }
+  t.numObjects = num;
+  sizeClass &c = _classes[n];
+  if(num > 0 || !c.slabs) return;
+  // keep the most recent slab, so that allocating and deleting a single
+  // object in a loop does not call malloc and free each time
+  char *s = *(char**)c.slabs;
+  while(s){
+    char *prev = *(char**)s;
+    free(s);
+    s = prev;
+  }
+  *(char**)c.slabs = 0;
+  c.freeList = 0;
+  c.numSlabs = 1;
+  for(threadCache *tc = _caches; tc; tc = tc->nextInAllocator){
+    threadClass &o = tc->classes[n];
+    o.freeList = 0;
+    o.numFree = 0;
+    o.next = o.end = 0;
+  }
+  t.next = c.slabs + align;
+  t.end = c.slabs + slabSize;
+}
+
+size_t slabAllocator::getMemory() const
+{
+  size_t mem = 0;
+  for(int i = 0; i < numClasses; i++)
+    mem += _classes[i].numSlabs * slabSize;
+  return mem;
+}
+
+size_t slabAllocator::getNumObjects() const
+{
+  long num = 0;
+  for(threadCache *c = _caches; c; c = c->nextInAllocator)
+    for(int i = 0; i < numClasses; i++)
+      num += c->classes[i].numObjects;
+  return num;
+}
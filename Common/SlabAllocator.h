@@ -0,0 +1,70 @@
+// Gmsh - Copyright (C) 1997-2013 C. Geuzaine, J.-F. Remacle
+//
+// See the LICENSE.txt file for license information. Please report all
+// bugs and problems to the public mailing list <gmsh@geuz.org>.
+
+#ifndef _SLAB_ALLOCATOR_H_
+#define _SLAB_ALLOCATOR_H_
+
+#include <stddef.h>
+
+// Allocator for large numbers of small objects (mesh vertices and
+// elements): objects of the same size class (a multiple of 16 bytes) are
+// carved out of 64 kB slabs by a pointer bump, and deleted objects are
+// recycled through a free list, which avoids the per-object malloc time
+// and memory overhead. Objects larger than 512 bytes are allocated with
+// the global operator new.
+//
+// Each thread has its own cache (a slab to carve objects from and a free
+// list) for each size class, so that allocating and deleting objects does
+// not require any locking: the shared pool is only locked to get a new
+// slab, or to exchange batches of free objects between threads. When the
+// last object of a size class is deleted outside of a parallel region
+// (e.g. when a model is destroyed) all the slabs of the class but one are
+// given back to the system at once.
+//
+// The allocator has no constructor, so that it can be used at namespace
+// scope (it is zero-initialized before any object gets allocated).
+class slabAllocator {
+ private:
+  enum { align = 16, maxSize = 512, slabSize = 1 << 16, batchSize = 256 };
+  enum { numClasses = maxSize / align + 1 };
+  // slabs and free objects shared by all the threads
+  struct sizeClass {
+    char *slabs; // linked list of slabs, most recent first
+    void *freeList;
+    size_t numSlabs;
+  };
+  // objects cached by a thread
+  struct threadClass {
+    void *freeList;
+    size_t numFree;
+    char *next, *end; // free space in the current slab of the thread
+    long numObjects; // objects allocated minus objects deleted by the thread
+  };
+  struct threadCache {
+    slabAllocator *owner;
+    threadCache *nextInThread, *nextInAllocator;
+    threadClass classes[numClasses];
+  };
+  sizeClass _classes[numClasses];
+  // all the thread caches of this allocator
+  threadCache *_caches;
+  // the caches of the current thread (one per allocator)
+  static threadCache *_threadCaches;
+#if defined(_OPENMP)
+#pragma omp threadprivate(_threadCaches)
+#endif
+  threadCache *_getCache();
+  void _refill(size_t n, threadClass &t);
+  void _flush(size_t n, threadClass &t);
+  void _release(size_t n, threadClass &t);
+ public:
+  void *allocate(size_t size);
+  void deallocate(void *p, size_t size);
+  // memory reserved in the slabs (in bytes) and number of live objects
+  size_t getMemory() const;
+  size_t getNumObjects() const;
+};
+
+#endif
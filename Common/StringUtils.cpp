@@ -4,6 +4,7 @@
 // bugs and problems to the public mailing list <gmsh@geuz.org>.
 
 #include <stdio.h>
+#include <algorithm>
 #if defined(__CYGWIN__)
 #include <sys/cygwin.h>
 #endif
@@ -13,14 +14,34 @@
 
 void SwapBytes(char *array, int size, int n)
 {
-  char *x = new char[size];
-  for(int i = 0; i < n; i++) {
-    char *a = &array[i * size];
-    memcpy(x, a, size);
-    for(int c = 0; c < size; c++)
-      a[size - 1 - c] = x[c];
+  // the 4 and 8 byte cases are written so that the compiler recognizes
+  // byte swaps, and vectorizes the loops
+  if(size == 4){
+    for(int i = 0; i < n; i++){
+      unsigned int u;
+      memcpy(&u, &array[4 * i], 4);
+      u = (u >> 24) | ((u >> 8) & 0xff00U) | ((u << 8) & 0xff0000U) | (u << 24);
+      memcpy(&array[4 * i], &u, 4);
+    }
+  }
+  else if(size == 8){
+    for(int i = 0; i < n; i++){
+      unsigned long long u;
+      memcpy(&u, &array[8 * i], 8);
+      u = (u >> 56) | ((u >> 40) & 0xff00ULL) | ((u >> 24) & 0xff0000ULL) |
+        ((u >> 8) & 0xff000000ULL) | ((u << 8) & 0xff00000000ULL) |
+        ((u << 24) & 0xff0000000000ULL) | ((u << 40) & 0xff000000000000ULL) |
+        (u << 56);
+      memcpy(&array[8 * i], &u, 8);
+    }
+  }
+  else{
+    for(int i = 0; i < n; i++){
+      char *a = &array[i * size];
+      for(int c = 0; c < size / 2; c++)
+        std::swap(a[c], a[size - 1 - c]);
+    }
   }
-  delete [] x;
 }
 
 std::string ExtractDoubleQuotedString(const char *str, int len)
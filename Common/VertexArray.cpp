@@ -13,8 +13,8 @@
 template<int N> float ElementDataLessThan<N>::tolerance = 0.0F;
 float BarycenterLessThan::tolerance = 0.0F;
 
-VertexArray::VertexArray(int numVerticesPerElement, int numElements)
-  : _numVerticesPerElement(numVerticesPerElement)
+VertexArray::VertexArray(int numVerticesPerElement, int numElements, bool chunk)
+  : _numVerticesPerElement(numVerticesPerElement), _chunk(chunk)
 {
   int nb = (numElements ? numElements : 1) * _numVerticesPerElement;
   _vertices.reserve(nb * 3);
@@ -55,6 +55,16 @@ void VertexArray::_addElement(MElement *ele)
   if(ele && CTX::instance()->pickElements) _elements.push_back(ele);
 }
 
+void VertexArray::_addBoundary(const ElementData<3> &e)
+{
+  ElementDataLessThan<3>::tolerance = (float)(CTX::instance()->lc * 1.e-12);
+  std::set<ElementData<3>, ElementDataLessThan<3> >::iterator it = _data3.find(e);
+  if(it == _data3.end())
+    _data3.insert(e);
+  else
+    _data3.erase(it);
+}
+
 void VertexArray::add(double *x, double *y, double *z, SVector3 *n,
                       unsigned int *col, MElement *ele, bool unique, bool boundary)
 {
@@ -81,16 +91,19 @@ void VertexArray::add(double *x, double *y, double *z, SVector3 *n, unsigned cha
 
   if(boundary && npe == 3){
     ElementData<3> e(x, y, z, n, r, g, b, a, ele);
-    ElementDataLessThan<3>::tolerance = (float)(CTX::instance()->lc * 1.e-12);
-    std::set<ElementData<3>, ElementDataLessThan<3> >::iterator it = _data3.find(e);
-    if(it == _data3.end())
-      _data3.insert(e);
+    if(_chunk)
+      _boundary.push_back(e);
     else
-      _data3.erase(it);
+      _addBoundary(e);
     return;
   }
 
-  if(unique){
+  if(_chunk){
+    // 1: unique, 2: normals, 4: colors, 8: element pointers
+    _flags.push_back((unique ? 1 : 0) | (n ? 2 : 0) | ((r && g && b && a) ? 4 : 0) |
+                     ((ele && CTX::instance()->pickElements) ? 8 : 0));
+  }
+  else if(unique){
     Barycenter pc(0.0F, 0.0F, 0.0F);
     for(int i = 0; i < npe; i++)
       pc += Barycenter(x[i], y[i], z[i]);
@@ -108,6 +121,57 @@ void VertexArray::add(double *x, double *y, double *z, SVector3 *n, unsigned cha
   }
 }
 
+void VertexArray::appendChunk(VertexArray *chunk)
+{
+  for(unsigned int i = 0; i < chunk->_boundary.size(); i++)
+    _addBoundary(chunk->_boundary[i]);
+
+  int npe = getNumVerticesPerElement();
+  BarycenterLessThan::tolerance = (float)(CTX::instance()->lc * 1.e-12);
+  int nv = 0, nn = 0, nc = 0, ne = 0;
+  for(unsigned int i = 0; i < chunk->_flags.size(); i++){
+    unsigned char flags = chunk->_flags[i];
+    bool add = true;
+    if(flags & 1){
+      // the vertices were stored as floats, so the barycenter is exactly
+      // the one computed by add()
+      const float *v = &chunk->_vertices[nv];
+      Barycenter pc(0.0F, 0.0F, 0.0F);
+      for(int j = 0; j < npe; j++)
+        pc += Barycenter(v[3 * j], v[3 * j + 1], v[3 * j + 2]);
+      if(_barycenters.find(pc) != _barycenters.end())
+        add = false;
+      else
+        _barycenters.insert(pc);
+    }
+    if(add){
+      _vertices.insert(_vertices.end(), chunk->_vertices.begin() + nv,
+                       chunk->_vertices.begin() + nv + 3 * npe);
+      if(flags & 2)
+        _normals.insert(_normals.end(), chunk->_normals.begin() + nn,
+                        chunk->_normals.begin() + nn + 3 * npe);
+      if(flags & 4)
+        _colors.insert(_colors.end(), chunk->_colors.begin() + nc,
+                       chunk->_colors.begin() + nc + 4 * npe);
+      if(flags & 8)
+        _elements.insert(_elements.end(), chunk->_elements.begin() + ne,
+                         chunk->_elements.begin() + ne + npe);
+    }
+    nv += 3 * npe;
+    if(flags & 2) nn += 3 * npe;
+    if(flags & 4) nc += 4 * npe;
+    if(flags & 8) ne += npe;
+  }
+
+  // keep the memory of the chunk, as it is usually filled again
+  chunk->_vertices.clear();
+  chunk->_normals.clear();
+  chunk->_colors.clear();
+  chunk->_elements.clear();
+  chunk->_flags.clear();
+  chunk->_boundary.clear();
+}
+
 void VertexArray::finalize()
 {
   if(_data3.size()){
@@ -144,6 +144,11 @@ class VertexArray{
   std::set<ElementData<3>, ElementDataLessThan<3> > _data3;
   std::set<Barycenter, BarycenterLessThan> _barycenters;
   //std::tr1::unordered_set<Barycenter, BarycenterHash, BarycenterEqual> _barycenters;
+  // chunk mode: what was added for each element (see the flags in add()),
+  // and the boundary triangles in the order they were added
+  bool _chunk;
+  std::vector<unsigned char> _flags;
+  std::vector<ElementData<3> > _boundary;
 
   // add stuff in the arrays
   void _addVertex(float x, float y, float z);
@@ -151,8 +156,13 @@ class VertexArray{
   void _addColor(unsigned char r, unsigned char g, unsigned char b,
                  unsigned char a);
   void _addElement(MElement *ele);
+  void _addBoundary(const ElementData<3> &e);
  public:
-  VertexArray(int numVerticesPerElement, int numElements);
+  // in chunk mode, the test for unique elements and the merging of the
+  // boundary triangles are postponed until the chunk is appended to another
+  // array with appendChunk(): chunks can thus be filled concurrently, and
+  // appending them in order gives the same array as filling it serially
+  VertexArray(int numVerticesPerElement, int numElements, bool chunk=false);
   ~VertexArray(){}
   // return the number of vertices in the array
   int getNumVertices() { return (int)_vertices.size() / 3; }
@@ -208,6 +218,8 @@ class VertexArray{
                           double &xmax, double &ymax, double &zmax);
   // merge another vertex array into this one
   void merge(VertexArray *va);
+  // append a vertex array filled in chunk mode to this one, and clear it
+  void appendChunk(VertexArray *chunk);
 };
 
 #endif
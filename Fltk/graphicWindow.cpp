@@ -274,6 +274,8 @@ static int _save_celum(const char *name){ return genericMeshFileDialog
     (name, "CELUM Options", FORMAT_CELUM, false, false); }
 static int _save_su2(const char *name){ return genericMeshFileDialog
     (name, "SU2 Options", FORMAT_SU2, false, false); }
+static int _save_mshb(const char *name){ return genericMeshFileDialog
+    (name, "MSHB Options", FORMAT_MSHB, false, false); }
 static int _save_med(const char *name){ return genericMeshFileDialog
     (name, "MED Options", FORMAT_MED, false, false); }
 static int _save_mesh(const char *name){ return genericMeshFileDialog
@@ -338,6 +340,7 @@ static int _save_auto(const char *name)
   case FORMAT_INP  : return _save_inp(name);
   case FORMAT_CELUM: return _save_celum(name);
   case FORMAT_SU2  : return _save_su2(name);
+  case FORMAT_MSHB : return _save_mshb(name);
   case FORMAT_P3D  : return _save_p3d(name);
   case FORMAT_IR3  : return _save_ir3(name);
   case FORMAT_STL  : return _save_stl(name);
@@ -376,6 +379,7 @@ static void file_save_as_cb(Fl_Widget *w, void *data)
     {"Geometry - OpenCASCADE BRep" TT "*.brep", _save_brep},
 #endif
     {"Mesh - Gmsh MSH" TT "*.msh", _save_msh},
+    {"Mesh - Gmsh Compact Binary" TT "*.mshb", _save_mshb},
     {"Mesh - Abaqus INP" TT "*.inp", _save_inp},
     {"Mesh - CELUM" TT "*.celum", _save_celum},
 #if defined(HAVE_LIBCGNS)
@@ -94,7 +94,7 @@ statisticsWindow::statisticsWindow(int deltaFontSize)
 
   int num = 0;
   int width = 26 * FL_NORMAL_SIZE;
-  int height = 5 * WB + 18 * BH;
+  int height = 5 * WB + 20 * BH;
 
   win = new paletteWindow
     (width, height, CTX::instance()->nonModalWindows ? true : false, "Statistics");
@@ -137,6 +137,11 @@ statisticsWindow::statisticsWindow(int deltaFontSize)
       value[num] = new Fl_Output(2 * WB, 2 * WB + 16 * BH, IW, BH, "Disto");
       value[num]->tooltip("~ min (J_min/J_0, J_0/J_max)"); num++;
 
+      value[num] = new Fl_Output(2 * WB, 2 * WB + 17 * BH, IW, BH, "Memory per element");
+      value[num]->tooltip("Bytes per element, including allocation overhead"); num++;
+      value[num] = new Fl_Output(2 * WB, 2 * WB + 18 * BH, IW, BH, "Memory per node");
+      value[num]->tooltip("Bytes per node, including allocation overhead"); num++;
+
       for(int i = 0; i < 4; i++){
         int ww = 3 * FL_NORMAL_SIZE;
         new Fl_Box
@@ -441,6 +446,9 @@ void statisticsWindow::compute(bool elementQuality)
     value[num]->value(label[num]); num++;
   }
 
+  sprintf(label[num], "%.4g B", s[36]); value[num]->value(label[num]); num++;
+  sprintf(label[num], "%.4g B", s[37]); value[num]->value(label[num]); num++;
+
   // post
   sprintf(label[num], "%g", s[26]); value[num]->value(label[num]); num++;
   sprintf(label[num], "%g", s[27]); value[num]->value(label[num]); num++;
@@ -171,6 +171,57 @@ GModel *GModel::findByName(const std::string &name, const std::string &fileName)
   return 0;
 }
 
+static int atomicIncrement(int &num)
+{
+#if defined(_OPENMP) && defined(__GNUC__)
+  return __sync_add_and_fetch(&num, 1);
+#else
+  int n;
+#if defined(_OPENMP)
+#pragma omp critical (GModel_numbers)
+#endif
+  n = ++num;
+  return n;
+#endif
+}
+
+static void atomicMax(int &num, int val)
+{
+#if defined(_OPENMP) && defined(__GNUC__)
+  int old = num;
+  while(old < val){
+    const int prev = __sync_val_compare_and_swap(&num, old, val);
+    if(prev == old) break;
+    old = prev;
+  }
+#else
+#if defined(_OPENMP)
+#pragma omp critical (GModel_numbers)
+#endif
+  num = std::max(num, val);
+#endif
+}
+
+int GModel::getNewVertexNumber()
+{
+  return atomicIncrement(_maxVertexNum);
+}
+
+int GModel::getNewElementNumber()
+{
+  return atomicIncrement(_maxElementNum);
+}
+
+void GModel::reserveVertexNumber(int num)
+{
+  atomicMax(_maxVertexNum, num);
+}
+
+void GModel::reserveElementNumber(int num)
+{
+  atomicMax(_maxElementNum, num);
+}
+
 void GModel::destroy()
 {
   _name.clear();
@@ -978,6 +1029,40 @@ int GModel::indexMeshVertices(bool all, int singlePartition, bool renumber)
   return numVertices;
 }
 
+void GModel::renumberMeshCanonically()
+{
+  std::vector<GEntity*> entities;
+  getEntities(entities);
+
+  // first number in each entity
+  std::vector<int> firstVertex(entities.size() + 1, 1);
+  std::vector<int> firstElement(entities.size() + 1, 1);
+  for(unsigned int i = 0; i < entities.size(); i++){
+    firstVertex[i + 1] = firstVertex[i] + entities[i]->mesh_vertices.size();
+    firstElement[i + 1] = firstElement[i] + entities[i]->getNumMeshElements();
+  }
+
+  // the maximum numbers of this model are set once after the loop
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic) \
+  num_threads(std::max(CTX::instance()->mesh.maxNumThreads2D, \
+                       CTX::instance()->mesh.maxNumThreads3D))
+#endif
+  for(int i = 0; i < (int)entities.size(); i++){
+    GEntity *ge = entities[i];
+    for(unsigned int j = 0; j < ge->mesh_vertices.size(); j++)
+      ge->mesh_vertices[j]->forceNum(firstVertex[i] + j, false);
+    for(unsigned int j = 0; j < ge->getNumMeshElements(); j++)
+      ge->getMeshElement(j)->forceNum(firstElement[i] + j, false);
+  }
+
+  // the numbering is now dense, so that the vertex and element caches will
+  // be vectors
+  _maxVertexNum = firstVertex.back() - 1;
+  _maxElementNum = firstElement.back() - 1;
+  destroyMeshCaches();
+}
+
 void GModel::scaleMesh(double factor)
 {
   std::vector<GEntity*> entities;
@@ -1516,10 +1601,8 @@ int GModel::removeDuplicateMeshVertices(double tolerance)
 
   std::vector<MVertex*> vertices;
   for(unsigned int i = 0; i < entities.size(); i++)
-    for(unsigned int j = 0; j < entities[i]->mesh_vertices.size(); j++){
-      MVertex *v = entities[i]->mesh_vertices[j];
-      vertices.push_back(new MVertex(v->x(), v->y(), v->z()));
-    }
+    vertices.insert(vertices.end(), entities[i]->mesh_vertices.begin(),
+                    entities[i]->mesh_vertices.end());
   MVertexPositionSet pos(vertices);
   for(unsigned int i = 0; i < vertices.size(); i++)
     pos.find(vertices[i]->x(), vertices[i]->y(), vertices[i]->z(), eps);
@@ -1530,12 +1613,24 @@ int GModel::removeDuplicateMeshVertices(double tolerance)
   Msg::Info("Found %d duplicate vertices ", num);
 
   if(!num){
-    for(unsigned int i = 0; i < vertices.size(); i++)
-      delete vertices[i];
     Msg::Info("No duplicate vertices found");
     return 0;
   }
 
+  // the vertices kept are now all tagged: get the one replacing each
+  // vertex concurrently, and index the vertices by their position in the
+  // vector
+  const int numVertices = vertices.size();
+  std::vector<MVertex*> unique(numVertices);
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+  for(int i = 0; i < numVertices; i++)
+    unique[i] = pos.findTagged(vertices[i]->x(), vertices[i]->y(),
+                               vertices[i]->z(), eps);
+  for(int i = 0; i < numVertices; i++)
+    vertices[i]->setIndex(i);
+
   std::map<int, std::vector<MElement*> > elements[10];
   for(unsigned int i = 0; i < entities.size(); i++){
     for(unsigned int j = 0; j < entities[i]->getNumMeshElements(); j++){
@@ -1543,7 +1638,12 @@ int GModel::removeDuplicateMeshVertices(double tolerance)
       std::vector<MVertex*> verts;
       for(int k = 0; k < e->getNumVertices(); k++){
         MVertex *v = e->getVertex(k);
-        MVertex *v2 = pos.find(v->x(), v->y(), v->z(), eps);
+        int idx = v->getIndex();
+        MVertex *v2;
+        if(idx >= 0 && idx < numVertices && vertices[idx] == v)
+          v2 = unique[idx];
+        else // vertex not stored in the entities
+          v2 = pos.findTagged(v->x(), v->y(), v->z(), eps);
         if(v2) verts.push_back(v2);
       }
       if((int)verts.size() == e->getNumVertices()){
@@ -1568,8 +1668,20 @@ int GModel::removeDuplicateMeshVertices(double tolerance)
     }
   }
 
-  for(unsigned int i = 0; i < entities.size(); i++)
+  // the vertices kept are reused: only delete the elements and the
+  // duplicate vertices
+  for(unsigned int i = 0; i < entities.size(); i++){
+    entities[i]->mesh_vertices.clear();
     entities[i]->deleteMesh();
+  }
+  for(int i = 0; i < numVertices; i++){
+    if(unique[i] != vertices[i]){
+      delete vertices[i];
+      vertices[i] = 0;
+    }
+    else
+      vertices[i]->setEntity(0);
+  }
 
   for(int i = 0; i < (int)(sizeof(elements) / sizeof(elements[0])); i++)
     _storeElementsInEntities(elements[i]);
@@ -48,6 +48,8 @@ class GModel
   std::set<GVertex*, GEntityLessThan> _chainVertices;
 
   int _readMSH2(const std::string &name);
+  // read a VTK file mapped in memory
+  int _readVTK(const char *data, size_t size, bool bigEndian);
   int _writeMSH2(const std::string &name, double version=2.2, bool binary=false,
                  bool saveAll=false, bool saveParametric=false,
                  double scalingFactor=1.0, int elementStartNum=0,
@@ -190,6 +192,12 @@ class GModel
   int getMaxElementNumber(){ return _maxElementNum; }
   void setMaxVertexNumber(int num){ _maxVertexNum = num; }
   void setMaxElementNumber(int num){ _maxElementNum = num; }
+  // thread-safe versions of the above, used when creating vertices and
+  // elements: get a new num, or make sure a given num is never handed out
+  int getNewVertexNumber();
+  int getNewElementNumber();
+  void reserveVertexNumber(int num);
+  void reserveElementNumber(int num);
   void checkPointMaxNumbers()
   {
     _checkPointedMaxVertexNum = _maxVertexNum;
@@ -380,6 +388,12 @@ class GModel
   // starting at 1
   int indexMeshVertices(bool all, int singlePartition=0, bool renumber=true);
 
+  // renumber all the mesh vertices and elements in a continuous sequence
+  // starting at 1, entity by entity (by dimension, then by tag) and in
+  // creation order inside each entity: the result does not depend on the
+  // order in which the entities were meshed
+  void renumberMeshCanonically();
+
   // scale the mesh by the given factor
   void scaleMesh(double factor);
 
@@ -615,6 +629,11 @@ class GModel
                           bool saveAll=false, bool saveParametric=false,
                           double scalingFactor=1.0);
 
+  // Gmsh compact binary mesh format (flat per-block arrays)
+  int readMSHB(const std::string &name);
+  int writeMSHB(const std::string &name, bool saveAll=false,
+                double scalingFactor=1.0);
+
   // Iridium file format
   int writeIR3(const std::string &name, int elementTagType,
                bool saveAll, double scalingFactor);
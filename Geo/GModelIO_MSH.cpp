@@ -16,6 +16,7 @@
 #include "MPrism.h"
 #include "MPyramid.h"
 #include "StringUtils.h"
+#include "OutputBuffer.h"
 
 void writeMSHPeriodicNodes(FILE *fp, std::vector<GEntity*> &entities)
 {
@@ -432,22 +433,49 @@ static int getNumElementsMSH(GEntity *ge, bool saveAll, int saveSinglePartition)
   return n;
 }
 
-static void writeElementMSH(FILE *fp, GModel *model, MElement *ele, bool binary,
-                            int elementary)
-{
-  if(model->getGhostCells().size()){
-    std::vector<short> ghosts;
-    std::pair<std::multimap<MElement*, short>::iterator,
-              std::multimap<MElement*, short>::iterator> itp =
-      model->getGhostCells().equal_range(ele);
-    for(std::multimap<MElement*, short>::iterator it = itp.first;
-        it != itp.second; it++)
-      ghosts.push_back(it->second);
-    ele->writeMSH(fp, binary, elementary, &ghosts);
+// formats the mesh vertices
+class vertexWriterMSH {
+ private:
+  bool _binary, _saveParametric;
+  double _scalingFactor;
+ public:
+  std::vector<MVertex*> vertices;
+  vertexWriterMSH(bool binary, bool saveParametric, double scalingFactor)
+    : _binary(binary), _saveParametric(saveParametric),
+      _scalingFactor(scalingFactor) {}
+  void operator()(outputBuffer &buf, int i)
+  {
+    vertices[i]->writeMSH(buf, _binary, _saveParametric, _scalingFactor);
   }
-  else
-    ele->writeMSH(fp, binary, elementary);
-}
+};
+
+// formats the mesh elements of an entity
+class elementWriterMSH {
+ private:
+  GModel *_model;
+  bool _binary;
+  int _elementary;
+ public:
+  std::vector<MElement*> elements;
+  elementWriterMSH(GModel *model, bool binary, int elementary)
+    : _model(model), _binary(binary), _elementary(elementary) {}
+  void operator()(outputBuffer &buf, int i)
+  {
+    MElement *ele = elements[i];
+    if(_model->getGhostCells().size()){
+      std::vector<short> ghosts;
+      std::pair<std::multimap<MElement*, short>::iterator,
+                std::multimap<MElement*, short>::iterator> itp =
+        _model->getGhostCells().equal_range(ele);
+      for(std::multimap<MElement*, short>::iterator it = itp.first;
+          it != itp.second; it++)
+        ghosts.push_back(it->second);
+      ele->writeMSH(buf, _binary, _elementary, &ghosts);
+    }
+    else
+      ele->writeMSH(buf, _binary, _elementary);
+  }
+};
 
 template<class T>
 static void writeElementsMSH(FILE *fp, GModel *model, GEntity *ge, std::vector<T*> &ele,
@@ -455,11 +483,13 @@ static void writeElementsMSH(FILE *fp, GModel *model, GEntity *ge, std::vector<T
 {
   if(!saveAll && ge->physicals.empty()) return;
 
+  elementWriterMSH w(model, binary, ge->tag());
   for(unsigned int i = 0; i < ele.size(); i++){
     if(saveSinglePartition && ele[i]->getPartition() != saveSinglePartition)
       continue;
-    writeElementMSH(fp, model, ele[i], binary, ge->tag());
+    w.elements.push_back(ele[i]);
   }
+  writeInBlocks(fp, w.elements.size(), w);
 }
 
 int GModel::writeMSH(const std::string &name, double version, bool binary,
@@ -542,9 +572,11 @@ int GModel::writeMSH(const std::string &name, double version, bool binary,
 
   fprintf(fp, "$Nodes\n");
   fprintf(fp, "%d\n", numVertices);
+  vertexWriterMSH vw(binary, saveParametric, scalingFactor);
   for(unsigned int i = 0; i < entities.size(); i++)
-    for(unsigned int j = 0; j < entities[i]->mesh_vertices.size(); j++)
-      entities[i]->mesh_vertices[j]->writeMSH(fp, binary, saveParametric, scalingFactor);
+    vw.vertices.insert(vw.vertices.end(), entities[i]->mesh_vertices.begin(),
+                       entities[i]->mesh_vertices.end());
+  writeInBlocks(fp, vw.vertices.size(), vw);
 
   if(binary) fprintf(fp, "\n");
   fprintf(fp, "$EndNodes\n");
@@ -10,6 +10,7 @@
 #include <sstream>
 #include <cassert>
 #include <iomanip>
+#include <algorithm>
 #include "GModel.h"
 #include "OS.h"
 #include "GmshDefines.h"
@@ -26,6 +27,7 @@
 #include "GmshMessage.h"
 #include "Context.h"
 #include "OS.h"
+#include "OutputBuffer.h"
 
 #define FAST_ELEMENTS 1
 
@@ -59,6 +61,211 @@ static bool getVertices(int num, int *indices, std::vector<MVertex*> &vec,
   return true;
 }
 
+// Large $Nodes and $Elements sections are parsed in parallel: the file is
+// mapped in memory, the lines of the section are split into chunks of
+// consecutive lines, and each chunk is parsed by a different thread. If
+// anything goes wrong (e.g. a line that does not contain exactly one node
+// or element), the section is read again sequentially with fscanf/fread.
+
+static const int minNumParallelMSH2 = 10000;
+
+static inline void skipBlanks(const char *&p, const char *end)
+{
+  while(p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+}
+
+static inline bool scanInt(const char *&p, const char *end, int &val)
+{
+  skipBlanks(p, end);
+  bool neg = false;
+  if(p < end && (*p == '-' || *p == '+')) neg = (*p++ == '-');
+  if(p == end || *p < '0' || *p > '9') return false;
+  int v = 0;
+  while(p < end && *p >= '0' && *p <= '9') v = 10 * v + (*p++ - '0');
+  val = neg ? -v : v;
+  return true;
+}
+
+static inline bool scanDouble(const char *&p, const char *end, double &val)
+{
+  skipBlanks(p, end);
+  if(p == end || *p == '\n') return false;
+  // strtod gives the same (correctly rounded) result as fscanf, and always
+  // stops before the end of the line
+  char *q;
+  val = strtod(p, &q);
+  if(q == p) return false;
+  p = q;
+  return true;
+}
+
+static inline bool scanEndOfLine(const char *&p, const char *end)
+{
+  skipBlanks(p, end);
+  if(p == end || *p != '\n') return false;
+  p++;
+  return true;
+}
+
+// split the "numLines" lines starting at "p" into "numChunks" chunks:
+// chunk i contains lines [i * numLines / numChunks, (i + 1) * numLines /
+// numChunks) and starts at chunks[i]; chunks[numChunks] is the end of the
+// last line
+static bool splitLines(const char *p, const char *end, int numLines,
+                       int numChunks, std::vector<const char*> &chunks)
+{
+  chunks.resize(numChunks + 1);
+  int c = 0;
+  for(int i = 0; i < numLines; i++){
+    while(c < numChunks && (long long)c * numLines / numChunks == i)
+      chunks[c++] = p;
+    p = (const char*)memchr(p, '\n', end - p);
+    if(!p) return false;
+    p++;
+  }
+  while(c <= numChunks) chunks[c++] = p;
+  return true;
+}
+
+static int getNumChunksMSH2(int numLines)
+{
+  return std::max(1, std::min(numLines / 1000, 8 * Msg::GetMaxThreads()));
+}
+
+// read the tags and coordinates of the "numVertices" nodes starting at the
+// current position in fp, and move after the last node
+static bool readNodesMSH2(FILE *fp, bool binary, bool swap, int numVertices,
+                          std::vector<int> &nums, std::vector<double> &xyz)
+{
+  long start = ftell(fp);
+  size_t size;
+  char *data = (start < 0) ? 0 : MapFile(fp, size);
+  if(!data) return false;
+  if((size_t)start > size){
+    UnmapFile(data, size);
+    return false;
+  }
+  const char *beg = data + start, *end = data + size, *last = 0;
+  nums.resize(numVertices);
+  xyz.resize(3 * numVertices);
+  if(binary){
+    const size_t rec = sizeof(int) + 3 * sizeof(double);
+    if((size_t)(end - beg) / rec >= (size_t)numVertices){
+#if defined(_OPENMP)
+      const int numThreads = Msg::GetMaxThreads();
+#pragma omp parallel for num_threads(numThreads)
+#endif
+      for(int i = 0; i < numVertices; i++){
+        memcpy(&nums[i], beg + i * rec, sizeof(int));
+        memcpy(&xyz[3 * i], beg + i * rec + sizeof(int), 3 * sizeof(double));
+      }
+      if(swap){
+        SwapBytes((char*)&nums[0], sizeof(int), numVertices);
+        SwapBytes((char*)&xyz[0], sizeof(double), 3 * numVertices);
+      }
+      last = beg + numVertices * rec;
+    }
+  }
+  else{
+    const int numChunks = getNumChunksMSH2(numVertices);
+    std::vector<const char*> chunks;
+    if(splitLines(beg, end, numVertices, numChunks, chunks)){
+      int errors = 0;
+#if defined(_OPENMP)
+      const int numThreads = std::min(numChunks, Msg::GetMaxThreads());
+#pragma omp parallel for schedule(dynamic) reduction(+:errors) \
+  num_threads(numThreads)
+#endif
+      for(int c = 0; c < numChunks; c++){
+        const char *p = chunks[c];
+        for(int i = (long long)c * numVertices / numChunks; p < chunks[c + 1]; i++){
+          if(!scanInt(p, end, nums[i]) || !scanDouble(p, end, xyz[3 * i]) ||
+             !scanDouble(p, end, xyz[3 * i + 1]) ||
+             !scanDouble(p, end, xyz[3 * i + 2]) || !scanEndOfLine(p, end)){
+            errors++;
+            break;
+          }
+        }
+      }
+      if(!errors) last = chunks[numChunks];
+    }
+  }
+  if(last) fseek(fp, last - data, SEEK_SET);
+  UnmapFile(data, size);
+  return last != 0;
+}
+
+// read all the integers in the "numElements" lines starting at the current
+// position in fp (one vector per chunk of lines), and move after the last
+// line
+static bool readElementsMSH2(FILE *fp, int numElements,
+                             std::vector<std::vector<int> > &values)
+{
+  long start = ftell(fp);
+  size_t size;
+  char *data = (start < 0) ? 0 : MapFile(fp, size);
+  if(!data) return false;
+  if((size_t)start > size){
+    UnmapFile(data, size);
+    return false;
+  }
+  const char *beg = data + start, *end = data + size, *last = 0;
+  const int numChunks = getNumChunksMSH2(numElements);
+  std::vector<const char*> chunks;
+  if(splitLines(beg, end, numElements, numChunks, chunks)){
+    values.resize(numChunks);
+    int errors = 0;
+#if defined(_OPENMP)
+    const int numThreads = std::min(numChunks, Msg::GetMaxThreads());
+#pragma omp parallel for schedule(dynamic) reduction(+:errors) \
+  num_threads(numThreads)
+#endif
+    for(int c = 0; c < numChunks; c++){
+      const char *p = chunks[c];
+      // each integer takes at least 2 characters
+      values[c].reserve((chunks[c + 1] - chunks[c]) / 2);
+      while(p < chunks[c + 1]){
+        int v;
+        if(scanInt(p, end, v)) values[c].push_back(v);
+        else if(!scanEndOfLine(p, end)){
+          errors++;
+          break;
+        }
+      }
+    }
+    if(!errors) last = chunks[numChunks];
+    else values.clear();
+  }
+  if(last) fseek(fp, last - data, SEEK_SET);
+  UnmapFile(data, size);
+  return last != 0;
+}
+
+// the integers of an ASCII $Elements section, parsed beforehand by
+// readElementsMSH2 and then read from the file: the elements can span more
+// lines than the pre-parsed ones (the file position is then at the end of
+// the pre-parsed lines)
+class elementReaderMSH2 {
+ private:
+  FILE *_fp;
+  std::vector<std::vector<int> > _values;
+  unsigned int _chunk, _pos;
+ public:
+  elementReaderMSH2(FILE *fp) : _fp(fp), _chunk(0), _pos(0) {}
+  std::vector<std::vector<int> > &values(){ return _values; }
+  bool get(int &v)
+  {
+    while(_chunk < _values.size() && _pos == _values[_chunk].size()){
+      // free the memory as we go
+      std::vector<int>().swap(_values[_chunk++]);
+      _pos = 0;
+    }
+    if(_chunk == _values.size()) return fscanf(_fp, "%d", &v) == 1;
+    v = _values[_chunk][_pos++];
+    return true;
+  }
+};
+
 static MElement *createElementMSH2(GModel *m, int num, int typeMSH, int physical,
                                    int reg, int part, std::vector<MVertex*> &v,
                                    std::map<int, std::vector<MElement*> > elements[10],
@@ -256,7 +463,46 @@ int GModel::_readMSH2(const std::string &name)
       vertexMap.clear();
       minVertex = numVertices + 1;
       int maxVertex = -1;
-      for(int i = 0; i < numVertices; i++) {
+      std::vector<int> nums;
+      std::vector<double> coords;
+      bool parsed = false;
+      if(!parametric && numVertices >= minNumParallelMSH2 &&
+         readNodesMSH2(fp, binary, swap, numVertices, nums, coords)){
+        std::vector<MVertex*> verts(numVertices);
+#if defined(_OPENMP)
+        const int numThreads = Msg::GetMaxThreads();
+#pragma omp parallel for num_threads(numThreads)
+#endif
+        for(int i = 0; i < numVertices; i++)
+          verts[i] = new MVertex(coords[3 * i], coords[3 * i + 1],
+                                 coords[3 * i + 2], 0, nums[i]);
+        for(int i = 0; i < numVertices; i++){
+          minVertex = std::min(minVertex, nums[i]);
+          maxVertex = std::max(maxVertex, nums[i]);
+        }
+        // fill the vector directly if the numbering is dense
+        bool dense = ((minVertex == 1 && maxVertex == numVertices) ||
+                      (minVertex == 0 && maxVertex == numVertices - 1));
+        if(dense){
+          vertexVector.assign(numVertices + 1, (MVertex*)0);
+          for(int i = 0; i < numVertices && dense; i++){
+            if(vertexVector[nums[i]]) dense = false;
+            vertexVector[nums[i]] = verts[i];
+          }
+        }
+        if(dense)
+          Msg::Info("Vertex numbering is dense");
+        else{
+          vertexVector.clear();
+          for(int i = 0; i < numVertices; i++){
+            if(vertexMap.count(nums[i]))
+              Msg::Warning("Skipping duplicate vertex %d", nums[i]);
+            vertexMap[nums[i]] = verts[i];
+          }
+        }
+        parsed = true;
+      }
+      for(int i = 0; i < numVertices && !parsed; i++) {
         int num;
         double xyz[3], uv[2];
         MVertex *newVertex = 0;
@@ -336,7 +582,7 @@ int GModel::_readMSH2(const std::string &name)
       }
       // If the vertex numbering is dense, transfer the map into a
       // vector to speed up element creation
-      if((int)vertexMap.size() == numVertices &&
+      if(!parsed && (int)vertexMap.size() == numVertices &&
          ((minVertex == 1 && maxVertex == numVertices) ||
           (minVertex == 0 && maxVertex == numVertices - 1))){
         Msg::Info("Vertex numbering is dense");
@@ -368,13 +614,16 @@ int GModel::_readMSH2(const std::string &name)
       Msg::Info("%d elements", numElements);
       Msg::ResetProgressMeter();
       if(!binary){
+        elementReaderMSH2 in(fp);
+        if(numElements >= minNumParallelMSH2)
+          readElementsMSH2(fp, numElements, in.values());
         for(int i = 0; i < numElements; i++) {
           int num, type, physical = 0, elementary = 0, partition = 0, parent = 0;
           int dom1 = 0, dom2 = 0, numVertices;
           std::vector<short> ghosts;
           if(version <= 1.0){
-            if(fscanf(fp, "%d %d %d %d %d", &num, &type, &physical, &elementary,
-                      &numVertices) != 5){
+            if(!in.get(num) || !in.get(type) || !in.get(physical) ||
+               !in.get(elementary) || !in.get(numVertices)){
               fclose(fp);
               return 0;
             }
@@ -382,11 +631,11 @@ int GModel::_readMSH2(const std::string &name)
           }
           else{
             int numTags;
-            if(fscanf(fp, "%d %d %d", &num, &type, &numTags) != 3){ fclose(fp); return 0; }
+            if(!in.get(num) || !in.get(type) || !in.get(numTags)){ fclose(fp); return 0; }
             int numPartitions = 0;
             for(int j = 0; j < numTags; j++){
               int tag;
-              if(fscanf(fp, "%d", &tag) != 1){ fclose(fp); return 0; }
+              if(!in.get(tag)){ fclose(fp); return 0; }
               if(j == 0) physical = tag;
               else if(j == 1) elementary = tag;
               else if(version < 2.2 && j == 2) partition = tag;
@@ -397,7 +646,7 @@ int GModel::_readMSH2(const std::string &name)
                 parent = tag;
               else if(j == 3 + numPartitions && (numTags == 5 + numPartitions)) {
                 dom1 = tag; j++;
-                if(fscanf(fp, "%d", &dom2) != 1){ fclose(fp); return 0; }
+                if(!in.get(dom2)){ fclose(fp); return 0; }
               }
             }
             if(!(numVertices = MElement::getInfoMSH(type))) {
@@ -405,12 +654,12 @@ int GModel::_readMSH2(const std::string &name)
                 fclose(fp);
                 return 0;
               }
-              if(fscanf(fp, "%d", &numVertices) != 1){ fclose(fp); return 0; }
+              if(!in.get(numVertices)){ fclose(fp); return 0; }
             }
           }
           int *indices = new int[numVertices];
           for(int j = 0; j < numVertices; j++)
-            if(fscanf(fp, "%d", &indices[j]) != 1){ fclose(fp); return 0; }
+            if(!in.get(indices[j])){ fclose(fp); return 0; }
           std::vector<MVertex*> vertices;
           if(vertexVector.size()){
             if(!getVertices(numVertices, indices, vertexVector, vertices, minVertex)){
@@ -680,33 +929,97 @@ int GModel::_readMSH2(const std::string &name)
   return postpro ? 2 : 1;
 }
 
-template<class T>
-static void writeElementMSH(FILE *fp, GModel *model, T *ele, bool saveAll,
-                            double version, bool binary, int &num, int elementary,
-                            std::vector<int> &physicals, int parentNum = 0,
-                            int dom1Num = 0, int dom2Num = 0)
-{
-  std::vector<short> ghosts;
-  if(model->getGhostCells().size()){
-    std::pair<std::multimap<MElement*, short>::iterator,
-              std::multimap<MElement*, short>::iterator> itp =
-      model->getGhostCells().equal_range(ele);
-    for(std::multimap<MElement*, short>::iterator it = itp.first;
-        it != itp.second; it++)
-      ghosts.push_back(it->second);
+// formats the mesh vertices
+class vertexWriterMSH2 {
+ private:
+  bool _binary, _saveParametric;
+  double _scalingFactor;
+ public:
+  std::vector<MVertex*> vertices;
+  vertexWriterMSH2(bool binary, bool saveParametric, double scalingFactor)
+    : _binary(binary), _saveParametric(saveParametric),
+      _scalingFactor(scalingFactor) {}
+  void operator()(outputBuffer &buf, int i)
+  {
+    vertices[i]->writeMSH2(buf, _binary, _saveParametric, _scalingFactor);
   }
+};
+
+// element records collected while traversing the model; they are
+// formatted concurrently by blocks when enough of them have been collected
+class elementWriterMSH2 {
+ private:
+  struct record {
+    MElement *ele;
+    int num, elementary, physicals, parentNum, dom1Num, dom2Num;
+  };
+  FILE *_fp;
+  GModel *_model;
+  double _version;
+  bool _binary, _saveAll;
+  std::vector<record> _records;
+  // physical tags of the records (consecutive records usually share them)
+  std::vector<std::vector<int> > _physicals;
+ public:
+  elementWriterMSH2(FILE *fp, GModel *model, double version, bool binary,
+                    bool saveAll)
+    : _fp(fp), _model(model), _version(version), _binary(binary),
+      _saveAll(saveAll) {}
+  // element "ele" will be saved with numbers starting after "num"
+  void add(MElement *ele, int num, int elementary, std::vector<int> &physicals,
+           int parentNum, int dom1Num, int dom2Num)
+  {
+    if(_physicals.empty() || _physicals.back() != physicals)
+      _physicals.push_back(physicals);
+    record r = {ele, num, elementary, (int)_physicals.size() - 1, parentNum,
+                dom1Num, dom2Num};
+    _records.push_back(r);
+    if(_records.size() >= 100000) flush();
+  }
+  void flush()
+  {
+    writeInBlocks(_fp, _records.size(), *this);
+    _records.clear();
+    _physicals.clear();
+  }
+  void operator()(outputBuffer &buf, int i)
+  {
+    const record &r = _records[i];
+    std::vector<short> ghosts;
+    if(_model->getGhostCells().size()){
+      std::pair<std::multimap<MElement*, short>::iterator,
+                std::multimap<MElement*, short>::iterator> itp =
+        _model->getGhostCells().equal_range(r.ele);
+      for(std::multimap<MElement*, short>::iterator it = itp.first;
+          it != itp.second; it++)
+        ghosts.push_back(it->second);
+    }
 
-  if(saveAll)
-    ele->writeMSH2(fp, version, binary, ++num, elementary, 0,
-                   parentNum, dom1Num, dom2Num, &ghosts);
-  else{
-    if(parentNum) parentNum = parentNum - physicals.size() + 1;
-    for(unsigned int j = 0; j < physicals.size(); j++){
-      ele->writeMSH2(fp, version, binary, ++num, elementary, physicals[j],
-                     parentNum, dom1Num, dom2Num, &ghosts);
-      if(parentNum) parentNum++;
+    int num = r.num;
+    if(_saveAll)
+      r.ele->writeMSH2(buf, _version, _binary, ++num, r.elementary, 0,
+                       r.parentNum, r.dom1Num, r.dom2Num, &ghosts);
+    else{
+      std::vector<int> &physicals = _physicals[r.physicals];
+      int parentNum = r.parentNum;
+      if(parentNum) parentNum = parentNum - physicals.size() + 1;
+      for(unsigned int j = 0; j < physicals.size(); j++){
+        r.ele->writeMSH2(buf, _version, _binary, ++num, r.elementary, physicals[j],
+                         parentNum, r.dom1Num, r.dom2Num, &ghosts);
+        if(parentNum) parentNum++;
+      }
     }
   }
+};
+
+template<class T>
+static void writeElementMSH(elementWriterMSH2 &w, GModel *model, T *ele,
+                            bool saveAll, int &num, int elementary,
+                            std::vector<int> &physicals, int parentNum = 0,
+                            int dom1Num = 0, int dom2Num = 0)
+{
+  w.add(ele, num, elementary, physicals, parentNum, dom1Num, dom2Num);
+  num += saveAll ? 1 : physicals.size();
 
   model->setMeshElementIndex(ele, num); // should really be a multimap...
 
@@ -715,9 +1028,9 @@ static void writeElementMSH(FILE *fp, GModel *model, T *ele, bool saveAll,
 }
 
 template<class T>
-static void writeElementsMSH(FILE *fp, GModel *model, std::vector<T*> &ele,
-                             bool saveAll, int saveSinglePartition, double version,
-                             bool binary, int &num, int elementary,
+static void writeElementsMSH(elementWriterMSH2 &w, GModel *model, std::vector<T*> &ele,
+                             bool saveAll, int saveSinglePartition, int &num,
+                             int elementary,
                              std::vector<int> &physicals)
 {
   // Hack to save each partition as a separate physical entity
@@ -737,7 +1050,7 @@ static void writeElementsMSH(FILE *fp, GModel *model, std::vector<T*> &ele,
         newPhysicals.push_back((maxPhysical - elementary) * offset);
       }
       ele[i]->setPartition(0);
-      writeElementMSH(fp, model, ele[i], saveAll, version, binary, num,
+      writeElementMSH(w, model, ele[i], saveAll, num,
                       newElementary, newPhysicals);
     }
     return;
@@ -752,7 +1065,7 @@ static void writeElementsMSH(FILE *fp, GModel *model, std::vector<T*> &ele,
     MElement *parent = ele[i]->getParent();
     if(parent)
       parentNum = model->getMeshElementIndex(parent);
-    writeElementMSH(fp, model, ele[i], saveAll, version, binary, num,
+    writeElementMSH(w, model, ele[i], saveAll, num,
                     elementary, physicals, parentNum);
   }
 }
@@ -837,6 +1150,27 @@ static int getNumElementsMSH(GModel *m, bool saveAll, int saveSinglePartition)
   return n;
 }
 
+static void writeHeaderMSH2(FILE *fp, GModel *m, double version, bool binary)
+{
+  fprintf(fp, "$MeshFormat\n");
+  fprintf(fp, "%g %d %d\n", version, binary ? 1 : 0, (int)sizeof(double));
+  if(binary){
+    int one = 1;
+    fwrite(&one, sizeof(int), 1, fp);
+    fprintf(fp, "\n");
+  }
+  fprintf(fp, "$EndMeshFormat\n");
+
+  if(m->numPhysicalNames()){
+    fprintf(fp, "$PhysicalNames\n");
+    fprintf(fp, "%d\n", m->numPhysicalNames());
+    for(GModel::piter it = m->firstPhysicalName(); it != m->lastPhysicalName(); it++)
+      fprintf(fp, "%d %d \"%s\"\n", it->first.first, it->first.second,
+              it->second.c_str());
+    fprintf(fp, "$EndPhysicalNames\n");
+  }
+}
+
 int GModel::_writeMSH2(const std::string &name, double version, bool binary,
                        bool saveAll, bool saveParametric, double scalingFactor,
                        int elementStartNum, int saveSinglePartition, bool multipleView)
@@ -868,23 +1202,7 @@ int GModel::_writeMSH2(const std::string &name, double version, bool binary,
   int numElements = getNumElementsMSH(this, saveAll, saveSinglePartition);
 
   if(version >= 2.0){
-    fprintf(fp, "$MeshFormat\n");
-    fprintf(fp, "%g %d %d\n", version, binary ? 1 : 0, (int)sizeof(double));
-    if(binary){
-      int one = 1;
-      fwrite(&one, sizeof(int), 1, fp);
-      fprintf(fp, "\n");
-    }
-    fprintf(fp, "$EndMeshFormat\n");
-
-    if(numPhysicalNames()){
-      fprintf(fp, "$PhysicalNames\n");
-      fprintf(fp, "%d\n", numPhysicalNames());
-      for(piter it = firstPhysicalName(); it != lastPhysicalName(); it++)
-        fprintf(fp, "%d %d \"%s\"\n", it->first.first, it->first.second,
-                it->second.c_str());
-      fprintf(fp, "$EndPhysicalNames\n");
-    }
+    writeHeaderMSH2(fp, this, version, binary);
 
     if (saveParametric)
       fprintf(fp, "$ParametricNodes\n");
@@ -898,10 +1216,11 @@ int GModel::_writeMSH2(const std::string &name, double version, bool binary,
 
   std::vector<GEntity*> entities;
   getEntities(entities);
+  vertexWriterMSH2 vw(binary, saveParametric, scalingFactor);
   for(unsigned int i = 0; i < entities.size(); i++)
-    for(unsigned int j = 0; j < entities[i]->mesh_vertices.size(); j++)
-      entities[i]->mesh_vertices[j]->writeMSH2(fp, binary, saveParametric,
-                                               scalingFactor);
+    vw.vertices.insert(vw.vertices.end(), entities[i]->mesh_vertices.begin(),
+                       entities[i]->mesh_vertices.end());
+  writeInBlocks(fp, vw.vertices.size(), vw);
 
   if(binary) fprintf(fp, "\n");
 
@@ -919,6 +1238,7 @@ int GModel::_writeMSH2(const std::string &name, double version, bool binary,
 
   fprintf(fp, "%d\n", numElements);
   int num = elementStartNum;
+  elementWriterMSH2 w(fp, this, version, binary, saveAll);
 
   _elementIndexCache.clear();
 
@@ -927,86 +1247,86 @@ int GModel::_writeMSH2(const std::string &name, double version, bool binary,
    for(viter it = firstVertex(); it != lastVertex(); ++it)
      for(unsigned int i = 0; i < (*it)->points.size(); i++)
        if((*it)->points[i]->ownsParent())
-         writeElementMSH(fp, this, (*it)->points[i]->getParent(),
-                         saveAll, version, binary, num, (*it)->tag(), (*it)->physicals);
+         writeElementMSH(w, this, (*it)->points[i]->getParent(),
+                         saveAll, num, (*it)->tag(), (*it)->physicals);
    for(eiter it = firstEdge(); it != lastEdge(); ++it)
      for(unsigned int i = 0; i < (*it)->lines.size(); i++)
        if((*it)->lines[i]->ownsParent())
-         writeElementMSH(fp, this, (*it)->lines[i]->getParent(),
-                         saveAll, version, binary, num, (*it)->tag(), (*it)->physicals);
+         writeElementMSH(w, this, (*it)->lines[i]->getParent(),
+                         saveAll, num, (*it)->tag(), (*it)->physicals);
    for(fiter it = firstFace(); it != lastFace(); ++it)
      for(unsigned int i = 0; i < (*it)->triangles.size(); i++)
        if((*it)->triangles[i]->ownsParent())
-         writeElementMSH(fp, this, (*it)->triangles[i]->getParent(),
-                         saveAll, version, binary, num, (*it)->tag(), (*it)->physicals);
+         writeElementMSH(w, this, (*it)->triangles[i]->getParent(),
+                         saveAll, num, (*it)->tag(), (*it)->physicals);
    for(riter it = firstRegion(); it != lastRegion(); ++it)
      for(unsigned int i = 0; i < (*it)->tetrahedra.size(); i++)
        if((*it)->tetrahedra[i]->ownsParent())
-         writeElementMSH(fp, this, (*it)->tetrahedra[i]->getParent(),
-                         saveAll, version, binary, num, (*it)->tag(), (*it)->physicals);
+         writeElementMSH(w, this, (*it)->tetrahedra[i]->getParent(),
+                         saveAll, num, (*it)->tag(), (*it)->physicals);
    for(fiter it = firstFace(); it != lastFace(); ++it)
      for(unsigned int i = 0; i < (*it)->polygons.size(); i++)
        if((*it)->polygons[i]->ownsParent())
-         writeElementMSH(fp, this, (*it)->polygons[i]->getParent(),
-                         saveAll, version, binary, num, (*it)->tag(), (*it)->physicals);
+         writeElementMSH(w, this, (*it)->polygons[i]->getParent(),
+                         saveAll, num, (*it)->tag(), (*it)->physicals);
    for(riter it = firstRegion(); it != lastRegion(); ++it)
      for(unsigned int i = 0; i < (*it)->polyhedra.size(); i++)
        if((*it)->polyhedra[i]->ownsParent())
-         writeElementMSH(fp, this, (*it)->polyhedra[i]->getParent(),
-                         saveAll, version, binary, num, (*it)->tag(), (*it)->physicals);
+         writeElementMSH(w, this, (*it)->polyhedra[i]->getParent(),
+                         saveAll, num, (*it)->tag(), (*it)->physicals);
   }
   // points
   for(viter it = firstVertex(); it != lastVertex(); ++it)
-    writeElementsMSH(fp, this, (*it)->points, saveAll, saveSinglePartition,
-                     version, binary, num, (*it)->tag(), (*it)->physicals);
+    writeElementsMSH(w, this, (*it)->points, saveAll, saveSinglePartition,
+                     num, (*it)->tag(), (*it)->physicals);
   // lines
   for(eiter it = firstEdge(); it != lastEdge(); ++it)
-    writeElementsMSH(fp, this, (*it)->lines, saveAll, saveSinglePartition,
-                     version, binary, num, (*it)->tag(), (*it)->physicals);
+    writeElementsMSH(w, this, (*it)->lines, saveAll, saveSinglePartition,
+                     num, (*it)->tag(), (*it)->physicals);
   // triangles
   for(fiter it = firstFace(); it != lastFace(); ++it)
-    writeElementsMSH(fp, this, (*it)->triangles, saveAll, saveSinglePartition,
-                     version, binary, num, (*it)->tag(), (*it)->physicals);
+    writeElementsMSH(w, this, (*it)->triangles, saveAll, saveSinglePartition,
+                     num, (*it)->tag(), (*it)->physicals);
 
   // quads
   for(fiter it = firstFace(); it != lastFace(); ++it)
-    writeElementsMSH(fp, this, (*it)->quadrangles, saveAll, saveSinglePartition,
-                     version, binary, num, (*it)->tag(), (*it)->physicals);
+    writeElementsMSH(w, this, (*it)->quadrangles, saveAll, saveSinglePartition,
+                     num, (*it)->tag(), (*it)->physicals);
   // polygons
   for(fiter it = firstFace(); it != lastFace(); it++)
-    writeElementsMSH(fp, this, (*it)->polygons, saveAll, saveSinglePartition,
-                     version, binary, num, (*it)->tag(), (*it)->physicals);
+    writeElementsMSH(w, this, (*it)->polygons, saveAll, saveSinglePartition,
+                     num, (*it)->tag(), (*it)->physicals);
   // tets
   for(riter it = firstRegion(); it != lastRegion(); ++it)
-    writeElementsMSH(fp, this, (*it)->tetrahedra, saveAll, saveSinglePartition,
-                     version, binary, num, (*it)->tag(), (*it)->physicals);
+    writeElementsMSH(w, this, (*it)->tetrahedra, saveAll, saveSinglePartition,
+                     num, (*it)->tag(), (*it)->physicals);
 
   // hexas
   for(riter it = firstRegion(); it != lastRegion(); ++it)
-    writeElementsMSH(fp, this, (*it)->hexahedra, saveAll, saveSinglePartition,
-                     version, binary, num, (*it)->tag(), (*it)->physicals);
+    writeElementsMSH(w, this, (*it)->hexahedra, saveAll, saveSinglePartition,
+                     num, (*it)->tag(), (*it)->physicals);
 
   // prisms
   for(riter it = firstRegion(); it != lastRegion(); ++it)
-    writeElementsMSH(fp, this, (*it)->prisms, saveAll, saveSinglePartition,
-                     version, binary, num, (*it)->tag(), (*it)->physicals);
+    writeElementsMSH(w, this, (*it)->prisms, saveAll, saveSinglePartition,
+                     num, (*it)->tag(), (*it)->physicals);
 
   // pyramids
   for(riter it = firstRegion(); it != lastRegion(); ++it)
-    writeElementsMSH(fp, this, (*it)->pyramids, saveAll, saveSinglePartition,
-                     version, binary, num, (*it)->tag(), (*it)->physicals);
+    writeElementsMSH(w, this, (*it)->pyramids, saveAll, saveSinglePartition,
+                     num, (*it)->tag(), (*it)->physicals);
 
   // polyhedra
   for(riter it = firstRegion(); it != lastRegion(); ++it)
-    writeElementsMSH(fp, this, (*it)->polyhedra, saveAll, saveSinglePartition,
-                     version, binary, num, (*it)->tag(), (*it)->physicals);
+    writeElementsMSH(w, this, (*it)->polyhedra, saveAll, saveSinglePartition,
+                     num, (*it)->tag(), (*it)->physicals);
 
   // level set faces
   for(fiter it = firstFace(); it != lastFace(); ++it) {
     for(unsigned int i = 0; i < (*it)->triangles.size(); i++) {
       MTriangle *t = (*it)->triangles[i];
       if(t->getDomain(0))
-        writeElementMSH(fp, this, t, saveAll, version, binary, num,
+        writeElementMSH(w, this, t, saveAll, num,
                         (*it)->tag(), (*it)->physicals, 0,
                         getMeshElementIndex(t->getDomain(0)),
                         getMeshElementIndex(t->getDomain(1)));
@@ -1014,7 +1334,7 @@ int GModel::_writeMSH2(const std::string &name, double version, bool binary,
     for(unsigned int i = 0; i < (*it)->polygons.size(); i++) {
       MPolygon *p = (*it)->polygons[i];
       if(p->getDomain(0))
-        writeElementMSH(fp, this, p, saveAll, version, binary, num,
+        writeElementMSH(w, this, p, saveAll, num,
                         (*it)->tag(), (*it)->physicals, 0,
                         getMeshElementIndex(p->getDomain(0)),
                         getMeshElementIndex(p->getDomain(1)));
@@ -1025,12 +1345,13 @@ int GModel::_writeMSH2(const std::string &name, double version, bool binary,
     for(unsigned int i = 0; i < (*it)->lines.size(); i++) {
       MLine *l = (*it)->lines[i];
       if(l->getDomain(0))
-        writeElementMSH(fp, this, l, saveAll, version, binary, num,
+        writeElementMSH(w, this, l, saveAll, num,
                         (*it)->tag(), (*it)->physicals, 0,
                         getMeshElementIndex(l->getDomain(0)),
                         getMeshElementIndex(l->getDomain(1)));
     }
   }
+  w.flush();
 
   if(binary) fprintf(fp, "\n");
 
@@ -1048,25 +1369,229 @@ int GModel::_writeMSH2(const std::string &name, double version, bool binary,
   return 1;
 }
 
+// elements and vertices saved in the file of a single partition
+struct partitionMSH2 {
+  struct record {
+    MElement *ele;
+    int elementary;
+    std::vector<int> *physicals;
+  };
+  int tag, elementStartNum, numElements;
+  std::vector<record> elements;
+  std::vector<MVertex*> vertices;
+  partitionMSH2() : tag(0), elementStartNum(0), numElements(0) {}
+};
+
+class vertexIndexLessThan {
+ public:
+  bool operator()(const MVertex *v1, const MVertex *v2) const
+  {
+    return v1->getIndex() < v2->getIndex();
+  }
+};
+
+// dispatch the elements of entity "ge" in the partitions; returns false if
+// some elements have parents or domains, whose numbering requires the
+// complete traversal of the model done in _writeMSH2
+template<class T>
+static bool classifyElementsMSH2(GEntity *ge, std::vector<T*> &ele, bool saveAll,
+                                 std::map<int, int> &partitionIndex,
+                                 std::vector<partitionMSH2> &partitions)
+{
+  if(!saveAll && ge->physicals.empty()) return true;
+  for(unsigned int i = 0; i < ele.size(); i++){
+    if(ele[i]->getParent() || ele[i]->getDomain(0)) return false;
+    std::map<int, int>::iterator it = partitionIndex.find(ele[i]->getPartition());
+    if(it == partitionIndex.end()) continue;
+    partitionMSH2::record r = {ele[i], ge->tag(), &ge->physicals};
+    partitions[it->second].elements.push_back(r);
+  }
+  return true;
+}
+
+static bool classifyElementsMSH2(GModel *m, bool saveAll,
+                                 std::map<int, int> &partitionIndex,
+                                 std::vector<partitionMSH2> &p)
+{
+  // same order as in _writeMSH2
+  for(GModel::viter it = m->firstVertex(); it != m->lastVertex(); ++it)
+    if(!classifyElementsMSH2(*it, (*it)->points, saveAll, partitionIndex, p))
+      return false;
+  for(GModel::eiter it = m->firstEdge(); it != m->lastEdge(); ++it)
+    if(!classifyElementsMSH2(*it, (*it)->lines, saveAll, partitionIndex, p))
+      return false;
+  for(GModel::fiter it = m->firstFace(); it != m->lastFace(); ++it)
+    if(!classifyElementsMSH2(*it, (*it)->triangles, saveAll, partitionIndex, p))
+      return false;
+  for(GModel::fiter it = m->firstFace(); it != m->lastFace(); ++it)
+    if(!classifyElementsMSH2(*it, (*it)->quadrangles, saveAll, partitionIndex, p))
+      return false;
+  for(GModel::fiter it = m->firstFace(); it != m->lastFace(); ++it)
+    if(!classifyElementsMSH2(*it, (*it)->polygons, saveAll, partitionIndex, p))
+      return false;
+  for(GModel::riter it = m->firstRegion(); it != m->lastRegion(); ++it)
+    if(!classifyElementsMSH2(*it, (*it)->tetrahedra, saveAll, partitionIndex, p))
+      return false;
+  for(GModel::riter it = m->firstRegion(); it != m->lastRegion(); ++it)
+    if(!classifyElementsMSH2(*it, (*it)->hexahedra, saveAll, partitionIndex, p))
+      return false;
+  for(GModel::riter it = m->firstRegion(); it != m->lastRegion(); ++it)
+    if(!classifyElementsMSH2(*it, (*it)->prisms, saveAll, partitionIndex, p))
+      return false;
+  for(GModel::riter it = m->firstRegion(); it != m->lastRegion(); ++it)
+    if(!classifyElementsMSH2(*it, (*it)->pyramids, saveAll, partitionIndex, p))
+      return false;
+  for(GModel::riter it = m->firstRegion(); it != m->lastRegion(); ++it)
+    if(!classifyElementsMSH2(*it, (*it)->polyhedra, saveAll, partitionIndex, p))
+      return false;
+  return true;
+}
+
+// get the vertices of the partition (sorted by index, i.e., in the order
+// in which they are saved) and the number of element lines in the file
+static void countPartitionMSH2(partitionMSH2 &part, bool saveAll)
+{
+  const bool saveTri = CTX::instance()->mesh.saveTri;
+  part.numElements = 0;
+  part.vertices.clear();
+  for(unsigned int i = 0; i < part.elements.size(); i++){
+    MElement *e = part.elements[i].ele;
+    int p = saveAll ? 1 : part.elements[i].physicals->size();
+    int nbC = e->getNumChildren();
+    part.numElements += (saveTri && nbC) ? nbC * p : p;
+    for(int k = 0; k < e->getNumVertices(); k++)
+      part.vertices.push_back(e->getVertex(k));
+  }
+  std::sort(part.vertices.begin(), part.vertices.end(), vertexIndexLessThan());
+  part.vertices.erase(std::unique(part.vertices.begin(), part.vertices.end()),
+                      part.vertices.end());
+}
+
+static bool writePartitionMSH2(const std::string &name, GModel *m,
+                               partitionMSH2 &part, bool binary, bool saveAll,
+                               bool saveParametric, double scalingFactor,
+                               std::vector<GEntity*> &entities)
+{
+  FILE *fp;
+#if defined(_OPENMP)
+#pragma omp critical (Fopen)
+#endif
+  fp = Fopen(name.c_str(), binary ? "wb" : "w");
+  if(!fp) return false;
+
+  writeHeaderMSH2(fp, m, 2.2, binary);
+
+  fprintf(fp, saveParametric ? "$ParametricNodes\n" : "$Nodes\n");
+  fprintf(fp, "%d\n", (int)part.vertices.size());
+  vertexWriterMSH2 vw(binary, saveParametric, scalingFactor);
+  vw.vertices.swap(part.vertices);
+  writeInBlocks(fp, vw.vertices.size(), vw);
+  if(binary) fprintf(fp, "\n");
+  fprintf(fp, saveParametric ? "$EndParametricNodes\n" : "$EndNodes\n");
+
+  fprintf(fp, "$Elements\n");
+  fprintf(fp, "%d\n", part.numElements);
+  elementWriterMSH2 w(fp, m, 2.2, binary, saveAll);
+  int num = part.elementStartNum;
+  for(unsigned int i = 0; i < part.elements.size(); i++){
+    partitionMSH2::record &r = part.elements[i];
+    w.add(r.ele, num, r.elementary, *r.physicals, 0, 0, 0);
+    num += saveAll ? 1 : r.physicals->size();
+    if(CTX::instance()->mesh.saveTri && r.ele->getNumChildren())
+      num += r.ele->getNumChildren() - 1;
+  }
+  w.flush();
+  if(binary) fprintf(fp, "\n");
+  fprintf(fp, "$EndElements\n");
+
+  writeMSHPeriodicNodes(fp, entities);
+
+  fclose(fp);
+  return true;
+}
+
+static std::string getPartitionFileName(const std::string &baseName, int partition)
+{
+  std::ostringstream sstream;
+  sstream << baseName << "_" << std::setw(6) << std::setfill('0') << partition;
+  return sstream.str();
+}
+
 int GModel::writePartitionedMSH(const std::string &baseName, bool binary,
                                 bool saveAll, bool saveParametric,
                                 double scalingFactor)
 {
-  int index = 0;
+  if(meshPartitions.empty()) return 1;
+
+  // if there are no physicals we save all the elements
+  if(noPhysicalGroups()) saveAll = true;
+
+  // classify the elements in their partition in a single pass over the model
+  std::vector<partitionMSH2> partitions(meshPartitions.size());
+  std::map<int, int> partitionIndex;
   for(std::set<int>::iterator it = meshPartitions.begin();
       it != meshPartitions.end(); it++){
-    int partition = *it;
+    int i = partitionIndex.size();
+    partitions[i].tag = *it;
+    partitionIndex[*it] = i;
+  }
 
-    std::ostringstream sstream;
-    sstream << baseName << "_" << std::setw(6) << std::setfill('0') << partition;
+  if(!classifyElementsMSH2(this, saveAll, partitionIndex, partitions)){
+    // the numbering of parent and domain elements needs the whole model:
+    // write the partitions one after the other
+    int startNum = 0;
+    for(std::set<int>::iterator it = meshPartitions.begin();
+        it != meshPartitions.end(); it++){
+      int partition = *it;
+      std::string name = getPartitionFileName(baseName, partition);
+      Msg::Info("Writing partition %d in file '%s'", partition, name.c_str());
+      _writeMSH2(name, 2.2, binary, saveAll, saveParametric,
+                 scalingFactor, startNum, partition);
+      startNum += getNumElementsMSH(this, saveAll, partition);
+    }
+    return 1;
+  }
 
-    int startNum = index ? getNumElementsMSH(this, saveAll, partition) : 0;
-    Msg::Info("Writing partition %d in file '%s'", partition, sstream.str().c_str());
-    _writeMSH2(sstream.str(), 2.2, binary, saveAll, saveParametric,
-               scalingFactor, startNum, partition);
-    index++;
+  // number the vertices once for all the partitions: a vertex on a
+  // partition boundary has the same number in all the files
+  indexMeshVertices(saveAll);
+
+  const int numPartitions = partitions.size();
+#if defined(_OPENMP)
+  const int numThreads = std::max(1, std::min(numPartitions,
+                                               Msg::GetMaxThreads()));
+#pragma omp parallel for schedule(dynamic) num_threads(numThreads)
+#endif
+  for(int i = 0; i < numPartitions; i++)
+    countPartitionMSH2(partitions[i], saveAll);
+
+  // element numbers are contiguous across the partitions
+  for(int i = 1; i < numPartitions; i++)
+    partitions[i].elementStartNum = partitions[i - 1].elementStartNum +
+      partitions[i - 1].numElements;
+
+  Msg::Info("Writing %d partitions in files '%s_*'", numPartitions,
+            baseName.c_str());
+
+  std::vector<GEntity*> entities;
+  getEntities(entities);
+  std::vector<char> written(numPartitions, 0);
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic) num_threads(numThreads)
+#endif
+  for(int i = 0; i < numPartitions; i++){
+    std::string name = getPartitionFileName(baseName, partitions[i].tag);
+    written[i] = writePartitionMSH2(name, this, partitions[i], binary, saveAll,
+                                    saveParametric, scalingFactor, entities);
+    // release the memory as soon as possible
+    std::vector<partitionMSH2::record>().swap(partitions[i].elements);
   }
 
+  for(int i = 0; i < numPartitions; i++)
+    if(!written[i])
+      Msg::Error("Unable to open file '%s'",
+                 getPartitionFileName(baseName, partitions[i].tag).c_str());
+
 #if 0
   if(_ghostCells.size()){
     Msg::Info("Writing ghost cells in debug file 'ghosts.pos'");
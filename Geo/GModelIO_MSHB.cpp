@@ -0,0 +1,498 @@
+// Gmsh - Copyright (C) 1997-2013 C. Geuzaine, J.-F. Remacle
+//
+// See the LICENSE.txt file for license information. Please report all
+// bugs and problems to the public mailing list <gmsh@geuz.org>.
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "GModel.h"
+#include "OS.h"
+#include "MElement.h"
+#include "discreteVertex.h"
+#include "discreteEdge.h"
+#include "discreteFace.h"
+#include "discreteRegion.h"
+
+// Compact binary mesh format (".mshb"). The file is a direct image of the
+// arrays used to build the mesh, so that it can be mapped in memory and
+// the arrays handed to solvers as-is. All the integers are stored in the
+// native byte order (the "one" field of the header is used to detect
+// files written on machines with a different endianness) and all the
+// sections start on 8 byte boundaries:
+//
+// * header
+// * entity table: for each entity, its dimension and tag, the range of
+//   its vertices in the coordinate array and the range of its physical
+//   tags in the physical tag array
+// * block table: for each block of elements of the same type in the same
+//   entity, the entity index, the MSH element type, the number of
+//   elements and of nodes per element, and the offsets of the element tag
+//   array, of the (optional) partition array and of the connectivity
+//   array of the block
+// * physical tags (int)
+// * vertex coordinates (3 doubles per vertex; the tag of vertex i is i+1)
+// * element tags, partitions and connectivities of each block (int; the
+//   connectivity stores the 0-based index of the vertices)
+// * physical names: for each name, its dimension, number and length,
+//   followed by the characters of the name
+
+#define MSHB_VERSION 1
+
+struct headerMSHB {
+  char magic[8];
+  long long version, one;
+  long long numVertices, numEntities, numBlocks, numPhysicalTags, namesSize;
+  long long entitiesOffset, blocksOffset, physicalsOffset, coordinatesOffset;
+  long long namesOffset;
+};
+
+struct entityMSHB {
+  long long dim, tag, firstVertex, numVertices, firstPhysical, numPhysicals;
+};
+
+struct blockMSHB {
+  long long entity, type, numElements, numNodes;
+  long long tagsOffset, partitionsOffset, connectivityOffset;
+};
+
+static const char magicMSHB[8] = {'G', 'M', 'S', 'H', 'M', 'S', 'H', 'B'};
+
+static long long pad8(long long n)
+{
+  return (n + 7) & ~7LL;
+}
+
+static void writePaddingMSHB(FILE *fp, long long n)
+{
+  static const char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  if(pad8(n) != n) fwrite(zeros, 1, pad8(n) - n, fp);
+}
+
+static GEntity *getEntityMSHB(GModel *m, int dim, int tag)
+{
+  switch(dim){
+  case 0:
+    {
+      GVertex *v = m->getVertexByTag(tag);
+      if(!v){
+        v = new discreteVertex(m, tag);
+        m->add(v);
+      }
+      if(!v->points.empty()){ // CAD points already have one by default
+        v->points.clear();
+        v->mesh_vertices.clear();
+      }
+      return v;
+    }
+  case 1:
+    {
+      GEdge *e = m->getEdgeByTag(tag);
+      if(!e){
+        e = new discreteEdge(m, tag, 0, 0);
+        m->add(e);
+      }
+      return e;
+    }
+  case 2:
+    {
+      GFace *f = m->getFaceByTag(tag);
+      if(!f){
+        f = new discreteFace(m, tag);
+        m->add(f);
+      }
+      return f;
+    }
+  case 3:
+    {
+      GRegion *r = m->getRegionByTag(tag);
+      if(!r){
+        r = new discreteRegion(m, tag);
+        m->add(r);
+      }
+      return r;
+    }
+  }
+  return 0;
+}
+
+template<class T>
+static void addElementsMSHB(std::vector<T*> &dst, const std::vector<MElement*> &src)
+{
+  dst.reserve(dst.size() + src.size());
+  for(unsigned int i = 0; i < src.size(); i++) dst.push_back((T*)src[i]);
+}
+
+static bool storeElementsMSHB(GEntity *ge, const std::vector<MElement*> &ele)
+{
+  if(ele.empty()) return true;
+  int type = ele[0]->getType();
+  if(ele[0]->getDim() != ge->dim()) return false;
+  switch(type){
+  case TYPE_PNT: addElementsMSHB(((GVertex*)ge)->points, ele); break;
+  case TYPE_LIN: addElementsMSHB(((GEdge*)ge)->lines, ele); break;
+  case TYPE_TRI: addElementsMSHB(((GFace*)ge)->triangles, ele); break;
+  case TYPE_QUA: addElementsMSHB(((GFace*)ge)->quadrangles, ele); break;
+  case TYPE_TET: addElementsMSHB(((GRegion*)ge)->tetrahedra, ele); break;
+  case TYPE_HEX: addElementsMSHB(((GRegion*)ge)->hexahedra, ele); break;
+  case TYPE_PRI: addElementsMSHB(((GRegion*)ge)->prisms, ele); break;
+  case TYPE_PYR: addElementsMSHB(((GRegion*)ge)->pyramids, ele); break;
+  default: return false;
+  }
+  return true;
+}
+
+int GModel::readMSHB(const std::string &name)
+{
+  FILE *fp = Fopen(name.c_str(), "rb");
+  if(!fp){
+    Msg::Error("Unable to open file '%s'", name.c_str());
+    return 0;
+  }
+
+  double t1 = GetTimeInSeconds();
+
+  size_t size;
+  char *data = MapFile(fp, size);
+  fclose(fp);
+  if(!data){
+    Msg::Error("Unable to read file '%s'", name.c_str());
+    return 0;
+  }
+
+  const headerMSHB *h = (const headerMSHB*)data;
+  if(size < sizeof(headerMSHB) || memcmp(h->magic, magicMSHB, 8)){
+    Msg::Error("'%s' is not a binary mesh file", name.c_str());
+    UnmapFile(data, size);
+    return 0;
+  }
+  if(h->one != 1){
+    Msg::Error("Binary mesh file '%s' has the wrong byte order", name.c_str());
+    UnmapFile(data, size);
+    return 0;
+  }
+  if(h->version > MSHB_VERSION){
+    Msg::Error("Unknown binary mesh file version (%d)", (int)h->version);
+    UnmapFile(data, size);
+    return 0;
+  }
+
+  // check that all the sections are inside the file
+  const long long fileSize = size;
+  bool ok = true;
+#define CHECK_MSHB(offset, n, type)                                     \
+  if(n < 0 || offset < 0 || offset + (long long)((n) * sizeof(type)) > fileSize) \
+    ok = false;
+  CHECK_MSHB(h->entitiesOffset, h->numEntities, entityMSHB);
+  CHECK_MSHB(h->blocksOffset, h->numBlocks, blockMSHB);
+  CHECK_MSHB(h->physicalsOffset, h->numPhysicalTags, int);
+  CHECK_MSHB(h->coordinatesOffset, 3 * h->numVertices, double);
+  CHECK_MSHB(h->namesOffset, h->namesSize, char);
+  const entityMSHB *ents = (const entityMSHB*)(data + h->entitiesOffset);
+  const blockMSHB *blocks = (const blockMSHB*)(data + h->blocksOffset);
+  for(long long i = 0; ok && i < h->numEntities; i++){
+    if(ents[i].firstVertex < 0 || ents[i].numVertices < 0 ||
+       ents[i].firstVertex + ents[i].numVertices > h->numVertices ||
+       ents[i].firstPhysical < 0 || ents[i].numPhysicals < 0 ||
+       ents[i].firstPhysical + ents[i].numPhysicals > h->numPhysicalTags)
+      ok = false;
+  }
+  for(long long i = 0; ok && i < h->numBlocks; i++){
+    const blockMSHB &b = blocks[i];
+    if(b.entity < 0 || b.entity >= h->numEntities ||
+       MElement::getInfoMSH(b.type) != b.numNodes) ok = false;
+    CHECK_MSHB(b.tagsOffset, b.numElements, int);
+    if(b.partitionsOffset) CHECK_MSHB(b.partitionsOffset, b.numElements, int);
+    CHECK_MSHB(b.connectivityOffset, b.numElements * b.numNodes, int);
+  }
+#undef CHECK_MSHB
+  if(!ok){
+    Msg::Error("Corrupted binary mesh file '%s'", name.c_str());
+    UnmapFile(data, size);
+    return 0;
+  }
+
+  const int numVertices = h->numVertices;
+  const double *xyz = (const double*)(data + h->coordinatesOffset);
+  const int *physicals = (const int*)(data + h->physicalsOffset);
+
+  std::vector<MVertex*> vertices(numVertices);
+  for(int i = 0; i < numVertices; i++)
+    vertices[i] = new MVertex(xyz[3 * i], xyz[3 * i + 1], xyz[3 * i + 2], 0, i + 1);
+
+  // classify the vertices and store them in bulk in their entity
+  std::vector<GEntity*> entities(h->numEntities);
+  for(long long i = 0; i < h->numEntities; i++){
+    const entityMSHB &e = ents[i];
+    GEntity *ge = getEntityMSHB(this, e.dim, e.tag);
+    if(!ge){
+      Msg::Error("Wrong entity dimension %d in binary mesh file", (int)e.dim);
+      continue;
+    }
+    entities[i] = ge;
+    ge->mesh_vertices.reserve(ge->mesh_vertices.size() + e.numVertices);
+    for(long long j = e.firstVertex; j < e.firstVertex + e.numVertices; j++){
+      MVertex *v = vertices[j];
+      if(v->onWhat()) continue;
+      v->setEntity(ge);
+      ge->mesh_vertices.push_back(v);
+    }
+    for(long long j = e.firstPhysical; j < e.firstPhysical + e.numPhysicals; j++){
+      if(std::find(ge->physicals.begin(), ge->physicals.end(), physicals[j]) ==
+         ge->physicals.end())
+        ge->physicals.push_back(physicals[j]);
+    }
+  }
+
+  // create the elements block by block
+  int numElements = 0;
+  MElementFactory factory;
+  for(long long i = 0; i < h->numBlocks; i++){
+    const blockMSHB &b = blocks[i];
+    GEntity *ge = entities[b.entity];
+    if(!ge) continue;
+    const int *tags = (const int*)(data + b.tagsOffset);
+    const int *partitions = b.partitionsOffset ?
+      (const int*)(data + b.partitionsOffset) : 0;
+    const int *conn = (const int*)(data + b.connectivityOffset);
+    const int nn = b.numNodes;
+    std::vector<MElement*> elements;
+    elements.reserve(b.numElements);
+    std::vector<MVertex*> v(nn);
+    for(long long j = 0; j < b.numElements; j++){
+      for(int k = 0; k < nn; k++){
+        int idx = conn[j * nn + k];
+        if(idx < 0 || idx >= numVertices){
+          Msg::Error("Wrong vertex index %d in binary mesh file", idx);
+          v.clear();
+          break;
+        }
+        v[k] = vertices[idx];
+        // vertices not listed in any entity are classified on the entity
+        // of the first element that uses them
+        if(!v[k]->onWhat()){
+          v[k]->setEntity(ge);
+          ge->mesh_vertices.push_back(v[k]);
+        }
+      }
+      if((int)v.size() != nn) break;
+      MElement *ele = factory.create(b.type, v, tags[j],
+                                     partitions ? partitions[j] : 0);
+      if(!ele){
+        Msg::Error("Unknown type of element %d", (int)b.type);
+        break;
+      }
+      elements.push_back(ele);
+    }
+    if(!storeElementsMSHB(ge, elements)){
+      Msg::Error("Wrong type of element %d in entity %d of dimension %d",
+                 (int)b.type, ge->tag(), ge->dim());
+      for(unsigned int j = 0; j < elements.size(); j++) delete elements[j];
+      continue;
+    }
+    if(partitions){
+      for(long long j = 0; j < b.numElements; j++)
+        if(partitions[j]) getMeshPartitions().insert(partitions[j]);
+    }
+    numElements += elements.size();
+  }
+
+  // unused vertices
+  for(int i = 0; i < numVertices; i++)
+    if(!vertices[i]->onWhat()) delete vertices[i];
+
+  // physical names
+  const char *p = data + h->namesOffset, *end = p + h->namesSize;
+  while(p + 3 * sizeof(int) <= end){
+    int info[3];
+    memcpy(info, p, 3 * sizeof(int));
+    p += 3 * sizeof(int);
+    if(info[2] < 0 || p + info[2] > end) break;
+    setPhysicalName(std::string(p, info[2]), info[0], info[1]);
+    p += info[2];
+  }
+
+  UnmapFile(data, size);
+
+  Msg::Info("Read %d vertices and %d elements in %g s", numVertices, numElements,
+            GetTimeInSeconds() - t1);
+  return 1;
+}
+
+int GModel::writeMSHB(const std::string &name, bool saveAll, double scalingFactor)
+{
+  FILE *fp = Fopen(name.c_str(), "wb");
+  if(!fp){
+    Msg::Error("Unable to open file '%s'", name.c_str());
+    return 0;
+  }
+
+  if(noPhysicalGroups()) saveAll = true;
+
+  // vertices are numbered entity by entity, so that the vertices of each
+  // entity form a contiguous range in the coordinate array
+  int numVertices = indexMeshVertices(saveAll);
+
+  std::vector<GEntity*> entities;
+  getEntities(entities);
+
+  std::vector<MVertex*> vertices;
+  vertices.reserve(numVertices);
+  std::vector<entityMSHB> ents;
+  std::vector<blockMSHB> blocks;
+  std::vector<std::vector<MElement*> > blockElements;
+  std::vector<int> physicals;
+  bool skipped = false;
+  for(unsigned int i = 0; i < entities.size(); i++){
+    GEntity *ge = entities[i];
+    entityMSHB e;
+    e.dim = ge->dim();
+    e.tag = ge->tag();
+    e.firstVertex = vertices.size();
+    for(unsigned int j = 0; j < ge->mesh_vertices.size(); j++)
+      if(ge->mesh_vertices[j]->getIndex() > 0)
+        vertices.push_back(ge->mesh_vertices[j]);
+    e.numVertices = vertices.size() - e.firstVertex;
+    e.firstPhysical = physicals.size();
+    e.numPhysicals = ge->physicals.size();
+    physicals.insert(physicals.end(), ge->physicals.begin(), ge->physicals.end());
+
+    unsigned int numBlocks = blocks.size();
+    if(saveAll || ge->physicals.size()){
+      std::map<int, std::vector<MElement*> > types;
+      for(unsigned int j = 0; j < ge->getNumMeshElements(); j++){
+        MElement *ele = ge->getMeshElement(j);
+        int type = ele->getTypeForMSH();
+        if(!type) continue;
+        if(type == MSH_POLYG_ || type == MSH_POLYH_ || type == MSH_POLYG_B){
+          skipped = true;
+          continue;
+        }
+        types[type].push_back(ele);
+      }
+      for(std::map<int, std::vector<MElement*> >::iterator it = types.begin();
+          it != types.end(); it++){
+        blockMSHB b;
+        b.entity = ents.size();
+        b.type = it->first;
+        b.numElements = it->second.size();
+        b.numNodes = MElement::getInfoMSH(it->first);
+        b.partitionsOffset = 0;
+        for(unsigned int j = 0; j < it->second.size(); j++){
+          if(it->second[j]->getPartition()){
+            b.partitionsOffset = 1;
+            break;
+          }
+        }
+        blocks.push_back(b);
+        blockElements.push_back(std::vector<MElement*>());
+        blockElements.back().swap(it->second);
+      }
+    }
+    if(e.numVertices || e.numPhysicals || blocks.size() > numBlocks)
+      ents.push_back(e);
+    else
+      physicals.resize(e.firstPhysical);
+  }
+  if(skipped)
+    Msg::Warning("Polygons and polyhedra are not saved in binary mesh files");
+  if((int)vertices.size() != numVertices){
+    Msg::Error("Wrong number of vertices in binary mesh file (%d != %d)",
+               (int)vertices.size(), numVertices);
+    fclose(fp);
+    return 0;
+  }
+
+  std::vector<char> names;
+  for(piter it = firstPhysicalName(); it != lastPhysicalName(); it++){
+    int info[3] = {it->first.first, it->first.second, (int)it->second.size()};
+    names.insert(names.end(), (char*)info, (char*)info + sizeof(info));
+    names.insert(names.end(), it->second.begin(), it->second.end());
+  }
+
+  // layout of the file
+  headerMSHB h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, magicMSHB, 8);
+  h.version = MSHB_VERSION;
+  h.one = 1;
+  h.numVertices = numVertices;
+  h.numEntities = ents.size();
+  h.numBlocks = blocks.size();
+  h.numPhysicalTags = physicals.size();
+  h.namesSize = names.size();
+  long long offset = sizeof(headerMSHB);
+  h.entitiesOffset = offset;
+  offset += ents.size() * sizeof(entityMSHB);
+  h.blocksOffset = offset;
+  offset += blocks.size() * sizeof(blockMSHB);
+  h.physicalsOffset = offset;
+  offset += pad8(physicals.size() * sizeof(int));
+  h.coordinatesOffset = offset;
+  offset += 3 * (long long)numVertices * sizeof(double);
+  for(unsigned int i = 0; i < blocks.size(); i++){
+    blockMSHB &b = blocks[i];
+    b.tagsOffset = offset;
+    offset += pad8(b.numElements * sizeof(int));
+    if(b.partitionsOffset){
+      b.partitionsOffset = offset;
+      offset += pad8(b.numElements * sizeof(int));
+    }
+    b.connectivityOffset = offset;
+    offset += pad8(b.numElements * b.numNodes * sizeof(int));
+  }
+  h.namesOffset = offset;
+
+  fwrite(&h, sizeof(headerMSHB), 1, fp);
+  if(ents.size()) fwrite(&ents[0], sizeof(entityMSHB), ents.size(), fp);
+  if(blocks.size()) fwrite(&blocks[0], sizeof(blockMSHB), blocks.size(), fp);
+  if(physicals.size()) fwrite(&physicals[0], sizeof(int), physicals.size(), fp);
+  writePaddingMSHB(fp, physicals.size() * sizeof(int));
+
+  const int chunk = 65536;
+  std::vector<double> xyz;
+  for(int i = 0; i < numVertices; i += chunk){
+    int n = std::min(chunk, numVertices - i);
+    xyz.resize(3 * n);
+    for(int j = 0; j < n; j++){
+      MVertex *v = vertices[i + j];
+      xyz[3 * j] = v->x() * scalingFactor;
+      xyz[3 * j + 1] = v->y() * scalingFactor;
+      xyz[3 * j + 2] = v->z() * scalingFactor;
+    }
+    fwrite(&xyz[0], sizeof(double), 3 * n, fp);
+  }
+
+  int num = 0;
+  std::vector<int> tags, conn;
+  for(unsigned int i = 0; i < blocks.size(); i++){
+    const blockMSHB &b = blocks[i];
+    std::vector<MElement*> &ele = blockElements[i];
+    const int ne = b.numElements, nn = b.numNodes;
+    tags.resize(ne);
+    for(int j = 0; j < ne; j++) tags[j] = ++num;
+    fwrite(&tags[0], sizeof(int), ne, fp);
+    writePaddingMSHB(fp, ne * sizeof(int));
+    if(b.partitionsOffset){
+      for(int j = 0; j < ne; j++) tags[j] = ele[j]->getPartition();
+      fwrite(&tags[0], sizeof(int), ne, fp);
+      writePaddingMSHB(fp, ne * sizeof(int));
+    }
+    conn.resize((size_t)ne * nn);
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+    for(int j = 0; j < ne; j++){
+      std::vector<int> verts;
+      ele[j]->getVerticesIdForMSH(verts);
+      for(int k = 0; k < nn; k++) conn[(size_t)j * nn + k] = verts[k] - 1;
+    }
+    fwrite(&conn[0], sizeof(int), conn.size(), fp);
+    writePaddingMSHB(fp, conn.size() * sizeof(int));
+  }
+
+  if(names.size()) fwrite(&names[0], 1, names.size(), fp);
+
+  fclose(fp);
+  return 1;
+}
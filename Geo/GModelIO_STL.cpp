@@ -4,15 +4,222 @@
 // bugs and problems to the public mailing list <gmsh@geuz.org>.
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
 #include "GModel.h"
 #include "OS.h"
 #include "MLine.h"
 #include "MTriangle.h"
 #include "MQuadrangle.h"
-#include "MVertexPositionSet.h"
 #include "discreteFace.h"
 #include "StringUtils.h"
 
+// part of an ASCII STL file: the points of consecutive "vertex" lines,
+// possibly starting a new solid
+struct partSTL {
+  bool newSolid;
+  std::vector<SPoint3> points;
+  partSTL(bool n=false) : newSolid(n) {}
+};
+
+static bool isKeywordSTL(const char *p, const char *end, const char *lower,
+                         const char *upper)
+{
+  int n = strlen(lower);
+  return (end - p >= n && (!strncmp(p, lower, n) || !strncmp(p, upper, n)));
+}
+
+// read a number in [p, end): the mapped file is not NUL-terminated, so the
+// number is copied to a local buffer for strtod
+static bool scanDoubleSTL(const char *&p, const char *end, double &val)
+{
+  while(p < end && (*p == ' ' || *p == '\t')) p++;
+  char buf[64];
+  int n = 0;
+  while(p < end && n < (int)sizeof(buf) - 1 && !isspace((unsigned char)*p))
+    buf[n++] = *p++;
+  if(!n || (p < end && !isspace((unsigned char)*p))) return false;
+  buf[n] = '\0';
+  char *q;
+  val = strtod(buf, &q);
+  return q == buf + n;
+}
+
+// read the lines in [p, end) of an ASCII STL file
+static void readPartsSTL(const char *p, const char *end, std::vector<partSTL> &parts)
+{
+  parts.push_back(partSTL());
+  while(p < end){
+    const char *eol = (const char*)memchr(p, '\n', end - p);
+    if(!eol) eol = end;
+    while(p < eol && (*p == ' ' || *p == '\t')) p++;
+    if(isKeywordSTL(p, eol, "vertex", "VERTEX")){
+      p += 6;
+      double xyz[3];
+      if(scanDoubleSTL(p, eol, xyz[0]) && scanDoubleSTL(p, eol, xyz[1]) &&
+         scanDoubleSTL(p, eol, xyz[2]))
+        parts.back().points.push_back(SPoint3(xyz[0], xyz[1], xyz[2]));
+    }
+    else if(isKeywordSTL(p, eol, "solid", "SOLID")){
+      parts.push_back(partSTL(true));
+    }
+    p = eol + 1;
+  }
+}
+
+static void readASCIISTL(const char *data, size_t size,
+                         std::vector<std::vector<SPoint3> > &points)
+{
+  // split the file in chunks of complete lines, parsed concurrently
+  const int numChunks = std::max
+    (1, std::min((int)(size >> 20), 8 * Msg::GetMaxThreads()));
+  std::vector<const char*> chunks(numChunks + 1);
+  chunks[0] = data;
+  chunks[numChunks] = data + size;
+  for(int i = 1; i < numChunks; i++){
+    const char *p = data + (size_t)((double)i * size / numChunks);
+    p = std::max(p, chunks[i - 1]);
+    const char *eol = (const char*)memchr(p, '\n', data + size - p);
+    chunks[i] = eol ? eol + 1 : data + size;
+  }
+  std::vector<std::vector<partSTL> > parts(numChunks);
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for(int i = 0; i < numChunks; i++)
+    readPartsSTL(chunks[i], chunks[i + 1], parts[i]);
+
+  // the first "solid" line is the header
+  for(int i = 0; i < numChunks; i++){
+    for(unsigned int j = 0; j < parts[i].size(); j++){
+      partSTL &part = parts[i][j];
+      if(part.newSolid || (points.empty() && part.points.size()))
+        points.resize(points.size() + 1);
+      if(points.empty()) continue;
+      points.back().insert(points.back().end(), part.points.begin(),
+                           part.points.end());
+    }
+  }
+  if(points.size() > 1 && points[0].empty()) points.erase(points.begin());
+}
+
+static void readBinarySTL(const char *data, size_t size,
+                          std::vector<std::vector<SPoint3> > &points)
+{
+  size_t pos = 0;
+  while(pos + 84 <= size){
+    unsigned int nfacets = 0;
+    memcpy(&nfacets, data + pos + 80, sizeof(unsigned int));
+    pos += 84;
+    bool swap = false;
+    if(nfacets > 100000000){
+      Msg::Info("Swapping bytes from binary file");
+      swap = true;
+      SwapBytes((char*)&nfacets, sizeof(unsigned int), 1);
+    }
+    if(!nfacets) continue;
+    points.resize(points.size() + 1);
+    if(pos + 50 * (size_t)nfacets > size) break;
+    std::vector<SPoint3> &p = points.back();
+    p.resize(3 * (size_t)nfacets);
+    const char *facets = data + pos;
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+    for(int i = 0; i < (int)nfacets; i++){
+      float xyz[12];
+      memcpy(xyz, facets + 50 * (size_t)i, 12 * sizeof(float));
+      if(swap) SwapBytes((char*)xyz, sizeof(float), 12);
+      for(int j = 0; j < 3; j++)
+        p[3 * (size_t)i + j] = SPoint3(xyz[3 + 3 * j], xyz[3 + 3 * j + 1],
+                                       xyz[3 + 3 * j + 2]);
+    }
+    pos += 50 * (size_t)nfacets;
+  }
+}
+
+// Merges points closer than a tolerance, with a hash grid of cells of size
+// 2 * tolerance: the neighbors of a point are in the 8 cells closest to it.
+// As with MVertexPositionSet, a point is merged with the closest of the
+// points already created (within the tolerance), or creates a new one.
+class vertexWelderSTL {
+ private:
+  double _min[3], _eps, _h;
+  std::vector<MVertex*> &_vertices;
+  // heads of the lists of vertices in each slot of the hash table, and
+  // next vertex in the same slot
+  std::vector<int> _table, _next;
+  unsigned long long _mask;
+  inline unsigned long long _slot(long long c[3]) const
+  {
+    return ((unsigned long long)c[0] * 73856093ULL ^
+            (unsigned long long)c[1] * 19349663ULL ^
+            (unsigned long long)c[2] * 83492791ULL) & _mask;
+  }
+ public:
+  vertexWelderSTL(std::vector<MVertex*> &vertices, SBoundingBox3d &bbox,
+                  double eps, size_t numPoints)
+    : _eps(eps), _vertices(vertices)
+  {
+    _min[0] = bbox.min().x(); _min[1] = bbox.min().y(); _min[2] = bbox.min().z();
+    double diag = norm(SVector3(bbox.max(), bbox.min()));
+    _h = (eps > 0.) ? 2. * eps : (diag > 0. ? 1.e-6 * diag : 1.);
+    size_t n = 1024;
+    while(n < numPoints / 2) n *= 2;
+    _table.resize(n, -1);
+    _mask = n - 1;
+  }
+  int find(const SPoint3 &p)
+  {
+    long long c[3];
+    int side[3];
+    for(int k = 0; k < 3; k++){
+      double u = (p[k] - _min[k]) / _h;
+      c[k] = (long long)floor(u);
+      side[k] = (u - c[k] < 0.5) ? -1 : 1;
+    }
+    int best = -1;
+    double bestDist = 0.;
+    for(int n = 0; n < 8; n++){
+      long long cn[3] = {c[0] + ((n & 1) ? side[0] : 0),
+                         c[1] + ((n & 2) ? side[1] : 0),
+                         c[2] + ((n & 4) ? side[2] : 0)};
+      for(int i = _table[_slot(cn)]; i >= 0; i = _next[i]){
+        MVertex *v = _vertices[i];
+        double dx = v->x() - p.x(), dy = v->y() - p.y(), dz = v->z() - p.z();
+        double d = dx * dx + dy * dy + dz * dz;
+        if((d < _eps * _eps || d == 0.) && (best < 0 || d < bestDist)){
+          best = i;
+          bestDist = d;
+        }
+      }
+    }
+    if(best >= 0) return best;
+    best = _vertices.size();
+    _vertices.push_back(new MVertex(p.x(), p.y(), p.z()));
+    unsigned long long s = _slot(c);
+    _next.push_back(_table[s]);
+    _table[s] = best;
+    return best;
+  }
+};
+
+class triangleLessThanSTL {
+ private:
+  const std::vector<int> &_v;
+ public:
+  triangleLessThanSTL(const std::vector<int> &v) : _v(v) {}
+  bool operator()(int a, int b) const
+  {
+    for(int k = 0; k < 3; k++)
+      if(_v[3 * a + k] != _v[3 * b + k]) return _v[3 * a + k] < _v[3 * b + k];
+    return a < b;
+  }
+};
+
 int GModel::readSTL(const std::string &name, double tolerance)
 {
   FILE *fp = Fopen(name.c_str(), "rb");
@@ -21,51 +228,25 @@ int GModel::readSTL(const std::string &name, double tolerance)
     return 0;
   }
 
+  double t1 = GetTimeInSeconds();
+
+  size_t size;
+  char *data = MapFile(fp, size);
+  fclose(fp);
+  if(!data){
+    Msg::Error("Unable to read file '%s'", name.c_str());
+    return 0;
+  }
+
   // store triplets of points for each solid found in the file
   std::vector<std::vector<SPoint3> > points;
-  SBoundingBox3d bbox;
 
   // "solid", or binary data header
-  char buffer[256];
-  if(!fgets(buffer, sizeof(buffer), fp)){ fclose(fp); return 0; }
-
-  bool binary = strncmp(buffer, "solid", 5) && strncmp(buffer, "SOLID", 5);
+  bool binary = (size < 5 || (strncmp(data, "solid", 5) &&
+                              strncmp(data, "SOLID", 5)));
 
   // ASCII STL
-  if(!binary){
-    points.resize(1);
-    while(!feof(fp)) {
-      // "facet normal x y z" or "endsolid"
-      if(!fgets(buffer, sizeof(buffer), fp)) break;
-      if(!strncmp(buffer, "endsolid", 8) ||
-         !strncmp(buffer, "ENDSOLID", 8)){
-        // "solid"
-        if(!fgets(buffer, sizeof(buffer), fp)) break;
-        if(!strncmp(buffer, "solid", 5) ||
-           !strncmp(buffer, "SOLID", 5)){
-          points.resize(points.size() + 1);
-          // "facet normal x y z"
-          if(!fgets(buffer, sizeof(buffer), fp)) break;
-        }
-      }
-      // "outer loop"
-      if(!fgets(buffer, sizeof(buffer), fp)) break;
-      // "vertex x y z"
-      for(int i = 0; i < 3; i++){
-        if(!fgets(buffer, sizeof(buffer), fp)) break;
-        char s1[256];
-        double x, y, z;
-        if(sscanf(buffer, "%s %lf %lf %lf", s1, &x, &y, &z) != 4) break;
-        SPoint3 p(x, y, z);
-        points.back().push_back(p);
-        bbox += p;
-      }
-      // "endloop"
-      if(!fgets(buffer, sizeof(buffer), fp)) break;
-      // "endfacet"
-      if(!fgets(buffer, sizeof(buffer), fp)) break;
-    }
-   }
+  if(!binary) readASCIISTL(data, size, points);
 
   // check if we could parse something
   bool empty = true;
@@ -84,52 +265,30 @@ int GModel::readSTL(const std::string &name, double tolerance)
       Msg::Info("Mesh is in binary format");
     else
       Msg::Info("Wrong ASCII header or empty file: trying binary read");
-    rewind(fp);
-    while(!feof(fp)) {
-      char header[80];
-      if(!fread(header, sizeof(char), 80, fp)) break;
-      unsigned int nfacets = 0;
-      size_t ret = fread(&nfacets, sizeof(unsigned int), 1, fp);
-      bool swap = false;
-      if(nfacets > 100000000){
-        Msg::Info("Swapping bytes from binary file");
-        swap = true;
-        SwapBytes((char*)&nfacets, sizeof(unsigned int), 1);
-      }
-      if(ret && nfacets){
-        points.resize(points.size() + 1);
-        char *data = new char[nfacets * 50 * sizeof(char)];
-        ret = fread(data, sizeof(char), nfacets * 50, fp);
-        if(ret == nfacets * 50){
-          for(unsigned int i = 0; i < nfacets; i++) {
-            float *xyz = (float *)&data[i * 50 * sizeof(char)];
-            if(swap) SwapBytes((char*)xyz, sizeof(float), 12);
-            for(int j = 0; j < 3; j++){
-              SPoint3 p(xyz[3 + 3 * j], xyz[3 + 3 * j + 1], xyz[3 + 3 * j + 2]);
-              points.back().push_back(p);
-              bbox += p;
-            }
-          }
-        }
-        delete [] data;
-      }
-    }
+    readBinarySTL(data, size, points);
   }
 
+  UnmapFile(data, size);
+
+  double t2 = GetTimeInSeconds();
+  Msg::Info("Read STL file in %g s", t2 - t1);
+
   std::vector<GFace*> faces;
+  std::vector<int> numFacets;
+  size_t numPoints = 0;
   for(unsigned int i = 0; i < points.size(); i++){
     if(points[i].empty()){
       Msg::Error("No facets found in STL file for solid %d", i);
-      fclose(fp);
       return 0;
     }
     if(points[i].size() % 3){
       Msg::Error("Wrong number of points (%d) in STL file for solid %d",
                  points[i].size(), i);
-      fclose(fp);
       return 0;
     }
     Msg::Info("%d facets in solid %d", points[i].size() / 3, i);
+    numFacets.push_back(points[i].size() / 3);
+    numPoints += points[i].size();
     // create face
     GFace *face = new discreteFace(this, getMaxElementaryNumber(2) + 1);
     faces.push_back(face);
@@ -137,42 +296,61 @@ int GModel::readSTL(const std::string &name, double tolerance)
   }
 
   // create triangles using unique vertices
+  SBoundingBox3d bbox;
+  for(unsigned int i = 0; i < points.size(); i++)
+    for(unsigned int j = 0; j < points[i].size(); j++)
+      bbox += points[i][j];
   double eps = norm(SVector3(bbox.max(), bbox.min())) * tolerance;
   std::vector<MVertex*> vertices;
-  for(unsigned int i = 0; i < points.size(); i++)
+  std::vector<int> corners(numPoints);
+  vertexWelderSTL welder(vertices, bbox, eps, numPoints);
+  size_t c = 0;
+  for(unsigned int i = 0; i < points.size(); i++){
     for(unsigned int j = 0; j < points[i].size(); j++)
-      vertices.push_back(new MVertex(points[i][j].x(), points[i][j].y(),
-                                     points[i][j].z()));
-  MVertexPositionSet pos(vertices);
+      corners[c++] = welder.find(points[i][j]);
+    std::vector<SPoint3>().swap(points[i]);
+  }
 
-  std::set<MFace,Less_Face> unique;
+  double t3 = GetTimeInSeconds();
+  Msg::Info("Welded %d points into %d vertices in %g s", (int)numPoints,
+            (int)vertices.size(), t3 - t2);
+
+  // remove duplicate triangles (same vertices), keeping the first one
+  const int numTriangles = numPoints / 3;
+  std::vector<int> sorted(corners);
+  for(int i = 0; i < numTriangles; i++)
+    std::sort(sorted.begin() + 3 * i, sorted.begin() + 3 * i + 3);
+  std::vector<int> order(numTriangles);
+  for(int i = 0; i < numTriangles; i++) order[i] = i;
+  std::sort(order.begin(), order.end(), triangleLessThanSTL(sorted));
+  std::vector<char> duplicate(numTriangles, 0);
   int nbDuplic = 0;
-  for(unsigned int i = 0; i < points.size(); i ++){
-    for(unsigned int j = 0; j < points[i].size(); j += 3){
-      MVertex *v[3];
-      for(int k = 0; k < 3; k++){
-        double x = points[i][j + k].x();
-        double y = points[i][j + k].y();
-        double z = points[i][j + k].z();
-        v[k] = pos.find(x, y, z, eps);
-      }
-      MFace mf (v[0], v[1], v[2]);
-      if (unique.find(mf) == unique.end()){
-	faces[i]->triangles.push_back(new MTriangle(v[0], v[1], v[2]));
-	unique.insert(mf);
-      }
-      else{
-	nbDuplic++;
-      }
+  for(int i = 1; i < numTriangles; i++){
+    int a = order[i - 1], b = order[i];
+    if(sorted[3 * a] == sorted[3 * b] && sorted[3 * a + 1] == sorted[3 * b + 1] &&
+       sorted[3 * a + 2] == sorted[3 * b + 2]){
+      duplicate[b] = 1;
+      nbDuplic++;
+    }
+  }
+
+  int t = 0;
+  for(unsigned int i = 0; i < faces.size(); i++){
+    for(int end = t + numFacets[i]; t < end; t++){
+      if(duplicate[t]) continue;
+      faces[i]->triangles.push_back(new MTriangle(vertices[corners[3 * t]],
+                                                  vertices[corners[3 * t + 1]],
+                                                  vertices[corners[3 * t + 2]]));
     }
   }
   if (nbDuplic)
     Msg::Warning("%d duplicate triangles in STL file", nbDuplic);
 
   _associateEntityWithMeshVertices();
-  _storeVerticesInEntities(vertices); // will delete unused vertices
+  _storeVerticesInEntities(vertices);
 
-  fclose(fp);
+  Msg::Info("Created %d triangles in %g s", numTriangles - nbDuplic,
+            GetTimeInSeconds() - t3);
   return 1;
 }
 
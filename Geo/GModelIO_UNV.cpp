@@ -5,6 +5,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
 #include "GModel.h"
 #include "OS.h"
 #include "MLine.h"
@@ -14,58 +15,140 @@
 #include "MHexahedron.h"
 #include "MPrism.h"
 #include "Context.h"
+#include "OutputBuffer.h"
+
+// cursor over the lines of a UNV file mapped in memory
+class lineReaderUNV {
+ private:
+  const char *_p, *_end;
+ public:
+  lineReaderUNV(const char *data, size_t size) : _p(data), _end(data + size) {}
+  // same as fgets(buf, size, fp), but discards the rest of long lines
+  bool getLine(char *buf, int size)
+  {
+    if(_p >= _end) return false;
+    const char *eol = (const char*)memchr(_p, '\n', _end - _p);
+    eol = eol ? eol + 1 : _end;
+    int n = std::min((int)(eol - _p), size - 1);
+    memcpy(buf, _p, n);
+    buf[n] = '\0';
+    _p = eol;
+    return true;
+  }
+};
+
+// parse up to n integers in str; return the number of integers read
+static int getIntsUNV(const char *str, int *val, int n)
+{
+  for(int i = 0; i < n; i++){
+    char *end;
+    val[i] = strtol(str, &end, 10);
+    if(end == str) return i;
+    str = end;
+  }
+  return n;
+}
+
+// make the vertices read so far accessible by tag: nodes are usually
+// numbered (almost) contiguously, in which case they are stored in a vector
+// indexed by tag instead of a map
+static void cacheVerticesUNV(const std::vector<MVertex*> &nodes, int maxNum,
+                             std::vector<MVertex*> &vec,
+                             std::map<int, MVertex*> &map)
+{
+  vec.clear();
+  map.clear();
+  if(maxNum <= 2 * (int)nodes.size()){
+    vec.resize(maxNum + 1, 0);
+    for(unsigned int i = 0; i < nodes.size(); i++)
+      vec[nodes[i]->getNum()] = nodes[i];
+  }
+  else{
+    for(unsigned int i = 0; i < nodes.size(); i++)
+      map[nodes[i]->getNum()] = nodes[i];
+  }
+}
 
 int GModel::readUNV(const std::string &name)
 {
-  FILE *fp = Fopen(name.c_str(), "r");
+  FILE *fp = Fopen(name.c_str(), "rb");
   if(!fp){
     Msg::Error("Unable to open file '%s'", name.c_str());
     return 0;
   }
 
+  double t1 = GetTimeInSeconds();
+
+  size_t size;
+  char *data = MapFile(fp, size);
+  fclose(fp);
+  if(!data){
+    Msg::Error("Unable to read file '%s'", name.c_str());
+    return 0;
+  }
+
+  lineReaderUNV lr(data, size);
   char buffer[256];
   std::map<int, std::vector<MElement*> > elements[7];
   std::map<int, std::map<int, std::string> > physicals[4];
 
+  _vertexVectorCache.clear();
   _vertexMapCache.clear();
+  std::vector<MVertex*> nodes;
+  int maxNum = 0;
+  bool ok = true;
 
-  while(!feof(fp)) {
-    if(!fgets(buffer, sizeof(buffer), fp)) break;
+  while(ok) {
+    if(!lr.getLine(buffer, sizeof(buffer))) break;
     if(!strncmp(buffer, "    -1", 6)){
-      if(!fgets(buffer, sizeof(buffer), fp)) break;
+      if(!lr.getLine(buffer, sizeof(buffer))) break;
       if(!strncmp(buffer, "    -1", 6))
-        if(!fgets(buffer, sizeof(buffer), fp)) break;
+        if(!lr.getLine(buffer, sizeof(buffer))) break;
       int record = 0;
       sscanf(buffer, "%d", &record);
       if(record == 2411){ // nodes
         Msg::Info("Reading nodes");
-        while(fgets(buffer, sizeof(buffer), fp)){
+        while(lr.getLine(buffer, sizeof(buffer))){
           if(!strncmp(buffer, "    -1", 6)) break;
-          int num, dum;
-          if(sscanf(buffer, "%d %d %d %d", &num, &dum, &dum, &dum) != 4) break;
-          if(!fgets(buffer, sizeof(buffer), fp)) break;
-          double x, y, z;
-          for(unsigned int i = 0; i < strlen(buffer); i++)
+          int num[4];
+          if(getIntsUNV(buffer, num, 4) != 4) break;
+          if(!lr.getLine(buffer, sizeof(buffer))) break;
+          double xyz[3];
+          char *p = buffer;
+          for(unsigned int i = 0; buffer[i]; i++)
             if(buffer[i] == 'D') buffer[i] = 'E';
-          if(sscanf(buffer, "%lf %lf %lf", &x, &y, &z) != 3) break;
-          _vertexMapCache[num] = new MVertex(x, y, z, 0, num);
+          int i = 0;
+          for(; i < 3; i++){
+            char *end;
+            xyz[i] = strtod(p, &end);
+            if(end == p) break;
+            p = end;
+          }
+          if(i != 3) break;
+          nodes.push_back(new MVertex(xyz[0], xyz[1], xyz[2], 0, num[0]));
+          maxNum = std::max(maxNum, num[0]);
         }
+        cacheVerticesUNV(nodes, maxNum, _vertexVectorCache, _vertexMapCache);
       }
       else if(record == 2412){ // elements
         Msg::Info("Reading elements");
         std::map<int, int> warn;
-        while(fgets(buffer, sizeof(buffer), fp)){
-          if(strlen(buffer) < 3) continue; // possible line ending after last fscanf
+        while(lr.getLine(buffer, sizeof(buffer))){
+          if(strlen(buffer) < 3) continue; // possible line ending after last node
           if(!strncmp(buffer, "    -1", 6)) break;
-          int num, type, elementary, physical, color, numNodes;
+          int num, type, elementary, physical, numNodes, tags[6];
+          if(getIntsUNV(buffer, tags, 6) != 6) break;
+          num = tags[0];
+          type = tags[1];
 	  if(!CTX::instance()->mesh.switchElementTags) {
-            if(sscanf(buffer, "%d %d %d %d %d %d", &num, &type, &elementary, &physical,
-                      &color, &numNodes) != 6) break;
+            elementary = tags[2];
+            physical = tags[3];
 	  }
           else {
-            if(sscanf(buffer, "%d %d %d %d %d %d", &num, &type, &physical, &elementary,
-                      &color, &numNodes) != 6) break;
+            physical = tags[2];
+            elementary = tags[3];
 	  }
+          numNodes = tags[5];
           if(elementary < 0) elementary = getMaxElementaryNumber(-1) + 1;
           if(physical < 0) physical = 0;
           if(!type){
@@ -82,22 +165,37 @@ int GModel::readUNV(const std::string &name)
           case 11: case 21: case 22: case 31:
           case 23: case 24: case 32:
             // beam elements
-            if(!fgets(buffer, sizeof(buffer), fp)) break;
-            int dum;
-            if(sscanf(buffer, "%d %d %d", &dum, &dum, &dum) != 3) break;
+            if(!lr.getLine(buffer, sizeof(buffer))) break;
+            int dum[3];
+            if(getIntsUNV(buffer, dum, 3) != 3) break;
             break;
           }
+          // the node numbers span one or more lines
           std::vector<MVertex*> vertices(numNodes);
+          char *p = buffer;
+          p[0] = '\0';
           for(int i = 0; i < numNodes; i++){
             int n;
-            if(!fscanf(fp, "%d", &n)){ fclose(fp); return 0; }
+            char *end;
+            while(1){
+              n = strtol(p, &end, 10);
+              if(end != p) break;
+              if(!lr.getLine(buffer, sizeof(buffer))){
+                ok = false;
+                break;
+              }
+              p = buffer;
+            }
+            if(!ok) break;
+            p = end;
             vertices[i] = getMeshVertexByTag(n);
             if(!vertices[i]){
               Msg::Error("Wrong vertex index %d", n);
-              fclose(fp);
-              return 0;
+              ok = false;
+              break;
             }
           }
+          if(!ok) break;
           int dim = -1;
           switch(type){
           case 11: case 21: case 22: case 31:
@@ -181,15 +279,24 @@ int GModel::readUNV(const std::string &name)
     }
   }
 
+  UnmapFile(data, size);
+
   for(int i = 0; i < (int)(sizeof(elements) / sizeof(elements[0])); i++)
     _storeElementsInEntities(elements[i]);
   _associateEntityWithMeshVertices();
-  _storeVerticesInEntities(_vertexMapCache);
+  if(_vertexVectorCache.size())
+    _storeVerticesInEntities(_vertexVectorCache);
+  else
+    _storeVerticesInEntities(_vertexMapCache);
 
   for(int i = 0; i < 4; i++)
     _storePhysicalTagsInEntities(i, physicals[i]);
 
-  fclose(fp);
+  if(!ok) return 0;
+
+  double t2 = GetTimeInSeconds();
+  Msg::Info("Read %g Mb in %g s (%g Mb/s)", size / 1024. / 1024., t2 - t1,
+            (t2 > t1) ? size / 1024. / 1024. / (t2 - t1) : 0.);
   return 1;
 }
 
@@ -207,6 +314,32 @@ static std::string physicalName(GModel *m, int dim, int num)
   return name;
 }
 
+class vertexWriterUNV {
+ private:
+  const std::vector<MVertex*> &_vertices;
+  double _scalingFactor;
+ public:
+  vertexWriterUNV(const std::vector<MVertex*> &vertices, double scalingFactor)
+    : _vertices(vertices), _scalingFactor(scalingFactor) {}
+  void operator()(outputBuffer &buf, int i)
+  {
+    _vertices[i]->writeUNV(buf, _scalingFactor);
+  }
+};
+
+class elementWriterUNV {
+ private:
+  const std::vector<std::pair<MElement*, int> > &_elements;
+ public:
+  elementWriterUNV(const std::vector<std::pair<MElement*, int> > &elements)
+    : _elements(elements) {}
+  void operator()(outputBuffer &buf, int i)
+  {
+    MElement *e = _elements[i].first;
+    e->writeUNV(buf, e->getNum(), _elements[i].second, 0);
+  }
+};
+
 int GModel::writeUNV(const std::string &name, bool saveAll, bool saveGroupsOfNodes,
                      double scalingFactor)
 {
@@ -216,6 +349,8 @@ int GModel::writeUNV(const std::string &name, bool saveAll, bool saveGroupsOfNod
     return 0;
   }
 
+  double t1 = GetTimeInSeconds();
+
   if(noPhysicalGroups()) saveAll = true;
 
   indexMeshVertices(saveAll);
@@ -226,21 +361,31 @@ int GModel::writeUNV(const std::string &name, bool saveAll, bool saveGroupsOfNod
   // nodes
   fprintf(fp, "%6d\n", -1);
   fprintf(fp, "%6d\n", 2411);
-  for(unsigned int i = 0; i < entities.size(); i++)
-    for(unsigned int j = 0; j < entities[i]->mesh_vertices.size(); j++)
-      entities[i]->mesh_vertices[j]->writeUNV(fp, scalingFactor);
+  {
+    std::vector<MVertex*> vertices;
+    for(unsigned int i = 0; i < entities.size(); i++)
+      for(unsigned int j = 0; j < entities[i]->mesh_vertices.size(); j++)
+        if(entities[i]->mesh_vertices[j]->getIndex() >= 0)
+          vertices.push_back(entities[i]->mesh_vertices[j]);
+    vertexWriterUNV w(vertices, scalingFactor);
+    writeInBlocks(fp, vertices.size(), w);
+  }
   fprintf(fp, "%6d\n", -1);
 
   // elements
   fprintf(fp, "%6d\n", -1);
   fprintf(fp, "%6d\n", 2412);
-  for(unsigned int i = 0; i < entities.size(); i++){
-    if(saveAll || entities[i]->physicals.size()){
-      for(unsigned int j = 0; j < entities[i]->getNumMeshElements(); j++){
-        MElement *e = entities[i]->getMeshElement(j);
-        e->writeUNV(fp, e->getNum(), entities[i]->tag(), 0);
+  {
+    std::vector<std::pair<MElement*, int> > elements;
+    for(unsigned int i = 0; i < entities.size(); i++){
+      if(saveAll || entities[i]->physicals.size()){
+        for(unsigned int j = 0; j < entities[i]->getNumMeshElements(); j++)
+          elements.push_back(std::make_pair(entities[i]->getMeshElement(j),
+                                            entities[i]->tag()));
       }
     }
+    elementWriterUNV w(elements);
+    writeInBlocks(fp, elements.size(), w);
   }
   fprintf(fp, "%6d\n", -1);
 
@@ -249,6 +394,7 @@ int GModel::writeUNV(const std::string &name, bool saveAll, bool saveGroupsOfNod
 
   // save groups of elements (and groups of nodes if requested) for each
   // physical
+  outputBuffer buf;
   fprintf(fp, "%6d\n", -1);
   fprintf(fp, "%6d\n", 2477);
   for(int dim = 0; dim <= 3; dim++){
@@ -271,21 +417,22 @@ int GModel::writeUNV(const std::string &name, bool saveAll, bool saveGroupsOfNod
       for(unsigned int i = 0; i < entities.size(); i++)
         nele += entities[i]->getNumMeshElements();
 
-      fprintf(fp, "%10d%10d%10d%10d%10d%10d%10d%10d\n",
-              it->first, 0, 0, 0, 0, 0, 0, (int)nodes.size() + nele);
-      fprintf(fp, "%s\n", physicalName(this, dim, it->first).c_str());
+      buf.format("%10d%10d%10d%10d%10d%10d%10d%10d\n",
+                 it->first, 0, 0, 0, 0, 0, 0, (int)nodes.size() + nele);
+      buf.format("%s\n", physicalName(this, dim, it->first).c_str());
 
       if(saveGroupsOfNodes){
         int row = 0;
         for(std::set<MVertex*>::iterator it2 = nodes.begin(); it2 != nodes.end(); it2++){
           if(row == 2) {
-            fprintf(fp, "\n");
+            buf.put('\n');
             row = 0;
           }
-          fprintf(fp, "%10d%10d%10d%10d", 7, (*it2)->getIndex(), 0, 0);
+          buf.format("%10d%10d%10d%10d", 7, (*it2)->getIndex(), 0, 0);
           row++;
+          if(buf.size() > (1 << 20)) buf.write(fp);
         }
-        fprintf(fp, "\n");
+        buf.put('\n');
       }
 
       {
@@ -294,19 +441,26 @@ int GModel::writeUNV(const std::string &name, bool saveAll, bool saveGroupsOfNod
           for(unsigned int j = 0; j < entities[i]->getNumMeshElements(); j++){
             MElement *e = entities[i]->getMeshElement(j);
             if(row == 2) {
-              fprintf(fp, "\n");
+              buf.put('\n');
               row = 0;
             }
-            fprintf(fp, "%10d%10d%10d%10d", 8, e->getNum(), 0, 0);
+            buf.format("%10d%10d%10d%10d", 8, e->getNum(), 0, 0);
             row++;
+            if(buf.size() > (1 << 20)) buf.write(fp);
           }
         }
-        fprintf(fp, "\n");
+        buf.put('\n');
       }
     }
-    fprintf(fp, "%6d\n", -1);
+    buf.format("%6d\n", -1);
   }
+  buf.write(fp);
 
+  long size = ftell(fp);
   fclose(fp);
+
+  double t2 = GetTimeInSeconds();
+  Msg::Info("Wrote %g Mb in %g s (%g Mb/s)", size / 1024. / 1024., t2 - t1,
+            (t2 > t1) ? size / 1024. / 1024. / (t2 - t1) : 0.);
   return 1;
 }
@@ -3,6 +3,8 @@
 // See the LICENSE.txt file for license information. Please report all
 // bugs and problems to the public mailing list <gmsh@geuz.org>.
 
+#include <ctype.h>
+#include <algorithm>
 #include "GModel.h"
 #include "OS.h"
 #include "MPoint.h"
@@ -14,6 +16,108 @@
 #include "MPrism.h"
 #include "MPyramid.h"
 #include "StringUtils.h"
+#include "OutputBuffer.h"
+
+// in ASCII mode, vertices and elements are formatted concurrently by
+// blocks; in binary mode, they are packed by chunks in large arrays, which
+// are byte-swapped and written at once
+class vertexWriterVTK {
+ private:
+  const std::vector<MVertex*> &_vertices;
+  double _scalingFactor;
+ public:
+  vertexWriterVTK(const std::vector<MVertex*> &vertices, double scalingFactor)
+    : _vertices(vertices), _scalingFactor(scalingFactor) {}
+  void operator()(outputBuffer &buf, int i)
+  {
+    _vertices[i]->writeVTK(buf, false, _scalingFactor);
+  }
+};
+
+class elementWriterVTK {
+ private:
+  const std::vector<MElement*> &_elements;
+ public:
+  elementWriterVTK(const std::vector<MElement*> &elements) : _elements(elements) {}
+  void operator()(outputBuffer &buf, int i)
+  {
+    _elements[i]->writeVTK(buf, false);
+  }
+};
+
+static const int chunkSizeVTK = 1 << 16;
+
+static void writeVerticesVTK(FILE *fp, const std::vector<MVertex*> &vertices,
+                             double scalingFactor, bool bigEndian)
+{
+  std::vector<double> data;
+  for(int start = 0; start < (int)vertices.size(); start += chunkSizeVTK){
+    const int n = std::min(chunkSizeVTK, (int)vertices.size() - start);
+    data.resize(3 * n);
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+    for(int i = 0; i < n; i++){
+      MVertex *v = vertices[start + i];
+      data[3 * i] = v->x() * scalingFactor;
+      data[3 * i + 1] = v->y() * scalingFactor;
+      data[3 * i + 2] = v->z() * scalingFactor;
+    }
+    // VTK always expects big endian binary data
+    if(!bigEndian) SwapBytes((char*)&data[0], sizeof(double), 3 * n);
+    fwrite(&data[0], sizeof(double), 3 * n, fp);
+  }
+}
+
+static void writeElementsVTK(FILE *fp, const std::vector<MElement*> &elements,
+                             bool bigEndian)
+{
+  std::vector<int> offsets, data;
+  for(int start = 0; start < (int)elements.size(); start += chunkSizeVTK){
+    const int n = std::min(chunkSizeVTK, (int)elements.size() - start);
+    offsets.resize(n + 1);
+    offsets[0] = 0;
+    for(int i = 0; i < n; i++)
+      offsets[i + 1] = offsets[i] + elements[start + i]->getNumVertices() + 1;
+    data.resize(offsets[n]);
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+    for(int i = 0; i < n; i++){
+      MElement *e = elements[start + i];
+      int *d = &data[offsets[i]];
+      d[0] = e->getNumVertices();
+      for(int j = 0; j < d[0]; j++)
+        d[j + 1] = e->getVertexVTK(j)->getIndex() - 1;
+    }
+    if(!bigEndian) SwapBytes((char*)&data[0], sizeof(int), data.size());
+    fwrite(&data[0], sizeof(int), data.size(), fp);
+  }
+}
+
+static void writeElementTypesVTK(FILE *fp, const std::vector<MElement*> &elements,
+                                 bool binary, bool bigEndian)
+{
+  std::vector<int> data;
+  outputBuffer buf;
+  for(int start = 0; start < (int)elements.size(); start += chunkSizeVTK){
+    const int n = std::min(chunkSizeVTK, (int)elements.size() - start);
+    data.resize(n);
+    for(int i = 0; i < n; i++)
+      data[i] = elements[start + i]->getTypeForVTK();
+    if(binary){
+      if(!bigEndian) SwapBytes((char*)&data[0], sizeof(int), n);
+      fwrite(&data[0], sizeof(int), n, fp);
+    }
+    else{
+      for(int i = 0; i < n; i++){
+        buf.putInt(data[i]);
+        buf.put('\n');
+      }
+      buf.write(fp);
+    }
+  }
+}
 
 int GModel::writeVTK(const std::string &name, bool binary, bool saveAll,
                      double scalingFactor, bool bigEndian)
@@ -24,6 +128,8 @@ int GModel::writeVTK(const std::string &name, bool binary, bool saveAll,
     return 0;
   }
 
+  double t1 = GetTimeInSeconds();
+
   if(noPhysicalGroups()) saveAll = true;
 
   // get the number of vertices and index the vertices in a continuous
@@ -44,59 +150,127 @@ int GModel::writeVTK(const std::string &name, bool binary, bool saveAll,
 
   // write mesh vertices
   fprintf(fp, "POINTS %d double\n", numVertices);
+  std::vector<MVertex*> vertices;
+  vertices.reserve(numVertices);
   for(unsigned int i = 0; i < entities.size(); i++)
     for(unsigned int j = 0; j < entities[i]->mesh_vertices.size(); j++)
-      entities[i]->mesh_vertices[j]->writeVTK(fp, binary, scalingFactor, bigEndian);
+      if(entities[i]->mesh_vertices[j]->getIndex() >= 0)
+        vertices.push_back(entities[i]->mesh_vertices[j]);
+  if(binary){
+    writeVerticesVTK(fp, vertices, scalingFactor, bigEndian);
+  }
+  else{
+    vertexWriterVTK w(vertices, scalingFactor);
+    writeInBlocks(fp, vertices.size(), w);
+  }
   fprintf(fp, "\n");
 
-  // loop over all elements we need to save and count vertices
-  int numElements = 0, totalNumInt = 0;
+  // list all the elements we need to save and count vertices
+  std::vector<MElement*> elements;
+  int totalNumInt = 0;
   for(unsigned int i = 0; i < entities.size(); i++){
     if(entities[i]->physicals.size() || saveAll){
       for(unsigned int j = 0; j < entities[i]->getNumMeshElements(); j++){
-        if(entities[i]->getMeshElement(j)->getTypeForVTK()){
-          numElements++;
-          totalNumInt += entities[i]->getMeshElement(j)->getNumVertices() + 1;
+        MElement *e = entities[i]->getMeshElement(j);
+        if(e->getTypeForVTK()){
+          elements.push_back(e);
+          totalNumInt += e->getNumVertices() + 1;
         }
       }
     }
   }
 
   // print vertex indices in ascii or binary
-  fprintf(fp, "CELLS %d %d\n", numElements, totalNumInt);
-  for(unsigned int i = 0; i < entities.size(); i++){
-    if(entities[i]->physicals.size() || saveAll){
-      for(unsigned int j = 0; j < entities[i]->getNumMeshElements(); j++){
-        if(entities[i]->getMeshElement(j)->getTypeForVTK())
-          entities[i]->getMeshElement(j)->writeVTK(fp, binary, bigEndian);
-      }
-    }
+  fprintf(fp, "CELLS %d %d\n", (int)elements.size(), totalNumInt);
+  if(binary){
+    writeElementsVTK(fp, elements, bigEndian);
+  }
+  else{
+    elementWriterVTK w(elements);
+    writeInBlocks(fp, elements.size(), w);
   }
   fprintf(fp, "\n");
 
   // print element types in ascii or binary
-  fprintf(fp, "CELL_TYPES %d\n", numElements);
-  for(unsigned int i = 0; i < entities.size(); i++){
-    if(entities[i]->physicals.size() || saveAll){
-      for(unsigned int j = 0; j < entities[i]->getNumMeshElements(); j++){
-        int type = entities[i]->getMeshElement(j)->getTypeForVTK();
-        if(type){
-          if(binary){
-            // VTK always expects big endian binary data
-            if(!bigEndian) SwapBytes((char*)&type, sizeof(int), 1);
-            fwrite(&type, sizeof(int), 1, fp);
-          }
-          else
-            fprintf(fp, "%d\n", type);
-        }
-      }
-    }
-  }
+  fprintf(fp, "CELL_TYPES %d\n", (int)elements.size());
+  writeElementTypesVTK(fp, elements, binary, bigEndian);
 
+  long size = ftell(fp);
   fclose(fp);
+
+  double t2 = GetTimeInSeconds();
+  Msg::Info("Wrote %g Mb in %g s (%g Mb/s)", size / 1024. / 1024., t2 - t1,
+            (t2 > t1) ? size / 1024. / 1024. / (t2 - t1) : 0.);
   return 1;
 }
 
+// cursor over a VTK file mapped in memory
+class cursorVTK {
+ private:
+  const char *_p, *_end;
+ public:
+  cursorVTK(const char *data, size_t size) : _p(data), _end(data + size) {}
+  // copy the next line (without the end of line) in buf
+  bool getLine(char *buf, int size)
+  {
+    if(_p >= _end) return false;
+    const char *eol = (const char*)memchr(_p, '\n', _end - _p);
+    if(!eol) eol = _end;
+    int n = std::min((int)(eol - _p), size - 1);
+    memcpy(buf, _p, n);
+    buf[n] = '\0';
+    _p = (eol < _end) ? eol + 1 : _end;
+    return true;
+  }
+  // skip the rest of the current line, including the end of line
+  void skipLine()
+  {
+    const char *eol = (const char*)memchr(_p, '\n', _end - _p);
+    _p = eol ? eol + 1 : _end;
+  }
+  // copy the next whitespace-separated word in buf
+  bool getWord(char *buf, int size)
+  {
+    while(_p < _end && isspace(*_p)) _p++;
+    if(_p >= _end) return false;
+    int n = 0;
+    while(_p < _end && !isspace(*_p)){
+      if(n < size - 1) buf[n++] = *_p;
+      _p++;
+    }
+    buf[n] = '\0';
+    return true;
+  }
+  bool getInt(int &val)
+  {
+    while(_p < _end && isspace(*_p)) _p++;
+    bool neg = false;
+    if(_p < _end && (*_p == '-' || *_p == '+')) neg = (*_p++ == '-');
+    if(_p >= _end || *_p < '0' || *_p > '9') return false;
+    int v = 0;
+    while(_p < _end && *_p >= '0' && *_p <= '9') v = 10 * v + (*_p++ - '0');
+    val = neg ? -v : v;
+    return true;
+  }
+  bool getDouble(double &val)
+  {
+    char buf[64];
+    if(!getWord(buf, sizeof(buf))) return false;
+    char *end;
+    val = strtod(buf, &end);
+    return end != buf;
+  }
+  // copy n binary values of the given size, swapping bytes if necessary
+  bool getBinary(void *data, int size, size_t n, bool swap)
+  {
+    if((size_t)(_end - _p) < size * n) return false;
+    memcpy(data, _p, size * n);
+    _p += size * n;
+    if(swap) SwapBytes((char*)data, size, n);
+    return true;
+  }
+};
+
 int GModel::readVTK(const std::string &name, bool bigEndian)
 {
   FILE *fp = Fopen(name.c_str(), "rb");
@@ -105,18 +279,43 @@ int GModel::readVTK(const std::string &name, bool bigEndian)
     return 0;
   }
 
+  double t1 = GetTimeInSeconds();
+
+  size_t size;
+  char *data = MapFile(fp, size);
+  fclose(fp);
+  if(!data){
+    Msg::Error("Unable to read file '%s'", name.c_str());
+    return 0;
+  }
+  int status = _readVTK(data, size, bigEndian);
+  UnmapFile(data, size);
+
+  double t2 = GetTimeInSeconds();
+  if(status)
+    Msg::Info("Read %g Mb in %g s (%g Mb/s)", size / 1024. / 1024., t2 - t1,
+              (t2 > t1) ? size / 1024. / 1024. / (t2 - t1) : 0.);
+  return status;
+}
+
+int GModel::_readVTK(const char *data, size_t size, bool bigEndian)
+{
+  cursorVTK fp(data, size);
   char buffer[256], buffer2[256];
   std::map<int, std::map<int, std::string> > physicals[4];
 
-  if(!fgets(buffer, sizeof(buffer), fp)){ fclose(fp); return 0; } // version line
-  if(!fgets(buffer, sizeof(buffer), fp)){ fclose(fp); return 0; } // title
+  if(!fp.getLine(buffer, sizeof(buffer))) return 0; // version line
+  if(!fp.getLine(buffer, sizeof(buffer))) return 0; // title
 
-  if(fscanf(fp, "%s", buffer) != 1) // ASCII or BINARY
+  if(!fp.getWord(buffer, sizeof(buffer))) // ASCII or BINARY
     Msg::Error("Failed reading buffer");
   bool binary = false;
   if(!strcmp(buffer, "BINARY")) binary = true;
+  // VTK always stores big endian binary data
+  const bool swap = !bigEndian;
 
-  if(fscanf(fp, "%s %s", buffer, buffer2) != 2){ fclose(fp); return 0; }
+  if(!fp.getWord(buffer, sizeof(buffer)) || !fp.getWord(buffer2, sizeof(buffer2)))
+    return 0;
 
   bool unstructured = false;
   if(!strcmp(buffer, "DATASET") && !strcmp(buffer2, "UNSTRUCTURED_GRID"))
@@ -125,16 +324,17 @@ int GModel::readVTK(const std::string &name, bool bigEndian)
   if((strcmp(buffer, "DATASET") &&  strcmp(buffer2, "UNSTRUCTURED_GRID")) ||
      (strcmp(buffer, "DATASET") &&  strcmp(buffer2, "POLYDATA"))){
     Msg::Error("VTK reader can only read unstructured or polydata datasets");
-    fclose(fp);
     return 0;
   }
 
-  // read mesh vertices
+  // read mesh vertices (they are numbered implicitly, so we directly store
+  // them in a vector)
   int numVertices;
-  if(fscanf(fp, "%s %d %s\n", buffer, &numVertices, buffer2) != 3) return 0;
+  if(!fp.getWord(buffer, sizeof(buffer)) || !fp.getInt(numVertices) ||
+     !fp.getWord(buffer2, sizeof(buffer2))) return 0;
+  fp.skipLine();
   if(strcmp(buffer, "POINTS") || !numVertices){
     Msg::Warning("No points in dataset");
-    fclose(fp);
     return 0;
   }
   int datasize;
@@ -144,40 +344,34 @@ int GModel::readVTK(const std::string &name, bool bigEndian)
     datasize = sizeof(float);
   else{
     Msg::Warning("VTK reader only accepts float or double datasets");
-    fclose(fp);
     return 0;
   }
   Msg::Info("Reading %d points", numVertices);
-  std::vector<MVertex*> vertices(numVertices);
-  for(int i = 0 ; i < numVertices; i++){
-    double xyz[3];
-    if(binary){
-      if(datasize == sizeof(float)){
-        float f[3];
-        if(fread(f, sizeof(float), 3, fp) != 3){ fclose(fp); return 0; }
-        if(!bigEndian) SwapBytes((char*)f, sizeof(float), 3);
-        for(int j = 0; j < 3; j++) xyz[j] = f[j];
-      }
-      else{
-        if(fread(xyz, sizeof(double), 3, fp) != 3){ fclose(fp); return 0; }
-        if(!bigEndian) SwapBytes((char*)xyz, sizeof(double), 3);
-      }
+  std::vector<double> xyz(3 * numVertices);
+  if(binary){
+    if(datasize == sizeof(float)){
+      std::vector<float> f(3 * numVertices);
+      if(!fp.getBinary(&f[0], sizeof(float), f.size(), swap)) return 0;
+      for(unsigned int i = 0; i < f.size(); i++) xyz[i] = f[i];
     }
     else{
-      if(fscanf(fp, "%lf %lf %lf", &xyz[0], &xyz[1], &xyz[2]) != 3){
-        fclose(fp);
-        return 0;
-      }
+      if(!fp.getBinary(&xyz[0], sizeof(double), xyz.size(), swap)) return 0;
     }
-    vertices[i] = new MVertex(xyz[0], xyz[1], xyz[2]);
   }
+  else{
+    for(unsigned int i = 0; i < xyz.size(); i++)
+      if(!fp.getDouble(xyz[i])) return 0;
+  }
+  std::vector<MVertex*> vertices(numVertices);
+  for(int i = 0 ; i < numVertices; i++)
+    vertices[i] = new MVertex(xyz[3 * i], xyz[3 * i + 1], xyz[3 * i + 2]);
+  std::vector<double>().swap(xyz);
 
   // read mesh elements
   int numElements, totalNumInt;
-  if(fscanf(fp, "%s %d %d\n", buffer, &numElements, &totalNumInt) != 3){
-    fclose(fp);
-    return 0;
-  }
+  if(!fp.getWord(buffer, sizeof(buffer)) || !fp.getInt(numElements) ||
+     !fp.getInt(totalNumInt)) return 0;
+  fp.skipLine();
 
   bool haveCells = true;
   bool haveLines = false;
@@ -192,82 +386,87 @@ int GModel::readVTK(const std::string &name, bool bigEndian)
   }
   else{
     Msg::Warning("No cells or polygons in dataset");
-    fclose(fp);
     return 0;
   }
 
   std::map<int, std::vector<MElement*> > elements[8];
 
   if (haveCells){
-    std::vector<std::vector<MVertex*> > cells(numElements);
-    for(unsigned int i = 0; i < cells.size(); i++){
-      int numVerts, n[100];
-      if(binary){
-	if(fread(&numVerts, sizeof(int), 1, fp) != 1){ fclose(fp); return 0; }
-	if(!bigEndian) SwapBytes((char*)&numVerts, sizeof(int), 1);
-	if((int)fread(n, sizeof(int), numVerts, fp) != numVerts){ fclose(fp); return 0; }
-	if(!bigEndian) SwapBytes((char*)n, sizeof(int), numVerts);
-      }
-      else{
-	if(fscanf(fp, "%d", &numVerts) != 1){ fclose(fp); return 0; }
-	for(int j = 0; j < numVerts; j++){
-	  if(fscanf(fp, "%d", &n[j]) != 1){ fclose(fp); return 0; }
-	}
-      }
-      for(int j = 0; j < numVerts; j++){
-	if(n[j] >= 0 && n[j] < (int)vertices.size())
-	  cells[i].push_back(vertices[n[j]]);
-	else
-	  Msg::Error("Bad vertex index");
+    // the cells are stored as in the file, i.e. as a flat list of (number
+    // of vertices, vertex indices) records
+    std::vector<int> cells(totalNumInt);
+    if(binary){
+      if(!fp.getBinary(&cells[0], sizeof(int), cells.size(), swap)) return 0;
+    }
+    else{
+      for(unsigned int i = 0; i < cells.size(); i++)
+        if(!fp.getInt(cells[i])) return 0;
+    }
+    std::vector<int> offsets(numElements + 1, 0);
+    for(int i = 0; i < numElements; i++){
+      if(offsets[i] >= totalNumInt || cells[offsets[i]] < 0 ||
+         offsets[i] + 1 + cells[offsets[i]] > totalNumInt){
+        Msg::Error("Invalid cell %d", i);
+        return 0;
       }
+      offsets[i + 1] = offsets[i] + 1 + cells[offsets[i]];
     }
 
+    std::vector<int> types(numElements, 0);
     if (unstructured){
-      if(fscanf(fp, "%s %d\n", buffer, &numElements) != 2 ){ fclose(fp); return 0; }
-      if(strcmp(buffer, "CELL_TYPES") || numElements != (int)cells.size()){
+      if(!fp.getWord(buffer, sizeof(buffer)) || !fp.getInt(numElements)) return 0;
+      fp.skipLine();
+      if(strcmp(buffer, "CELL_TYPES") || numElements != (int)types.size()){
 	Msg::Error("No or invalid number of cells types");
-        fclose(fp);
 	return 0;
       }
-      for(unsigned int i = 0; i < cells.size(); i++){
-	int type;
-	if(binary){
-	  if(fread(&type, sizeof(int), 1, fp) != 1){ fclose(fp); return 0; }
-	  if(!bigEndian) SwapBytes((char*)&type, sizeof(int), 1);
-	}
-	else{
-	  if(fscanf(fp, "%d", &type) != 1){ fclose(fp); return 0; }
-	}
-	switch(type){
-	case 1: elements[0][1].push_back(new MPoint(cells[i])); break;
+      if(binary){
+        if(!fp.getBinary(&types[0], sizeof(int), types.size(), swap)) return 0;
+      }
+      else{
+        for(unsigned int i = 0; i < types.size(); i++)
+          if(!fp.getInt(types[i])) return 0;
+      }
+    }
+
+    std::vector<MVertex*> cell;
+    for(int i = 0; i < numElements; i++){
+      cell.clear();
+      for(int j = offsets[i] + 1; j < offsets[i + 1]; j++){
+	if(cells[j] >= 0 && cells[j] < (int)vertices.size())
+	  cell.push_back(vertices[cells[j]]);
+	else
+	  Msg::Error("Bad vertex index");
+      }
+      if (unstructured){
+	switch(types[i]){
+	case 1: elements[0][1].push_back(new MPoint(cell)); break;
 	// first order elements
-	case 3: elements[1][1].push_back(new MLine(cells[i])); break;
-	case 5: elements[2][1].push_back(new MTriangle(cells[i])); break;
-	case 9: elements[3][1].push_back(new MQuadrangle(cells[i])); break;
-	case 10: elements[4][1].push_back(new MTetrahedron(cells[i])); break;
-	case 12: elements[5][1].push_back(new MHexahedron(cells[i])); break;
-	case 13: elements[6][1].push_back(new MPrism(cells[i])); break;
-	case 14: elements[7][1].push_back(new MPyramid(cells[i])); break;
+	case 3: elements[1][1].push_back(new MLine(cell)); break;
+	case 5: elements[2][1].push_back(new MTriangle(cell)); break;
+	case 9: elements[3][1].push_back(new MQuadrangle(cell)); break;
+	case 10: elements[4][1].push_back(new MTetrahedron(cell)); break;
+	case 12: elements[5][1].push_back(new MHexahedron(cell)); break;
+	case 13: elements[6][1].push_back(new MPrism(cell)); break;
+	case 14: elements[7][1].push_back(new MPyramid(cell)); break;
 	// second order elements
-	case 21: elements[1][1].push_back(new MLine(cells[i])); break;
-	case 22: elements[2][1].push_back(new MTriangle(cells[i])); break;
-	case 23: elements[3][1].push_back(new MQuadrangle(cells[i])); break;
-	case 24: elements[4][1].push_back(new MTetrahedron(cells[i])); break;
-	case 25: elements[5][1].push_back(new MHexahedron(cells[i])); break;
+	case 21: elements[1][1].push_back(new MLine(cell)); break;
+	case 22: elements[2][1].push_back(new MTriangle(cell)); break;
+	case 23: elements[3][1].push_back(new MQuadrangle(cell)); break;
+	case 24: elements[4][1].push_back(new MTetrahedron(cell)); break;
+	case 25: elements[5][1].push_back(new MHexahedron(cell)); break;
 	default:
-	  Msg::Error("Unknown type of cell %d", type);
+	  Msg::Error("Unknown type of cell %d", types[i]);
 	  break;
 	}
       }
-    }
-    else{
-      for(unsigned int i = 0; i < cells.size(); i++){
-	int nbNodes = (int)cells[i].size();
+      else{
+	int nbNodes = (int)cell.size();
 	switch(nbNodes){
-	case 1: elements[0][1].push_back(new MPoint(cells[i])); break;
-	case 2: elements[1][1].push_back(new MLine(cells[i])); break;
-	case 3: elements[2][1].push_back(new MTriangle(cells[i])); break;
-	case 4: elements[3][1].push_back(new MQuadrangle(cells[i])); break;
+	case 1: elements[0][1].push_back(new MPoint(cell)); break;
+	case 2: elements[1][1].push_back(new MLine(cell)); break;
+	case 3: elements[2][1].push_back(new MTriangle(cell)); break;
+	case 4: elements[3][1].push_back(new MQuadrangle(cell)); break;
 	default:
 	  Msg::Error("Unknown type of mesh element with %d nodes", nbNodes);
 	  break;
@@ -277,22 +476,20 @@ int GModel::readVTK(const std::string &name, bool bigEndian)
   }
   else if (haveLines){
     if(!binary){
-      int v0, v1;
-      char line[100000], *p, *pEnd, *pEnd2;
       int iLine = 1;
-      for (int k= 0; k < numElements; k++){
+      for (int k = 0; k < numElements; k++){
 	physicals[1][iLine][1] = "centerline";
-	if(!fgets(line, sizeof(line), fp)){ fclose(fp); return 0; }
-	v0 = (int)strtol(line, &pEnd, 10); //ignore first line
-	v0 = (int)strtol(pEnd, &pEnd2, 10);
-	p=pEnd2;
-	while(1){
-	  v1 = strtol(p, &pEnd, 10);
-	  if (p == pEnd )  break;
-	  elements[1][iLine].push_back(new MLine(vertices[v0],vertices[v1]));
-	  p = pEnd;
+        int n, v0, v1;
+        if(!fp.getInt(n) || !fp.getInt(v0)) return 0;
+        for(int j = 1; j < n; j++){
+          if(!fp.getInt(v1)) return 0;
+          if(v0 < 0 || v0 >= numVertices || v1 < 0 || v1 >= numVertices){
+            Msg::Error("Bad vertex index");
+            return 0;
+          }
+	  elements[1][iLine].push_back(new MLine(vertices[v0], vertices[v1]));
 	  v0 = v1;
-	}
+        }
 	iLine++;
       }
     }
@@ -310,6 +507,5 @@ int GModel::readVTK(const std::string &name, bool bigEndian)
   for(int i = 0; i < 4; i++)
     _storePhysicalTagsInEntities(i, physicals[i]);
 
-  fclose(fp);
   return 1;
 }
@@ -23,29 +23,52 @@
 #include "StringUtils.h"
 #include "Numeric.h"
 #include "Context.h"
+#include "OutputBuffer.h"
+#include "SlabAllocator.h"
 
 #define SQU(a)      ((a)*(a))
 
 double MElement::_isInsideTolerance = 1.e-6;
 
+static slabAllocator elementAllocator;
+
+void *MElement::operator new(size_t size)
+{
+  return elementAllocator.allocate(size);
+}
+
+void MElement::operator delete(void *p, size_t size)
+{
+  elementAllocator.deallocate(p, size);
+}
+
+size_t MElement::getAllocatedMemory()
+{
+  return elementAllocator.getMemory();
+}
+
+size_t MElement::getNumAllocated()
+{
+  return elementAllocator.getNumObjects();
+}
+
 MElement::MElement(int num, int part) : _visible(1)
 {
-#if defined(_OPENMP)
-  #pragma omp critical
-#endif
-  {
-    // we should make GModel a mandatory argument to the constructor
-    GModel *m = GModel::current();
-    if(num){
-      _num = num;
-      m->setMaxElementNumber(std::max(m->getMaxElementNumber(), _num));
-    }
-    else{
-      m->setMaxElementNumber(m->getMaxElementNumber() + 1);
-      _num = m->getMaxElementNumber();
-    }
-    _partition = (short)part;
+  // we should make GModel a mandatory argument to the constructor
+  GModel *m = GModel::current();
+  if(num){
+    _num = num;
+    m->reserveElementNumber(_num);
   }
+  else
+    _num = m->getNewElementNumber();
+  _partition = (short)part;
+}
+
+void MElement::forceNum(int num, bool reserve)
+{
+  _num = num;
+  if(reserve) GModel::current()->reserveElementNumber(_num);
 }
 
 void MElement::_getEdgeRep(MVertex *v0, MVertex *v1,
@@ -732,6 +755,14 @@ double MElement::integrateFlux(double val[], int face, int pOrder, int order)
 
 void MElement::writeMSH(FILE *fp, bool binary, int entity,
                         std::vector<short> *ghosts)
+{
+  outputBuffer buf;
+  writeMSH(buf, binary, entity, ghosts);
+  buf.write(fp);
+}
+
+void MElement::writeMSH(outputBuffer &buf, bool binary, int entity,
+                        std::vector<short> *ghosts)
 {
   int num = getNum();
   int type = getTypeForMSH();
@@ -760,23 +791,35 @@ void MElement::writeMSH(FILE *fp, bool binary, int entity,
   int numData = data.size();
 
   if(!binary){
-    fprintf(fp, "%d %d %d %d", num, type, entity, numData);
-    for(int i = 0; i < numData; i++)
-      fprintf(fp, " %d", data[i]);
-    fprintf(fp, "\n");
+    buf.putInt(num); buf.put(' ');
+    buf.putInt(type); buf.put(' ');
+    buf.putInt(entity); buf.put(' ');
+    buf.putInt(numData);
+    for(int i = 0; i < numData; i++){
+      buf.put(' '); buf.putInt(data[i]);
+    }
+    buf.put('\n');
   }
   else{
-    fwrite(&num, sizeof(int), 1, fp);
-    fwrite(&type, sizeof(int), 1, fp);
-    fwrite(&entity, sizeof(int), 1, fp);
-    fwrite(&numData, sizeof(int), 1, fp);
-    fwrite(&data[0], sizeof(int), numData, fp);
+    int header[4] = {num, type, entity, numData};
+    buf.put(header, 4 * sizeof(int));
+    buf.put(&data[0], numData * sizeof(int));
   }
 }
 
 void MElement::writeMSH2(FILE *fp, double version, bool binary, int num,
                          int elementary, int physical, int parentNum,
                          int dom1Num, int dom2Num, std::vector<short> *ghosts)
+{
+  outputBuffer buf;
+  writeMSH2(buf, version, binary, num, elementary, physical, parentNum,
+            dom1Num, dom2Num, ghosts);
+  buf.write(fp);
+}
+
+void MElement::writeMSH2(outputBuffer &buf, double version, bool binary, int num,
+                         int elementary, int physical, int parentNum,
+                         int dom1Num, int dom2Num, std::vector<short> *ghosts)
 {
   int type = getTypeForMSH();
 
@@ -792,47 +835,67 @@ void MElement::writeMSH2(FILE *fp, double version, bool binary, int num,
     if(poly){
       for (int i = 0; i < getNumChildren() ; i++){
          MElement *t = getChild(i);
-         t->writeMSH2(fp, version, binary, num++, elementary, physical, 0, 0, 0, ghosts);
+         t->writeMSH2(buf, version, binary, num++, elementary, physical, 0, 0, 0, ghosts);
       }
       return;
     }
     if(type == MSH_TRI_B){
       MTriangle *t = new MTriangle(getVertex(0), getVertex(1), getVertex(2));
-      t->writeMSH2(fp, version, binary, num++, elementary, physical, 0, 0, 0, ghosts);
+      t->writeMSH2(buf, version, binary, num++, elementary, physical, 0, 0, 0, ghosts);
       delete t;
       return;
     }
     if(type == MSH_LIN_B || type == MSH_LIN_C){
       MLine *l = new MLine(getVertex(0), getVertex(1));
-      l->writeMSH2(fp, version, binary, num++, elementary, physical, 0, 0, 0, ghosts);
+      l->writeMSH2(buf, version, binary, num++, elementary, physical, 0, 0, 0, ghosts);
       delete l;
       return;
     }
   }
 
   if(!binary){
-    fprintf(fp, "%d %d", num ? num : _num, type);
-    if(version < 2.0)
-      fprintf(fp, " %d %d %d", abs(physical), elementary, n);
-    else if (version < 2.2)
-      fprintf(fp, " %d %d %d", abs(physical), elementary, _partition);
-    else if(!_partition && !par && !dom)
-      fprintf(fp, " %d %d %d", 2 + par + dom, abs(physical), elementary);
-    else if(!ghosts)
-      fprintf(fp, " %d %d %d 1 %d", 4 + par + dom, abs(physical), elementary, _partition);
+    int tags[5], numTags;
+    if(version < 2.0){
+      tags[0] = abs(physical); tags[1] = elementary; tags[2] = n; numTags = 3;
+    }
+    else if (version < 2.2){
+      tags[0] = abs(physical); tags[1] = elementary; tags[2] = _partition;
+      numTags = 3;
+    }
+    else if(!_partition && !par && !dom){
+      tags[0] = 2 + par + dom; tags[1] = abs(physical); tags[2] = elementary;
+      numTags = 3;
+    }
+    else if(!ghosts){
+      tags[0] = 4 + par + dom; tags[1] = abs(physical); tags[2] = elementary;
+      tags[3] = 1; tags[4] = _partition; numTags = 5;
+    }
     else{
       int numGhosts = ghosts->size();
-      fprintf(fp, " %d %d %d %d %d", 4 + numGhosts + par + dom, abs(physical),
-              elementary, 1 + numGhosts, _partition);
-      for(unsigned int i = 0; i < ghosts->size(); i++)
-        fprintf(fp, " %d", -(*ghosts)[i]);
+      tags[0] = 4 + numGhosts + par + dom; tags[1] = abs(physical);
+      tags[2] = elementary; tags[3] = 1 + numGhosts; tags[4] = _partition;
+      numTags = 5;
+    }
+    buf.putInt(num ? num : _num); buf.put(' ');
+    buf.putInt(type);
+    for(int i = 0; i < numTags; i++){
+      buf.put(' '); buf.putInt(tags[i]);
+    }
+    if(ghosts && version >= 2.2 && (_partition || par || dom)){
+      for(unsigned int i = 0; i < ghosts->size(); i++){
+        buf.put(' '); buf.putInt(-(*ghosts)[i]);
+      }
+    }
+    if(version >= 2.0 && par){
+      buf.put(' '); buf.putInt(parentNum);
+    }
+    if(version >= 2.0 && dom){
+      buf.put(' '); buf.putInt(dom1Num);
+      buf.put(' '); buf.putInt(dom2Num);
+    }
+    if(version >= 2.0 && poly){
+      buf.put(' '); buf.putInt(n);
     }
-    if(version >= 2.0 && par)
-      fprintf(fp, " %d", parentNum);
-    if(version >= 2.0 && dom)
-      fprintf(fp, " %d %d", dom1Num, dom2Num);
-    if(version >= 2.0 && poly)
-      fprintf(fp, " %d", n);
   }
   else{
     int numTags, numGhosts = 0;
@@ -854,7 +917,7 @@ void MElement::writeMSH2(FILE *fp, double version, bool binary, int num,
       for(int i = 0; i < numGhosts; i++) blob[8 + i] = -(*ghosts)[i];
     if(par) blob[8 + numGhosts] = parentNum;
     if(poly) Msg::Error("Unable to write polygons/polyhedra in binary files.");
-    fwrite(blob, sizeof(int), 4 + numTags, fp);
+    buf.put(blob, (4 + numTags) * sizeof(int));
   }
 
   if(physical < 0) reverse();
@@ -863,12 +926,13 @@ void MElement::writeMSH2(FILE *fp, double version, bool binary, int num,
   getVerticesIdForMSH(verts);
 
   if(!binary){
-    for(int i = 0; i < n; i++)
-      fprintf(fp, " %d", verts[i]);
-    fprintf(fp, "\n");
+    for(int i = 0; i < n; i++){
+      buf.put(' '); buf.putInt(verts[i]);
+    }
+    buf.put('\n');
   }
   else{
-    fwrite(&verts[0], sizeof(int), n, fp);
+    buf.put(&verts[0], n * sizeof(int));
   }
 
   if(physical < 0) reverse();
@@ -1000,6 +1064,13 @@ void MElement::writeVRML(FILE *fp)
 }
 
 void MElement::writeVTK(FILE *fp, bool binary, bool bigEndian)
+{
+  outputBuffer buf;
+  writeVTK(buf, binary, bigEndian);
+  buf.write(fp);
+}
+
+void MElement::writeVTK(outputBuffer &buf, bool binary, bool bigEndian)
 {
   if(!getTypeForVTK()) return;
 
@@ -1011,17 +1082,25 @@ void MElement::writeVTK(FILE *fp, bool binary, bool bigEndian)
       verts[i + 1] = getVertexVTK(i)->getIndex() - 1;
     // VTK always expects big endian binary data
     if(!bigEndian) SwapBytes((char*)verts, sizeof(int), n + 1);
-    fwrite(verts, sizeof(int), n + 1, fp);
+    buf.put(verts, (n + 1) * sizeof(int));
   }
   else{
-    fprintf(fp, "%d", n);
-    for(int i = 0; i < n; i++)
-      fprintf(fp, " %d", getVertexVTK(i)->getIndex() - 1);
-    fprintf(fp, "\n");
+    buf.putInt(n);
+    for(int i = 0; i < n; i++){
+      buf.put(' '); buf.putInt(getVertexVTK(i)->getIndex() - 1);
+    }
+    buf.put('\n');
   }
 }
 
 void MElement::writeUNV(FILE *fp, int num, int elementary, int physical)
+{
+  outputBuffer buf;
+  writeUNV(buf, num, elementary, physical);
+  buf.write(fp);
+}
+
+void MElement::writeUNV(outputBuffer &buf, int num, int elementary, int physical)
 {
   int type = getTypeForUNV();
   if(!type) return;
@@ -1030,20 +1109,20 @@ void MElement::writeUNV(FILE *fp, int num, int elementary, int physical)
   int physical_property = elementary;
   int material_property = abs(physical);
   int color = 7;
-  fprintf(fp, "%10d%10d%10d%10d%10d%10d\n",
-          num ? num : _num, type, physical_property, material_property, color, n);
+  buf.format("%10d%10d%10d%10d%10d%10d\n",
+             num ? num : _num, type, physical_property, material_property, color, n);
   if(type == 21 || type == 24) // linear beam or parabolic beam
-    fprintf(fp, "%10d%10d%10d\n", 0, 0, 0);
+    buf.format("%10d%10d%10d\n", 0, 0, 0);
 
   if(physical < 0) reverse();
 
   for(int k = 0; k < n; k++) {
-    fprintf(fp, "%10d", getVertexUNV(k)->getIndex());
+    buf.format("%10d", getVertexUNV(k)->getIndex());
     if(k % 8 == 7)
-      fprintf(fp, "\n");
+      buf.put('\n');
   }
   if(n - 1 % 8 != 7)
-    fprintf(fp, "\n");
+    buf.put('\n');
 
   if(physical < 0) reverse();
 }
@@ -34,8 +34,12 @@ class MElement
   char _visible;
  protected:
   // the tolerance used to determine if a point is inside an element,
-  // in parametric coordinates
+  // in parametric coordinates (each thread has its own, as it is changed
+  // temporarily e.g. by the non-strict octree searches)
   static double _isInsideTolerance;
+#if defined(_OPENMP)
+#pragma omp threadprivate(_isInsideTolerance)
+#endif
   void _getEdgeRep(MVertex *v0, MVertex *v1,
                    double *x, double *y, double *z, SVector3 *n,
                    int faceIndex=-1);
@@ -45,6 +49,14 @@ class MElement
   MElement(int num=0, int part=0);
   virtual ~MElement(){}
 
+  // elements are allocated in slabs (see SlabAllocator.h)
+  static void *operator new(size_t size);
+  static void operator delete(void *p, size_t size);
+
+  // memory used by all the elements (in bytes) and number of elements
+  static size_t getAllocatedMemory();
+  static size_t getNumAllocated();
+
   // set/get the tolerance for isInside() test
   static void setTolerance(const double tol){ _isInsideTolerance = tol; }
   static double getTolerance() { return _isInsideTolerance; }
@@ -52,6 +64,10 @@ class MElement
   // return the tag of the element
   virtual int getNum() const { return _num; }
 
+  // force the tag of the element (e.g. when renumbering the mesh); if
+  // reserve is false, the maximum number of the current model is not updated
+  void forceNum(int num, bool reserve=true);
+
   // return the geometrical dimension of the element
   virtual int getDim() const = 0;
 
@@ -327,6 +343,16 @@ class MElement
                          int num=0, int elementary=1, int physical=1,
                          int parentNum=0, int dom1Num = 0, int dom2Num = 0,
                          std::vector<short> *ghosts=0);
+  // same, formatted in a memory buffer
+  virtual void writeMSH(outputBuffer &buf, bool binary=false, int elementary=1,
+                        std::vector<short> *ghosts=0);
+  virtual void writeMSH2(outputBuffer &buf, double version=1.0, bool binary=false,
+                         int num=0, int elementary=1, int physical=1,
+                         int parentNum=0, int dom1Num = 0, int dom2Num = 0,
+                         std::vector<short> *ghosts=0);
+  virtual void writeUNV(outputBuffer &buf, int num=0, int elementary=1,
+                        int physical=1);
+  virtual void writeVTK(outputBuffer &buf, bool binary=false, bool bigEndian=false);
   virtual void writePOS(FILE *fp, bool printElementary, bool printElementNumber,
                         bool printGamma, bool printEta, bool printRho,
                         bool printDisto,double scalingFactor=1.0, int elementary=1);
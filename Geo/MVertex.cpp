@@ -13,9 +13,33 @@
 #include "GFaceCompound.h"
 #include "GmshMessage.h"
 #include "StringUtils.h"
+#include "OutputBuffer.h"
+#include "SlabAllocator.h"
 
 double MVertexLessThanLexicographic::tolerance = 1.e-6;
 
+static slabAllocator vertexAllocator;
+
+void *MVertex::operator new(size_t size)
+{
+  return vertexAllocator.allocate(size);
+}
+
+void MVertex::operator delete(void *p, size_t size)
+{
+  vertexAllocator.deallocate(p, size);
+}
+
+size_t MVertex::getAllocatedMemory()
+{
+  return vertexAllocator.getMemory();
+}
+
+size_t MVertex::getNumAllocated()
+{
+  return vertexAllocator.getNumObjects();
+}
+
 bool MVertexLessThanLexicographic::operator()(const MVertex *v1, const MVertex *v2) const
 {
   if(v1->x() - v2->x() >  tolerance) return true;
@@ -45,22 +69,15 @@ double angle3Vertices(const MVertex *p1, const MVertex *p2, const MVertex *p3)
 MVertex::MVertex(double x, double y, double z, GEntity *ge, int num)
   : _visible(1), _order(1), _x(x), _y(y), _z(z), _ge(ge)
 {
-#if defined(_OPENMP)
-#pragma omp critical
-#endif
-  {
-    // we should make GModel a mandatory argument to the constructor
-    GModel *m = GModel::current();
-    if(num){
-      _num = num;
-      m->setMaxVertexNumber(std::max(m->getMaxVertexNumber(), _num));
-    }
-    else{
-      m->setMaxVertexNumber(m->getMaxVertexNumber() + 1);
-      _num = m->getMaxVertexNumber();
-    }
-    _index = num;
+  // we should make GModel a mandatory argument to the constructor
+  GModel *m = GModel::current();
+  if(num){
+    _num = num;
+    m->reserveVertexNumber(_num);
   }
+  else
+    _num = m->getNewVertexNumber();
+  _index = num;
 }
 
 void MVertex::deleteLast()
@@ -71,61 +88,68 @@ void MVertex::deleteLast()
   delete this;
 }
 
-void MVertex::forceNum(int num)
+void MVertex::forceNum(int num, bool reserve)
 {
-#if defined(_OPENMP)
-#pragma omp critical
-#endif
-  {
-    _num = num;
-    GModel::current()->setMaxVertexNumber
-      (std::max(GModel::current()->getMaxVertexNumber(), _num));
-  }
+  _num = num;
+  if(reserve) GModel::current()->reserveVertexNumber(_num);
 }
 
 void MVertex::writeMSH(FILE *fp, bool binary, bool saveParametric, double scalingFactor)
+{
+  outputBuffer buf;
+  writeMSH(buf, binary, saveParametric, scalingFactor);
+  buf.write(fp);
+}
+
+void MVertex::writeMSH(outputBuffer &buf, bool binary, bool saveParametric,
+                       double scalingFactor)
 {
   if(_index < 0) return; // negative index vertices are never saved
 
   if(!binary){
-    fprintf(fp, "%d %.16g %.16g %.16g ", _index, x() * scalingFactor,
-            y() * scalingFactor, z() * scalingFactor);
+    buf.putInt(_index); buf.put(' ');
+    buf.putDouble(x() * scalingFactor); buf.put(' ');
+    buf.putDouble(y() * scalingFactor); buf.put(' ');
+    buf.putDouble(z() * scalingFactor); buf.put(' ');
   }
   else{
-    fwrite(&_index, sizeof(int), 1, fp);
+    buf.put(&_index, sizeof(int));
     double data[3] = {x() * scalingFactor, y() * scalingFactor, z() * scalingFactor};
-    fwrite(data, sizeof(double), 3, fp);
+    buf.put(data, 3 * sizeof(double));
   }
 
   int zero = 0;
   if(!onWhat() || !saveParametric){
     if(!binary)
-      fprintf(fp, "0\n");
+      buf.put("0\n");
     else
-      fwrite(&zero, sizeof(int), 1, fp);
+      buf.put(&zero, sizeof(int));
   }
   else{
     int entity = onWhat()->tag();
     int dim = onWhat()->dim();
-    if(!binary)
-      fprintf(fp, "%d %d ", entity, dim);
+    if(!binary){
+      buf.putInt(entity); buf.put(' ');
+      buf.putInt(dim); buf.put(' ');
+    }
     else{
-      fwrite(&entity, sizeof(int), 1, fp);
-      fwrite(&dim, sizeof(int), 1, fp);
+      buf.put(&entity, sizeof(int));
+      buf.put(&dim, sizeof(int));
     }
     switch(dim){
     case 0:
       if(!binary)
-        fprintf(fp, "\n");
+        buf.put('\n');
       break;
     case 1:
       {
         double _u;
         getParameter(0, _u);
-        if(!binary)
-          fprintf(fp, "%.16g\n", _u);
+        if(!binary){
+          buf.putDouble(_u); buf.put('\n');
+        }
         else
-          fwrite(&_u, sizeof(double), 1, fp);
+          buf.put(&_u, sizeof(double));
       }
       break;
     case 2:
@@ -133,21 +157,23 @@ void MVertex::writeMSH(FILE *fp, bool binary, bool saveParametric, double scalin
         double _u, _v;
         getParameter(0, _u);
         getParameter(1, _v);
-        if(!binary)
-          fprintf(fp, "%.16g %.16g\n", _u, _v);
+        if(!binary){
+          buf.putDouble(_u); buf.put(' ');
+          buf.putDouble(_v); buf.put('\n');
+        }
         else{
-          fwrite(&_u, sizeof(double), 1, fp);
-          fwrite(&_v, sizeof(double), 1, fp);
+          buf.put(&_u, sizeof(double));
+          buf.put(&_v, sizeof(double));
         }
       }
       break;
     default:
       if(!binary)
-        fprintf(fp, "0 0 0\n");
+        buf.put("0 0 0\n");
       else{
-        fwrite(&zero, sizeof(int), 1, fp);
-        fwrite(&zero, sizeof(int), 1, fp);
-        fwrite(&zero, sizeof(int), 1, fp);
+        buf.put(&zero, sizeof(int));
+        buf.put(&zero, sizeof(int));
+        buf.put(&zero, sizeof(int));
       }
       break;
     }
@@ -155,6 +181,14 @@ void MVertex::writeMSH(FILE *fp, bool binary, bool saveParametric, double scalin
 }
 
 void MVertex::writeMSH2(FILE *fp, bool binary, bool saveParametric, double scalingFactor)
+{
+  outputBuffer buf;
+  writeMSH2(buf, binary, saveParametric, scalingFactor);
+  buf.write(fp);
+}
+
+void MVertex::writeMSH2(outputBuffer &buf, bool binary, bool saveParametric,
+                        double scalingFactor)
 {
   if(_index < 0) return; // negative index vertices are never saved
 
@@ -169,20 +203,24 @@ void MVertex::writeMSH2(FILE *fp, bool binary, bool saveParametric, double scali
   }
 
   if(!binary){
+    buf.putInt(_index); buf.put(' ');
+    buf.putDouble(x() * scalingFactor); buf.put(' ');
+    buf.putDouble(y() * scalingFactor); buf.put(' ');
+    buf.putDouble(z() * scalingFactor);
     if(!saveParametric)
-      fprintf(fp, "%d %.16g %.16g %.16g\n", _index, x() * scalingFactor,
-              y() * scalingFactor, z() * scalingFactor);
-    else
-      fprintf(fp, "%d %.16g %.16g %.16g %d %d", _index, x() * scalingFactor,
-              y() * scalingFactor, z() * scalingFactor, myDim, myTag);
+      buf.put('\n');
+    else{
+      buf.put(' '); buf.putInt(myDim);
+      buf.put(' '); buf.putInt(myTag);
+    }
   }
   else{
-    fwrite(&_index, sizeof(int), 1, fp);
+    buf.put(&_index, sizeof(int));
     double data[3] = {x() * scalingFactor, y() * scalingFactor, z() * scalingFactor};
-    fwrite(data, sizeof(double), 3, fp);
+    buf.put(data, 3 * sizeof(double));
     if(saveParametric){
-      fwrite(&myDim, sizeof(int), 1, fp);
-      fwrite(&myTag, sizeof(int), 1, fp);
+      buf.put(&myDim, sizeof(int));
+      buf.put(&myTag, sizeof(int));
     }
   }
 
@@ -190,25 +228,28 @@ void MVertex::writeMSH2(FILE *fp, bool binary, bool saveParametric, double scali
     if(myDim == 1){
       double _u;
       getParameter(0, _u);
-      if(!binary)
-        fprintf(fp, " %.16g\n", _u);
+      if(!binary){
+        buf.put(' '); buf.putDouble(_u); buf.put('\n');
+      }
       else
-        fwrite(&_u, sizeof(double), 1, fp);
+        buf.put(&_u, sizeof(double));
     }
     else if (myDim == 2){
       double _u, _v;
       getParameter(0, _u);
       getParameter(1, _v);
-      if(!binary)
-        fprintf(fp, " %.16g %.16g\n", _u, _v);
+      if(!binary){
+        buf.put(' '); buf.putDouble(_u);
+        buf.put(' '); buf.putDouble(_v); buf.put('\n');
+      }
       else{
-        fwrite(&_u, sizeof(double), 1, fp);
-        fwrite(&_v, sizeof(double), 1, fp);
+        buf.put(&_u, sizeof(double));
+        buf.put(&_v, sizeof(double));
       }
     }
     else
       if(!binary)
-        fprintf(fp, "\n");
+        buf.put('\n');
   }
 }
 
@@ -228,22 +269,37 @@ void MVertex::writeVRML(FILE *fp, double scalingFactor)
 }
 
 void MVertex::writeUNV(FILE *fp, double scalingFactor)
+{
+  outputBuffer buf;
+  writeUNV(buf, scalingFactor);
+  buf.write(fp);
+}
+
+void MVertex::writeUNV(outputBuffer &buf, double scalingFactor)
 {
   if(_index < 0) return; // negative index vertices are never saved
 
   int coord_sys = 1;
   int displacement_coord_sys = 1;
   int color = 11;
-  fprintf(fp, "%10d%10d%10d%10d\n", _index, coord_sys, displacement_coord_sys, color);
+  buf.format("%10d%10d%10d%10d\n", _index, coord_sys, displacement_coord_sys, color);
   // hack to print the numbers with "D+XX" exponents
   char tmp[128];
   sprintf(tmp, "%25.16E%25.16E%25.16E\n", x() * scalingFactor,
           y() * scalingFactor, z() * scalingFactor);
   for(unsigned int i = 0; i < strlen(tmp); i++) if(tmp[i] == 'E') tmp[i] = 'D';
-  fprintf(fp, "%s", tmp);
+  buf.put(tmp);
 }
 
 void MVertex::writeVTK(FILE *fp, bool binary, double scalingFactor, bool bigEndian)
+{
+  outputBuffer buf;
+  writeVTK(buf, binary, scalingFactor, bigEndian);
+  buf.write(fp);
+}
+
+void MVertex::writeVTK(outputBuffer &buf, bool binary, double scalingFactor,
+                       bool bigEndian)
 {
   if(_index < 0) return; // negative index vertices are never saved
 
@@ -251,11 +307,12 @@ void MVertex::writeVTK(FILE *fp, bool binary, double scalingFactor, bool bigEndi
     double data[3] = {x() * scalingFactor, y() * scalingFactor, z() * scalingFactor};
     // VTK always expects big endian binary data
     if(!bigEndian) SwapBytes((char*)data, sizeof(double), 3);
-    fwrite(data, sizeof(double), 3, fp);
+    buf.put(data, 3 * sizeof(double));
   }
   else{
-    fprintf(fp, "%.16g %.16g %.16g\n",
-            x() * scalingFactor, y() * scalingFactor, z() * scalingFactor);
+    buf.putDouble(x() * scalingFactor); buf.put(' ');
+    buf.putDouble(y() * scalingFactor); buf.put(' ');
+    buf.putDouble(z() * scalingFactor); buf.put('\n');
   }
 }
 
@@ -17,6 +17,7 @@ class GEntity;
 class GEdge;
 class GFace;
 class MVertex;
+class outputBuffer;
 
 class MVertexLessThanLexicographic{
  public:
@@ -50,6 +51,14 @@ class MVertex{
  public:
   MVertex(double x, double y, double z, GEntity *ge=0, int num=0);
   virtual ~MVertex(){}
+
+  // vertices are allocated in slabs (see SlabAllocator.h)
+  static void *operator new(size_t size);
+  static void operator delete(void *p, size_t size);
+
+  // memory used by all the vertices (in bytes) and number of vertices
+  static size_t getAllocatedMemory();
+  static size_t getNumAllocated();
   void deleteLast();
 
   // get/set the visibility flag
@@ -78,8 +87,9 @@ class MVertex{
   // get the immutab vertex number
   inline int getNum() const { return _num; }
 
-  // force the immutable number (this should normally never be used)
-  void forceNum(int num);
+  // force the immutable number (this should normally never be used); if
+  // reserve is false, the maximum number of the current model is not updated
+  void forceNum(int num, bool reserve=true);
 
   // get/set the index
   inline int getIndex() const { return _index; }
@@ -108,6 +118,14 @@ class MVertex{
                 double scalingFactor=1.0);
   void writeMSH2(FILE *fp, bool binary=false, bool saveParametric=false,
                  double scalingFactor=1.0);
+  // same, formatted in a memory buffer
+  void writeMSH(outputBuffer &buf, bool binary=false, bool saveParametric=false,
+                double scalingFactor=1.0);
+  void writeMSH2(outputBuffer &buf, bool binary=false, bool saveParametric=false,
+                 double scalingFactor=1.0);
+  void writeUNV(outputBuffer &buf, double scalingFactor=1.0);
+  void writeVTK(outputBuffer &buf, bool binary=false, double scalingFactor=1.0,
+                bool bigEndian=false);
   void writePLY2(FILE *fp);
   void writeVRML(FILE *fp, double scalingFactor=1.0);
   void writeUNV(FILE *fp, double scalingFactor=1.0);
@@ -0,0 +1,145 @@
+// Gmsh - Copyright (C) 1997-2013 C. Geuzaine, J.-F. Remacle
+//
+// See the LICENSE.txt file for license information. Please report all
+// bugs and problems to the public mailing list <gmsh@geuz.org>.
+
+#include <math.h>
+#include <algorithm>
+#include "MVertexPositionSet.h"
+
+MVertexPositionSet::MVertexPositionSet(std::vector<MVertex*> &vertices,
+                                       int maxDuplicates)
+  : _vertices(vertices), _h(0.), _mask(0)
+{
+  _min[0] = _min[1] = _min[2] = 0.;
+  for(unsigned int i = 0; i < vertices.size(); i++){
+    vertices[i]->setIndex(0);
+    if(!i || vertices[i]->x() < _min[0]) _min[0] = vertices[i]->x();
+    if(!i || vertices[i]->y() < _min[1]) _min[1] = vertices[i]->y();
+    if(!i || vertices[i]->z() < _min[2]) _min[2] = vertices[i]->z();
+  }
+}
+
+void MVertexPositionSet::_cell(double x, double y, double z, long long c[3]) const
+{
+  c[0] = (long long)floor((x - _min[0]) / _h);
+  c[1] = (long long)floor((y - _min[1]) / _h);
+  c[2] = (long long)floor((z - _min[2]) / _h);
+}
+
+void MVertexPositionSet::_build(double tolerance)
+{
+  const int n = _vertices.size();
+  if(tolerance > 0.)
+    _h = 4. * tolerance;
+  else{
+    // only coincident vertices can be found
+    double max = 0.;
+    for(int i = 0; i < n; i++)
+      max = std::max(max, std::max(fabs(_vertices[i]->x() - _min[0]),
+                                   std::max(fabs(_vertices[i]->y() - _min[1]),
+                                            fabs(_vertices[i]->z() - _min[2]))));
+    _h = (max > 0.) ? 1.e-6 * max : 1.;
+  }
+  unsigned long long size = 1024;
+  while(size < (unsigned long long)n) size *= 2;
+  _mask = size - 1;
+
+  std::vector<int> slots(n);
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+  for(int i = 0; i < n; i++){
+    long long c[3];
+    _cell(_vertices[i]->x(), _vertices[i]->y(), _vertices[i]->z(), c);
+    slots[i] = _slot(c);
+  }
+  // counting sort of the vertices by slot
+  _start.assign(size + 1, 0);
+  for(int i = 0; i < n; i++) _start[slots[i] + 1]++;
+  for(unsigned long long s = 0; s < size; s++) _start[s + 1] += _start[s];
+  _sorted.resize(n);
+  std::vector<int> pos(_start.begin(), _start.end() - 1);
+  for(int i = 0; i < n; i++) _sorted[pos[slots[i]]++] = i;
+  _xyz.resize(3 * n);
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+  for(int j = 0; j < n; j++){
+    _xyz[3 * j] = _vertices[_sorted[j]]->x();
+    _xyz[3 * j + 1] = _vertices[_sorted[j]]->y();
+    _xyz[3 * j + 2] = _vertices[_sorted[j]]->z();
+  }
+}
+
+int MVertexPositionSet::_find(double x, double y, double z, double tolerance,
+                              bool tagged) const
+{
+  long long c[3];
+  _cell(x, y, z, c);
+  const double p[3] = {x, y, z};
+  // neighboring cells to visit in each direction (0 if the point is
+  // farther than the tolerance from the cell boundaries)
+  int side[3];
+  for(int k = 0; k < 3; k++){
+    double f = ((p[k] - _min[k]) / _h - c[k]) * _h;
+    side[k] = (f < tolerance) ? -1 : (f > _h - tolerance) ? 1 : 0;
+  }
+  const double tol2 = tolerance * tolerance;
+  int best = -1, bestTagged = -1;
+  double dist = 0., distTagged = 0.;
+  unsigned long long visited[8];
+  int numVisited = 0;
+  for(int n = 0; n < 8; n++){
+    if(((n & 1) && !side[0]) || ((n & 2) && !side[1]) || ((n & 4) && !side[2]))
+      continue;
+    const long long cn[3] = {c[0] + ((n & 1) ? side[0] : 0),
+                             c[1] + ((n & 2) ? side[1] : 0),
+                             c[2] + ((n & 4) ? side[2] : 0)};
+    const unsigned long long s = _slot(cn);
+    // different cells can share the same slot
+    if(std::find(visited, visited + numVisited, s) != visited + numVisited)
+      continue;
+    visited[numVisited++] = s;
+    for(int j = _start[s]; j < _start[s + 1]; j++){
+      const double dx = _xyz[3 * j] - x, dy = _xyz[3 * j + 1] - y;
+      const double dz = _xyz[3 * j + 2] - z;
+      const double d = dx * dx + dy * dy + dz * dz;
+      if(d >= tol2) continue;
+      const int i = _sorted[j];
+      // ties are broken by the position in the vector, for reproducibility
+      if(best < 0 || d < dist || (d == dist && i < best)){
+        best = i;
+        dist = d;
+      }
+      if(_vertices[i]->getIndex() < 0 &&
+         (bestTagged < 0 || d < distTagged || (d == distTagged && i < bestTagged))){
+        bestTagged = i;
+        distTagged = d;
+      }
+    }
+  }
+  return tagged ? bestTagged : (bestTagged >= 0 ? bestTagged : best);
+}
+
+MVertex *MVertexPositionSet::find(double x, double y, double z, double tolerance)
+{
+  if(_vertices.empty()) return 0;
+  if(!_h || 4. * tolerance > _h) _build(tolerance);
+  int i = _find(x, y, z, tolerance, false);
+  if(i >= 0){
+    _vertices[i]->setIndex(-1);
+    return _vertices[i];
+  }
+  Msg::Error("Could not find vertex (%g,%g,%g) (tol %g)",
+             x, y, z, tolerance);
+  return 0;
+}
+
+MVertex *MVertexPositionSet::findTagged(double x, double y, double z,
+                                        double tolerance) const
+{
+  if(_vertices.empty() || !_h || 4. * tolerance > _h) return 0;
+  int i = _find(x, y, z, tolerance, true);
+  return (i >= 0) ? _vertices[i] : 0;
+}
@@ -355,6 +355,22 @@ static double LC_MVertex_PNTS(GEntity *ge, double U, double V)
   }
 }
 
+// take the minimum of the mesh sizes, then constrain by lcMin and lcMax
+static double constrainMeshSize(double l1, double l2, double l3, double l4)
+{
+  double lc = std::min(std::min(std::min(l1, l2), l3), l4);
+  lc = std::max(lc, CTX::instance()->mesh.lcMin);
+  lc = std::min(lc, CTX::instance()->mesh.lcMax);
+
+  if(lc <= 0.){
+    Msg::Error("Wrong mesh element size lc = %g (lcmin = %g, lcmax = %g)",
+               lc, CTX::instance()->mesh.lcMin, CTX::instance()->mesh.lcMax);
+    lc = l1;
+  }
+
+  return lc * CTX::instance()->mesh.lcFactor;
+}
+
 // This is the only function that is used by the meshers
 double BGM_MeshSize(GEntity *ge, double U, double V,
                     double X, double Y, double Z)
@@ -377,27 +393,47 @@ double BGM_MeshSize(GEntity *ge, double U, double V,
   FieldManager *fields = ge->model()->getFields();
   if(fields->getBackgroundField() > 0){
     Field *f = fields->get(fields->getBackgroundField());
+    // fields are not thread-safe (they can e.g. perform ANN searches or
+    // evaluate MathEx expressions with internal state)
+#if defined(_OPENMP)
+#pragma omp critical (BGM_fields)
+#endif
     if(f) l4 = (*f)(X, Y, Z, ge);
   }
 
-  // take the minimum, then constrain by lcMin and lcMax
-  double lc = std::min(std::min(std::min(l1, l2), l3), l4);
-  lc = std::max(lc, CTX::instance()->mesh.lcMin);
-  lc = std::min(lc, CTX::instance()->mesh.lcMax);
+  //Emi fix
+  //if (lc == l1) lc /= 10.;
 
-  if(lc <= 0.){
-    Msg::Error("Wrong mesh element size lc = %g (lcmin = %g, lcmax = %g)",
-               lc, CTX::instance()->mesh.lcMin, CTX::instance()->mesh.lcMax);
-    lc = l1;
-  }
+  return constrainMeshSize(l1, l2, l3, l4);
+}
 
-  //Msg::Debug("BGM X,Y,Z=%g,%g,%g L4=%g L3=%g L2=%g L1=%g LC=%g LFINAL=%g DIM =%d ",
-  //X, Y, Z, l4, l3, l2, l1, lc, lc * CTX::instance()->mesh.lcFactor, ge->dim());
+void BGM_MeshSize(GEntity *ge, int n, const double *U, const double *V,
+                  const double *xyz, double *lc)
+{
+  if(n <= 0) return;
 
-  //Emi fix
-  //if (lc == l1) lc /= 10.;
+  // lc from fields, stored in lc
+  std::fill(lc, lc + n, MAX_LC);
+  FieldManager *fields = ge->model()->getFields();
+  if(fields->getBackgroundField() > 0){
+    Field *f = fields->get(fields->getBackgroundField());
+#if defined(_OPENMP)
+#pragma omp critical (BGM_fields)
+#endif
+    if(f) f->evaluate(xyz, n, lc, ge);
+  }
 
-  return lc * CTX::instance()->mesh.lcFactor;
+  const double l1 = CTX::instance()->lc;
+  for(int i = 0; i < n; i++){
+    const double u = U ? U[i] : 0., v = V ? V[i] : 0.;
+    double l2 = MAX_LC;
+    if(CTX::instance()->mesh.lcFromPoints && ge->dim() < 2)
+      l2 = LC_MVertex_PNTS(ge, u, v);
+    double l3 = MAX_LC;
+    if(CTX::instance()->mesh.lcFromCurvature && ge->dim() < 3)
+      l3 = LC_MVertex_CURV(ge, u, v);
+    lc[i] = constrainMeshSize(l1, l2, l3, lc[i]);
+  }
 }
 
 
@@ -427,6 +463,9 @@ SMetric3 BGM_MeshMetric(GEntity *ge,
     Field *f = fields->get(fields->getBackgroundField());
     if(f) {
       SMetric3 l4;
+#if defined(_OPENMP)
+#pragma omp critical (BGM_fields)
+#endif
       if (!f->isotropic()) (*f)(X, Y, Z, l4, ge);
       else {
         const double L = (*f)(X, Y, Z, ge);
@@ -473,8 +512,9 @@ void backgroundMesh::unset()
 }
 
 backgroundMesh::backgroundMesh(GFace *_gf, bool cfd)
+  : _octree(0), _lastHit(-1)
 #if defined(HAVE_ANN)
-  : _octree(0), uv_kdtree(0), nodes(0), angle_nodes(0), angle_kdtree(0)
+  , uv_kdtree(0), nodes(0), angle_nodes(0), angle_kdtree(0)
 #endif
 {
 
@@ -550,6 +590,8 @@ backgroundMesh::backgroundMesh(GFace *_gf, bool cfd)
 
   _3Dto2D.clear();
   _2Dto3D.clear();
+
+  _buildSearchCache();
 }
 
 backgroundMesh::~backgroundMesh()
@@ -680,6 +722,7 @@ void backgroundMesh::propagate1dMesh(GFace *_gf)
     MVertex *v_3D = itv2->second;
     _sizes[v_2D] = exp(sizes[v_3D]);
   }
+  _updateValueCache();
 }
 
 crossField2d::crossField2d(MVertex* v, GEdge* ge)
@@ -826,6 +869,7 @@ void backgroundMesh::propagateCrossField(GFace *_gf)
     crossField2d::normalizeAngle (angle);
     _angles[v_2D] = angle;
   }
+  _updateValueCache();
 }
 
 void backgroundMesh::updateSizes(GFace *_gf)
@@ -875,22 +919,98 @@ void backgroundMesh::updateSizes(GFace *_gf)
       else s0->second = std::min(s0->second,_beta*s1->second);
     }
   }
+  _updateValueCache();
 }
 
 bool backgroundMesh::inDomain (double u, double v, double w) const
 {
+  double uv2[3];
+  if (w == 0. && _walk(u, v, uv2) >= 0) return true;
   return _octree->find(u, v, w, 2, true) != 0;
 }
 
-double backgroundMesh::operator() (double u, double v, double w) const
+void backgroundMesh::_buildSearchCache()
 {
-  double uv[3] = {u, v, w};
-  double uv2[3];
+  const int n = _triangles.size();
+  _neighbors.assign(3 * n, -1);
+  _triSizes.resize(3 * n);
+  _triCos4.resize(3 * n);
+  _triSin4.resize(3 * n);
+  _updateValueCache();
+  std::map<MEdge, int, Less_Edge> edges;
+  for (int i = 0; i < n; i++){
+    for (int j = 0; j < 3; j++){
+      // edge opposite to vertex j
+      MEdge e(_triangles[i]->getVertex((j + 1) % 3),
+              _triangles[i]->getVertex((j + 2) % 3));
+      std::map<MEdge, int, Less_Edge>::iterator it = edges.find(e);
+      if (it == edges.end())
+        edges[e] = 3 * i + j;
+      else{
+        _neighbors[3 * i + j] = it->second / 3;
+        _neighbors[it->second] = i;
+        edges.erase(it);
+      }
+    }
+    _triIndex[_triangles[i]] = i;
+  }
+}
+
+void backgroundMesh::_updateValueCache()
+{
+  // nothing to do before the cache is built
+  const int n = _triangles.size();
+  if ((int)_triSizes.size() != 3 * n) return;
+  for (int i = 0; i < n; i++){
+    for (int j = 0; j < 3; j++){
+      MVertex *v = _triangles[i]->getVertex(j);
+      std::map<MVertex*,double>::const_iterator its = _sizes.find(v);
+      _triSizes[3 * i + j] = (its == _sizes.end()) ? 0. : its->second;
+      std::map<MVertex*,double>::const_iterator ita = _angles.find(v);
+      const double a = (ita == _angles.end()) ? 0. : ita->second;
+      _triCos4[3 * i + j] = cos(4 * a);
+      _triSin4[3 * i + j] = sin(4 * a);
+    }
+  }
+}
+
+int backgroundMesh::_walk(double u, double v, double *uv2) const
+{
+  // give up after a few steps: the octree is faster for distant points
+  const int maxSteps = 20;
+  double uv[3] = {u, v, 0.};
+  int t = _lastHit;
+  for (int step = 0; t >= 0 && step < maxSteps; step++){
+    _triangles[t]->xyz2uvw(uv, uv2);
+    if (_triangles[t]->isInside(uv2[0], uv2[1], uv2[2])) return t;
+    // cross the edge opposite to the smallest barycentric coordinate
+    const double b[3] = {1. - uv2[0] - uv2[1], uv2[0], uv2[1]};
+    int j = 0;
+    if (b[1] < b[j]) j = 1;
+    if (b[2] < b[j]) j = 2;
+    t = _neighbors[3 * t + j];
+  }
+  return -1;
+}
+
+int backgroundMesh::_find(double u, double v, double w, double *uv2) const
+{
+  if (w == 0.){
+    int t = _walk(u, v, uv2);
+    if (t >= 0){
+      _lastHit = t;
+      return t;
+    }
+  }
   MElement *e = _octree->find(u, v, w, 2, true);
   if (!e) {
 #if defined(HAVE_ANN)
     //printf("BGM octree not found --> find in kdtree \n");
     double pt[3] = {u, v, 0.0};
+    // ANN uses global variables during searches
+#if defined(_OPENMP)
+#pragma omp critical (ANN)
+#endif
     uv_kdtree->annkSearch(pt, 2, index, dist);
     SPoint3  p1(nodes[index[0]][0], nodes[index[0]][1], nodes[index[0]][2]);
     SPoint3  p2(nodes[index[1]][0], nodes[index[1]][1], nodes[index[1]][2]);
@@ -898,16 +1018,60 @@ double backgroundMesh::operator() (double u, double v, double w) const
     signedDistancePointLine(p1, p2, SPoint3(u, v, 0.), d, pnew);
     e = _octree->find(pnew.x(), pnew.y(), 0.0, 2, true);
 #endif
-    if(!e){
-      Msg::Error("BGM octree: cannot find UVW=%g %g %g", u, v, w);
-      return -1000.0;//0.4;
-    }
+    if(!e) return -1;
   }
+  double uv[3] = {u, v, w};
   e->xyz2uvw(uv, uv2);
-  std::map<MVertex*,double>::const_iterator itv1 = _sizes.find(e->getVertex(0));
-  std::map<MVertex*,double>::const_iterator itv2 = _sizes.find(e->getVertex(1));
-  std::map<MVertex*,double>::const_iterator itv3 = _sizes.find(e->getVertex(2));
-  return itv1->second * (1-uv2[0]-uv2[1]) + itv2->second * uv2[0] + itv3->second * uv2[1];
+  std::map<MElement*, int>::const_iterator it = _triIndex.find(e);
+  _lastHit = it->second;
+  return _lastHit;
+}
+
+double backgroundMesh::operator() (double u, double v, double w) const
+{
+  double uv2[3];
+  const int t = _find(u, v, w, uv2);
+  if (t < 0){
+    Msg::Error("BGM octree: cannot find UVW=%g %g %g", u, v, w);
+    return -1000.0;//0.4;
+  }
+  const double *s = &_triSizes[3 * t];
+  return s[0] * (1-uv2[0]-uv2[1]) + s[1] * uv2[0] + s[2] * uv2[1];
+}
+
+void backgroundMesh::eval(int n, const double *uv, double *sizes,
+                          double *angles) const
+{
+  if (!_octree){
+    for (int i = 0; i < n; i++){
+      if (sizes) sizes[i] = (*this)(uv[2 * i], uv[2 * i + 1], 0.);
+      if (angles) angles[i] = getAngle(uv[2 * i], uv[2 * i + 1], 0.);
+    }
+    return;
+  }
+  for (int i = 0; i < n; i++){
+    double uv2[3];
+    const int t = _find(uv[2 * i], uv[2 * i + 1], 0., uv2);
+    if (t < 0){
+      Msg::Error("BGM octree: cannot find UVW=%g %g %g", uv[2 * i],
+                 uv[2 * i + 1], 0.);
+      if (sizes) sizes[i] = -1000.0;
+      if (angles) angles[i] = -1000.0;
+      continue;
+    }
+    const double b[3] = {1-uv2[0]-uv2[1], uv2[0], uv2[1]};
+    if (sizes){
+      const double *s = &_triSizes[3 * t];
+      sizes[i] = s[0] * b[0] + s[1] * b[1] + s[2] * b[2];
+    }
+    if (angles){
+      const double *c = &_triCos4[3 * t], *s = &_triSin4[3 * t];
+      double angle = atan2(s[0] * b[0] + s[1] * b[1] + s[2] * b[2],
+                           c[0] * b[0] + c[1] * b[1] + c[2] * b[2]) / 4.0;
+      crossField2d::normalizeAngle (angle);
+      angles[i] = angle;
+    }
+  }
 }
 
 double backgroundMesh::getAngle(double u, double v, double w) const
@@ -919,6 +1083,10 @@ double backgroundMesh::getAngle(double u, double v, double w) const
   if (!_octree){
 #if defined(HAVE_ANN)
     double pt[3] = {u,v,0.0};
+    // ANN uses global variables during searches
+#if defined(_OPENMP)
+#pragma omp critical (ANN)
+#endif
     angle_kdtree->annkSearch(pt, _NBANN, index, dist);
     double SINE = 0.0 , COSINE = 0.0;
     for (int i=0;i<_NBANN;i++){
@@ -942,36 +1110,15 @@ double backgroundMesh::getAngle(double u, double v, double w) const
   //  crossField2d::normalizeAngle (angles);
   //  return angles;
 
-  double uv[3] = {u, v, w};
   double uv2[3];
-  MElement *e = _octree->find(u, v, w, 2, true);
-  if (!e) {
-#if defined(HAVE_ANN)
-    //printf("BGM octree not found --> find in kdtree \n");
-    double pt[3] = {u,v,0.0};
-    uv_kdtree->annkSearch(pt, 2, index, dist);
-    SPoint3  p1(nodes[index[0]][0], nodes[index[0]][1], nodes[index[0]][2]);
-    SPoint3  p2(nodes[index[1]][0], nodes[index[1]][1], nodes[index[1]][2]);
-    SPoint3 pnew; double d;
-    signedDistancePointLine(p1, p2, SPoint3(u, v, 0.), d, pnew);
-    e = _octree->find(pnew.x(), pnew.y(), 0., 2, true);
-#endif
-    if(!e){
-      Msg::Error("BGM octree angle: cannot find UVW=%g %g %g", u, v, w);
-      return -1000.0;
-    }
+  const int t = _find(u, v, w, uv2);
+  if (t < 0){
+    Msg::Error("BGM octree angle: cannot find UVW=%g %g %g", u, v, w);
+    return -1000.0;
   }
-  e->xyz2uvw(uv, uv2);
-  std::map<MVertex*,double>::const_iterator itv1 = _angles.find(e->getVertex(0));
-  std::map<MVertex*,double>::const_iterator itv2 = _angles.find(e->getVertex(1));
-  std::map<MVertex*,double>::const_iterator itv3 = _angles.find(e->getVertex(2));
-
-  double cos4 = cos (4*itv1->second) * (1-uv2[0]-uv2[1]) +
-    cos (4*itv2->second) * uv2[0] +
-    cos (4*itv3->second) * uv2[1] ;
-  double sin4 = sin (4*itv1->second) * (1-uv2[0]-uv2[1]) +
-    sin (4*itv2->second) * uv2[0] +
-    sin (4*itv3->second) * uv2[1] ;
+  const double *c = &_triCos4[3 * t], *s = &_triSin4[3 * t];
+  double cos4 = c[0] * (1-uv2[0]-uv2[1]) + c[1] * uv2[0] + c[2] * uv2[1];
+  double sin4 = s[0] * (1-uv2[0]-uv2[1]) + s[1] * uv2[0] + s[2] * uv2[1];
   double angle = atan2(sin4,cos4)/4.0;
   crossField2d::normalizeAngle (angle);
 
@@ -49,7 +49,26 @@ class backgroundMesh : public simpleFunction<double>
   std::map<MVertex*,MVertex*> _2Dto3D;
   std::map<MVertex*,double> _distance;  
   std::map<MVertex*,double> _angles;  
+  // neighbors of the triangles (across the edge opposite to each vertex,
+  // -1 on the boundary), and sizes and cross field (cos(4 angle), sin(4
+  // angle)) at the 3 vertices of each triangle
+  std::vector<int> _neighbors;
+  std::map<MElement*, int> _triIndex;
+  std::vector<double> _triSizes, _triCos4, _triSin4;
+  // the last triangle found: since consecutive queries are usually close
+  // to each other, we walk from it before searching in the octree
+  mutable int _lastHit;
+  void _buildSearchCache();
+  // refresh the per-triangle copies of the sizes and angles after they
+  // have been modified
+  void _updateValueCache();
+  int _walk(double u, double v, double *uv2) const;
+  int _find(double u, double v, double w, double *uv2) const;
+  // each thread meshing a surface has its own background mesh
   static backgroundMesh * _current;
+#if defined(_OPENMP)
+#pragma omp threadprivate(_current)
+#endif
   backgroundMesh(GFace *, bool dist = false);
   ~backgroundMesh();
 #if defined(HAVE_ANN)
@@ -73,6 +92,10 @@ class backgroundMesh : public simpleFunction<double>
   double operator () (double u, double v, double w) const; // returns mesh size
   bool inDomain (double u, double v, double w) const; // returns true if in domain
   double getAngle(double u, double v, double w) const ; 
+  // returns mesh size and cross field angle for n points at once (uv[2 * i]
+  // and uv[2 * i + 1] are the parametric coordinates of point i); sizes or
+  // angles can be null
+  void eval(int n, const double *uv, double *sizes, double *angles) const;
   void print(const std::string &filename, GFace *gf, 
               const std::map<MVertex*, double>&) const;
   void print(const std::string &filename, GFace *gf, int choice = 0) const
@@ -88,6 +111,11 @@ class backgroundMesh : public simpleFunction<double>
 SMetric3 buildMetricTangentToCurve (SVector3 &t, double l_t, double l_n);
 SMetric3 buildMetricTangentToSurface (SVector3 &t1, SVector3 &t2, double l_t1, double l_t2, double l_n);
 double BGM_MeshSize(GEntity *ge, double U, double V, double X, double Y, double Z);
+// same for n points on the same entity (U and V can be null, xyz[3 * i + j]
+// is the j-th coordinate of point i): the background field is evaluated for
+// all the points at once
+void BGM_MeshSize(GEntity *ge, int n, const double *U, const double *V,
+                  const double *xyz, double *lc);
 SMetric3 BGM_MeshMetric(GEntity *ge, double U, double V, double X, double Y, double Z);
 bool Extend1dMeshIn2dSurfaces();
 bool Extend2dMeshIn3dVolumes();
@@ -47,6 +47,12 @@ Field::~Field()
     delete it->second;
 }
 
+void Field::evaluate(const double *xyz, int n, double *val, GEntity *ge)
+{
+  for(int i = 0; i < n; i++)
+    val[i] = (*this)(xyz[3 * i], xyz[3 * i + 1], xyz[3 * i + 2], ge);
+}
+
 FieldOption *Field::getOption(const std::string optionName)
 {
   std::map<std::string, FieldOption*>::iterator it = options.find(optionName);
@@ -418,6 +424,14 @@ class BoxField : public Field
     return (x <= x_max && x >= x_min && y <= y_max && y >= y_min && z <= z_max
             && z >= z_min) ? v_in : v_out;
   }
+  void evaluate(const double *xyz, int n, double *val, GEntity *ge=0)
+  {
+    for(int i = 0; i < n; i++){
+      const double x = xyz[3 * i], y = xyz[3 * i + 1], z = xyz[3 * i + 2];
+      val[i] = (x <= x_max && x >= x_min && y <= y_max && y >= y_min &&
+                z <= z_max && z >= z_min) ? v_in : v_out;
+    }
+  }
 };
 
 class CylinderField : public Field
@@ -483,6 +497,20 @@ class CylinderField : public Field
 
     return ((dx*dx + dy*dy + dz*dz < R*R) && fabs(adx) < 1) ? v_in : v_out;
   }
+  void evaluate(const double *xyz, int n, double *val, GEntity *ge=0)
+  {
+    const double a2 = xa*xa + ya*ya + za*za, R2 = R*R;
+    for(int i = 0; i < n; i++){
+      double dx = xyz[3 * i] - xc;
+      double dy = xyz[3 * i + 1] - yc;
+      double dz = xyz[3 * i + 2] - zc;
+      const double adx = (xa * dx + ya * dy + za * dz) / a2;
+      dx -= adx * xa;
+      dy -= adx * ya;
+      dz -= adx * za;
+      val[i] = ((dx*dx + dy*dy + dz*dz < R2) && fabs(adx) < 1) ? v_in : v_out;
+    }
+  }
 };
 
 class FrustumField : public Field
@@ -623,11 +651,9 @@ class ThresholdField : public Field
       (stopAtDistMax, "True to not impose element size outside DistMax (i.e., "
        "F = a very big value if Field[IField] > DistMax)");
   }
-  double operator() (double x, double y, double z, GEntity *ge=0)
+  double threshold(double d) const
   {
-    Field *field = GModel::current()->getFields()->get(iField);
-    if(!field || iField == id) return MAX_LC;
-    double r = ((*field) (x, y, z) - dmin) / (dmax - dmin);
+    double r = (d - dmin) / (dmax - dmin);
     r = std::max(std::min(r, 1.), 0.);
     double lc;
     if(stopAtDistMax && r >= 1.){
@@ -642,6 +668,23 @@ class ThresholdField : public Field
     }
     return lc;
   }
+  double operator() (double x, double y, double z, GEntity *ge=0)
+  {
+    Field *field = GModel::current()->getFields()->get(iField);
+    if(!field || iField == id) return MAX_LC;
+    return threshold((*field) (x, y, z));
+  }
+  void evaluate(const double *xyz, int n, double *val, GEntity *ge=0)
+  {
+    Field *field = GModel::current()->getFields()->get(iField);
+    if(!field || iField == id){
+      std::fill(val, val + n, MAX_LC);
+      return;
+    }
+    field->evaluate(xyz, n, val);
+    for(int i = 0; i < n; i++)
+      val[i] = threshold(val[i]);
+  }
 };
 
 class GradientField : public Field
@@ -940,6 +983,32 @@ class MathEvalExpression
     else
       return MAX_LC;
   }
+  void evaluate(const double *xyz, int n, double *val)
+  {
+    if(!_f){
+      std::fill(val, val + n, MAX_LC);
+      return;
+    }
+    const int nv = 3 + _fields.size();
+    std::vector<double> values(n * nv), f(n);
+    for(int i = 0; i < n; i++)
+      for(int j = 0; j < 3; j++) values[i * nv + j] = xyz[3 * i + j];
+    int j = 3;
+    for(std::set<int>::iterator it = _fields.begin(); it != _fields.end(); it++){
+      Field *field = GModel::current()->getFields()->get(*it);
+      if(field) field->evaluate(xyz, n, &f[0]);
+      else std::fill(f.begin(), f.end(), MAX_LC);
+      for(int i = 0; i < n; i++) values[i * nv + j] = f[i];
+      j++;
+    }
+    if(!_f->eval(n, &values[0], val)){
+      std::vector<double> v(nv), res(1);
+      for(int i = 0; i < n; i++){
+        v.assign(values.begin() + i * nv, values.begin() + (i + 1) * nv);
+        val[i] = _f->eval(v, res) ? res[0] : MAX_LC;
+      }
+    }
+  }
 };
 
 class MathEvalExpressionAniso
@@ -1046,6 +1115,16 @@ class MathEvalField : public Field
     }
     return expr.evaluate(x, y, z);
   }
+  void evaluate(const double *xyz, int n, double *val, GEntity *ge=0)
+  {
+    if(update_needed) {
+      if(!expr.set_function(f))
+        Msg::Error("Field %i: Invalid matheval expression \"%s\"",
+                   this->id, f.c_str());
+      update_needed = false;
+    }
+    expr.evaluate(xyz, n, val);
+  }
   const char *getName()
   {
     return "MathEval";
@@ -1246,8 +1325,11 @@ class PostViewField : public Field
     // of finding an element
     if(!octree->searchTensorWithTol(x, y, z, l, 0, 0, 0.05))
       Msg::Info("No tensor element found containing point (%g,%g,%g)", x, y, z);
-    if(l <= 0 && crop_negative_values)
-      for(int i = 0; i < 9; i++) l[i] = MAX_LC;
+    if(crop_negative_values && (l[0] <= 0 || l[4] <= 0 || l[8] <= 0)){
+      // use the metric of the isotropic size MAX_LC
+      for(int i = 0; i < 9; i++) l[i] = 0.;
+      l[0] = l[4] = l[8] = 1. / (MAX_LC * MAX_LC);
+    }
     metr(0, 0) = l[0];
     metr(0, 1) = l[1];
     metr(0, 2) = l[2];
@@ -1356,6 +1438,18 @@ class MinField : public Field
     }
     return v;
   }
+  void evaluate(const double *xyz, int n, double *val, GEntity *ge=0)
+  {
+    std::fill(val, val + n, MAX_LC);
+    if(n <= 0) return;
+    std::vector<double> tmp(n);
+    for(std::list<int>::iterator it = idlist.begin(); it != idlist.end(); it++) {
+      Field *f = (GModel::current()->getFields()->get(*it));
+      if(!f || *it == id) continue;
+      f->evaluate(xyz, n, &tmp[0], ge);
+      for(int i = 0; i < n; i++) val[i] = std::min(val[i], tmp[i]);
+    }
+  }
   const char *getName()
   {
     return "Min";
@@ -1384,6 +1478,18 @@ class MaxField : public Field
     }
     return v;
   }
+  void evaluate(const double *xyz, int n, double *val, GEntity *ge=0)
+  {
+    std::fill(val, val + n, -MAX_LC);
+    if(n <= 0) return;
+    std::vector<double> tmp(n);
+    for(std::list<int>::iterator it = idlist.begin(); it != idlist.end(); it++) {
+      Field *f = (GModel::current()->getFields()->get(*it));
+      if(!f || *it == id) continue;
+      f->evaluate(xyz, n, &tmp[0], ge);
+      for(int i = 0; i < n; i++) val[i] = std::max(val[i], tmp[i]);
+    }
+  }
   const char *getName()
   {
     return "Max";
@@ -1790,6 +1896,30 @@ class AttractorField : public Field
     kdtree->annkSearch(xyz, 1, index, dist);
     return sqrt(dist[0]);
   }
+  void evaluate(const double *xyz, int n, double *val, GEntity *ge=0)
+  {
+    if(n <= 0) return;
+    // the first point looks up the coordinate fields and builds the kd-tree
+    // if needed; the other ones reuse them
+    val[0] = (*this)(xyz[0], xyz[1], xyz[2], ge);
+    std::vector<double> c;
+    if(_xField || _yField || _zField){
+      c.assign(xyz, xyz + 3 * n);
+      std::vector<double> tmp(n);
+      Field *cf[3] = {_xField, _yField, _zField};
+      for(int j = 0; j < 3; j++){
+        if(!cf[j]) continue;
+        cf[j]->evaluate(xyz, n, &tmp[0], ge);
+        for(int i = 0; i < n; i++) c[3 * i + j] = tmp[i];
+      }
+      xyz = &c[0];
+    }
+    for(int i = 1; i < n; i++){
+      double p[3] = {xyz[3 * i], xyz[3 * i + 1], xyz[3 * i + 2]};
+      kdtree->annkSearch(p, 1, index, dist);
+      val[i] = sqrt(dist[0]);
+    }
+  }
 };
 
 const char *BoundaryLayerField::getName()
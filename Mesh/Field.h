@@ -84,6 +84,10 @@ class Field {
   virtual bool isotropic () const { return true; }
   // isotropic
   virtual double operator() (double x, double y, double z, GEntity *ge=0) = 0;
+  // isotropic, evaluated at n points at once (xyz[3 * i + j] is the j-th
+  // coordinate of point i); the default implementation calls operator()
+  // for each point
+  virtual void evaluate(const double *xyz, int n, double *val, GEntity *ge=0);
   // anisotropic
   virtual void operator() (double x, double y, double z, SMetric3 &, GEntity *ge=0){}
 
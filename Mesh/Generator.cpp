@@ -11,6 +11,7 @@
 #include "Context.h"
 #include "OS.h"
 #include "GModel.h"
+#include "ExtrudeParams.h"
 #include "MPoint.h"
 #include "MLine.h"
 #include "MTriangle.h"
@@ -26,6 +27,7 @@
 #include "meshGRegion.h"
 #include "BackgroundMesh.h"
 #include "BoundaryLayers.h"
+#include "boundaryLayersData.h"
 #include "HighOrder.h"
 #include "Generator.h"
 #include "meshGFaceLloyd.h"
@@ -250,6 +252,13 @@ void GetStatistics(double stat[50], double quality[4][100])
   stat[14] = CTX::instance()->meshTimer[1];
   stat[15] = CTX::instance()->meshTimer[2];
 
+  // memory per element and per vertex (in bytes), including the unused
+  // space in the allocation slabs
+  if(MElement::getNumAllocated())
+    stat[36] = (double)MElement::getAllocatedMemory() / MElement::getNumAllocated();
+  if(MVertex::getNumAllocated())
+    stat[37] = (double)MVertex::getAllocatedMemory() / MVertex::getNumAllocated();
+
   if(quality){
     for(int i = 0; i < 3; i++)
       for(int j = 0; j < 100; j++)
@@ -457,6 +466,50 @@ static void PrintMesh2dStatistics(GModel *m)
   fclose(statreport);
 }
 
+// surfaces whose mesh does not depend on the mesh of other surfaces, and
+// whose meshing does not modify global data, can be meshed concurrently
+static bool meshableConcurrently(GFace *gf)
+{
+  if(gf->geomType() == GEntity::CompoundSurface) return false;
+  if(gf->meshMaster() != gf->tag()) return false;
+  ExtrudeParams *ep = gf->meshAttributes.extrude;
+  if(ep && ep->mesh.ExtrudeMesh) return false;
+  return true;
+}
+
+// estimated cost for meshing a surface: the number of mesh lines on its
+// boundary (the number of triangles grows like its square)
+static int estimatedCost(GFace *gf)
+{
+  int n = 0;
+  std::list<GEdge*> edges = gf->edges();
+  for(std::list<GEdge*>::iterator it = edges.begin(); it != edges.end(); ++it)
+    n += (*it)->lines.size();
+  return n;
+}
+
+// renumber the vertices and elements created during the 2D meshing (the
+// ones numbered above maxv and maxe) surface by surface, in creation order
+// in each surface: the numbering then does not depend on the order in
+// which the surfaces were meshed
+static void renumberSurfaceMeshes(GModel *m, int maxv, int maxe)
+{
+  int nv = maxv, ne = maxe;
+  for(GModel::fiter it = m->firstFace(); it != m->lastFace(); ++it){
+    GFace *gf = *it;
+    for(unsigned int i = 0; i < gf->mesh_vertices.size(); i++)
+      if(gf->mesh_vertices[i]->getNum() > maxv)
+        gf->mesh_vertices[i]->forceNum(++nv);
+    for(unsigned int i = 0; i < gf->getNumMeshElements(); i++){
+      MElement *e = gf->getMeshElement(i);
+      if(e->getNum() > maxe) e->forceNum(++ne);
+    }
+  }
+  m->setMaxVertexNumber(nv);
+  m->setMaxElementNumber(ne);
+  m->destroyMeshCaches();
+}
+
 static void Mesh2D(GModel *m)
 {
   if(TooManyElements(m, 2)) return;
@@ -482,17 +535,56 @@ static void Mesh2D(GModel *m)
 
     Msg::ResetProgressMeter();
 
+    int nbThreads = 1;
+#if defined(_OPENMP)
+    // Lloyd smoothing is not thread-safe
+    if(!CTX::instance()->mesh.optimizeLloyd)
+      nbThreads = CTX::instance()->mesh.maxNumThreads2D;
+#endif
+    const int maxv = m->getMaxVertexNumber();
+    const int maxe = m->getMaxElementNumber();
+
+    if(nbThreads > 1){
+      // mesh the independent surfaces first, the most expensive ones first
+      // so that the small ones fill the gaps at the end; the others will be
+      // meshed serially below
+      std::vector<GFace*> temp;
+      std::vector<std::pair<int, int> > cost;
+      for(std::set<GFace*, GEntityLessThan>::iterator it = f.begin();
+          it != f.end(); ++it){
+        if(meshableConcurrently(*it)){
+          cost.push_back(std::make_pair(-estimatedCost(*it), (int)temp.size()));
+          temp.push_back(*it);
+        }
+      }
+      std::sort(cost.begin(), cost.end());
+      Msg::Info("Meshing %d surfaces with %d threads", (int)temp.size(),
+                nbThreads);
+#if defined(_OPENMP)
+#pragma omp parallel num_threads(nbThreads)
+#endif
+      {
+#if defined(_OPENMP)
+#pragma omp for schedule(dynamic, 1)
+#endif
+        for(int K = 0; K < (int)cost.size(); K++){
+          backgroundMesh::unset();
+          meshGFace mesher(true, CTX::instance()->mesh.multiplePasses);
+          mesher(temp[cost[K].second]);
+        }
+        // the background mesh is threadprivate: each thread deletes its own
+        backgroundMesh::unset();
+      }
+    }
+
     int nIter = 0, nTot = m->getNumFaces();
     while(1){
       int nPending = 0;
       std::vector<GFace*> temp;
       temp.insert(temp.begin(), f.begin(), f.end());
-#if defined(_OPENMP)
-#pragma omp parallel for schedule (dynamic)
-#endif
       for(size_t K = 0 ; K < temp.size() ; K++){
 	if (temp[K]->meshStatistics.status == GFace::PENDING){
-          backgroundMesh::current()->unset();
+          backgroundMesh::unset();
 	  meshGFace mesher(true, CTX::instance()->mesh.multiplePasses);
 	  mesher(temp[K]);
 
@@ -516,22 +608,14 @@ static void Mesh2D(GModel *m)
           }
 #endif
 
-#if defined(_OPENMP)
-#pragma omp critical
-#endif
-	  {
-	    nPending++;
-	  }
+	  nPending++;
 	}
         if(!nIter) Msg::ProgressMeter(nPending, nTot, false, "Meshing 2D...");
       }
-#if defined(_OPENMP)
-#pragma omp master
-#endif
       for(std::set<GFace*, GEntityLessThan>::iterator it = cf.begin();
           it != cf.end(); ++it){
         if ((*it)->meshStatistics.status == GFace::PENDING){
-          backgroundMesh::current()->unset();
+          backgroundMesh::unset();
           meshGFace mesher(true, CTX::instance()->mesh.multiplePasses);
           mesher(*it);
 
@@ -562,6 +646,8 @@ static void Mesh2D(GModel *m)
       if(!nPending) break;
       if(nIter++ > 10) break;
     }
+
+    if(nbThreads > 1) renumberSurfaceMeshes(m, maxv, maxe);
   }
 
   // collapseSmallEdges(*m);
@@ -608,6 +694,50 @@ static void FindConnectedRegions(std::vector<GRegion*> &delaunay,
 	    nbVolumes,connected.size());
 }
 
+// give consecutive numbers, in a fixed order, to the vertices and elements
+// created while meshing the connected parts in parallel: the numbers handed
+// out during the meshing depend on the thread scheduling
+static void RenumberConnectedParts(GModel *m,
+                                   std::vector<std::vector<GRegion*> > &connected,
+                                   int maxVertexNum, int maxElementNum)
+{
+  int nv = maxVertexNum, ne = maxElementNum;
+  for(unsigned int i = 0; i < connected.size(); i++){
+    std::set<GEntity*> done;
+    for(unsigned j = 0; j < connected[i].size(); j++){
+      GRegion *gr = connected[i][j];
+      // the surface meshes (bounding and embedded faces, with their edges
+      // and vertices) can be modified when recovering the boundary
+      std::list<GFace*> f = gr->faces(), emb = gr->embeddedFaces();
+      f.insert(f.end(), emb.begin(), emb.end());
+      std::vector<GEntity*> entities;
+      for(std::list<GFace*>::iterator it = f.begin(); it != f.end(); ++it){
+        entities.push_back(*it);
+        std::list<GEdge*> e = (*it)->edges();
+        for(std::list<GEdge*>::iterator ite = e.begin(); ite != e.end(); ++ite){
+          GVertex *v0 = (*ite)->getBeginVertex(), *v1 = (*ite)->getEndVertex();
+          entities.push_back(*ite);
+          if(v0) entities.push_back(v0);
+          if(v1) entities.push_back(v1);
+        }
+      }
+      entities.push_back(gr);
+      for(unsigned int k = 0; k < entities.size(); k++){
+        GEntity *ge = entities[k];
+        if(!done.insert(ge).second) continue;
+        for(unsigned int l = 0; l < ge->mesh_vertices.size(); l++)
+          if(ge->mesh_vertices[l]->getNum() > maxVertexNum)
+            ge->mesh_vertices[l]->forceNum(++nv);
+        for(unsigned int l = 0; l < ge->getNumMeshElements(); l++)
+          if(ge->getMeshElement(l)->getNum() > maxElementNum)
+            ge->getMeshElement(l)->forceNum(++ne);
+      }
+    }
+  }
+  m->setMaxVertexNumber(nv);
+  m->setMaxElementNumber(ne);
+}
+
 static void Mesh3D(GModel *m)
 {
   if(TooManyElements(m, 3)) return;
@@ -647,26 +777,73 @@ static void Mesh3D(GModel *m)
     }
   }
 
-  // pragma OMP ICI ??
-  for(unsigned int i = 0; i < connected.size(); i++){
-    MeshDelaunayVolume(connected[i]);
+  int nbThreads = 1;
+#if defined(_OPENMP)
+  // the hex-dominant post-processing and the 3D boundary layers work on
+  // data shared by the whole model: in that case the connected parts are
+  // meshed one after the other
+  bool independent = (CTX::instance()->mesh.algo3d != ALGO_3D_RTREE &&
+                      !CTX::instance()->mesh.recombine3DAll &&
+                      !getBLField(m));
+  for(unsigned int i = 0; i < connected.size(); i++)
+    for(unsigned j = 0; j < connected[i].size(); j++)
+      if(connected[i][j]->meshAttributes.recombine3D) independent = false;
+  if(independent)
+    nbThreads = std::min(CTX::instance()->mesh.maxNumThreads3D,
+                         (int)connected.size());
+#endif
 
-    //Additional code for hex mesh begin
-    for(unsigned j=0;j<connected[i].size();j++){
-      GRegion *gr = connected[i][j];
-      //R-tree
-      if(CTX::instance()->mesh.algo3d == ALGO_3D_RTREE){
-	Filler f;
-	f.treat_region(gr);
+  if(nbThreads > 1){
+    // start with the most expensive parts, estimated by the number of
+    // triangles on their boundary, to balance the load between threads
+    std::vector<std::pair<int, int> > cost(connected.size());
+    for(unsigned int i = 0; i < connected.size(); i++){
+      std::set<GFace*> faces;
+      for(unsigned j = 0; j < connected[i].size(); j++){
+        std::list<GFace*> f = connected[i][j]->faces();
+        faces.insert(f.begin(), f.end());
       }
-      //Recombine3D into hex
-      if(CTX::instance()->mesh.recombine3DAll || gr->meshAttributes.recombine3D){
-	Recombinator rec;
-	rec.execute();
-	Supplementary sup;
-	sup.execute();
-	PostOp post;
-	post.execute(0);
+      int nbTri = 0;
+      for(std::set<GFace*>::iterator it = faces.begin(); it != faces.end(); ++it)
+        nbTri += (*it)->triangles.size();
+      cost[i] = std::make_pair(-nbTri, (int)i);
+    }
+    std::sort(cost.begin(), cost.end());
+    Msg::Info("Meshing %d connected volume parts with %d threads",
+              (int)connected.size(), nbThreads);
+    // the options and the model are only read while meshing the parts; the
+    // vertex and element numbers are taken atomically (and renumbered below),
+    // the size field evaluations and the tetgen calls are serialized
+    const int maxVertexNum = m->getMaxVertexNumber();
+    const int maxElementNum = m->getMaxElementNumber();
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic) num_threads(nbThreads)
+#endif
+    for(int i = 0; i < (int)cost.size(); i++)
+      MeshDelaunayVolume(connected[cost[i].second]);
+    RenumberConnectedParts(m, connected, maxVertexNum, maxElementNum);
+  }
+  else{
+    for(unsigned int i = 0; i < connected.size(); i++){
+      MeshDelaunayVolume(connected[i]);
+
+      //Additional code for hex mesh begin
+      for(unsigned j=0;j<connected[i].size();j++){
+        GRegion *gr = connected[i][j];
+        //R-tree
+        if(CTX::instance()->mesh.algo3d == ALGO_3D_RTREE){
+          Filler f;
+          f.treat_region(gr);
+        }
+        //Recombine3D into hex
+        if(CTX::instance()->mesh.recombine3DAll || gr->meshAttributes.recombine3D){
+          Recombinator rec;
+          rec.execute();
+          Supplementary sup;
+          sup.execute();
+          PostOp post;
+          post.execute(0);
+        }
       }
     }
   }
@@ -818,6 +995,10 @@ void GenerateMesh(GModel *m, int ask)
 #endif
   }
 
+  // Make the numbering independent of the (parallel) meshing order
+  if(CTX::instance()->mesh.canonicalNumbering)
+    m->renumberMeshCanonically();
+
   Msg::Info("%d vertices %d elements",
             m->getNumMeshVertices(), m->getNumMeshElements());
 
@@ -96,6 +96,25 @@ static double F_Lc(GEdge *ge, double t)
   return d / lc_here;
 }
 
+// F_Lc at n points strictly inside the curve, with a single evaluation of
+// the mesh size field
+static void F_Lc(GEdge *ge, int n, const double *t, double *val)
+{
+  std::vector<double> xyz(3 * n);
+  for(int i = 0; i < n; i++){
+    GPoint p = ge->point(t[i]);
+    xyz[3 * i] = p.x();
+    xyz[3 * i + 1] = p.y();
+    xyz[3 * i + 2] = p.z();
+  }
+  BGM_MeshSize(ge, n, t, 0, &xyz[0], val);
+  for(int i = 0; i < n; i++){
+    SVector3 der = ge->firstDer(t[i]);
+    const double d = norm(der);
+    val[i] = d / val[i];
+  }
+}
+
 static double F_Lc_aniso(GEdge *ge, double t)
 {
 #if defined(HAVE_ANN)
@@ -246,9 +265,28 @@ static void RecursiveIntegration(GEdge *ge, IntPoint *from, IntPoint *to,
   (*depth)--;
 }
 
+// the first levels of the recursive integration are always refined
+static const int MIN_INTEGRATION_DEPTH = 6;
+
+static void bisect(double t1, double t2, int depth, std::vector<double> &t)
+{
+  if(depth == MIN_INTEGRATION_DEPTH){
+    t.push_back(t2);
+    return;
+  }
+  const double tm = 0.5 * (t1 + t2);
+  bisect(t1, tm, depth + 1, t);
+  bisect(tm, t2, depth + 1, t);
+}
+
+// if given, fBatch evaluates f at several points strictly inside [t1, t2]:
+// it is used to evaluate f at once for all the points of the first
+// (always refined) levels of the integration
 static double Integration(GEdge *ge, double t1, double t2,
                           double (*f) (GEdge *e, double X),
-                          std::vector<IntPoint> &Points, double Prec)
+                          std::vector<IntPoint> &Points, double Prec,
+                          void (*fBatch) (GEdge *e, int n, const double *X,
+                                          double *val) = 0)
 {
   IntPoint from, to;
 
@@ -262,7 +300,27 @@ static double Integration(GEdge *ge, double t1, double t2,
   to.t = t2;
   to.lc = f(ge, to.t);
 
-  RecursiveIntegration(ge, &from, &to, f, Points, Prec, &depth);
+  if(!fBatch){
+    RecursiveIntegration(ge, &from, &to, f, Points, Prec, &depth);
+    return Points.back().p;
+  }
+
+  // the points are computed by bisection, exactly as in
+  // RecursiveIntegration, so that the result is the same
+  std::vector<double> t;
+  bisect(t1, t2, 0, t);
+  std::vector<double> lc(t.size());
+  fBatch(ge, t.size() - 1, &t[0], &lc[0]);
+  lc.back() = to.lc;
+  IntPoint a = from;
+  for(unsigned int i = 0; i < t.size(); i++){
+    IntPoint b;
+    b.t = t[i];
+    b.lc = lc[i];
+    depth = MIN_INTEGRATION_DEPTH;
+    RecursiveIntegration(ge, &a, &b, f, Points, Prec, &depth);
+    a = b;
+  }
 
   return Points.back().p;
 }
@@ -401,7 +459,7 @@ void meshGEdge::operator() (GEdge *ge)
     }
     else{
        a = Integration(ge, t_begin, t_end, F_Lc, Points,
-                      CTX::instance()->mesh.lcIntegrationPrecision);
+                      CTX::instance()->mesh.lcIntegrationPrecision, F_Lc);
     }
 
     // we should maybe provide an option to disable the smoothing
@@ -753,6 +753,50 @@ void modifyInitialMeshForTakingIntoAccountBoundaryLayers(GFace *gf)
   gf->mesh_vertices.insert(gf->mesh_vertices.begin(),verts.begin(),verts.end());
 }
 
+// pseudo random number in [0, 1] used to perturb the boundary points before
+// the initial triangulation: each face has its own sequence, seeded with its
+// tag, so that its mesh does not depend on the order in which the faces are
+// meshed (nor on the number of threads meshing them)
+static double faceRandom(unsigned int &seed)
+{
+  seed = seed * 1103515245u + 12345u;
+  return (double)((seed >> 16) & 0x7fff) / 32767.;
+}
+
+// compute the mesh size at the boundary points "pts" of the BDS mesh,
+// whose corresponding mesh vertices are "verts": the mesh size field is
+// evaluated at once for all the points on the same model vertex or edge
+static void setBoundaryMeshSizes(std::vector<MVertex*> &verts,
+                                 std::vector<BDS_Point*> &pts)
+{
+  std::map<GEntity*, std::vector<int> > onEntity;
+  for(unsigned int i = 0; i < verts.size(); i++){
+    GEntity *ge = verts[i]->onWhat();
+    if(ge->dim() < 2)
+      onEntity[ge].push_back(i);
+    else
+      pts[i]->lcBGM() = MAX_LC;
+  }
+  for(std::map<GEntity*, std::vector<int> >::iterator it = onEntity.begin();
+      it != onEntity.end(); ++it){
+    GEntity *ge = it->first;
+    const std::vector<int> &idx = it->second;
+    const int n = idx.size();
+    std::vector<double> u(n, 0.), xyz(3 * n), lc(n);
+    for(int i = 0; i < n; i++){
+      MVertex *here = verts[idx[i]];
+      if(ge->dim() == 1) here->getParameter(0, u[i]);
+      xyz[3 * i] = here->x();
+      xyz[3 * i + 1] = here->y();
+      xyz[3 * i + 2] = here->z();
+    }
+    BGM_MeshSize(ge, n, &u[0], 0, &xyz[0], &lc[0]);
+    for(int i = 0; i < n; i++)
+      pts[idx[i]]->lcBGM() = lc[i];
+  }
+  for(unsigned int i = 0; i < pts.size(); i++)
+    pts[i]->lc() = pts[i]->lcBGM();
+}
 
 // Builds An initial triangular mesh that respects the boundaries of
 // the domain, including embedded points and surfaces
@@ -883,11 +927,10 @@ bool meshGenerator(GFace *gf, int RECUR_ITER,
   // domain.
   DocRecord doc(points.size() + 4);
   {
+    unsigned int seed = gf->tag();
     for(unsigned int i = 0; i < points.size(); i++){
-      double XX = CTX::instance()->mesh.randFactor * LC2D * (double)rand() /
-        (double)RAND_MAX;
-      double YY = CTX::instance()->mesh.randFactor * LC2D * (double)rand() /
-        (double)RAND_MAX;
+      double XX = CTX::instance()->mesh.randFactor * LC2D * faceRandom(seed);
+      double YY = CTX::instance()->mesh.randFactor * LC2D * faceRandom(seed);
       //      printf("%22.15E %22.15E \n",XX,YY);
       doc.points[i].where.h = points[i]->u + XX;
       doc.points[i].where.v = points[i]->v + YY;
@@ -1106,25 +1149,17 @@ bool meshGenerator(GFace *gf, int RECUR_ITER,
     if (!onlyInitialMesh){
       Msg::Debug("Computing mesh size field at mesh vertices %d",
 		 edgesToRecover.size());
+      std::vector<MVertex*> verts;
+      std::vector<BDS_Point*> pts;
       for(int i = 0; i < doc.numPoints; i++){
 	BDS_Point *pp = (BDS_Point*)doc.points[i].data;
 	std::map<BDS_Point*, MVertex*,PointLessThan>::iterator itv = recoverMap.find(pp);
 	if(itv != recoverMap.end()){
-	  MVertex *here = itv->second;
-	  GEntity *ge = here->onWhat();
-	  if(ge->dim() == 0){
-	    pp->lcBGM() = BGM_MeshSize(ge, 0, 0, here->x(), here->y(), here->z());
-	  }
-	  else if(ge->dim() == 1){
-	    double u;
-	    here->getParameter(0, u);
-	    pp->lcBGM() = BGM_MeshSize(ge, u, 0, here->x(), here->y(), here->z());
-	  }
-	  else
-	    pp->lcBGM() = MAX_LC;
-	  pp->lc() = pp->lcBGM();
+	  verts.push_back(itv->second);
+	  pts.push_back(pp);
 	}
       }
+      setBoundaryMeshSizes(verts, pts);
     }
   }
 
@@ -1535,18 +1570,6 @@ static bool buildConsecutiveListOfVertices(GFace *gf, GEdgeLoop &gel,
       U = param.x() / m->scalingU ;
       V = param.y() / m->scalingV;
       BDS_Point *pp = m->add_point(count + countTot, U, V, gf);
-      if(ge->dim() == 0){
-        pp->lcBGM() = BGM_MeshSize(ge, 0, 0, here->x(), here->y(), here->z());
-      }
-      else if(ge->dim() == 1){
-        double u;
-        here->getParameter(0, u);
-        pp->lcBGM() = BGM_MeshSize(ge, u, 0,here->x(), here->y(), here->z());
-      }
-      else
-        pp->lcBGM() = MAX_LC;
-
-      pp->lc() = pp->lcBGM();
       m->add_geom (ge->tag(), ge->dim());
       BDS_GeomEntity *g = m->get_geom(ge->tag(), ge->dim());
       pp->g = g;
@@ -1559,6 +1582,7 @@ static bool buildConsecutiveListOfVertices(GFace *gf, GEdgeLoop &gel,
       recoverMapLocal[pp] = here;
       count++;
     }
+    setBoundaryMeshSizes(edgeLoop, edgeLoop_BDS);
     last_coord = coords[coords.size() - 1];
     if(MYDEBUG) printf("last coord %g %g\n", last_coord.x(), last_coord.y());
     result.insert(result.end(), edgeLoop_BDS.begin(), edgeLoop_BDS.end());
@@ -1675,14 +1699,13 @@ static bool meshGeneratorPeriodic(GFace *gf, bool debug = true)
   {
     DocRecord doc(nbPointsTotal + 4);
     int count = 0;
+    unsigned int seed = gf->tag();
     for(unsigned int i = 0; i < edgeLoops_BDS.size(); i++){
       std::vector<BDS_Point*> &edgeLoop_BDS = edgeLoops_BDS[i];
       for(unsigned int j = 0; j < edgeLoop_BDS.size(); j++){
         BDS_Point *pp = edgeLoop_BDS[j];
-        double XX = CTX::instance()->mesh.randFactor * LC2D * (double)rand() /
-          (double)RAND_MAX;
-        double YY = CTX::instance()->mesh.randFactor * LC2D * (double)rand() /
-          (double)RAND_MAX;
+        double XX = CTX::instance()->mesh.randFactor * LC2D * faceRandom(seed);
+        double YY = CTX::instance()->mesh.randFactor * LC2D * faceRandom(seed);
         doc.points[count].where.h = pp->u + XX;
         doc.points[count].where.v = pp->v + YY;
         doc.points[count].adjacent = NULL;
@@ -2543,8 +2566,8 @@ bool translate(GFace* gf,MElementOctree* octree,MVertex* vertex,SPoint2 corr,SVe
   reparamMeshVertexOnFace(vertex,gf,point);
   x = point.x();
   y = point.y();
-  size = backgroundMesh::current()->operator()(x,y,0.0)/**get_ratio(gf,corr)*/;
-  angle = backgroundMesh::current()->getAngle(x,y,0.0);
+  double uv[2] = {x, y};
+  backgroundMesh::current()->eval(1, uv, &size, &angle);
 
   delta_x = k*size*cos(angle);
   delta_y = k*size*sin(angle);
@@ -24,11 +24,17 @@
 #include "GFaceCompound.h"
 #include "intersectCurveSurface.h"
 #include "surfaceFiller.h"
-
-double LIMIT_ = 0.5 * sqrt(2.0) * 1;
-int  N_GLOBAL_SEARCH;
-int  N_SEARCH;
-double DT_INSERT_VERTEX;
+#include "hilbertSort.h"
+
+// surfaces can be meshed concurrently: the size limit (changed temporarily by
+// the frontal-quad algorithm) and the search counters are per-thread
+static double LIMIT_ = 0.70710678118654752440; // 0.5 * sqrt(2.0)
+static int N_GLOBAL_SEARCH = 0;
+static int N_SEARCH = 0;
+static double DT_INSERT_VERTEX = 0.;
+#if defined(_OPENMP)
+#pragma omp threadprivate(LIMIT_, N_GLOBAL_SEARCH, N_SEARCH, DT_INSERT_VERTEX)
+#endif
 int MTri3::radiusNorm = 2;
 
 /*
@@ -1631,7 +1637,7 @@ void bowyerWatsonFrontalLayers(GFace *gf, bool quad,
   // _printTris (name, AllTris, Us, Vs,true);
   transferDataStructure(gf, AllTris, DATA);
   MTri3::radiusNorm = 2;
-  LIMIT_ = 0.5 * sqrt(2.0) * 1;
+  LIMIT_ = 0.70710678118654752440; // 0.5 * sqrt(2.0)
   backgroundMesh::unset();
 #if defined(HAVE_ANN)
   {
@@ -1665,7 +1671,21 @@ void bowyerWatsonParallelograms(GFace *gf,
   int nbSwaps = edgeSwapPass(gf, AllTris, SWCR_DEL, DATA);
   Msg::Debug("Delaunization of the initial mesh done (%d swaps)", nbSwaps);
 
-  std::sort(packed.begin(), packed.end(), MVertexLessThanLexicographic());
+  // sort the points in biased randomized rounds, each round along a Hilbert
+  // curve in the parameter plane, so that each point is located by a short
+  // walk from the last inserted one
+  {
+    std::vector<double> uv(2 * packed.size());
+    for (unsigned int i = 0; i < packed.size(); i++){
+      packed[i]->getParameter(0, uv[2 * i]);
+      packed[i]->getParameter(1, uv[2 * i + 1]);
+    }
+    std::vector<int> perm;
+    hilbertSort(2, packed.size(), uv.empty() ? 0 : &uv[0], perm, true);
+    std::vector<MVertex*> sorted(packed.size());
+    for (unsigned int i = 0; i < packed.size(); i++) sorted[i] = packed[perm[i]];
+    packed.swap(sorted);
+  }
 
   //  printf("staring to insert points\n");
   N_GLOBAL_SEARCH = 0;
@@ -1711,6 +1731,10 @@ void bowyerWatsonParallelograms(GFace *gf,
 
 
   }
+  if (packed.size())
+    Msg::Debug("Surface %d: %d points inserted, %g walk steps per point "
+               "(%d global searches)", gf->tag(), (int)packed.size(),
+               (double)N_SEARCH / packed.size(), N_GLOBAL_SEARCH);
   //  printf("%d vertices \n",(int)packed.size());
   //clock_t t2 = clock();
   //double DT = (double)(t2-t1)/CLOCKS_PER_SEC;
@@ -87,6 +87,9 @@ class MTri3
 
  public :
   static int radiusNorm; // 2 is euclidian norm, -1 is infinite norm  , 3 quality
+#if defined(_OPENMP)
+#pragma omp threadprivate(radiusNorm)
+#endif
   bool isDeleted() const { return deleted; }
   void forceRadius(double r) { circum_radius = r; }
   inline double getRadius() const { return circum_radius; }
@@ -1145,26 +1145,31 @@ struct  quadBlob {
   inline void setBlobNumber(int number) { iBlob = number; }
   static void computeMatrices()
   {
-    if (matricesDone)return;
-    matricesDone = true;
-    M3.resize(6,6);
-    M5.resize(10,10);
-
-    // compute M3
-    M3.setAll(0);
-    M5.setAll(0);
-    M3(0,2) = M3(1,0) = M3(2,1) = -1.;
-    M3(0,3+0) = M3(1,3+1) =M3(2,3+2) =1.;
-    M3(3+0,0) = M3(3+1,1) =M3(3+2,2) =1.;
-    M3(3+0,3+0) = M3(3+1,3+1) =M3(3+2,3+2) =1.;
-    M3.invertInPlace();
-    // compute M5
-    M5(0,2) = M5(1,3) = M5(2,4) = M5(3,0) = M5(4,1) = -1;
-    for (int i=0;i<5;i++){
-      M5(5+i,5+i) = 1;
-      M5(i,5+i) = M5(5+i,i) = 1;
-    }
-    M5.invertInPlace();
+    // surfaces can be meshed concurrently
+#if defined(_OPENMP)
+#pragma omp critical (quadBlob_matrices)
+#endif
+    if (!matricesDone){
+      M3.resize(6,6);
+      M5.resize(10,10);
+
+      // compute M3
+      M3.setAll(0);
+      M5.setAll(0);
+      M3(0,2) = M3(1,0) = M3(2,1) = -1.;
+      M3(0,3+0) = M3(1,3+1) =M3(2,3+2) =1.;
+      M3(3+0,0) = M3(3+1,1) =M3(3+2,2) =1.;
+      M3(3+0,3+0) = M3(3+1,3+1) =M3(3+2,3+2) =1.;
+      M3.invertInPlace();
+      // compute M5
+      M5(0,2) = M5(1,3) = M5(2,4) = M5(3,0) = M5(4,1) = -1;
+      for (int i=0;i<5;i++){
+        M5(5+i,5+i) = 1;
+        M5(i,5+i) = M5(5+i,i) = 1;
+      }
+      M5.invertInPlace();
+      matricesDone = true;
+    }
   }
   void expand_blob (std::vector<MVertex*> & path)
   {
@@ -1168,15 +1168,34 @@ void MeshDelaunayVolume(std::vector<GRegion*> &regions)
       // sprintf(opts, "-q3.5Ype%c", (Msg::GetVerbosity() < 3) ? 'Q':
       //        (Msg::GetVerbosity() > 6) ? 'V': '\0');*/
     }
+    // tetgen (re)initializes the global state of its exact predicates at
+    // each call, so it is not run concurrently when several volumes are
+    // meshed in parallel
+    bool tetgenFailed = false;
+#if defined(_OPENMP)
+#pragma omp critical (tetgen)
+#endif
     try{
       tetrahedralize(opts, &in, &out);
     }
     catch (int error){
+      tetgenFailed = true;
+    }
+    if(tetgenFailed){
       Msg::Error("Self intersecting surface mesh, computing intersections "
                  "(this could take a while)");
       sprintf(opts, "dV");
+      tetgenFailed = false;
+#if defined(_OPENMP)
+#pragma omp critical (tetgen)
+#endif
       try{
         tetrahedralize(opts, &in, &out);
+      }
+      catch (int error2){
+        tetgenFailed = true;
+      }
+      if(!tetgenFailed){
         Msg::Info("%d intersecting faces have been saved into 'intersect.pos'",
                   out.numberoftrifaces);
         FILE *fp = Fopen("intersect.pos", "w");
@@ -1197,7 +1216,7 @@ void MeshDelaunayVolume(std::vector<GRegion*> &regions)
         else
           Msg::Error("Could not open file 'intersect.pos'");
       }
-      catch (int error2){
+      else{
         Msg::Error("Surface mesh is wrong, cannot do the 3D mesh");
       }
       gr->set(faces);
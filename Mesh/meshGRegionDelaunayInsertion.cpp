@@ -19,8 +19,6 @@
 #include "Numeric.h"
 #include "Context.h"
 
-int MTet4::radiusNorm = 2;
-static double LIMIT_ = 1;
 
 static void createAllEmbeddedFaces (GRegion *gr, std::set<MFace, Less_Face> &allEmbeddedFaces)
 {
@@ -46,23 +44,76 @@ static bool isActive(MTet4 *t, double limit_, int &active)
 
 int MTet4::inCircumSphere(const double *p) const
 {
-  double pa[3] = {base->getVertex(0)->x(),
-                  base->getVertex(0)->y(),
-                  base->getVertex(0)->z()};
-  double pb[3] = {base->getVertex(1)->x(),
-                  base->getVertex(1)->y(),
-                  base->getVertex(1)->z()};
-  double pc[3] = {base->getVertex(2)->x(),
-                  base->getVertex(2)->y(),
-                  base->getVertex(2)->z()};
-  double pd[3] = {base->getVertex(3)->x(),
-                  base->getVertex(3)->y(),
-                  base->getVertex(3)->z()};
+  double pa[3], pb[3], pc[3], pd[3];
+  getXYZ(0, pa);
+  getXYZ(1, pb);
+  getXYZ(2, pc);
+  getXYZ(3, pd);
   double result = robustPredicates::insphere(pa, pb, pc, pd, (double*)p) *
     robustPredicates::orient3d(pa, pb, pc, pd);
   return (result > 0) ? 1 : 0;
 }
 
+void MTet4::reserve(int o)
+{
+#if defined(_OPENMP)
+#if defined(__GNUC__)
+  int old = owner;
+  while(old == -1 || o < old){
+    const int prev = __sync_val_compare_and_swap(&owner, old, o);
+    if(prev == old) break;
+    old = prev;
+  }
+#else
+#pragma omp critical (MTet4_claim)
+  if(owner == -1 || o < owner) owner = o;
+#endif
+#else
+  if(owner == -1 || o < owner) owner = o;
+#endif
+}
+
+bool MTet4::claim(int o)
+{
+#if defined(_OPENMP)
+#if defined(__GNUC__)
+  const int old = __sync_val_compare_and_swap(&owner, -1, o);
+  return (old == -1 || old == o);
+#else
+  bool ok;
+#pragma omp critical (MTet4_claim)
+  {
+    if(owner == -1) owner = o;
+    ok = (owner == o);
+  }
+  return ok;
+#endif
+#else
+  if(owner == -1) owner = o;
+  return (owner == o);
+#endif
+}
+
+void MTet4::xyz2uvw(const double xyz[3], double uvw[3]) const
+{
+  double p[4][3];
+  for(int i = 0; i < 4; i++) getXYZ(i, p[i]);
+  double mat[3][3], b[3], det;
+  for(int i = 0; i < 3; i++){
+    for(int j = 0; j < 3; j++) mat[i][j] = p[j + 1][i] - p[0][i];
+    b[i] = xyz[i] - p[0][i];
+  }
+  sys3x3(mat, b, uvw, &det);
+}
+
+void MTet4::createTet()
+{
+  MVertex *v[4];
+  for(int i = 0; i < 4; i++) v[i] = factory->getVertex(verts[i]);
+  factory = 0;
+  base = new MTetrahedron(v[0], v[1], v[2], v[3]);
+}
+
 static int faces[4][3] = {{0,1,2}, {0,2,3}, {0,3,1}, {1,3,2}};
 
 struct faceXtet{
@@ -71,13 +122,14 @@ struct faceXtet{
   int i1;
   faceXtet(MTet4 *_t, int iFac) : t1(_t), i1(iFac)
   {
-    v[0] = t1->tet()->getVertex(faces[iFac][0]);
-    v[1] = t1->tet()->getVertex(faces[iFac][1]);
-    v[2] = t1->tet()->getVertex(faces[iFac][2]);
+    v[0] = t1->getVertex(faces[iFac][0]);
+    v[1] = t1->getVertex(faces[iFac][1]);
+    v[2] = t1->getVertex(faces[iFac][2]);
     std::sort(v, v + 3);
   }
 
-  inline MVertex * getVertex (int i) const { return t1->tet()->getVertex(faces[i1][i]);}
+  inline MVertex * getVertex (int i) const { return t1->getVertex(faces[i1][i]);}
+  inline int getVertexIndex (int i) const { return t1->getVertexIndex(faces[i1][i]);}
 
  inline bool operator < (const faceXtet & other) const
   {
@@ -94,17 +146,19 @@ struct faceXtet{
 	    v[1] == other.v[1] &&
 	    v[2] == other.v[2] );
   }
-  bool visible (MVertex *v){
-    MVertex* v0 = t1->tet()->getVertex(faces[i1][0]);
-    MVertex* v1 = t1->tet()->getVertex(faces[i1][1]);
-    MVertex* v2 = t1->tet()->getVertex(faces[i1][2]);
-    double a[3] = {v0->x(),v0->y(),v0->z()};
-    double b[3] = {v1->x(),v1->y(),v1->z()};
-    double c[3] = {v2->x(),v2->y(),v2->z()};
-    double d[3] = {v->x(),v->y(),v->z()};
+  bool visible (const double *p){
+    double a[3], b[3], c[3];
+    t1->getXYZ(faces[i1][0], a);
+    t1->getXYZ(faces[i1][1], b);
+    t1->getXYZ(faces[i1][2], c);
+    double d[3] = {p[0],p[1],p[2]};
     double o = robustPredicates :: orient3d(a,b,c,d);
     return o < 0;
   }
+  bool visible (MVertex *v){
+    const double p[3] = {v->x(),v->y(),v->z()};
+    return visible(p);
+  }
 };
 
 template <class ITER>
@@ -237,7 +291,7 @@ static void extendCavity (std::list<faceXtet> & shell,
 
 // if all faces of the tet that are not in the shell see v, then it is ok
 // either to add or to remove t from the shell
-static bool verifyShell (MVertex *v, MTet4*t, std::list<faceXtet> & shell){
+static bool verifyShell (const double *v, MTet4*t, std::list<faceXtet> & shell){
   if (!t)return false;
   return 1;
   int NBAD_BEFORE=0,NBAD_AFTER=0;
@@ -254,9 +308,9 @@ static bool verifyShell (MVertex *v, MTet4*t, std::list<faceXtet> & shell){
   return (NBAD_AFTER < NBAD_BEFORE);
 }
 
-int makeCavityStarShaped (std::list<faceXtet> & shell,
-			   std::list<MTet4*> & cavity,
-			   MVertex *v ){
+static int makeCavityStarShaped (std::list<faceXtet> & shell,
+                                 std::list<MTet4*> & cavity,
+                                 const double *v ){
   std::list<faceXtet> wrong;
   for (std::list<faceXtet>::iterator it = shell.begin(); it != shell.end() ;++it) {
     faceXtet &fxt = *it;
@@ -290,6 +344,13 @@ int makeCavityStarShaped (std::list<faceXtet> & shell,
   return 1;
 }
 
+int makeCavityStarShaped (std::list<faceXtet> & shell,
+			   std::list<MTet4*> & cavity,
+			   MVertex *v ){
+  const double p[3] = {v->x(), v->y(), v->z()};
+  return makeCavityStarShaped(shell, cavity, p);
+}
+
 void recurFindCavity(std::list<faceXtet> & shell,
                      std::list<MTet4*> & cavity,
                      MVertex *v ,
@@ -389,11 +450,14 @@ bool insertVertexB(std::list<faceXtet> &shell,
 		   MVertex *v,
 		   MTet4 *t,
 		   MTet4Factory &myFactory,
-		   std::set<MTet4*,compareTet4Ptr> &allTets,
+		   MTet4Factory::container &allTets,
 		   std::vector<double> & vSizes,
 		   std::vector<double> & vSizesBGM,
-		   std::set<MTet4*,compareTet4Ptr> *activeTets = 0 )
+		   std::set<MTet4*,compareTet4Ptr> *activeTets = 0,
+                   double limit_ = 1., MTet4 **slots = 0)
 {
+  // if "slots" is given, the new tets are created in these slots, and are
+  // neither queued nor freed
   std::list<MTet4*> new_cavity;
   // check that volume is conserved
     double newVolume = 0;
@@ -413,8 +477,6 @@ bool insertVertexB(std::list<faceXtet> &shell,
 
   bool onePointIsTooClose = false;
   while (it != shell.end()){
-    MTetrahedron *tr = new MTetrahedron(it->getVertex(0), it->getVertex(1), it->getVertex(2), v);
-
     //    double lc = .25 * (vSizes[tr->getVertex(0)->getIndex()] +
     //		       vSizes[tr->getVertex(1)->getIndex()] +
     //		       vSizes[tr->getVertex(2)->getIndex()] +
@@ -425,7 +487,9 @@ bool insertVertexB(std::list<faceXtet> &shell,
     //			  vSizesBGM[tr->getVertex(3)->getIndex()]);
     //    double LL = std::min(lc, lcBGM);
 
-    MTet4 *t4 = myFactory.Create(tr, vSizes, vSizesBGM);
+    MTet4 *t4 = myFactory.Create(it->getVertexIndex(0), it->getVertexIndex(1),
+                                 it->getVertexIndex(2), v->getIndex(), vSizes,
+                                 vSizesBGM, slots ? slots[k] : 0);
     t4->setOnWhat(t->onWhat());
     /*
     double d1 = sqrt((it->v[0]->x() - v->x()) * (it->v[0]->x() - v->x()) +
@@ -461,12 +525,17 @@ bool insertVertexB(std::list<faceXtet> &shell,
       if (fabs(oldVolume - newVolume) < 1.e-10 * oldVolume &&
 	            !onePointIsTooClose){
     connectTets_vector(new_cavity.begin(), new_cavity.end());
-    allTets.insert(newTets, newTets + shell.size());
+    if(!slots){
+#if defined(_OPENMP)
+#pragma omp critical (MTet4Factory_insert)
+#endif
+      allTets.push(newTets, newTets + shell.size());
+    }
 
     if (activeTets){
       for (std::list<MTet4*>::iterator i = new_cavity.begin(); i != new_cavity.end(); ++i){
         int active_face;
-        if(isActive(*i, LIMIT_, active_face) && (*i)->getRadius() > LIMIT_){
+        if(isActive(*i, limit_, active_face) && (*i)->getRadius() > limit_){
           if ((*activeTets).find(*i) == (*activeTets).end())
             (*activeTets).insert(*i);
         }
@@ -484,7 +553,8 @@ bool insertVertexB(std::list<faceXtet> &shell,
     //    printTets ("oldCavity.pos",cavity,true);
     //    printTets ("newCavity.pos",new_cavity);
     //    Msg::Fatal("");
-    for (unsigned int i = 0; i <shell.size(); i++) myFactory.Free(newTets[i]);
+    if(!slots)
+      for (unsigned int i = 0; i <shell.size(); i++) myFactory.Free(newTets[i]);
     delete [] newTets;
     ittet = cavity.begin();
     ittete = cavity.end();
@@ -499,17 +569,19 @@ bool insertVertexB(std::list<faceXtet> &shell,
 bool insertVertex(MVertex *v,
                   MTet4 *t,
                   MTet4Factory &myFactory,
-                  std::set<MTet4*,compareTet4Ptr> &allTets,
+                  MTet4Factory::container &allTets,
 		  std::vector<double> & vSizes,
                   std::vector<double> & vSizesBGM,
-		  std::set<MTet4*,compareTet4Ptr> *activeTets = 0 )
+		  std::set<MTet4*,compareTet4Ptr> *activeTets = 0,
+                  double limit_ = 1.)
 {
   std::list<faceXtet> shell;
   std::list<MTet4*> cavity;
 
   recurFindCavity(shell, cavity, v, t);
 
-  return insertVertexB(shell,cavity,v,t,myFactory,allTets,vSizes,vSizesBGM,activeTets);
+  return insertVertexB(shell,cavity,v,t,myFactory,allTets,vSizes,vSizesBGM,activeTets,
+                       limit_);
 
 }
 
@@ -665,9 +737,9 @@ void non_recursive_classify(MTet4 *t, std::list<MTet4*> &theRegion,
       t->setOnWhat(bidon);
       bool FF[4] = {0,0,0,0};
       for (int i = 0; i < 4; i++){
-	GFace* gfound = findInFaceSearchStructure (t->tet()->getVertex(faces[i][0]),
-						   t->tet()->getVertex(faces[i][1]),
-						   t->tet()->getVertex(faces[i][2]),
+	GFace* gfound = findInFaceSearchStructure (t->getVertex(faces[i][0]),
+						   t->getVertex(faces[i][1]),
+						   t->getVertex(faces[i][2]),
 						   search);
 	if (gfound){
 	  FF[i] = true;
@@ -1126,21 +1198,346 @@ double tetcircumcenter(double a[3], double b[3], double c[3], double d[3],
   return xxx;
 }
 
-static void memoryCleanup(MTet4Factory &myFactory, std::set<MTet4*, compareTet4Ptr> &allTets){
-  //  int n1 = allTets.size();
-  std::set<MTet4*,compareTet4Ptr>::iterator itd = allTets.begin();
-  while(itd != allTets.end()){
-    if((*itd)->isDeleted()){
-      myFactory.Free((*itd));
-      allTets.erase(itd++);
+// Parallel point insertion: a batch of the worst tets is taken from the
+// front of the queue and the cavities of their circumcenters are built
+// concurrently. Every tet visited by a cavity search (cavity tets and the
+// tets on the other side of the shell, whose neighbors will be updated) is
+// tagged with the index of the cavity; a cavity that hits a tet owned by
+// another one is released and retried in the next batch.
+//
+// Which cavity gets a contested tet depends on the thread scheduling. In
+// deterministic mode, the tets each cavity search will look at are first
+// computed without modifying the mesh, and are reserved by the cavity with
+// the lowest index in the batch; a cavity then only proceeds if it owns all
+// its tets, and can only use these tets. The new tets are allocated, queued
+// and freed serially, in the order of the batch: the result does not depend
+// on the scheduling nor on the number of threads.
+
+struct insertionCandidate {
+  enum status {CONFLICT, NOT_FOUND, NOT_STAR_SHAPED, FOUND, INSERTED, FAILED};
+  MTet4 *worst, *container;
+  double center[3], uvw[3], lc1;
+  std::list<faceXtet> shell;
+  std::list<MTet4*> cavity;
+  std::vector<MTet4*> claimed;
+  // the new tets (deterministic mode)
+  std::vector<MTet4*> newTets;
+  MVertex *v;
+  bool corrected;
+  int status;
+  insertionCandidate(MTet4 *t)
+    : worst(t), container(t), lc1(0.), v(0), corrected(false), status(CONFLICT) {}
+};
+
+// in deterministic mode, the tets were reserved beforehand, and a cavity can
+// only use the tets it has reserved
+static bool claimTet(MTet4 *t, int owner, std::vector<MTet4*> &claimed,
+                     bool reserved)
+{
+  if(t->getOwner() == owner) return true;
+  if(reserved || !t->claim(owner)) return false;
+  claimed.push_back(t);
+  return true;
+}
+
+static bool claimShell(std::list<faceXtet> &shell, int owner,
+                       std::vector<MTet4*> &claimed, bool reserved)
+{
+  for(std::list<faceXtet>::iterator it = shell.begin(); it != shell.end(); ++it){
+    MTet4 *opposite = it->t1->getNeigh(it->i1);
+    if(opposite && !claimTet(opposite, owner, claimed, reserved)) return false;
+  }
+  return true;
+}
+
+// same as recurFindCavity, but claims every tet it looks at
+static bool findCavityClaim(std::list<faceXtet> &shell,
+                            std::list<MTet4*> &cavity,
+                            const double *p, MTet4 *t, int owner,
+                            std::vector<MTet4*> &claimed, bool reserved)
+{
+  if(!claimTet(t, owner, claimed, reserved)) return false;
+  std::stack<MTet4*> _stack;
+  t->setDeleted(true);
+  cavity.push_back(t);
+  _stack.push(t);
+  while(!_stack.empty()){
+    t = _stack.top();
+    _stack.pop();
+    for (int i = 0; i < 4; i++){
+      MTet4 *neigh = t->getNeigh(i);
+      if (!neigh)
+        shell.push_back(faceXtet(t, i));
+      else{
+        if(!claimTet(neigh, owner, claimed, reserved)) return false;
+        if (!neigh->isDeleted()){
+          if (neigh->inCircumSphere(p) && (neigh->onWhat() == t->onWhat())){
+            neigh->setDeleted(true);
+            cavity.push_back(neigh);
+            _stack.push(neigh);
+          }
+          else
+            shell.push_back(faceXtet(t, i));
+        }
+      }
+    }
+  }
+  return true;
+}
+
+// read-only version of findCavityClaim: returns the tets it would look at,
+// i.e. the cavity and its neighbors (possibly several times)
+static void findCavityFootprint(const double *p, MTet4 *t,
+                                std::vector<MTet4*> &footprint)
+{
+  std::set<MTet4*> cavity;
+  std::stack<MTet4*> _stack;
+  cavity.insert(t);
+  footprint.push_back(t);
+  _stack.push(t);
+  while(!_stack.empty()){
+    t = _stack.top();
+    _stack.pop();
+    for (int i = 0; i < 4; i++){
+      MTet4 *neigh = t->getNeigh(i);
+      if (!neigh || cavity.count(neigh)) continue;
+      footprint.push_back(neigh);
+      if (neigh->inCircumSphere(p) && (neigh->onWhat() == t->onWhat())){
+        cavity.insert(neigh);
+        _stack.push(neigh);
+      }
     }
+  }
+}
+
+static void worstCircumcenter(insertionCandidate &c)
+{
+  double pa[3], pb[3], pc[3], pd[3];
+  c.worst->getXYZ(0, pa);
+  c.worst->getXYZ(1, pb);
+  c.worst->getXYZ(2, pc);
+  c.worst->getXYZ(3, pd);
+  tetcircumcenter(pa, pb, pc, pd, c.center, &c.uvw[0], &c.uvw[1], &c.uvw[2]);
+}
+
+static void buildCavityClaim(insertionCandidate &c, int owner,
+                             std::vector<double> &vSizes, bool reserved)
+{
+  if(!reserved) worstCircumcenter(c);
+
+  if(!findCavityClaim(c.shell, c.cavity, c.center, c.worst, owner, c.claimed,
+                      reserved)){
+    c.status = insertionCandidate::CONFLICT;
+    return;
+  }
+
+  bool found = false;
+  for (std::list<MTet4*>::iterator itc = c.cavity.begin(); itc != c.cavity.end(); ++itc){
+    (*itc)->xyz2uvw(c.center, c.uvw);
+    if ((*itc)->isInside(c.uvw[0], c.uvw[1], c.uvw[2])){
+      c.container = *itc;
+      found = true;
+      break;
+    }
+  }
+  if(!found){
+    c.status = insertionCandidate::NOT_FOUND;
+    return;
+  }
+
+  // the shell has to be claimed before each correction, so that the
+  // cavity can only be extended into tets owned by this cavity
+  while(1){
+    if(!claimShell(c.shell, owner, c.claimed, reserved)){
+      c.status = insertionCandidate::CONFLICT;
+      return;
+    }
+    int k = makeCavityStarShaped(c.shell, c.cavity, c.center);
+    if(k == -1){
+      c.status = insertionCandidate::NOT_STAR_SHAPED;
+      return;
+    }
+    else if(k == 0) break;
+    else if(k == 1) c.corrected = true;
+  }
+
+  MTet4 *t = c.container;
+  c.lc1 =
+    (1 - c.uvw[0] - c.uvw[1] - c.uvw[2]) * vSizes[t->getVertexIndex(0)] +
+    c.uvw[0] * vSizes[t->getVertexIndex(1)] +
+    c.uvw[1] * vSizes[t->getVertexIndex(2)] +
+    c.uvw[2] * vSizes[t->getVertexIndex(3)];
+  c.status = insertionCandidate::FOUND;
+}
+
+// inserts (at most) one vertex per candidate in the batch; returns false if
+// no progress could be made because all the cavities were in conflict
+static bool insertVerticesParallel(GRegion *gr, int nbThreads, int batchSize,
+                                   bool deterministic, MTet4Factory &myFactory,
+                                   MTet4Factory::container &allTets,
+                                   std::vector<double> &vSizes,
+                                   std::vector<double> &vSizesBGM, int &NUM,
+                                   int &ITER, int &REALCOUNT,
+                                   int &NB_CORRECTION_OF_CAVITY,
+                                   int &COUNT_MISS_1, int &COUNT_MISS_2)
+{
+  // the candidates are taken out of the queue during the whole batch
+  std::vector<insertionCandidate*> batch;
+  while(!allTets.empty() && (int)batch.size() < batchSize){
+    MTet4 *worst = allTets.top();
+    if(worst->isDeleted()){
+      myFactory.Free(worst);
+      allTets.pop();
+      continue;
+    }
+    if(worst->getRadius() < 1) break;
+    allTets.pop();
+    batch.push_back(new insertionCandidate(worst));
+  }
+  const int N = batch.size();
+
+  if(deterministic){
+#if defined(_OPENMP)
+#pragma omp parallel num_threads(nbThreads)
+#endif
+    {
+#if defined(_OPENMP)
+#pragma omp for schedule(dynamic)
+#endif
+      for(int i = 0; i < N; i++){
+        insertionCandidate &c = *batch[i];
+        worstCircumcenter(c);
+        findCavityFootprint(c.center, c.worst, c.claimed);
+        for(unsigned int j = 0; j < c.claimed.size(); j++)
+          c.claimed[j]->reserve(i);
+      }
+      // (implicit barrier)
+#if defined(_OPENMP)
+#pragma omp for schedule(dynamic)
+#endif
+      for(int i = 0; i < N; i++){
+        insertionCandidate &c = *batch[i];
+        bool owned = true;
+        for(unsigned int j = 0; j < c.claimed.size() && owned; j++)
+          owned = (c.claimed[j]->getOwner() == i);
+        if(owned) buildCavityClaim(c, i, vSizes, true);
+      }
+    }
+  }
+  else{
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic) num_threads(nbThreads)
+#endif
+    for(int i = 0; i < N; i++)
+      buildCavityClaim(*batch[i], i, vSizes, false);
+  }
+
+  // vertex creation and mesh size evaluation are not thread-safe; the mesh
+  // size field is evaluated at once for the whole batch
+  std::vector<double> centers;
+  for(int i = 0; i < N; i++){
+    insertionCandidate &c = *batch[i];
+    if(c.status != insertionCandidate::FOUND) continue;
+    if(c.corrected) NB_CORRECTION_OF_CAVITY++;
+    c.v = new MVertex(c.center[0], c.center[1], c.center[2], c.container->onWhat());
+    c.v->setIndex(NUM++);
+    myFactory.addVertex(c.v);
+    vSizes.push_back(c.lc1);
+    centers.insert(centers.end(), c.center, c.center + 3);
+    if(deterministic){
+      c.newTets.resize(c.shell.size());
+      for(unsigned int j = 0; j < c.newTets.size(); j++)
+        c.newTets[j] = myFactory.Allocate();
+    }
+  }
+  const int nFound = centers.size() / 3;
+  if(nFound){
+    vSizesBGM.resize(vSizesBGM.size() + nFound);
+    BGM_MeshSize(gr, nFound, 0, 0, &centers[0], &vSizesBGM[vSizesBGM.size() - nFound]);
+  }
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic) num_threads(nbThreads)
+#endif
+  for(int i = 0; i < N; i++){
+    insertionCandidate &c = *batch[i];
+    if(c.status != insertionCandidate::FOUND) continue;
+    if(insertVertexB(c.shell, c.cavity, c.v, c.container, myFactory, allTets,
+                     vSizes, vSizesBGM, 0, 1., c.newTets.empty() ? 0 : &c.newTets[0]))
+      c.status = insertionCandidate::INSERTED;
     else
-      itd++;
+      c.status = insertionCandidate::FAILED;
   }
+
+  bool progress = false;
+  for(int i = 0; i < N; i++){
+    insertionCandidate &c = *batch[i];
+    if(c.status == insertionCandidate::INSERTED){
+      REALCOUNT++;
+      c.v->onWhat()->mesh_vertices.push_back(c.v);
+      allTets.push(c.newTets.begin(), c.newTets.end());
+    }
+    else{
+      for (std::list<MTet4*>::iterator itc = c.cavity.begin(); itc != c.cavity.end(); ++itc)
+        (*itc)->setDeleted(false);
+      for(unsigned int j = 0; j < c.newTets.size(); j++)
+        myFactory.Free(c.newTets[j]);
+      if(c.status != insertionCandidate::CONFLICT){
+        if(c.status == insertionCandidate::NOT_FOUND) COUNT_MISS_2++;
+        else COUNT_MISS_1++;
+        c.worst->forceRadius(0.);
+        if(c.v) delete c.v;
+      }
+    }
+    allTets.push(c.worst);
+    if(c.status != insertionCandidate::CONFLICT){
+      progress = true;
+      if(ITER++ % 5000 == 0)
+        Msg::Info("%d points created - Worst tet radius is %g (PTS removed %d %d)",
+                  REALCOUNT, c.worst->getRadius(), COUNT_MISS_1, COUNT_MISS_2);
+    }
+  }
+  for(int i = 0; i < N; i++){
+    for(unsigned int j = 0; j < batch[i]->claimed.size(); j++)
+      batch[i]->claimed[j]->releaseOwner();
+    delete batch[i];
+  }
+  return progress;
+}
+
+static void memoryCleanup(MTet4Factory &myFactory, MTet4Factory::container &allTets){
+  //  int n1 = allTets.size();
+  std::vector<MTet4*> removed;
+  allTets.compact(removed);
+  for(unsigned int i = 0; i < removed.size(); i++)
+    myFactory.Free(removed[i]);
   //  Msg::Info("cleaning up the memory %d -> %d", n1, allTets.size());
 }
 
 
+// transfer the tets of the factory to their region, in the order of the
+// queue; the MTetrahedrons are only created once the factory is cleared, so
+// that the tets are not stored twice
+static void transferTets(MTet4Factory &myFactory)
+{
+  MTet4Factory::container &allTets = myFactory.getAllTets();
+  std::vector<MVertex*> verts;
+  std::vector<GRegion*> regions;
+  verts.reserve(4 * allTets.size());
+  regions.reserve(allTets.size());
+  for(MTet4Factory::iterator it = allTets.begin(); it != allTets.end(); ++it){
+    MTet4 *t = *it;
+    if(t->isDeleted()) continue;
+    for(int i = 0; i < 4; i++) verts.push_back(t->getVertex(i));
+    regions.push_back(t->onWhat());
+  }
+  myFactory.clear();
+  for(unsigned int i = 0; i < regions.size(); i++)
+    regions[i]->tetrahedra.push_back
+      (new MTetrahedron(verts[4 * i], verts[4 * i + 1], verts[4 * i + 2],
+                        verts[4 * i + 3]));
+}
+
 void insertVerticesInRegion (GRegion *gr, int maxVert, bool _classify)
 {
   //printf("sizeof MTet4 = %d sizeof MTetrahedron %d sizeof(MVertex) %d\n",
@@ -1150,7 +1547,7 @@ void insertVerticesInRegion (GRegion *gr, int maxVert, bool _classify)
   std::vector<double> vSizes;
   std::vector<double> vSizesBGM;
   MTet4Factory myFactory(1600000);
-  std::set<MTet4*, compareTet4Ptr> &allTets = myFactory.getAllTets();
+  MTet4Factory::container &allTets = myFactory.getAllTets();
   int NUM = 0;
   
 
@@ -1168,14 +1565,21 @@ void insertVerticesInRegion (GRegion *gr, int maxVert, bool _classify)
     for(std::map<MVertex*, double>::iterator it = vSizesMap.begin();
         it != vSizesMap.end(); ++it){
       it->first->setIndex(NUM++);
+      myFactory.addVertex(it->first);
       vSizes.push_back(it->second);
       vSizesBGM.push_back(it->second);
     }
   }
 
+  // the initial tets are replaced by the tets of the factory
   for(unsigned int i = 0; i < gr->tetrahedra.size(); i++){
-    gr->tetrahedra[i]->setVolumePositive();
-    allTets.insert(myFactory.Create(gr->tetrahedra[i], vSizes,vSizesBGM));
+    MTetrahedron *t = gr->tetrahedra[i];
+    t->setVolumePositive();
+    allTets.push(myFactory.Create(t->getVertex(0)->getIndex(),
+                                  t->getVertex(1)->getIndex(),
+                                  t->getVertex(2)->getIndex(),
+                                  t->getVertex(3)->getIndex(), vSizes, vSizesBGM));
+    delete t;
   }
 
   gr->tetrahedra.clear();
@@ -1238,6 +1642,13 @@ void insertVerticesInRegion (GRegion *gr, int maxVert, bool _classify)
   int COUNT_MISS_1 = 0;
   int COUNT_MISS_2 = 0;
 
+  int nbThreads = 1;
+#if defined(_OPENMP)
+  nbThreads = CTX::instance()->mesh.maxNumThreads3D;
+#endif
+  const bool deterministic = CTX::instance()->mesh.deterministic3D;
+  bool forceSerial = false;
+
   double t1 = Cpu();
   while(1){
     //    break;
@@ -1247,33 +1658,37 @@ void insertVerticesInRegion (GRegion *gr, int maxVert, bool _classify)
       break;
     }
 
-    MTet4 *worst = *allTets.begin();
+    MTet4 *worst = allTets.top();
+
+    // small meshes lead to too many conflicts between cavities; in
+    // deterministic mode, the batches do not depend on the number of threads
+    const int batchSize = std::min(deterministic ? 256 : 64 * nbThreads,
+                                   (int)allTets.size() / 100);
 
     if(worst->isDeleted()){
       myFactory.Free(worst);
-      allTets.erase(allTets.begin());
+      allTets.pop();
+    }
+    else if(nbThreads > 1 && batchSize > 1 && !forceSerial &&
+            worst->getRadius() >= 1){
+      forceSerial = !insertVerticesParallel
+        (gr, nbThreads, std::min(batchSize, maxVert - ITER + 1), deterministic,
+         myFactory, allTets, vSizes, vSizesBGM, NUM, ITER, REALCOUNT,
+         NB_CORRECTION_OF_CAVITY, COUNT_MISS_1, COUNT_MISS_2);
     }
     else{
+      forceSerial = false;
       if(ITER++ % 5000 == 0)
         Msg::Info("%d points created - Worst tet radius is %g (PTS removed %d %d)",
                  REALCOUNT, worst->getRadius(), COUNT_MISS_1,COUNT_MISS_2);
       if(worst->getRadius() < 1) break;
       double center[3];
       double uvw[3];
-      MTetrahedron *base = worst->tet();
-
-      double pa[3] = {base->getVertex(0)->x(),
-		      base->getVertex(0)->y(),
-		      base->getVertex(0)->z()};
-      double pb[3] = {base->getVertex(1)->x(),
-		      base->getVertex(1)->y(),
-		      base->getVertex(1)->z()};
-      double pc[3] = {base->getVertex(2)->x(),
-		      base->getVertex(2)->y(),
-		      base->getVertex(2)->z()};
-      double pd[3] = {base->getVertex(3)->x(),
-		      base->getVertex(3)->y(),
-		      base->getVertex(3)->z()};
+      double pa[3], pb[3], pc[3], pd[3];
+      worst->getXYZ(0, pa);
+      worst->getXYZ(1, pb);
+      worst->getXYZ(2, pc);
+      worst->getXYZ(3, pd);
 
       tetcircumcenter(pa,pb,pc,pd, center,&uvw[0],&uvw[1],&uvw[2] );
 
@@ -1285,7 +1700,7 @@ void insertVerticesInRegion (GRegion *gr, int maxVert, bool _classify)
 
       bool FOUND = false;
       for (std::list<MTet4*>::iterator itc = cavity.begin(); itc != cavity.end(); ++itc){
-	MTetrahedron *toto = (*itc)->tet();
+	MTet4 *toto = *itc;
 	//	(*itc)->setDeleted(false);
 	toto->xyz2uvw(center,uvw);
 	if (toto->isInside(uvw[0], uvw[1], uvw[2])){
@@ -1299,6 +1714,7 @@ void insertVerticesInRegion (GRegion *gr, int maxVert, bool _classify)
       if(FOUND){
         MVertex *v = new MVertex(center[0], center[1], center[2], worst->onWhat());
         v->setIndex(NUM++);
+        myFactory.addVertex(v);
 
 	//	printTets ("before.pos", cavity, true);
 	bool starShaped = true;
@@ -1314,10 +1730,10 @@ void insertVerticesInRegion (GRegion *gr, int maxVert, bool _classify)
 	//}
 
         double lc1 =
-          (1 - uvw[0] - uvw[1] - uvw[2]) * vSizes[worst->tet()->getVertex(0)->getIndex()] +
-          uvw[0] * vSizes[worst->tet()->getVertex(1)->getIndex()] +
-          uvw[1] * vSizes[worst->tet()->getVertex(2)->getIndex()] +
-          uvw[2] * vSizes[worst->tet()->getVertex(3)->getIndex()];
+          (1 - uvw[0] - uvw[1] - uvw[2]) * vSizes[worst->getVertexIndex(0)] +
+          uvw[0] * vSizes[worst->getVertexIndex(1)] +
+          uvw[1] * vSizes[worst->getVertexIndex(2)] +
+          uvw[2] * vSizes[worst->getVertexIndex(3)];
         double lc = BGM_MeshSize(gr, 0, 0, center[0], center[1], center[2]);
         // double lc = std::min(lc1, BGM_MeshSize(gr, 0, 0, center[0], center[1], center[2]));
         vSizes.push_back(lc1);
@@ -1326,7 +1742,7 @@ void insertVerticesInRegion (GRegion *gr, int maxVert, bool _classify)
         if(!starShaped || !insertVertexB(shell,cavity,v, worst, myFactory, allTets, vSizes,vSizesBGM)){
 	  COUNT_MISS_1++;
 	  //	  printf("coucou 1 %d\n",ITER);
-          myFactory.changeTetRadius(allTets.begin(), 0.);
+          myFactory.changeTetRadius(0.);
 	  for (std::list<MTet4*>::iterator itc = cavity.begin(); itc != cavity.end(); ++itc)
 	    (*itc)->setDeleted(false);
           delete v;
@@ -1343,7 +1759,7 @@ void insertVerticesInRegion (GRegion *gr, int maxVert, bool _classify)
 	//	  toto->xyz2uvw(center,uvw);
 	//	  printf("point outside %12.5E %12.5E %12.5E %12.5E\n",uvw[0], uvw[1], uvw[2],1-uvw[0]-uvw[1]-uvw[2]);
 	//	}
-        myFactory.changeTetRadius(allTets.begin(), 0.0);
+        myFactory.changeTetRadius(0.0);
 	COUNT_MISS_2++;
 	for (std::list<MTet4*>::iterator itc = cavity.begin(); itc != cavity.end(); ++itc)  (*itc)->setDeleted(false);
 	//	if (cavity.size() > 10)printTets ("cavity.pos", cavity, true);
@@ -1359,6 +1775,8 @@ void insertVerticesInRegion (GRegion *gr, int maxVert, bool _classify)
   }
 
   memoryCleanup(myFactory, allTets);
+  // smooth and transfer the tets in the same order as before (worst first)
+  allTets.sort();
   double t2 = Cpu();
   double dt = (t2-t1);
   int COUNT_MISS = COUNT_MISS_1+COUNT_MISS_2;
@@ -1385,16 +1803,7 @@ void insertVerticesInRegion (GRegion *gr, int maxVert, bool _classify)
     }
   }
 
-  while(1){
-    if(allTets.begin() == allTets.end()) break;
-    MTet4 *worst = *allTets.begin();
-    if(!worst->isDeleted()){
-      worst->onWhat()->tetrahedra.push_back(worst->tet());
-      worst->tet() = 0;
-    }
-    myFactory.Free(worst);
-    allTets.erase(allTets.begin());
-  }
+  transferTets(myFactory);
 }
 
 MVertex * optimalPointFrontal(GRegion *gr,
@@ -1437,7 +1846,7 @@ void bowyerWatsonFrontalLayers(GRegion *gr, bool hex)
   std::vector<double> vSizes;
   std::vector<double> vSizesBGM;
   MTet4Factory myFactory(1600000);
-  std::set<MTet4*, compareTet4Ptr> &allTets = myFactory.getAllTets();
+  MTet4Factory::container &allTets = myFactory.getAllTets();
   std::set<MTet4*, compareTet4Ptr> activeTets;
   int NUM = 0;
 
@@ -1445,10 +1854,9 @@ void bowyerWatsonFrontalLayers(GRegion *gr, bool hex)
     // TODO !!!
   }
 
-  if (hex){
-    LIMIT_ = sqrt(2.) * .99;
-    MTet4::radiusNorm =-1;
-  }
+  // the tets of the front are refined until their radius is smaller than
+  // this limit
+  const double LIMIT_ = hex ? sqrt(2.) * .99 : 1.;
 
   { // leave this in a block so the map gets deallocated directly
     std::map<MVertex*, double> vSizesMap;
@@ -1464,13 +1872,20 @@ void bowyerWatsonFrontalLayers(GRegion *gr, bool hex)
     for(std::map<MVertex*, double>::iterator it = vSizesMap.begin();
         it != vSizesMap.end(); ++it){
       it->first->setIndex(NUM++);
+      myFactory.addVertex(it->first);
       vSizes.push_back(it->second);
       vSizesBGM.push_back(it->second);
     }
   }
 
-  for(unsigned int i = 0; i < gr->tetrahedra.size(); i++)
-    allTets.insert(myFactory.Create(gr->tetrahedra[i], vSizes,vSizesBGM));
+  for(unsigned int i = 0; i < gr->tetrahedra.size(); i++){
+    MTetrahedron *t = gr->tetrahedra[i];
+    allTets.push(myFactory.Create(t->getVertex(0)->getIndex(),
+                                  t->getVertex(1)->getIndex(),
+                                  t->getVertex(2)->getIndex(),
+                                  t->getVertex(3)->getIndex(), vSizes, vSizesBGM));
+    delete t;
+  }
 
   gr->tetrahedra.clear();
   connectTets(allTets.begin(), allTets.end());
@@ -1519,7 +1934,6 @@ void bowyerWatsonFrontalLayers(GRegion *gr, bool hex)
       activeTets.insert(*it);
       updateActiveFaces(*it, LIMIT_, _front);
     }
-    else if ((*it)->getRadius() < LIMIT_)break;
   }
 
   // insert points
@@ -1554,12 +1968,14 @@ void bowyerWatsonFrontalLayers(GRegion *gr, bool hex)
 
 	  MVertex *v = optimalPointFrontal (gr,worst,active_face,vSizes,vSizesBGM);
 	  v->setIndex(NUM++);
+	  myFactory.addVertex(v);
 	  vSizes.push_back(.025);
 	  vSizesBGM.push_back(.025);
 
 	  if(!worst->inCircumSphere(v) ||
-	     !insertVertex(v, worst, myFactory, allTets, vSizes,vSizesBGM,&activeTets)){
-	    myFactory.changeTetRadius(allTets.begin(), 0.);
+	     !insertVertex(v, worst, myFactory, allTets, vSizes,vSizesBGM,&activeTets,
+                           LIMIT_)){
+	    myFactory.changeTetRadius(0.);
 	    if(v) delete v;
 	  }
 	  else{
@@ -1574,7 +1990,7 @@ void bowyerWatsonFrontalLayers(GRegion *gr, bool hex)
       }
     }
     _front.clear();
-    MTet4Factory::iterator it = activeTetsNotInFront.begin();
+    std::set<MTet4*, compareTet4Ptr>::iterator it = activeTetsNotInFront.begin();
     for ( ; it!=activeTetsNotInFront.end();++it){
       if((*it)->getRadius() > LIMIT_ && isActive(*it,LIMIT_,active_face)){
 	activeTets.insert(*it);
@@ -1599,16 +2015,5 @@ void bowyerWatsonFrontalLayers(GRegion *gr, bool hex)
   }
 
 
-  while(1){
-    if(allTets.begin() == allTets.end()) break;
-    MTet4 *worst = *allTets.begin();
-    if(!worst->isDeleted()){
-      worst->onWhat()->tetrahedra.push_back(worst->tet());
-      worst->tet() = 0;
-    }
-    myFactory.Free(worst);
-    allTets.erase(allTets.begin());
-  }
-  MTet4::radiusNorm = 2;
-  LIMIT_ = 1;
+  transferTets(myFactory);
 }
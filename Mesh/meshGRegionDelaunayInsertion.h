@@ -8,6 +8,8 @@
 
 #include <list>
 #include <set>
+#include <vector>
+#include <algorithm>
 #include <map>
 #include <stack>
 #include "MTetrahedron.h"
@@ -16,7 +18,6 @@
 #include "qualityMeasures.h"
 #include "robustPredicates.h"
 
-//#define _GMSH_PRE_ALLOCATE_STRATEGY_ 1
 class GRegion;
 class GFace;
 class GModel;
@@ -29,13 +30,19 @@ class MTet4Factory;
 
 // Memory usage for 1 million tets:
 //
-// * sizeof(MTet4) = 36 Bytes and sizeof(MTetrahedron) = 28 Bytes 
-//   -> 64 MB
-// * rb tree containing all pointers sorted with respect to tet
-//   radius: each bucket of the tree contains 4 pointers (16 Bytes)
-//   plus the data -> 20 MB
+// * sizeof(MTet4) = 80 Bytes on 64 bit machines (the MTet4s are
+//   allocated by chunks, so there is no malloc overhead) -> 80 MB; the
+//   MTetrahedrons (sizeof(MTetrahedron) = 48 Bytes) are only created for
+//   the tets that are transferred to the region, so the tets deleted
+//   during the refinement never allocate one
+// * binary heap containing all pointers sorted with respect to tet
+//   radius (deleted tets are only removed when they reach the top of
+//   the heap, or when the heap is compacted) -> 4 to 8 MB (the rb
+//   tree used before, with 4 pointers plus the data in each bucket,
+//   took about 20 MB)
 // * sizeof(MVertex) = 44 Bytes and there are about 200000 verts per
-//   million tet -> 9MB
+//   million tet -> 9MB, plus the vertex pointers and coordinates in the
+//   factory -> 6.4MB
 // * vector of char lengths per vertex -> 1.6Mb
 // * vectors in GEntities to store the element and vertex pointers 
 //   -> 5Mb
@@ -54,66 +61,87 @@ class MTet4
 {
   friend class MTet4Factory;
  private:
-  bool deleted;
+  // members are sorted by decreasing size to avoid padding
   double circum_radius;
-  MTetrahedron *base;
   MTet4 *neigh[4];
+  // the tets of a factory only store the indices of their vertices in the
+  // factory (where the coordinates are stored contiguously): the
+  // MTetrahedron is only created when it is requested by tet(), e.g. by the
+  // local mesh modifications
+  union {
+    MTetrahedron *base;
+    int verts[4];
+  };
   GRegion *gr;
+  // the factory "verts" refers to (0 if "base" is used)
+  MTet4Factory *factory;
+  // cavity currently owning this tet during parallel point insertion
+  // (-1 if none)
+  int owner;
+  bool deleted;
+  void createTet();
  public :
-  static int radiusNorm; // 2 is euclidian norm, -1 is infinite norm  
   ~MTet4(){}
   MTet4() 
-    : deleted(false), circum_radius(0.0), base(0), gr(0)
+    : circum_radius(0.0), base(0), gr(0), factory(0), owner(-1), deleted(false)
   {
     neigh[0] = neigh[1] = neigh[2] = neigh[3] = 0;
   }
   MTet4(MTetrahedron *t, double qual) 
-    : deleted(false), circum_radius(qual), base(t), gr(0)
+    : circum_radius(qual), base(t), gr(0), factory(0), owner(-1), deleted(false)
   {
     neigh[0] = neigh[1] = neigh[2] = neigh[3] = 0;
   }
   MTet4(MTetrahedron *t, const qualityMeasure4Tet &qm) 
-    : deleted(false), base(t), gr(0)
+    : base(t), gr(0), factory(0), owner(-1), deleted(false)
   {
     neigh[0] = neigh[1] = neigh[2] = neigh[3] = 0;
     double vol;
     circum_radius = qmTet(t, qm, &vol);
   }
-  void circumcenter(double *res)
+  inline MVertex *getVertex(int i) const;
+  // index of the vertex in the factory, i.e. MVertex::getIndex()
+  inline int getVertexIndex(int i) const;
+  inline void getXYZ(int i, double p[3]) const;
+  void circumcenter(double *res) const
   {
-    MVertex *v0 = base->getVertex(0);
-    MVertex *v1 = base->getVertex(1);
-    MVertex *v2 = base->getVertex(2);
-    MVertex *v3 = base->getVertex(3);
-    double A[4] = {v0->x(), v0->y(), v0->z()};
-    double B[4] = {v1->x(), v1->y(), v1->z()};
-    double C[4] = {v2->x(), v2->y(), v2->z()};
-    double D[4] = {v3->x(), v3->y(), v3->z()};
+    double A[3], B[3], C[3], D[3];
+    getXYZ(0, A);
+    getXYZ(1, B);
+    getXYZ(2, C);
+    getXYZ(3, D);
     double x,y,z;
     tetcircumcenter (A,B,C,D,res,&x,&y,&z);
   }
 
-  void setup(MTetrahedron *t, std::vector<double> &sizes, std::vector<double> &sizesBGM)
+  void setup(MTet4Factory *f, int v0, int v1, int v2, int v3,
+             std::vector<double> &sizes, std::vector<double> &sizesBGM)
   {
-    base = t;
+    factory = f;
+    verts[0] = v0;
+    verts[1] = v1;
+    verts[2] = v2;
+    verts[3] = v3;
     neigh[0] = neigh[1] = neigh[2] = neigh[3] = 0;
-    double center[3];
+    double center[3], p[3];
     circumcenter(center);
-    const double dx = base->getVertex(0)->x() - center[0];
-    const double dy = base->getVertex(0)->y() - center[1];
-    const double dz = base->getVertex(0)->z() - center[2];
+    getXYZ(0, p);
+    const double dx = p[0] - center[0];
+    const double dy = p[1] - center[1];
+    const double dz = p[2] - center[2];
     circum_radius = sqrt(dx * dx + dy * dy + dz * dz);
-    double lc1 = 0.25*(sizes[base->getVertex(0)->getIndex()]+
-                      sizes[base->getVertex(1)->getIndex()]+
-                       sizes[base->getVertex(2)->getIndex()]+
-                       sizes[base->getVertex(3)->getIndex()]);
-    double lcBGM = 0.25*(sizesBGM[base->getVertex(0)->getIndex()]+
-                         sizesBGM[base->getVertex(1)->getIndex()]+
-                         sizesBGM[base->getVertex(2)->getIndex()]+
-                         sizesBGM[base->getVertex(3)->getIndex()]);
+    double lc1 = 0.25*(sizes[v0]+
+                      sizes[v1]+
+                       sizes[v2]+
+                       sizes[v3]);
+    double lcBGM = 0.25*(sizesBGM[v0]+
+                         sizesBGM[v1]+
+                         sizesBGM[v2]+
+                         sizesBGM[v3]);
     double lc = Extend2dMeshIn3dVolumes() ? std::min(lc1, lcBGM) : lcBGM;
     circum_radius /= lc;
     deleted = false;
+    owner = -1;
   } 
   inline GRegion *onWhat() const { return gr; }
   inline void setOnWhat(GRegion *g) { gr = g; }
@@ -122,8 +150,12 @@ class MTet4
   inline double getRadius() const { return circum_radius; }
   inline double getQuality() const { return circum_radius; } 
   inline void setQuality(const double &q){ circum_radius = q; } 
-  inline MTetrahedron *tet() const { return base; }
-  inline MTetrahedron *&tet() { return base; }
+  inline MTetrahedron *tet() const { return const_cast<MTet4*>(this)->tet(); }
+  inline MTetrahedron *&tet()
+  {
+    if(factory) createTet();
+    return base;
+  }
   inline void setNeigh(int iN, MTet4 *n) { neigh[iN] = n; }
   inline MTet4 *getNeigh(int iN) const { return neigh[iN]; }
   int inCircumSphere(const double *p) const; 
@@ -137,25 +169,35 @@ class MTet4
     return inCircumSphere(v->x(), v->y(), v->z());
   }
   inline double getVolume() const { 
-    
-    double pa[3] = {base->getVertex(0)->x(), 
-		    base->getVertex(0)->y(), 
-		    base->getVertex(0)->z()};
-    double pb[3] = {base->getVertex(1)->x(), 
-		    base->getVertex(1)->y(),
-		    base->getVertex(1)->z()};
-    double pc[3] = {base->getVertex(2)->x(),
-		    base->getVertex(2)->y(), 
-		    base->getVertex(2)->z()};
-    double pd[3] = {base->getVertex(3)->x(),
-		    base->getVertex(3)->y(),
-		    base->getVertex(3)->z()};
+    double pa[3], pb[3], pc[3], pd[3];
+    getXYZ(0, pa);
+    getXYZ(1, pb);
+    getXYZ(2, pc);
+    getXYZ(3, pd);
     return fabs(robustPredicates::orient3d(pa, pb, pc, pd))/6.0; 
   }
+  // same as MTetrahedron::xyz2uvw() and MTetrahedron::isInside(), without
+  // creating the MTetrahedron
+  void xyz2uvw(const double xyz[3], double uvw[3]) const;
+  inline bool isInside(double u, double v, double w) const
+  {
+    const double tol = MElement::getTolerance();
+    if(u < (-tol) || v < (-tol) || w < (-tol) || u > ((1. + tol) - v - w))
+      return false;
+    return true;
+  }
   inline void setDeleted(bool d)
   {
     deleted = d;
   }
+  inline int getOwner() const { return owner; }
+  inline void releaseOwner() { owner = -1; }
+  // atomically take ownership of the tet for cavity "o"; returns false if
+  // another cavity already owns it
+  bool claim(int o);
+  // atomically give the tet to cavity "o" if it is not owned by a cavity
+  // with a lower index
+  void reserve(int o);
   inline bool assertNeigh() const 
   {
     if (deleted) return true;
@@ -189,80 +231,201 @@ class compareTet4Ptr
   }
 };
 
+// Priority queue of tets, worst (largest radius) first, stored as a binary
+// heap. Iterating over the queue visits the tets in no particular order.
+// Tets are removed lazily: a deleted tet stays in the queue until it
+// reaches the top or until compact() is called.
+class MTet4Queue
+{
+ public:
+  typedef std::vector<MTet4*>::iterator iterator;
+ private:
+  std::vector<MTet4*> _heap;
+  // heap order is the reverse of the sorting order
+  struct lessPriority {
+    inline bool operator () (const MTet4 *a, const MTet4 *b) const
+    {
+      return compareTet4Ptr()(b, a);
+    }
+  };
+ public:
+  inline iterator begin() { return _heap.begin(); }
+  inline iterator end() { return _heap.end(); }
+  inline bool empty() const { return _heap.empty(); }
+  inline unsigned int size() const { return _heap.size(); }
+  inline MTet4 *top() const { return _heap.front(); }
+  inline void push(MTet4 *t)
+  {
+    _heap.push_back(t);
+    std::push_heap(_heap.begin(), _heap.end(), lessPriority());
+  }
+  template <class ITER>
+  void push(ITER beg, ITER end)
+  {
+    for(; beg != end; ++beg) push(*beg);
+  }
+  inline void pop()
+  {
+    std::pop_heap(_heap.begin(), _heap.end(), lessPriority());
+    _heap.pop_back();
+  }
+  // remove all the deleted tets and return them
+  void compact(std::vector<MTet4*> &removed)
+  {
+    unsigned int n = 0;
+    for(unsigned int i = 0; i < _heap.size(); i++){
+      if(_heap[i]->isDeleted()) removed.push_back(_heap[i]);
+      else _heap[n++] = _heap[i];
+    }
+    _heap.resize(n);
+    std::make_heap(_heap.begin(), _heap.end(), lessPriority());
+  }
+  // sort the tets worst first, i.e. in the iteration order of a
+  // std::set<MTet4*, compareTet4Ptr>; a sorted array is still a valid heap
+  void sort() { std::sort(_heap.begin(), _heap.end(), compareTet4Ptr()); }
+  void clear() { std::vector<MTet4*>().swap(_heap); }
+};
+
 class MTet4Factory
 {
  public:
-  typedef std::set<MTet4*, compareTet4Ptr> container;
+  typedef MTet4Queue container;
   typedef container::iterator iterator;
  private:
   container allTets;
-#ifdef _GMSH_PRE_ALLOCATE_STRATEGY_
-  MTet4* allSlots;
-  int s_last, s_alloc;
-  std::stack<MTet4*> emptySlots;
+  // the vertices of the tets, indexed by MVertex::getIndex(), and their
+  // coordinates
+  std::vector<MVertex*> vertices;
+  std::vector<double> xyz;
+  // the MTet4s are allocated by chunks; freed ones are recycled through a
+  // free list, and are only given back to the system when the factory is
+  // destroyed
+  std::vector<MTet4*> chunks;
+  std::vector<MTet4*> emptySlots;
+  int chunkSize, lastInChunk;
   inline MTet4 *getANewSlot()
   {
-    if (s_last >= s_alloc) return 0;
-    MTet4 * t  = &(allSlots[s_last]);
-    s_last++;
-    return t;
+    if(chunks.empty() || lastInChunk == chunkSize){
+      chunks.push_back(new MTet4[chunkSize]);
+      lastInChunk = 0;
+    }
+    return &(chunks.back()[lastInChunk++]);
   }
   inline MTet4 *getAnEmptySlot()
   {
     if(!emptySlots.empty()){
-      MTet4* t = emptySlots.top();
-      emptySlots.pop();
+      MTet4* t = emptySlots.back();
+      emptySlots.pop_back();
       return t;
     }
     return getANewSlot();
-  };    
-#endif
+  }
  public :
+  // _size is the expected number of tets
   MTet4Factory(int _size = 1000000)
+    : chunkSize(std::max(1024, std::min(_size / 64, 65536))), lastInChunk(0)
   {
-#ifdef _GMSH_PRE_ALLOCATE_STRATEGY_
-    s_last = 0; s_alloc = _size;
-    allSlots = new MTet4[s_alloc];
-#endif
   }
-  ~MTet4Factory() 
+  ~MTet4Factory() { clear(); }
+  // delete all the tets (and their MTetrahedrons, if they were created)
+  void clear()
   {
-#ifdef _GMSH_PRE_ALLOCATE_STRATEGY_
-    delete [] allSlots;
-#endif
+    for(unsigned int i = 0; i < chunks.size(); i++){
+      for(int j = 0; j < chunkSize; j++)
+        if(!chunks[i][j].factory && chunks[i][j].base)
+          delete chunks[i][j].base;
+      delete [] chunks[i];
+    }
+    std::vector<MTet4*>().swap(chunks);
+    std::vector<MTet4*>().swap(emptySlots);
+    lastInChunk = 0;
+    allTets.clear();
+    std::vector<MVertex*>().swap(vertices);
+    std::vector<double>().swap(xyz);
   }
-  MTet4 *Create(MTetrahedron * t, std::vector<double> &sizes, 
-                std::vector<double> &sizesBGM)
+  // return a slot for a new tet
+  MTet4 *Allocate()
   {
-#ifdef _GMSH_PRE_ALLOCATE_STRATEGY_
-    MTet4 *t4 = getAnEmptySlot();
-#else
-    MTet4 *t4 = new MTet4;
+    MTet4 *t4;
+#if defined(_OPENMP)
+#pragma omp critical (MTet4Factory_slots)
 #endif
-    t4->setup(t, sizes, sizesBGM);
+    t4 = getAnEmptySlot();
+    return t4;
+  }
+  // register a vertex (its index must be set), before creating tets with it
+  void addVertex(MVertex *v)
+  {
+    const unsigned int i = v->getIndex();
+    if(i >= vertices.size()){
+      vertices.resize(i + 1, (MVertex*)0);
+      xyz.resize(3 * (i + 1));
+    }
+    vertices[i] = v;
+    xyz[3 * i] = v->x();
+    xyz[3 * i + 1] = v->y();
+    xyz[3 * i + 2] = v->z();
+  }
+  inline MVertex *getVertex(int i) const { return vertices[i]; }
+  inline const double *getXYZ(int i) const { return &xyz[3 * i]; }
+  // create a new tet from the indices of its vertices, in the given slot if
+  // any
+  MTet4 *Create(int v0, int v1, int v2, int v3, std::vector<double> &sizes, 
+                std::vector<double> &sizesBGM, MTet4 *slot = 0)
+  {
+    MTet4 *t4 = slot ? slot : Allocate();
+    *t4 = MTet4();
+    t4->setup(this, v0, v1, v2, v3, sizes, sizesBGM);
     return t4;
   }
   void Free(MTet4 *t)
   {
-    if (t->tet()) delete t->tet();
-    t->tet() = 0;
-#ifdef _GMSH_PRE_ALLOCATE_STRATEGY_
-    emptySlots.push(t);
+    if (!t->factory && t->base) delete t->base;
+    t->factory = 0;
+    t->base = 0;
     t->setDeleted(true);
-#else
-    delete t;
+#if defined(_OPENMP)
+#pragma omp critical (MTet4Factory_slots)
 #endif
+    emptySlots.push_back(t);
   }
-  void changeTetRadius(iterator it, double r)
+  // change the radius of the worst tet, i.e. the top of the queue
+  void changeTetRadius(double r)
   {
-    MTet4 *t = *it;
-    allTets.erase(it);
+    MTet4 *t = allTets.top();
+    allTets.pop();
     t->forceRadius(r);
-    allTets.insert(t);
+    allTets.push(t);
   }
   container &getAllTets(){ return allTets; }
 };
 
+inline MVertex *MTet4::getVertex(int i) const
+{
+  return factory ? factory->getVertex(verts[i]) : base->getVertex(i);
+}
+
+inline int MTet4::getVertexIndex(int i) const
+{
+  return factory ? verts[i] : base->getVertex(i)->getIndex();
+}
+
+inline void MTet4::getXYZ(int i, double p[3]) const
+{
+  if(factory){
+    const double *x = factory->getXYZ(verts[i]);
+    p[0] = x[0];
+    p[1] = x[1];
+    p[2] = x[2];
+  }
+  else{
+    MVertex *v = base->getVertex(i);
+    p[0] = v->x();
+    p[1] = v->y();
+    p[2] = v->z();
+  }
+}
+
 void optimizeMesh(GRegion *gr, const qualityMeasure4Tet &qm);
 
 #endif
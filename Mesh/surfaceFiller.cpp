@@ -199,7 +199,9 @@ bool compute4neighbors (GFace *gf,   // the surface
   // get the parameter of the point on the surface
   reparamMeshVertexOnFace(v_center, gf, midpoint);
 
-  double L = backgroundMesh::current()->operator()(midpoint[0],midpoint[1],0.0);
+  // size and cross field at the point, found with a single lookup
+  double L, angle;
+  backgroundMesh::current()->eval(1, midpoint, &L, &angle);
   //  printf("L = %12.5E\n",L);
   metricField = SMetric3(1./(L*L));
   FieldManager *fields = gf->model()->getFields();
@@ -237,7 +239,7 @@ bool compute4neighbors (GFace *gf,   // the surface
   SVector3 basis_v = crossprod(n,basis_u);
 
   for (int DIR = 0 ; DIR < NUMDIR ; DIR ++){
-    double quadAngle  = backgroundMesh::current()->getAngle (midpoint[0],midpoint[1],0) + DIRS[DIR];
+    double quadAngle  = angle + DIRS[DIR];
 
     // normalize vector t1 that is tangent to gf at midpoint
     SVector3 t1 = basis_u * cos (quadAngle) + basis_v * sin (quadAngle) ;
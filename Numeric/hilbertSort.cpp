@@ -0,0 +1,120 @@
+// Gmsh - Copyright (C) 1997-2013 C. Geuzaine, J.-F. Remacle
+//
+// See the LICENSE.txt file for license information. Please report all
+// bugs and problems to the public mailing list <gmsh@geuz.org>.
+
+#include <algorithm>
+#include "hilbertSort.h"
+
+typedef unsigned long long hilbertKey;
+
+// Convert the integer coordinates X[0..n-1] (b bits each) in place into
+// the "transposed" Hilbert index (J. Skilling, "Programming the Hilbert
+// curve", AIP Conf. Proc. 707, 2004).
+static void axesToTranspose(unsigned int *X, int b, int n)
+{
+  const unsigned int M = 1U << (b - 1);
+  // inverse undo
+  for(unsigned int Q = M; Q > 1; Q >>= 1){
+    const unsigned int P = Q - 1;
+    for(int i = 0; i < n; i++){
+      if(X[i] & Q) X[0] ^= P;
+      else{
+        const unsigned int t = (X[0] ^ X[i]) & P;
+        X[0] ^= t;
+        X[i] ^= t;
+      }
+    }
+  }
+  // Gray encode
+  for(int i = 1; i < n; i++) X[i] ^= X[i - 1];
+  unsigned int t = 0;
+  for(unsigned int Q = M; Q > 1; Q >>= 1)
+    if(X[n - 1] & Q) t ^= Q - 1;
+  for(int i = 0; i < n; i++) X[i] ^= t;
+}
+
+static hilbertKey hilbertIndex(const double *p, const double *min,
+                               const double *scale, int dim, int b)
+{
+  unsigned int X[3];
+  const double top = (double)((1U << b) - 1);
+  for(int j = 0; j < dim; j++){
+    double c = (p[j] - min[j]) * scale[j];
+    X[j] = (unsigned int)std::max(0., std::min(top, c));
+  }
+  axesToTranspose(X, b, dim);
+  hilbertKey key = 0;
+  for(int bit = b - 1; bit >= 0; bit--)
+    for(int j = 0; j < dim; j++)
+      key = (key << 1) | ((X[j] >> bit) & 1U);
+  return key;
+}
+
+class hilbertLessThan {
+ private:
+  const std::vector<hilbertKey> &_keys;
+ public:
+  hilbertLessThan(const std::vector<hilbertKey> &keys) : _keys(keys) {}
+  bool operator()(int a, int b) const
+  {
+    if(_keys[a] != _keys[b]) return _keys[a] < _keys[b];
+    return a < b;
+  }
+};
+
+void hilbertSort(int dim, int n, const double *xyz, std::vector<int> &perm,
+                 bool brio)
+{
+  perm.resize(n);
+  for(int i = 0; i < n; i++) perm[i] = i;
+  if(n < 2 || dim < 1 || dim > 3) return;
+
+  // 62 (2D) or 63 (3D) bits keys
+  const int b = (dim == 3) ? 21 : 31;
+  double min[3], max[3], scale[3];
+  for(int j = 0; j < dim; j++) min[j] = max[j] = xyz[j];
+  for(int i = 1; i < n; i++){
+    for(int j = 0; j < dim; j++){
+      min[j] = std::min(min[j], xyz[dim * i + j]);
+      max[j] = std::max(max[j], xyz[dim * i + j]);
+    }
+  }
+  // use the same scaling in all directions to keep the curve isotropic
+  double L = 0.;
+  for(int j = 0; j < dim; j++) L = std::max(L, max[j] - min[j]);
+  for(int j = 0; j < dim; j++)
+    scale[j] = L > 0. ? (double)((1U << b) - 1) / L : 0.;
+
+  std::vector<hilbertKey> keys(n);
+  for(int i = 0; i < n; i++)
+    keys[i] = hilbertIndex(&xyz[dim * i], min, scale, dim, b);
+
+  if(!brio){
+    std::sort(perm.begin(), perm.end(), hilbertLessThan(keys));
+    return;
+  }
+
+  // BRIO: each point goes to the last round with probability 1/2, to the
+  // one before with probability 1/4, etc. (the first round gathers the
+  // remaining points); rounds are inserted first to last
+  const size_t minRoundSize = 64;
+  int numRounds = 1;
+  for(size_t size = 2 * minRoundSize; size < (size_t)n; size *= 2) numRounds++;
+  std::vector<std::vector<int> > rounds(numRounds);
+  unsigned int seed = 12345;
+  for(int i = 0; i < n; i++){
+    int r = numRounds - 1;
+    while(r > 0){
+      seed = seed * 1103515245U + 12345U;
+      if((seed >> 16) & 1U) break;
+      r--;
+    }
+    rounds[r].push_back(i);
+  }
+  perm.clear();
+  for(int r = 0; r < numRounds; r++){
+    std::sort(rounds[r].begin(), rounds[r].end(), hilbertLessThan(keys));
+    perm.insert(perm.end(), rounds[r].begin(), rounds[r].end());
+  }
+}
@@ -0,0 +1,26 @@
+// Gmsh - Copyright (C) 1997-2013 C. Geuzaine, J.-F. Remacle
+//
+// See the LICENSE.txt file for license information. Please report all
+// bugs and problems to the public mailing list <gmsh@geuz.org>.
+
+#ifndef _HILBERT_SORT_H_
+#define _HILBERT_SORT_H_
+
+#include <vector>
+
+// Spatial sorting of point sets before incremental (Delaunay) insertion:
+// consecutive points in the sorted order are close to each other, so that
+// the point location walk starting from the last inserted point is short.
+
+// Compute the permutation "perm" that sorts the "n" points of dimension
+// "dim" (2 or 3) stored in "xyz" (xyz[dim * i + j] is the j-th coordinate
+// of point i) along a Hilbert curve. If "brio" is set, the points are
+// first grouped in rounds of geometrically increasing size (Biased
+// Randomized Insertion Order), and each round is sorted along the curve:
+// this keeps the walks short while avoiding the degenerate insertion
+// orders of a pure space-filling curve. The randomization uses a fixed
+// seed, so that the result is reproducible.
+void hilbertSort(int dim, int n, const double *xyz, std::vector<int> &perm,
+                 bool brio = false);
+
+#endif
@@ -75,4 +75,33 @@ bool mathEvaluator::eval(std::vector<double> &values, std::vector<double> &res)
   return true;
 }
 
+bool mathEvaluator::eval(int n, const double *values, double *res)
+{
+  const int numVar = _variables.size(), numExp = _expressions.size();
+  if(n <= 0) return true;
+
+  std::vector<double> tmp(n);
+  bool ok = true;
+  for(int k = 0; k < numExp && ok; k++){
+    try {
+      _expressions[k]->eval(n, numVar ? &_variables[0] : 0, values, numVar,
+                            &tmp[0]);
+      for(int i = 0; i < n; i++) res[i * numExp + k] = tmp[i];
+    }
+    catch(smlib::mathex::error &) {
+      ok = false;
+    }
+  }
+  if(ok) return true;
+
+  // errors (e.g. division by zero) are handled point by point
+  std::vector<double> v(numVar), r(numExp);
+  for(int i = 0; i < n; i++){
+    for(int j = 0; j < numVar; j++) v[j] = values[i * numVar + j];
+    if(!eval(v, r)) return false;
+    for(int k = 0; k < numExp; k++) res[i * numExp + k] = r[k];
+  }
+  return true;
+}
+
 #endif
@@ -29,6 +29,11 @@ class mathEvaluator{
   // evaluate the expression(s) using the given values and fill the
   // result vector. Returns true if the evaluation succeeded.
   bool eval(std::vector<double> &values, std::vector<double> &res);
+  // evaluate the expression(s) for n sets of values at once: values[i *
+  // numVariables + j] is the value of variable j for point i, and res[i *
+  // numExpressions + k] receives the value of expression k for point i.
+  // The results are the same as with n calls to the function above.
+  bool eval(int n, const double *values, double *res);
 };
 
 #else
@@ -47,6 +52,10 @@ class mathEvaluator{
   {
     return false;
   }
+  bool eval(int n, const double *values, double *res)
+  {
+    return false;
+  }
 };
 
 #endif
@@ -308,6 +308,22 @@ void GMSH_CutGridPlugin::addInView(int numsteps, int connect, int nbcomp,
   }     
 }
 
+static void searchGrid(OctreePost &o, int nbcomp, int numsteps, int nbu,
+                       int nbv, double ***pnts, double ***vals)
+{
+  // search all the grid points at once
+  std::vector<double> xyz(3 * nbu * nbv), v(nbcomp * numsteps * nbu * nbv);
+  for(int i = 0; i < nbu; i++)
+    for(int j = 0; j < nbv; j++)
+      for(int k = 0; k < 3; k++)
+        xyz[3 * (nbv * i + j) + k] = pnts[i][j][k];
+  o.search(nbcomp, nbu * nbv, &xyz[0], &v[0]);
+  for(int i = 0; i < nbu; i++)
+    for(int j = 0; j < nbv; j++)
+      for(int k = 0; k < nbcomp * numsteps; k++)
+        vals[i][j][k] = v[nbcomp * numsteps * (nbv * i + j) + k];
+}
+
 PView *GMSH_CutGridPlugin::GenerateView(PView *v1, int connect)
 {
   if(getNbU() <= 0 || getNbV() <= 0)
@@ -339,25 +355,19 @@ PView *GMSH_CutGridPlugin::GenerateView(PView *v1, int connect)
   }
   
   if(nbs){
-    for(int i = 0; i < getNbU(); i++)
-      for(int j = 0; j < getNbV(); j++)
-        o.searchScalar(pnts[i][j][0], pnts[i][j][1], pnts[i][j][2], vals[i][j]);
+    searchGrid(o, 1, numsteps, getNbU(), getNbV(), pnts, vals);
     addInView(numsteps, connect, 1, pnts, vals, data2->SP, &data2->NbSP, 
               data2->SL, &data2->NbSL, data2->SQ, &data2->NbSQ);
   }
 
   if(nbv){
-    for(int i = 0; i < getNbU(); i++)
-      for(int j = 0; j < getNbV(); j++)
-        o.searchVector(pnts[i][j][0], pnts[i][j][1], pnts[i][j][2], vals[i][j]);
+    searchGrid(o, 3, numsteps, getNbU(), getNbV(), pnts, vals);
     addInView(numsteps, connect, 3, pnts, vals, data2->VP, &data2->NbVP,
               data2->VL, &data2->NbVL, data2->VQ, &data2->NbVQ);
   }
 
   if(nbt){
-    for(int i = 0; i < getNbU(); i++)
-      for(int j = 0; j < getNbV(); j++)
-        o.searchTensor(pnts[i][j][0], pnts[i][j][1], pnts[i][j][2], vals[i][j]);
+    searchGrid(o, 9, numsteps, getNbU(), getNbV(), pnts, vals);
     addInView(numsteps, connect, 9, pnts, vals, data2->TP, &data2->NbTP, 
               data2->TL, &data2->NbTL, data2->TQ, &data2->NbTQ);
   }
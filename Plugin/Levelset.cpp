@@ -3,6 +3,7 @@
 // See the LICENSE.txt file for license information. Please report all
 // bugs and problems to the public mailing list <gmsh@geuz.org>.
 
+#include <algorithm>
 #include "Levelset.h"
 #include "MakeSimplex.h"
 #include "Numeric.h"
@@ -178,9 +179,17 @@ static void reorderPrism(int numComp, double xp[12], double yp[12], double zp[12
   }
 }
 
+struct GMSH_LevelsetPlugin::cutElement {
+  int ent, ele, numNodes, numEdges, numComp, type;
+  double x[8], y[8], z[8], levels[8], scalarValues[8];
+  // range of the levels over the nodes
+  double min, max;
+  // offset of the values of the element in the value buffer
+  int offset;
+};
+
 GMSH_LevelsetPlugin::GMSH_LevelsetPlugin()
 {
-  _invert = 0.;
   _ref[0] = _ref[1] = _ref[2] = 0.;
   _valueIndependent = 0; // "moving" levelset
   _valueView = -1; // use same view for levelset and field data
@@ -194,7 +203,7 @@ GMSH_LevelsetPlugin::GMSH_LevelsetPlugin()
 void GMSH_LevelsetPlugin::_addElement(int np, int numEdges, int numComp,
                                       double xp[12], double yp[12], double zp[12],
                                       double valp[12][9], PViewDataList *out,
-                                      bool firstStep)
+                                      bool firstStep) const
 {
   std::vector<double> *list;
   int *nbPtr;
@@ -260,39 +269,70 @@ void GMSH_LevelsetPlugin::_addElement(int np, int numEdges, int numComp,
       list->push_back(valp[k][l]);
 }
 
-void GMSH_LevelsetPlugin::_cutAndAddElements(PViewData *vdata, PViewData *wdata,
-                                             int ent, int ele, int vstep, int wstep,
-                                             double x[8], double y[8], double z[8],
-                                             double levels[8], double scalarValues[8],
-                                             PViewDataList* out)
+// the lists of a PViewDataList, in the order of getListPointers()
+static std::vector<double> PViewDataList::*const listMembers[24] = {
+  &PViewDataList::SP, &PViewDataList::VP, &PViewDataList::TP,
+  &PViewDataList::SL, &PViewDataList::VL, &PViewDataList::TL,
+  &PViewDataList::ST, &PViewDataList::VT, &PViewDataList::TT,
+  &PViewDataList::SQ, &PViewDataList::VQ, &PViewDataList::TQ,
+  &PViewDataList::SS, &PViewDataList::VS, &PViewDataList::TS,
+  &PViewDataList::SH, &PViewDataList::VH, &PViewDataList::TH,
+  &PViewDataList::SI, &PViewDataList::VI, &PViewDataList::TI,
+  &PViewDataList::SY, &PViewDataList::VY, &PViewDataList::TY
+};
+
+static int PViewDataList::*const numMembers[24] = {
+  &PViewDataList::NbSP, &PViewDataList::NbVP, &PViewDataList::NbTP,
+  &PViewDataList::NbSL, &PViewDataList::NbVL, &PViewDataList::NbTL,
+  &PViewDataList::NbST, &PViewDataList::NbVT, &PViewDataList::NbTT,
+  &PViewDataList::NbSQ, &PViewDataList::NbVQ, &PViewDataList::NbTQ,
+  &PViewDataList::NbSS, &PViewDataList::NbVS, &PViewDataList::NbTS,
+  &PViewDataList::NbSH, &PViewDataList::NbVH, &PViewDataList::NbTH,
+  &PViewDataList::NbSI, &PViewDataList::NbVI, &PViewDataList::NbTI,
+  &PViewDataList::NbSY, &PViewDataList::NbVY, &PViewDataList::NbTY
+};
+
+// move the elements of "src" at the end of "dst" (the lists of "src" keep
+// their capacity, so that they can be refilled without allocating)
+static void appendLists(PViewDataList *src, PViewDataList *dst)
 {
-  int stepmin = vstep, stepmax = vstep + 1, otherstep = wstep;
-  if(stepmin < 0){
-    stepmin = vdata->getFirstNonEmptyTimeStep();
-    stepmax = vdata->getNumTimeSteps();
+  for(int i = 0; i < 24; i++){
+    std::vector<double> &s(src->*listMembers[i]), &d(dst->*listMembers[i]);
+    if(s.empty()) continue;
+    d.insert(d.end(), s.begin(), s.end());
+    dst->*numMembers[i] += src->*numMembers[i];
+    s.clear();
+    src->*numMembers[i] = 0;
   }
-  if(wstep < 0) otherstep = wdata->getFirstNonEmptyTimeStep();
+}
 
-  int numNodes = vdata->getNumNodes(stepmin, ent, ele);
-  int numEdges = vdata->getNumEdges(stepmin, ent, ele);
-  int numComp = wdata->getNumComponents(otherstep, ent, ele);
-  int type = vdata->getType(stepmin, ent, ele);
+void GMSH_LevelsetPlugin::_cutAndAddElements(cutElement &e, const double *values,
+                                             int stepmin, int stepmax,
+                                             bool valuesPerStep,
+                                             const std::vector<char> &hasStep,
+                                             PViewDataList *out) const
+{
+  double *x = e.x, *y = e.y, *z = e.z, *levels = e.levels;
+  int numNodes = e.numNodes, numEdges = e.numEdges, numComp = e.numComp;
+  double ref[3] = {_ref[0], _ref[1], _ref[2]}, invert = 0.;
 
   // decompose the element into simplices
-  for(int simplex = 0; simplex < numSimplexDec(type); simplex++){
+  for(int simplex = 0; simplex < numSimplexDec(e.type); simplex++){
 
     int n[4], ep[12], nsn, nse;
-    getSimplexDec(numNodes, numEdges, type, simplex, n[0], n[1], n[2], n[3],
+    getSimplexDec(numNodes, numEdges, e.type, simplex, n[0], n[1], n[2], n[3],
                   nsn, nse);
 
     // loop over time steps
     for(int step = stepmin; step < stepmax; step++){
 
-      // check which edges cut the iso and interpolate the value
-      if(wstep < 0) otherstep = step;
+      if(!hasStep[step - stepmin]) continue;
 
-      if(!wdata->hasTimeStep(otherstep)) continue;
+      // values of the nodes at this step
+      const double *val = values;
+      if(valuesPerStep) val += (step - stepmin) * numNodes * numComp;
 
+      // check which edges cut the iso and interpolate the value
       int np = 0;
       double xp[12], yp[12], zp[12], valp[12][9];
       for(int i = 0; i < nse; i++){
@@ -301,9 +341,8 @@ void GMSH_LevelsetPlugin::_cutAndAddElements(PViewData *vdata, PViewData *wdata,
           double c = InterpolateIso(x, y, z, levels, 0., n[n0], n[n1],
                                     &xp[np], &yp[np], &zp[np]);
           for(int comp = 0; comp < numComp; comp++){
-            double v0, v1;
-            wdata->getValue(otherstep, ent, ele, n[n0], comp, v0);
-            wdata->getValue(otherstep, ent, ele, n[n1], comp, v1);
+            double v0 = val[n[n0] * numComp + comp];
+            double v1 = val[n[n1] * numComp + comp];
             valp[np][comp] = v0 + c * (v1 - v0);
           }
           ep[np++] = i + 1;
@@ -331,7 +370,7 @@ void GMSH_LevelsetPlugin::_cutAndAddElements(PViewData *vdata, PViewData *wdata,
             yp[nod] = y[n[nod]];
             zp[nod] = z[n[nod]];
             for(int comp = 0; comp < numComp; comp++)
-              wdata->getValue(otherstep, ent, ele, n[nod], comp, valp[nod][comp]);
+              valp[nod][comp] = val[n[nod] * numComp + comp];
           }
           _addElement(nsn, nse, numComp, xp, yp, zp, valp, out, step == stepmin);
         }
@@ -359,23 +398,23 @@ void GMSH_LevelsetPlugin::_cutAndAddElements(PViewData *vdata, PViewData *wdata,
           prodve(v1, v2, normal);
           switch (_orientation) {
           case MAP:
-            gradSimplex(x, y, z, scalarValues, gr);
-            prosca(gr, normal, &_invert);
+            gradSimplex(x, y, z, e.scalarValues, gr);
+            prosca(gr, normal, &invert);
             break;
           case PLANE:
-            prosca(normal, _ref, &_invert);
+            prosca(normal, ref, &invert);
             break;
           case SPHERE:
-            gr[0] = xp[0] - _ref[0];
-            gr[1] = yp[0] - _ref[1];
-            gr[2] = zp[0] - _ref[2];
-            prosca(gr, normal, &_invert);
+            gr[0] = xp[0] - ref[0];
+            gr[1] = yp[0] - ref[1];
+            gr[2] = zp[0] - ref[2];
+            prosca(gr, normal, &invert);
           case NONE:
           default:
             break;
           }
         }
-        if(_invert > 0.) {
+        if(invert > 0.) {
           double xpi[12], ypi[12], zpi[12], valpi[12][9];
           int epi[12];
           for(int k = 0; k < np; k++)
@@ -397,7 +436,7 @@ void GMSH_LevelsetPlugin::_cutAndAddElements(PViewData *vdata, PViewData *wdata,
             yp[np] = y[n[nod]];
             zp[np] = z[n[nod]];
             for(int comp = 0; comp < numComp; comp++)
-              wdata->getValue(otherstep, ent, ele, n[nod], comp, valp[np][comp]);
+              valp[np][comp] = val[n[nod] * numComp + comp];
             ep[np] = -(nod + 1); // store node num!
             np++;
           }
@@ -416,12 +455,147 @@ void GMSH_LevelsetPlugin::_cutAndAddElements(PViewData *vdata, PViewData *wdata,
 
     }
 
-    if(vstep < 0){
-      for(int i = stepmin; i < stepmax; i++) {
-	out->Time.push_back(vdata->getTime(i));
+  }
+}
+
+void GMSH_LevelsetPlugin::_cutElements(PViewData *vdata, PViewData *wdata,
+                                       int vstep, int wstep, PViewDataList *out)
+{
+  // the elements are read at step "vstep"; if vstep < 0 the levelset does
+  // not depend on the values, and the elements (read at the first
+  // non-empty step) are cut at all the steps
+  int stepmin = vstep, stepmax = vstep + 1;
+  if(stepmin < 0){
+    stepmin = vdata->getFirstNonEmptyTimeStep();
+    stepmax = vdata->getNumTimeSteps();
+  }
+  if(stepmax <= stepmin) return;
+
+  // the values are taken at step "wstep", or at the same step as the
+  // elements if wstep < 0
+  bool valuesPerStep = (wstep < 0);
+  int numValueSteps = valuesPerStep ? stepmax - stepmin : 1;
+  int compStep = valuesPerStep ? wdata->getFirstNonEmptyTimeStep() : wstep;
+  std::vector<char> hasStep(stepmax - stepmin);
+  for(int step = stepmin; step < stepmax; step++)
+    hasStep[step - stepmin] = wdata->hasTimeStep(valuesPerStep ? step : wstep);
+
+  // the view data cannot be accessed concurrently: the elements are
+  // processed by blocks, whose nodes are first read sequentially (with
+  // getElementBlock()); the levelset is then evaluated in parallel, and the
+  // elements whose range of levels cannot contain the zero level are
+  // discarded; the values of the remaining elements are read sequentially,
+  // and the elements are finally cut in parallel, each thread adding the
+  // new elements to its own buffer
+  const int blockSize = 16384;
+  int numThreads = Msg::GetMaxThreads();
+  std::vector<PViewDataList*> buffers(numThreads);
+  for(int i = 0; i < numThreads; i++) buffers[i] = new PViewDataList();
+  elementBlock block;
+  std::vector<cutElement> elements;
+  std::vector<int> candidates;
+  std::vector<double> values;
+
+  for(int ent = 0; ent < vdata->getNumEntities(stepmin); ent++){
+    int numEle = vdata->getNumElements(stepmin, ent);
+    for(int first = 0; first < numEle; first += blockSize){
+      int last = std::min(first + blockSize, numEle);
+      elements.clear();
+      for(int ele = first; ele < last; ele += block.num){
+        if(!vdata->getElementBlock(stepmin, ent, ele, last - ele, block)) break;
+        if(block.numNodes > 8) continue; // can't deal with this
+        for(int i = 0; i < block.num; i++){
+          if(block.skip[i]) continue;
+          elements.push_back(cutElement());
+          cutElement &e(elements.back());
+          e.ent = ent;
+          e.ele = block.first + i;
+          e.numNodes = block.numNodes;
+          e.numEdges = block.numEdges;
+          e.type = block.type;
+          double *xyz = block.getXYZ(i), *val = block.getValues(i);
+          for(int nod = 0; nod < e.numNodes; nod++){
+            e.x[nod] = xyz[3 * nod];
+            e.y[nod] = xyz[3 * nod + 1];
+            e.z[nod] = xyz[3 * nod + 2];
+            e.scalarValues[nod] = 0.;
+            if(vstep >= 0)
+              e.scalarValues[nod] = (block.numComp == 1) ? val[nod] :
+                ComputeScalarRep(block.numComp, &val[block.numComp * nod]);
+          }
+        }
+      }
+
+      int numElements = elements.size();
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+      for(int i = 0; i < numElements; i++){
+        cutElement &e(elements[i]);
+        for(int nod = 0; nod < e.numNodes; nod++){
+          e.levels[nod] = levelset(e.x[nod], e.y[nod], e.z[nod],
+                                   e.scalarValues[nod]);
+          if(!nod || e.levels[nod] < e.min) e.min = e.levels[nod];
+          if(!nod || e.levels[nod] > e.max) e.max = e.levels[nod];
+        }
       }
+
+      candidates.clear();
+      values.clear();
+      for(int i = 0; i < numElements; i++){
+        cutElement &e(elements[i]);
+        if(!e.numNodes) continue;
+        // when extracting volumes the elements entirely on the chosen side
+        // are kept too
+        if(_extractVolume < 0 && e.min > 0.) continue;
+        if(_extractVolume > 0 && e.max < 0.) continue;
+        if(!_extractVolume && (e.min > 0. || e.max < 0.)) continue;
+        e.numComp = wdata->getNumComponents(compStep, e.ent, e.ele);
+        e.offset = values.size();
+        for(int s = 0; s < numValueSteps; s++){
+          int step = valuesPerStep ? stepmin + s : wstep;
+          for(int nod = 0; nod < e.numNodes; nod++){
+            for(int comp = 0; comp < e.numComp; comp++){
+              double val = 0.;
+              if(hasStep[s])
+                wdata->getValue(step, e.ent, e.ele, nod, comp, val);
+              values.push_back(val);
+            }
+          }
+        }
+        candidates.push_back(i);
+      }
+
+      int numCandidates = candidates.size();
+      if(!numCandidates) continue;
+      const double *v = values.empty() ? 0 : &values[0];
+#if defined(_OPENMP)
+#pragma omp parallel
+#endif
+      {
+        PViewDataList *buffer = buffers[Msg::GetThreadNum()];
+#if defined(_OPENMP)
+#pragma omp for schedule(static)
+#endif
+        for(int i = 0; i < numCandidates; i++){
+          cutElement &e(elements[candidates[i]]);
+          _cutAndAddElements(e, v + e.offset, stepmin, stepmax, valuesPerStep,
+                             hasStep, buffer);
+        }
+      }
+      // a static schedule gives each thread a contiguous range of
+      // elements, in thread order: appending the buffers in order gives
+      // the same output as a sequential loop
+      for(int i = 0; i < numThreads; i++)
+        appendLists(buffers[i], out);
     }
+  }
+
+  for(int i = 0; i < numThreads; i++) delete buffers[i];
 
+  if(vstep < 0){
+    for(int i = stepmin; i < stepmax; i++)
+      out->Time.push_back(vdata->getTime(i));
   }
 }
 
@@ -462,25 +636,11 @@ PView *GMSH_LevelsetPlugin::execute(PView *v)
   // Force creation of one view per time step if we have multi meshes
   if(vdata->hasMultipleMeshes()) _valueIndependent = 0;
 
-  double x[8], y[8], z[8], levels[8];
-  double scalarValues[8] = {0., 0., 0., 0., 0., 0., 0., 0.};
-
   if(_valueIndependent) {
     // create a single output view containing the (possibly
     // multi-step) levelset
-    int firstNonEmptyStep = vdata->getFirstNonEmptyTimeStep();
     PViewDataList *out = getDataList(new PView());
-    for(int ent = 0; ent < vdata->getNumEntities(firstNonEmptyStep); ent++){
-      for(int ele = 0; ele < vdata->getNumElements(firstNonEmptyStep, ent); ele++){
-        if(vdata->skipElement(firstNonEmptyStep, ent, ele)) continue;
-        for(int nod = 0; nod < vdata->getNumNodes(firstNonEmptyStep, ent, ele); nod++){
-          vdata->getNode(firstNonEmptyStep, ent, ele, nod, x[nod], y[nod], z[nod]);
-          levels[nod] = levelset(x[nod], y[nod], z[nod], 0.);
-        }
-        _cutAndAddElements(vdata, wdata, ent, ele, -1, _valueTimeStep, x, y, z,
-                           levels, scalarValues, out);
-      }
-    }
+    _cutElements(vdata, wdata, -1, _valueTimeStep, out);
     out->setName(vdata->getName() + "_Levelset");
     out->setFileName(vdata->getFileName() + "_Levelset.pos");
     out->finalize();
@@ -490,19 +650,8 @@ PView *GMSH_LevelsetPlugin::execute(PView *v)
     for(int step = 0; step < vdata->getNumTimeSteps(); step++){
       if(!vdata->hasTimeStep(step)) continue;
       PViewDataList *out = getDataList(new PView());
-      for(int ent = 0; ent < vdata->getNumEntities(step); ent++){
-        for(int ele = 0; ele < vdata->getNumElements(step, ent); ele++){
-          if(vdata->skipElement(step, ent, ele)) continue;
-          for(int nod = 0; nod < vdata->getNumNodes(step, ent, ele); nod++){
-            vdata->getNode(step, ent, ele, nod, x[nod], y[nod], z[nod]);
-            vdata->getScalarValue(step, ent, ele, nod, scalarValues[nod]);
-            levels[nod] = levelset(x[nod], y[nod], z[nod], scalarValues[nod]);
-          }
-          int wstep = (_valueTimeStep < 0) ? step : _valueTimeStep;
-          _cutAndAddElements(vdata, wdata, ent, ele, step, wstep, x, y, z,
-                             levels, scalarValues, out);
-        }
-      }
+      int wstep = (_valueTimeStep < 0) ? step : _valueTimeStep;
+      _cutElements(vdata, wdata, step, wstep, out);
       char tmp[246];
       sprintf(tmp, "_Levelset_%d", step);
       out->setName(vdata->getName() + tmp);
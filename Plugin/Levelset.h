@@ -11,16 +11,19 @@
 class GMSH_LevelsetPlugin : public GMSH_PostPlugin
 {
  private:
-  double _invert;
+  // the nodes, levels and value type of an element to cut, read from the
+  // views beforehand so that the elements can be cut concurrently
+  struct cutElement;
   void _addElement(int np, int numEdges, int numComp,
                    double xp[12], double yp[12], double zp[12],
                    double valp[12][9], PViewDataList *out,
-                   bool firstStep);
-  void _cutAndAddElements(PViewData *vdata, PViewData *wdata,
-                          int ent, int ele, int step, int wstep,
-                          double x[8], double y[8], double z[8],
-                          double levels[8], double scalarValues[8],
-                          PViewDataList *out);
+                   bool firstStep) const;
+  void _cutAndAddElements(cutElement &e, const double *values,
+                          int stepmin, int stepmax, bool valuesPerStep,
+                          const std::vector<char> &hasStep,
+                          PViewDataList *out) const;
+  void _cutElements(PViewData *vdata, PViewData *wdata, int vstep, int wstep,
+                    PViewDataList *out);
  protected:
   double _ref[3], _targetError;
   int _valueTimeStep, _valueView, _valueIndependent, _recurLevel, _extractVolume;
@@ -28,6 +31,7 @@ class GMSH_LevelsetPlugin : public GMSH_PostPlugin
   ORIENTATION _orientation;
  public:
   GMSH_LevelsetPlugin();
+  // (called concurrently on the nodes of the elements)
   virtual double levelset(double x, double y, double z, double val) const = 0;
   virtual PView *execute(PView *);
   void assignSpecificVisibility() const;
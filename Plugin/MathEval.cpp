@@ -208,6 +208,8 @@ PView *GMSH_MathEvalPlugin::execute(PView *view)
       std::vector<double> v(std::max(9, numComp), 0.);
       std::vector<double> w(std::max(9, otherNumComp), 0.);
       std::vector<double> x(numNodes), y(numNodes), z(numNodes);
+      std::vector<double> allValues(numNodes * numVariables, 0.);
+      std::vector<double> allRes(numNodes * numComp2);
       for(int nod = 0; nod < numNodes; nod++)
         data1->getNode(timeBeg, ent, ele, nod, x[nod], y[nod], z[nod]);
       for(int nod = 0; nod < numNodes; nod++) out->push_back(x[nod]);
@@ -233,9 +235,19 @@ PView *GMSH_MathEvalPlugin::execute(PView *view)
               for(int comp = 0; comp < otherNumComp; comp++)
                 otherData->getValue(step2, ent, ele, nod, comp, w[comp]);
           }
+          double *values = &allValues[nod * numVariables];
           values[0] = x[nod]; values[1] = y[nod]; values[2] = z[nod];
           for(int i = 0; i < 9; i++) values[3 + i] = v[i];
           for(int i = 0; i < 9; i++) values[12 + i] = w[i];
+        }
+        // evaluate all the nodes at once, and node by node on error
+        if(f.eval(numNodes, &allValues[0], &allRes[0])){
+          out->insert(out->end(), allRes.begin(), allRes.end());
+          continue;
+        }
+        for(int nod = 0; nod < numNodes; nod++){
+          values.assign(allValues.begin() + nod * numVariables,
+                        allValues.begin() + (nod + 1) * numVariables);
           if(f.eval(values, res))
             for(int i = 0; i < numComp2; i++)
               out->push_back(res[i]);
@@ -5,6 +5,7 @@
 
 #include "MinMax.h"
 #include "PViewOptions.h"
+#include "Numeric.h"
 
 StringXNumber MinMaxOptions_Number[] = {
   {GMSH_FULLRC, "View", NULL, -1.},
@@ -73,21 +74,28 @@ PView *GMSH_MinMaxPlugin::execute(PView * v)
       //minView=data1->getMin(step); 
       //maxView=data1->getMax(step);
  
+      elementBlock block;
       for(int ent = 0; ent < data1->getNumEntities(step); ent++){
-	for(int ele = 0; ele < data1->getNumElements(step, ent); ele++){
-	  for(int nod = 0; nod < data1->getNumNodes(step, ent, ele); nod++){
-	    double val;
-	    data1->getScalarValue(step, ent, ele, nod, val);
-	    if(val<minView){
-	      data1->getNode(step, ent, ele, nod, xmin, ymin, zmin);
-	      minView=val;
-	    }
-	    if(val>maxView){
-	      data1->getNode(step, ent, ele, nod, xmax, ymax, zmax);
-	      maxView=val;
-	    }
-	  }
-	}
+        int numEle = data1->getNumElements(step, ent);
+        for(int first = 0; first < numEle; first += block.num){
+          if(!data1->getElementBlock(step, ent, first, 1024, block)) break;
+          for(int ele = 0; ele < block.num; ele++){
+            if(block.skip[ele]) continue;
+            double *xyz = block.getXYZ(ele), *v = block.getValues(ele);
+            for(int nod = 0; nod < block.numNodes; nod++){
+              double val = (block.numComp == 1) ? v[nod] :
+                ComputeScalarRep(block.numComp, &v[block.numComp * nod]);
+              if(val<minView){
+                xmin = xyz[3 * nod]; ymin = xyz[3 * nod + 1]; zmin = xyz[3 * nod + 2];
+                minView=val;
+              }
+              if(val>maxView){
+                xmax = xyz[3 * nod]; ymax = xyz[3 * nod + 1]; zmax = xyz[3 * nod + 2];
+                maxView=val;
+              }
+            }
+          }
+        }
       }
       if(!overTime){ 
 	// one stores min/max and at each time step 
@@ -244,32 +244,43 @@ PView *GMSH_ParticlesPlugin::execute(PView *v)
   double c3 = (-A2 - (gamma - 1) * DT * A1 - (0.5 - gamma + beta) * DT * DT * A0);
   double c4 = DT * DT * (beta + (0.5 + gamma - 2 * beta) + (0.5 - gamma + beta));
 
-  for(int i = 0; i < getNbU(); ++i){
-    for(int j = 0; j < getNbV(); ++j){
-      double XINIT[3], X0[3], X1[3];
-      getPoint(i, j, XINIT);
-      getPoint(i, j, X0);
-      getPoint(i, j, X1);
-      data2->NbVP++;
-      data2->VP.push_back(XINIT[0]);
-      data2->VP.push_back(XINIT[1]);
-      data2->VP.push_back(XINIT[2]);
-      for(int iter = 0; iter < maxIter; iter++){
-        double F[3], X[3];
-        o1.searchVector(X1[0], X1[1], X1[2], F, timeStep);
-        for(int k = 0; k < 3; k++)
-          X[k] = (c2 * X1[k] + c3 * X0[k] + c4 * F[k]) / c1;
-        data2->VP.push_back(X[0] - XINIT[0]);
-        data2->VP.push_back(X[1] - XINIT[1]);
-        data2->VP.push_back(X[2] - XINIT[2]);
-        for(int k = 0; k < 3; k++){
-          X0[k] = X1[k];
-          X1[k] = X[k];
-        }        
+  // the trajectories are computed in parallel, and then added to the view
+  // in the order of the initial points
+  int numSeeds = getNbU() * getNbV();
+  std::vector<std::vector<double> > DX(numSeeds);
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for(int i = 0; i < numSeeds; i++){
+    double XINIT[3], X0[3], X1[3];
+    getPoint(i / getNbV(), i % getNbV(), XINIT);
+    getPoint(i / getNbV(), i % getNbV(), X0);
+    getPoint(i / getNbV(), i % getNbV(), X1);
+    DX[i].resize(3 * maxIter);
+    void *hint = 0;
+    for(int iter = 0; iter < maxIter; iter++){
+      double F[3], X[3];
+      o1.searchVectorWithHint(X1[0], X1[1], X1[2], F, timeStep, &hint);
+      for(int k = 0; k < 3; k++)
+        X[k] = (c2 * X1[k] + c3 * X0[k] + c4 * F[k]) / c1;
+      for(int k = 0; k < 3; k++){
+        DX[i][3 * iter + k] = X[k] - XINIT[k];
+        X0[k] = X1[k];
+        X1[k] = X[k];
       }
     }
   }
 
+  for(int i = 0; i < numSeeds; i++){
+    double XINIT[3];
+    getPoint(i / getNbV(), i % getNbV(), XINIT);
+    data2->NbVP++;
+    data2->VP.push_back(XINIT[0]);
+    data2->VP.push_back(XINIT[1]);
+    data2->VP.push_back(XINIT[2]);
+    data2->VP.insert(data2->VP.end(), DX[i].begin(), DX[i].end());
+  }
+
   v2->getOptions()->vectorType = PViewOptions::Displacement;
 
   data2->setName(data1->getName() + "_Particles");
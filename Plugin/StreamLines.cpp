@@ -4,6 +4,7 @@
 // bugs and problems to the public mailing list <gmsh@geuz.org>.
 
 #include <math.h>
+#include <algorithm>
 #include "GmshConfig.h"
 #include "StreamLines.h"
 #include "OctreePost.h"
@@ -30,7 +31,8 @@ StringXNumber StreamLinesOptions_Number[] = {
   {GMSH_FULLRC, "MaxIter", NULL, 100},
   {GMSH_FULLRC, "TimeStep", NULL, 0},
   {GMSH_FULLRC, "View", NULL, -1.},
-  {GMSH_FULLRC, "OtherView", NULL, -1.}
+  {GMSH_FULLRC, "OtherView", NULL, -1.},
+  {GMSH_FULLRC, "Tolerance", NULL, 0.}
 };
 
 extern "C"
@@ -155,6 +157,12 @@ std::string GMSH_StreamLinesPlugin::getHelp() const
     "on the vector view.\n\n"
     "The time stepping scheme is a RK44 with step size "
     "`DT' and `MaxIter' maximum number of iterations.\n\n"
+    "If `Tolerance' > 0 and `TimeStep' >= 0, the time "
+    "step is instead adapted with an embedded RK45 "
+    "scheme so that the local error on the position "
+    "stays below `Tolerance', which requires fewer "
+    "evaluations of the velocity where it varies slowly "
+    "(the stream lines are still sampled every `DT').\n\n"
     "If `TimeStep' < 0, the plugin tries to compute "
     "streamlines of the unsteady flow.\n\n"
     "If `View' < 0, the plugin is run on the current view.\n\n"
@@ -198,6 +206,114 @@ void GMSH_StreamLinesPlugin::getPoint(int iU, int iV, double *X)
     v  * (StreamLinesOptions_Number[8].def - StreamLinesOptions_Number[2].def);
 }
 
+static void getVelocity(OctreePost &o, int step, const double X[3], double *V,
+                        void **hint)
+{
+  o.searchVectorWithHint(X[0], X[1], X[2], V, step, hint);
+}
+
+// integrate dX/dt = V from XINIT with a RK44 scheme: the positions after
+// each of the "maxIter" steps are stored in "X", after XINIT
+static void streamLineRK44(OctreePost &o, const double XINIT[3], double DT,
+                           int maxIter, const std::vector<int> &timeSteps,
+                           std::vector<double> &X)
+{
+  // X1 = X + a1 * DT * V(X)
+  // X2 = X + a2 * DT * V(X1)
+  // X3 = X + a3 * DT * V(X2)
+  // X4 = X + a4 * DT * V(X3)
+  // X = X + b1 X1 + b2 X2 + b3 X3 + b4 x4
+  const double b1 = 1. / 3., b2 = 2. / 3., b3 = 1. / 3., b4 = 1. / 6.;
+  const double a1 = 0.5, a2 = 0.5, a3 = 1., a4 = 1.;
+  double P[3] = {XINIT[0], XINIT[1], XINIT[2]}, X1[3], X2[3], X3[3], X4[3];
+  double val[3];
+  void *hint = 0;
+  X.resize(3 * (maxIter + 1));
+  for(int k = 0; k < 3; k++) X[k] = P[k];
+  for(int iter = 0; iter < maxIter; iter++){
+    int step = timeSteps[iter];
+    getVelocity(o, step, P, val, &hint);
+    for(int k = 0; k < 3; k++) X1[k] = P[k] + DT * val[k] * a1;
+    getVelocity(o, step, X1, val, &hint);
+    for(int k = 0; k < 3; k++) X2[k] = P[k] + DT * val[k] * a2;
+    getVelocity(o, step, X2, val, &hint);
+    for(int k = 0; k < 3; k++) X3[k] = P[k] + DT * val[k] * a3;
+    getVelocity(o, step, X3, val, &hint);
+    for(int k = 0; k < 3; k++) X4[k] = P[k] + DT * val[k] * a4;
+    for(int k = 0; k < 3; k++)
+      P[k] += (b1 * (X1[k] - P[k]) + b2 * (X2[k] - P[k]) +
+               b3 * (X3[k] - P[k]) + b4 * (X4[k] - P[k]));
+    for(int k = 0; k < 3; k++) X[3 * (iter + 1) + k] = P[k];
+  }
+}
+
+// same as above for a steady velocity field, with the embedded RK45 scheme
+// of Dormand and Prince: the step size is adapted to keep the local error
+// below "tol", and the positions every DT are interpolated with cubic
+// Hermite polynomials
+static void streamLineRK45(OctreePost &o, const double XINIT[3], double DT,
+                           int maxIter, int step, double tol,
+                           std::vector<double> &X)
+{
+  static const double c[7][6] = {
+    {0., 0., 0., 0., 0., 0.},
+    {1. / 5., 0., 0., 0., 0., 0.},
+    {3. / 40., 9. / 40., 0., 0., 0., 0.},
+    {44. / 45., -56. / 15., 32. / 9., 0., 0., 0.},
+    {19372. / 6561., -25360. / 2187., 64448. / 6561., -212. / 729., 0., 0.},
+    {9017. / 3168., -355. / 33., 46732. / 5247., 49. / 176., -5103. / 18656., 0.},
+    {35. / 384., 0., 500. / 1113., 125. / 192., -2187. / 6784., 11. / 84.}};
+  // difference between the 5th and the 4th order solutions
+  static const double e[7] = {71. / 57600., 0., -71. / 16695., 71. / 1920.,
+                              -17253. / 339200., 22. / 525., -1. / 40.};
+  const double T = DT * maxIter, hmin = 1.e-6 * DT;
+  double P[3] = {XINIT[0], XINIT[1], XINIT[2]}, K[7][3], Y[3];
+  double t = 0., h = DT;
+  void *hint = 0;
+  X.resize(3 * (maxIter + 1));
+  for(int k = 0; k < 3; k++) X[k] = P[k];
+  int next = 1;
+  getVelocity(o, step, P, K[0], &hint);
+  while(next <= maxIter){
+    h = std::min(h, T - t);
+    if(h <= 0.) break;
+    for(int s = 1; s < 7; s++){
+      for(int k = 0; k < 3; k++){
+        Y[k] = P[k];
+        for(int j = 0; j < s; j++) Y[k] += h * c[s][j] * K[j][k];
+      }
+      getVelocity(o, step, Y, K[s], &hint);
+    }
+    double err = 0.;
+    for(int k = 0; k < 3; k++){
+      double ek = 0.;
+      for(int s = 0; s < 7; s++) ek += e[s] * K[s][k];
+      err = std::max(err, fabs(h * ek));
+    }
+    if(err <= tol || h <= hmin){
+      // Y is the 5th order solution at t + h, and K[6] the velocity there
+      while(next <= maxIter && next * DT <= t + h * (1. + 1.e-12)){
+        double th = (next * DT - t) / h, th2 = th * th, th3 = th2 * th;
+        double h00 = 2. * th3 - 3. * th2 + 1., h10 = th3 - 2. * th2 + th;
+        double h01 = -2. * th3 + 3. * th2, h11 = th3 - th2;
+        for(int k = 0; k < 3; k++)
+          X[3 * next + k] = h00 * P[k] + h10 * h * K[0][k] + h01 * Y[k] +
+            h11 * h * K[6][k];
+        next++;
+      }
+      t += h;
+      for(int k = 0; k < 3; k++){
+        P[k] = Y[k];
+        K[0][k] = K[6][k];
+      }
+    }
+    double f = (err > 0.) ? 0.9 * pow(tol / err, 0.2) : 5.;
+    h = std::max(hmin, h * std::min(5., std::max(0.2, f)));
+  }
+  for(; next <= maxIter; next++)
+    for(int k = 0; k < 3; k++) X[3 * next + k] = P[k];
+}
+
 PView *GMSH_StreamLinesPlugin::execute(PView *v)
 {
   double DT = StreamLinesOptions_Number[11].def;
@@ -205,6 +321,7 @@ PView *GMSH_StreamLinesPlugin::execute(PView *v)
   int timeStep = (int)StreamLinesOptions_Number[13].def;
   int iView = (int)StreamLinesOptions_Number[14].def;
   int otherView = (int)StreamLinesOptions_Number[15].def;
+  double tol = StreamLinesOptions_Number[16].def;
 
   PView *v1 = getView(iView, v);
   if(!v1) return v;
@@ -220,97 +337,81 @@ PView *GMSH_StreamLinesPlugin::execute(PView *v)
   }
 
   OctreePost o1(v1);
-  double *val2 = 0;
-  OctreePost *o2 = 0;
-  if(data2){
-    val2 = new double[data2->getNumTimeSteps()];
-    o2 = new OctreePost(v2);
-  }
+  OctreePost *o2 = data2 ? new OctreePost(v2) : 0;
+  int numSteps2 = data2 ? data2->getNumTimeSteps() : 0;
 
   PView *v3 = new PView();
   PViewDataList *data3 = getDataList(v3);
 
-  const double b1 = 1. / 3., b2 = 2. / 3., b3 = 1. / 3., b4 = 1. / 6.;
-  const double a1 = 0.5, a2 = 0.5, a3 = 1., a4 = 1.;
-  double XINIT[3], X[3], DX[3], X1[3], X2[3], X3[3], X4[3];
+  // the time step of the velocity field used in each iteration
+  std::vector<int> timeSteps(maxIter, timeStep);
+  if(timeStep < 0){
+    int currentTimeStep = 0;
+    for(int iter = 0; iter < maxIter; iter++){
+      double currentT = data1->getTime(0) + DT * iter;
+      for(; currentTimeStep < data1->getNumTimeSteps() - 1 &&
+            currentT > 0.5 * (data1->getTime(currentTimeStep) +
+                              data1->getTime(currentTimeStep + 1));
+          currentTimeStep++);
+      timeSteps[iter] = currentTimeStep;
+    }
+  }
 
-  for(int i = 0; i < getNbU(); ++i){
-    for(int j = 0; j < getNbV(); ++j){
-      getPoint(i, j, XINIT);
-      getPoint(i, j, X);
-          
+  // the stream lines are computed in parallel, and then added to the view in
+  // the order of the seed points
+  int numSeeds = getNbU() * getNbV();
+  std::vector<std::vector<double> > X(numSeeds), val2(numSeeds);
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for(int i = 0; i < numSeeds; i++){
+    double XINIT[3];
+    getPoint(i / getNbV(), i % getNbV(), XINIT);
+    if(tol > 0. && timeStep >= 0)
+      streamLineRK45(o1, XINIT, DT, maxIter, timeStep, tol, X[i]);
+    else
+      streamLineRK44(o1, XINIT, DT, maxIter, timeSteps, X[i]);
+    if(o2){
+      void *hint = 0;
+      val2[i].resize(numSteps2 * (maxIter + 1));
+      for(int iter = 0; iter <= maxIter; iter++)
+        o2->searchScalarWithHint(X[i][3 * iter], X[i][3 * iter + 1],
+                                 X[i][3 * iter + 2], &val2[i][numSteps2 * iter],
+                                 -1, &hint);
+    }
+  }
+
+  for(int i = 0; i < numSeeds; i++){
+    const double *XINIT = &X[i][0];
+    if(!data2){
+      data3->NbVP++;
+      data3->VP.push_back(XINIT[0]);
+      data3->VP.push_back(XINIT[1]);
+      data3->VP.push_back(XINIT[2]);
+    }
+    for(int iter = 0; iter < maxIter; iter++){
+      if(timeStep < 0)
+        data3->Time.push_back(data1->getTime(0) + DT * iter);
+      const double *XPREV = &X[i][3 * iter], *XCUR = &X[i][3 * (iter + 1)];
       if(data2){
-        o2->searchScalar(X[0], X[1], X[2], val2, -1);
+        data3->NbSL++;
+        data3->SL.push_back(XPREV[0]); data3->SL.push_back(XCUR[0]);
+        data3->SL.push_back(XPREV[1]); data3->SL.push_back(XCUR[1]);
+        data3->SL.push_back(XPREV[2]); data3->SL.push_back(XCUR[2]);
+        for(int k = 0; k < numSteps2; k++)
+          data3->SL.push_back(val2[i][numSteps2 * iter + k]);
+        for(int k = 0; k < numSteps2; k++)
+          data3->SL.push_back(val2[i][numSteps2 * (iter + 1) + k]);
       }
       else{
-        data3->NbVP++;
-        data3->VP.push_back(X[0]);
-        data3->VP.push_back(X[1]);
-        data3->VP.push_back(X[2]);
-      }
-
-      int currentTimeStep = 0;
-
-      for(int iter = 0; iter < maxIter; iter++){
-
-        double XPREV[3] = {X[0], X[1], X[2]};
-
-        if(timeStep < 0){
-          double T0 = data1->getTime(0);
-          double currentT = T0 + DT * iter;
-          data3->Time.push_back(currentT);
-          for(; currentTimeStep < data1->getNumTimeSteps() - 1 && 
-                currentT > 0.5 * (data1->getTime(currentTimeStep) + 
-                                  data1->getTime(currentTimeStep + 1));
-          currentTimeStep++);
-        }
-        else{
-          currentTimeStep = timeStep;
-        }
-
-        // dX/dt = V
-        // X1 = X + a1 * DT * V(X)
-        // X2 = X + a2 * DT * V(X1)
-        // X3 = X + a3 * DT * V(X2)
-        // X4 = X + a4 * DT * V(X3)
-        // X = X + b1 X1 + b2 X2 + b3 X3 + b4 x4
-        double val[3];
-        o1.searchVector(X[0], X[1], X[2], val, currentTimeStep);
-        for(int k = 0; k < 3; k++) X1[k] = X[k] + DT * val[k] * a1;
-        o1.searchVector(X1[0], X1[1], X1[2], val, currentTimeStep);
-        for(int k = 0; k < 3; k++) X2[k] = X[k] + DT * val[k] * a2;
-        o1.searchVector(X2[0], X2[1], X2[2], val, currentTimeStep);
-        for(int k = 0; k < 3; k++) X3[k] = X[k] + DT * val[k] * a3;
-        o1.searchVector(X3[0], X3[1], X3[2], val, currentTimeStep);
-        for(int k = 0; k < 3; k++) X4[k] = X[k] + DT * val[k] * a4;
-
-        for(int k = 0; k < 3; k++) 
-          X[k] += (b1 * (X1[k] - X[k]) + b2 * (X2[k] - X[k]) + 
-                   b3 * (X3[k] - X[k]) + b4 * (X4[k] - X[k]));
-        for(int k = 0; k < 3; k++) DX[k] = X[k] - XINIT[k];
-
-        if(data2){
-          data3->NbSL++;
-          data3->SL.push_back(XPREV[0]); data3->SL.push_back(X[0]);
-          data3->SL.push_back(XPREV[1]); data3->SL.push_back(X[1]);
-          data3->SL.push_back(XPREV[2]); data3->SL.push_back(X[2]);
-          for(int k = 0; k < data2->getNumTimeSteps(); k++)
-            data3->SL.push_back(val2[k]);
-          o2->searchScalar(X[0], X[1], X[2], val2, -1);
-          for(int k = 0; k < data2->getNumTimeSteps(); k++)
-            data3->SL.push_back(val2[k]);
-        }
-        else{
-          data3->VP.push_back(DX[0]);
-          data3->VP.push_back(DX[1]);
-          data3->VP.push_back(DX[2]);
-        }
+        data3->VP.push_back(XCUR[0] - XINIT[0]);
+        data3->VP.push_back(XCUR[1] - XINIT[1]);
+        data3->VP.push_back(XCUR[2] - XINIT[2]);
       }
     }
   }
 
   if(data2){
-    delete [] val2;
     delete o2;
   }
   else{
@@ -3,8 +3,10 @@
 // See the LICENSE.txt file for license information. Please report all
 // bugs and problems to the public mailing list <gmsh@geuz.org>.
 
-#include "Octree.h"
+#include <set>
+#include <algorithm>
 #include "OctreePost.h"
+#include "BoundingVolumeHierarchy.h"
 #include "PView.h"
 #include "PViewData.h"
 #include "PViewDataList.h"
@@ -16,225 +18,11 @@
 #include "MElement.h"
 #include "Context.h"
 
-// helper routines for list-based views
-
-static void minmax(int n, double *X, double *Y, double *Z,
-                   double *min, double *max)
-{
-  min[0] = X[0];
-  min[1] = Y[0];
-  min[2] = Z[0];
-  max[0] = X[0];
-  max[1] = Y[0];
-  max[2] = Z[0];
-  for(int i = 1; i < n; i++) {
-    min[0] = (X[i] < min[0]) ? X[i] : min[0];
-    min[1] = (Y[i] < min[1]) ? Y[i] : min[1];
-    min[2] = (Z[i] < min[2]) ? Z[i] : min[2];
-    max[0] = (X[i] > max[0]) ? X[i] : max[0];
-    max[1] = (Y[i] > max[1]) ? Y[i] : max[1];
-    max[2] = (Z[i] > max[2]) ? Z[i] : max[2];
-  }
-
-  // make bounding boxes larger up to (absolute) geometrical tolerance
-  double eps = CTX::instance()->geom.tolerance;
-  for(int i = 0; i < 3; i++){
-    min[i] -= eps;
-    max[i] += eps;
-  }
-}
-
-static void centroid(int n, double *X, double *Y, double *Z, double *c)
-{
-  const double oc = 1./(double)n;
-  c[0] = X[0];
-  c[1] = Y[0];
-  c[2] = Z[0];
-  for(int i = 1; i < n; i++) {
-    c[0] += X[i];
-    c[1] += Y[i];
-    c[2] += Z[i];
-  }
-  c[0] *= oc;
-  c[1] *= oc;
-  c[2] *= oc;
-}
-
-static void pntBB(void *a, double *min, double *max)
-{
-  double *X = (double*) a, *Y = &X[1], *Z = &X[2];
-  minmax(1, X, Y, Z, min, max);
-}
-
-static void linBB(void *a, double *min, double *max)
-{
-  double *X = (double*) a, *Y = &X[2], *Z = &X[4];
-  minmax(2, X, Y, Z, min, max);
-}
-
-static void triBB(void *a, double *min, double *max)
-{
-  double *X = (double*) a, *Y = &X[3], *Z = &X[6];
-  minmax(3, X, Y, Z, min, max);
-}
-
-static void quaBB(void *a, double *min, double *max)
-{
-  double *X = (double*) a, *Y = &X[4], *Z = &X[8];
-  minmax(4, X, Y, Z, min, max);
-}
-
-static void tetBB(void *a, double *min, double *max)
-{
-  double *X = (double*) a, *Y = &X[4], *Z = &X[8];
-  minmax(4, X, Y, Z, min, max);
-}
-
-static void hexBB(void *a, double *min, double *max)
-{
-  double *X = (double*) a, *Y = &X[8], *Z = &X[16];
-  minmax(8, X, Y, Z, min, max);
-}
-
-static void priBB(void *a, double *min, double *max)
-{
-  double *X = (double*) a, *Y = &X[6], *Z = &X[12];
-  minmax(6, X, Y, Z, min, max);
-}
-
-static void pyrBB(void *a, double *min, double *max)
-{
-  double *X = (double*) a, *Y = &X[5], *Z = &X[10];
-  minmax(5, X, Y, Z, min, max);
-}
-
-static int pntInEle(void *a, double *x)
-{
-  return 1;
-}
-
-static int linInEle(void *a, double *x)
-{
-  double *X = (double*) a, *Y = &X[2], *Z = &X[4], uvw[3];
-  line lin(X, Y, Z);
-  lin.xyz2uvw(x, uvw);
-  return lin.isInside(uvw[0], uvw[1], uvw[2]);
-}
-
-static int triInEle(void *a, double *x)
-{
-  double *X = (double*) a, *Y = &X[3], *Z = &X[6], uvw[3];
-  triangle tri(X, Y, Z);
-  tri.xyz2uvw(x, uvw);
-  return tri.isInside(uvw[0], uvw[1], uvw[2]);
-}
-
-static int quaInEle(void *a, double *x)
-{
-  double *X = (double*) a, *Y = &X[4], *Z = &X[8], uvw[3];
-  quadrangle qua(X, Y, Z);
-  qua.xyz2uvw(x, uvw);
-  return qua.isInside(uvw[0], uvw[1], uvw[2]);
-}
-
-static int tetInEle(void *a, double *x)
-{
-  double *X = (double*) a, *Y = &X[4], *Z = &X[8], uvw[3];
-  tetrahedron tet(X, Y, Z);
-  tet.xyz2uvw(x, uvw);
-  return tet.isInside(uvw[0], uvw[1], uvw[2]);
-}
-
-static int hexInEle(void *a, double *x)
-{
-  double *X = (double*) a, *Y = &X[8], *Z = &X[16], uvw[3];
-  hexahedron hex(X, Y, Z);
-  hex.xyz2uvw(x, uvw);
-  return hex.isInside(uvw[0], uvw[1], uvw[2]);
-}
-
-static int priInEle(void *a, double *x)
-{
-  double *X = (double*) a, *Y = &X[6], *Z = &X[12], uvw[3];
-  prism pri(X, Y, Z);
-  pri.xyz2uvw(x, uvw);
-  return pri.isInside(uvw[0], uvw[1], uvw[2]);
-}
-
-static int pyrInEle(void *a, double *x)
-{
-  double *X = (double*) a, *Y = &X[5], *Z = &X[10], uvw[3];
-  pyramid pyr(X, Y, Z);
-  pyr.xyz2uvw(x, uvw);
-  return pyr.isInside(uvw[0], uvw[1], uvw[2]);
-}
-
-static void pntCentroid(void *a, double *x)
-{
-  double *X = (double*) a, *Y = &X[1], *Z = &X[2];
-  centroid(1, X, Y, Z, x);
-}
-
-static void linCentroid(void *a, double *x)
-{
-  double *X = (double*) a, *Y = &X[2], *Z = &X[4];
-  centroid(2, X, Y, Z, x);
-}
-
-static void triCentroid(void *a, double *x)
-{
-  double *X = (double*) a, *Y = &X[3], *Z = &X[6];
-  centroid(3, X, Y, Z, x);
-}
-
-static void quaCentroid(void *a, double *x)
-{
-  double *X = (double*) a, *Y = &X[4], *Z = &X[8];
-  centroid(4, X, Y, Z, x);
-}
-
-static void tetCentroid(void *a, double *x)
-{
-  double *X = (double*) a, *Y = &X[4], *Z = &X[8];
-  centroid(4, X, Y, Z, x);
-}
-
-static void hexCentroid(void *a, double *x)
-{
-  double *X = (double*) a, *Y = &X[8], *Z = &X[16];
-  centroid(8, X, Y, Z, x);
-}
-
-static void priCentroid(void *a, double *x)
-{
-  double *X = (double*) a, *Y = &X[6], *Z = &X[12];
-  centroid(6, X, Y, Z, x);
-}
-
-static void pyrCentroid(void *a, double *x)
-{
-  double *X = (double*) a, *Y = &X[5], *Z = &X[10];
-  centroid(5, X, Y, Z, x);
-}
-
-static void addListOfStuff(Octree *o, std::vector<double> &l, int nbelm)
-{
-  for(unsigned int i = 0; i < l.size(); i += nbelm)
-    Octree_Insert(&l[i], o);
-}
-
 // OctreePost implementation
 
 OctreePost::~OctreePost()
 {
-  Octree_Delete(_SPP); Octree_Delete(_VPP); Octree_Delete(_TPP);
-  Octree_Delete(_SL); Octree_Delete(_VL); Octree_Delete(_TL);
-  Octree_Delete(_ST); Octree_Delete(_VT); Octree_Delete(_TT);
-  Octree_Delete(_SQ); Octree_Delete(_VQ); Octree_Delete(_TQ);
-  Octree_Delete(_SS); Octree_Delete(_VS); Octree_Delete(_TS);
-  Octree_Delete(_SH); Octree_Delete(_VH); Octree_Delete(_TH);
-  Octree_Delete(_SI); Octree_Delete(_VI); Octree_Delete(_TI);
-  Octree_Delete(_SY); Octree_Delete(_VY); Octree_Delete(_TY);
+  delete _bvh;
 }
 
 OctreePost::OctreePost(PView *v)
@@ -247,17 +35,62 @@ OctreePost::OctreePost(PViewData *data)
   _create(data);
 }
 
+void OctreePost::_addList(std::vector<double> &l, int nbNod, int dim, int nbComp,
+                          int rank, std::vector<double> &boxes)
+{
+  int stride = 3 * nbNod + nbNod * nbComp * _theViewDataList->getNumTimeSteps();
+  // make bounding boxes larger up to (absolute) geometrical tolerance
+  double eps = CTX::instance()->geom.tolerance;
+  for(unsigned int i = 0; i + stride <= l.size(); i += stride){
+    double *X = &l[i], *Y = &X[nbNod], *Z = &X[2 * nbNod];
+    double min[3] = {X[0], Y[0], Z[0]}, max[3] = {X[0], Y[0], Z[0]};
+    for(int j = 1; j < nbNod; j++){
+      min[0] = std::min(min[0], X[j]); max[0] = std::max(max[0], X[j]);
+      min[1] = std::min(min[1], Y[j]); max[1] = std::max(max[1], Y[j]);
+      min[2] = std::min(min[2], Z[j]); max[2] = std::max(max[2], Z[j]);
+    }
+    for(int j = 0; j < 3; j++) boxes.push_back(min[j] - eps);
+    for(int j = 0; j < 3; j++) boxes.push_back(max[j] + eps);
+    postElement e = {X, nbNod, dim, nbComp, rank};
+    _elements.push_back(e);
+    _minRank[nbComp] = std::min(_minRank[nbComp], rank);
+  }
+}
+
 void OctreePost::_create(PViewData *data)
 {
-  _SPP = _VPP = _TPP = _SL = _VL = _TL = _ST = _VT = _TT = 0;
-  _SQ = _VQ = _TQ = _SS = _VS = _TS = _SH = _VH = _TH = 0;
-  _SI = _VI = _TI = _SY = _VY = _TY = 0;
+  _bvh = 0;
   _theViewDataList = 0;
   _theViewDataGModel = 0;
+  for(int i = 0; i < 10; i++) _minRank[i] = 8;
 
   _theViewDataGModel = dynamic_cast<PViewDataGModel*>(data);
 
-  if(_theViewDataGModel) return; // the octree is already available in the model
+  if(_theViewDataGModel){
+    // the octree is already available in the model: make sure it is
+    // created now, together with the function spaces of the elements, so
+    // that searches can be done concurrently
+    std::set<GModel*> models;
+    for(int step = 0; step < _theViewDataGModel->getNumTimeSteps(); step++)
+      models.insert(_theViewDataGModel->getModel(step));
+    for(std::set<GModel*>::iterator it = models.begin(); it != models.end(); it++){
+      SPoint3 p(0., 0., 0.);
+      (*it)->getMeshElementByCoord(p);
+      std::vector<GEntity*> entities;
+      (*it)->getEntities(entities);
+      std::set<int> types;
+      for(unsigned int i = 0; i < entities.size(); i++){
+        for(unsigned int j = 0; j < entities[i]->getNumMeshElements(); j++){
+          MElement *e = entities[i]->getMeshElement(j);
+          if(types.insert(e->getTypeForMSH()).second){
+            e->getFunctionSpace();
+            e->getFunctionSpace(1);
+          }
+        }
+      }
+    }
+    return;
+  }
 
   _theViewDataList = dynamic_cast<PViewDataList*>(data);
 
@@ -270,127 +103,95 @@ void OctreePost::_create(PViewData *data)
       return;
     }
 
-    SBoundingBox3d bb = l->getBoundingBox();
-    // make bounding box larger up to (absolute) geometrical tolerance
-    double eps = CTX::instance()->geom.tolerance;
-    SPoint3 bbmin = bb.min(), bbmax = bb.max(), bbeps(eps, eps, eps);
-    bbmin -= bbeps;
-    bbmax += bbeps;
-    double min[3] = {bbmin.x(), bbmin.y(), bbmin.z()};
-    double size[3] = {bbmax.x() - bbmin.x(),
-                      bbmax.y() - bbmin.y(),
-                      bbmax.z() - bbmin.z()};
-    const int maxElePerBucket = 100; // memory vs. speed trade-off
-
-    _SPP = Octree_Create(maxElePerBucket, min, size, pntBB, pntCentroid, pntInEle);
-    addListOfStuff(_SPP, l->SP, 3 + 1 * l->getNumTimeSteps());
-    Octree_Arrange(_SPP);
-    _VPP = Octree_Create(maxElePerBucket, min, size, pntBB, pntCentroid, pntInEle);
-    addListOfStuff(_VPP, l->VP, 3 + 3 * l->getNumTimeSteps());
-    Octree_Arrange(_VPP);
-    _TPP = Octree_Create(maxElePerBucket, min, size, pntBB, pntCentroid, pntInEle);
-    addListOfStuff(_TPP, l->TP, 3 + 9 * l->getNumTimeSteps());
-    Octree_Arrange(_TPP);
-
-    _SL = Octree_Create(maxElePerBucket, min, size, linBB, linCentroid, linInEle);
-    addListOfStuff(_SL, l->SL, 6 + 2 * l->getNumTimeSteps());
-    Octree_Arrange(_SL);
-    _VL = Octree_Create(maxElePerBucket, min, size, linBB, linCentroid, linInEle);
-    addListOfStuff(_VL, l->VL, 6 + 6 * l->getNumTimeSteps());
-    Octree_Arrange(_VL);
-    _TL = Octree_Create(maxElePerBucket, min, size, linBB, linCentroid, linInEle);
-    addListOfStuff(_TL, l->TL, 6 + 18 * l->getNumTimeSteps());
-    Octree_Arrange(_TL);
-
-    _ST = Octree_Create(maxElePerBucket, min, size, triBB, triCentroid, triInEle);
-    addListOfStuff(_ST, l->ST, 9 + 3 * l->getNumTimeSteps());
-    Octree_Arrange(_ST);
-    _VT = Octree_Create(maxElePerBucket, min, size, triBB, triCentroid, triInEle);
-    addListOfStuff(_VT, l->VT, 9 + 9 * l->getNumTimeSteps());
-    Octree_Arrange(_VT);
-    _TT = Octree_Create(maxElePerBucket, min, size, triBB, triCentroid, triInEle);
-    addListOfStuff(_TT, l->TT, 9 + 27 * l->getNumTimeSteps());
-    Octree_Arrange(_TT);
-
-    _SQ = Octree_Create(maxElePerBucket, min, size, quaBB, quaCentroid, quaInEle);
-    addListOfStuff(_SQ, l->SQ, 12 + 4 * l->getNumTimeSteps());
-    Octree_Arrange(_SQ);
-    _VQ = Octree_Create(maxElePerBucket, min, size, quaBB, quaCentroid, quaInEle);
-    addListOfStuff(_VQ, l->VQ, 12 + 12 * l->getNumTimeSteps());
-    Octree_Arrange(_VQ);
-    _TQ = Octree_Create(maxElePerBucket, min, size, quaBB, quaCentroid, quaInEle);
-    addListOfStuff(_TQ, l->TQ, 12 + 36 * l->getNumTimeSteps());
-    Octree_Arrange(_TQ);
-
-    _SS = Octree_Create(maxElePerBucket, min, size, tetBB, tetCentroid, tetInEle);
-    addListOfStuff(_SS, l->SS, 12 + 4 * l->getNumTimeSteps());
-    Octree_Arrange(_SS);
-    _VS = Octree_Create(maxElePerBucket, min, size, tetBB, tetCentroid, tetInEle);
-    addListOfStuff(_VS, l->VS, 12 + 12 * l->getNumTimeSteps());
-    Octree_Arrange(_VS);
-    _TS = Octree_Create(maxElePerBucket, min, size, tetBB, tetCentroid, tetInEle);
-    addListOfStuff(_TS, l->TS, 12 + 36 * l->getNumTimeSteps());
-    Octree_Arrange(_TS);
-
-    _SH = Octree_Create(maxElePerBucket, min, size, hexBB, hexCentroid, hexInEle);
-    addListOfStuff(_SH, l->SH, 24 + 8 * l->getNumTimeSteps());
-    Octree_Arrange(_SH);
-    _VH = Octree_Create(maxElePerBucket, min, size, hexBB, hexCentroid, hexInEle);
-    addListOfStuff(_VH, l->VH, 24 + 24 * l->getNumTimeSteps());
-    Octree_Arrange(_VH);
-    _TH = Octree_Create(maxElePerBucket, min, size, hexBB, hexCentroid, hexInEle);
-    addListOfStuff(_TH, l->TH, 24 + 72 * l->getNumTimeSteps());
-    Octree_Arrange(_TH);
-
-    _SI = Octree_Create(maxElePerBucket, min, size, priBB, priCentroid, priInEle);
-    addListOfStuff(_SI, l->SI, 18 + 6 * l->getNumTimeSteps());
-    Octree_Arrange(_SI);
-    _VI = Octree_Create(maxElePerBucket, min, size, priBB, priCentroid, priInEle);
-    addListOfStuff(_VI, l->VI, 18 + 18 * l->getNumTimeSteps());
-    Octree_Arrange(_VI);
-    _TI = Octree_Create(maxElePerBucket, min, size, priBB, priCentroid, priInEle);
-    addListOfStuff(_TI, l->TI, 18 + 54 * l->getNumTimeSteps());
-    Octree_Arrange(_TI);
-
-    _SY = Octree_Create(maxElePerBucket, min, size, pyrBB, pyrCentroid, pyrInEle);
-    addListOfStuff(_SY, l->SY, 15 + 5 * l->getNumTimeSteps());
-    Octree_Arrange(_SY);
-    _VY = Octree_Create(maxElePerBucket, min, size, pyrBB, pyrCentroid, pyrInEle);
-    addListOfStuff(_VY, l->VY, 15 + 15 * l->getNumTimeSteps());
-    Octree_Arrange(_VY);
-    _TY = Octree_Create(maxElePerBucket, min, size, pyrBB, pyrCentroid, pyrInEle);
-    addListOfStuff(_TY, l->TY, 15 + 45 * l->getNumTimeSteps());
-    Octree_Arrange(_TY);
+    // all the elements go in a single hierarchy; the rank gives the order
+    // in which the element types are tried when a point is in several
+    // elements (volumes first)
+    std::vector<double> boxes;
+    _addList(l->SS, 4, 3, 1, 0, boxes); _addList(l->VS, 4, 3, 3, 0, boxes);
+    _addList(l->TS, 4, 3, 9, 0, boxes);
+    _addList(l->SH, 8, 3, 1, 1, boxes); _addList(l->VH, 8, 3, 3, 1, boxes);
+    _addList(l->TH, 8, 3, 9, 1, boxes);
+    _addList(l->SI, 6, 3, 1, 2, boxes); _addList(l->VI, 6, 3, 3, 2, boxes);
+    _addList(l->TI, 6, 3, 9, 2, boxes);
+    _addList(l->SY, 5, 3, 1, 3, boxes); _addList(l->VY, 5, 3, 3, 3, boxes);
+    _addList(l->TY, 5, 3, 9, 3, boxes);
+    _addList(l->ST, 3, 2, 1, 4, boxes); _addList(l->VT, 3, 2, 3, 4, boxes);
+    _addList(l->TT, 3, 2, 9, 4, boxes);
+    _addList(l->SQ, 4, 2, 1, 5, boxes); _addList(l->VQ, 4, 2, 3, 5, boxes);
+    _addList(l->TQ, 4, 2, 9, 5, boxes);
+    _addList(l->SL, 2, 1, 1, 6, boxes); _addList(l->VL, 2, 1, 3, 6, boxes);
+    _addList(l->TL, 2, 1, 9, 6, boxes);
+    _addList(l->SP, 1, 0, 1, 7, boxes); _addList(l->VP, 1, 0, 3, 7, boxes);
+    _addList(l->TP, 1, 0, 9, 7, boxes);
+    _bvh = new boundingVolumeHierarchy(_elements.size(),
+                                       boxes.empty() ? 0 : &boxes[0]);
   }
 }
 
-static void *getElement(double P[3], Octree *octree, int nbNod,
-                        int qn, double *qx, double *qy, double *qz)
+class postElementLessThan {
+ private:
+  const std::vector<OctreePost::postElement> &_elements;
+ public:
+  postElementLessThan(const std::vector<OctreePost::postElement> &elements)
+    : _elements(elements) {}
+  bool operator()(int a, int b) const
+  {
+    if(_elements[a].rank != _elements[b].rank)
+      return _elements[a].rank < _elements[b].rank;
+    return a < b;
+  }
+};
+
+static bool isInside(const OctreePost::postElement &pe, double P[3])
 {
-  if(qn && qx && qy && qz){
-    std::vector<void*> v;
-    Octree_SearchAll(P, octree, &v);
-    if(nbNod == qn){
-      // try to use the value from the same geometrical element as the one
-      // provided in qx/y/z
-      double eps = CTX::instance()->geom.tolerance;
-      for(unsigned int i = 0; i < v.size(); i++){
-        double *X = (double*)v[i], *Y = &X[qn], *Z = &X[2 * qn];
-        bool ok = true;
-        for(int j = 0; j < qn; j++){
-          ok &= (fabs(X[j] - qx[j]) < eps &&
-                 fabs(Y[j] - qy[j]) < eps &&
-                 fabs(Z[j] - qz[j]) < eps);
-        }
-        if(ok) return v[i];
+  if(pe.nbNod == 1) return true; // the bounding box test is enough
+  double *X = (double*)pe.ele, *Y = &X[pe.nbNod], *Z = &X[2 * pe.nbNod], U[3];
+  elementFactory factory;
+  element *e = factory.create(pe.nbNod, pe.dim, X, Y, Z);
+  if(!e) return false;
+  e->xyz2uvw(P, U);
+  bool inside = e->isInside(U[0], U[1], U[2]);
+  delete e;
+  return inside;
+}
+
+const OctreePost::postElement *OctreePost::_getElement(double P[3], int nbComp,
+                                                       int qn, double *qx,
+                                                       double *qy, double *qz)
+{
+  std::vector<int> candidates;
+  _bvh->search(P, candidates);
+  int n = 0;
+  for(unsigned int i = 0; i < candidates.size(); i++)
+    if(_elements[candidates[i]].nbComp == nbComp)
+      candidates[n++] = candidates[i];
+  candidates.resize(n);
+  std::sort(candidates.begin(), candidates.end(), postElementLessThan(_elements));
+
+  // the first element of the first rank containing P, unless qx/y/z are
+  // given: then try to use the value from the same geometrical element as
+  // the one provided in qx/y/z
+  bool useQ = (qn && qx && qy && qz);
+  double eps = CTX::instance()->geom.tolerance;
+  const postElement *found = 0;
+  for(unsigned int i = 0; i < candidates.size(); i++){
+    const postElement &pe = _elements[candidates[i]];
+    if(found && pe.rank != found->rank) break;
+    if(!isInside(pe, P)) continue;
+    if(!found) found = &pe;
+    if(!useQ) break;
+    if(pe.nbNod == qn){
+      double *X = (double*)pe.ele, *Y = &X[qn], *Z = &X[2 * qn];
+      bool ok = true;
+      for(int j = 0; j < qn; j++){
+        ok &= (fabs(X[j] - qx[j]) < eps &&
+               fabs(Y[j] - qy[j]) < eps &&
+               fabs(Z[j] - qz[j]) < eps);
       }
+      if(ok) return &pe;
     }
-    if(v.size()) return v[0];
   }
-  else{
-    return Octree_Search(P, octree);
-  }
-  return 0;
+  return found;
 }
 
 static MElement *getElement(double P[3], GModel *m,
@@ -496,130 +297,102 @@ bool OctreePost::_getValue(void *in, int nbComp, double P[3], int timestep,
   return true;
 }
 
-bool OctreePost::searchScalar(double x, double y, double z, double *values,
-                              int step, double *size,
-                              int qn, double *qx, double *qy, double *qz)
+bool OctreePost::_search(int nbComp, double P[3], int step, double *values,
+                         double *size, int qn, double *qx, double *qy, double *qz,
+                         void **hint)
 {
-  double P[3] = {x, y, z};
-
   if(step < 0){
     int numSteps = 1;
     if(_theViewDataList) numSteps = _theViewDataList->getNumTimeSteps();
     else if(_theViewDataGModel) numSteps = _theViewDataGModel->getNumTimeSteps();
-    for(int i = 0; i < numSteps; i++){
+    for(int i = 0; i < nbComp * numSteps; i++)
       values[i] = 0.0;
-    }
   }
   else
-    values[0] = 0.0;
+    for(int i = 0; i < nbComp; i++)
+      values[i] = 0.0;
 
   if(_theViewDataList){
-    if(_getValue(getElement(P, _SS, 4, qn, qx, qy, qz),
-                 3, 4, 1, P, step, values, size)) return true;
-    if(_getValue(getElement(P, _SH, 8, qn, qx, qy, qz),
-                 3, 8, 1, P, step, values, size)) return true;
-    if(_getValue(getElement(P, _SI, 6, qn, qx, qy, qz),
-                 3, 6, 1, P, step, values, size)) return true;
-    if(_getValue(getElement(P, _SY, 5, qn, qx, qy, qz),
-                 3, 5, 1, P, step, values, size)) return true;
-    if(_getValue(getElement(P, _ST, 3, qn, qx, qy, qz),
-                 2, 3, 1, P, step, values, size)) return true;
-    if(_getValue(getElement(P, _SQ, 4, qn, qx, qy, qz),
-                 2, 4, 1, P, step, values, size)) return true;
-    if(_getValue(getElement(P, _SL, 2, qn, qx, qy, qz),
-                 1, 2, 1, P, step, values, size)) return true;
-    if(_getValue(getElement(P, _SPP, 1, qn, qx, qy, qz),
-                 0, 1, 1, P, step, values, size)) return true;
+    if(!_bvh) return false;
+    const postElement *e = 0;
+    if(hint && *hint){
+      // an element of a lower rank could also contain P: the hint can only
+      // be used directly if it has the lowest rank
+      const postElement *h = (const postElement*)*hint;
+      if(h->nbComp == nbComp && h->rank == _minRank[nbComp] && isInside(*h, P))
+        e = h;
+    }
+    if(!e) e = _getElement(P, nbComp, qn, qx, qy, qz);
+    if(hint) *hint = (void*)e;
+    if(e && _getValue(e->ele, e->dim, e->nbNod, nbComp, P, step, values, size))
+      return true;
   }
   else if(_theViewDataGModel){
     GModel *m = _theViewDataGModel->getModel((step < 0) ? 0 : step);
     if(m){
-      if(_getValue(getElement(P, m, qn, qx, qy, qz),
-                   1, P, step, values, size)) return true;
+      MElement *e = 0;
+      if(hint && *hint){
+        MElement *h = (MElement*)*hint;
+        double U[3];
+        h->xyz2uvw(P, U);
+        if(h->isInside(U[0], U[1], U[2])) e = h;
+      }
+      if(!e) e = getElement(P, m, qn, qx, qy, qz);
+      if(hint) *hint = e;
+      if(_getValue(e, nbComp, P, step, values, size)) return true;
     }
   }
 
   return false;
 }
 
-bool OctreePost::searchScalarWithTol(double x, double y, double z, double *values,
-                                     int step, double *size, double tol,
-                                     int qn, double *qx, double *qy, double *qz)
+bool OctreePost::_searchWithTol(int nbComp, double P[3], int step, double *values,
+                                double *size, double tol, int qn, double *qx,
+                                double *qy, double *qz)
 {
-  bool a = searchScalar(x, y, z, values, step, size, qn, qx, qy, qz);
+  bool a = _search(nbComp, P, step, values, size, qn, qx, qy, qz);
   if(!a && tol != 0.){
     double oldtol1 = element::getTolerance();
     double oldtol2 = MElement::getTolerance();
     element::setTolerance(tol);
     MElement::setTolerance(tol);
-    a = searchScalar(x, y, z, values, step, size, qn, qx, qy, qz);
+    a = _search(nbComp, P, step, values, size, qn, qx, qy, qz);
     element::setTolerance(oldtol1);
     MElement::setTolerance(oldtol2);
   }
   return a;
 }
 
-bool OctreePost::searchVector(double x, double y, double z, double *values,
+bool OctreePost::searchScalar(double x, double y, double z, double *values,
                               int step, double *size,
                               int qn, double *qx, double *qy, double *qz)
 {
   double P[3] = {x, y, z};
+  return _search(1, P, step, values, size, qn, qx, qy, qz);
+}
 
-  if(step < 0){
-    int numSteps = 1;
-    if(_theViewDataList) numSteps = _theViewDataList->getNumTimeSteps();
-    else if(_theViewDataGModel) numSteps = _theViewDataGModel->getNumTimeSteps();
-    for(int i = 0; i < 3 * numSteps; i++)
-      values[i] = 0.0;
-  }
-  else
-    for(int i = 0; i < 3; i++)
-      values[i] = 0.0;
-
-  if(_theViewDataList){
-    if(_getValue(getElement(P, _VS, 4, qn, qx, qy, qz),
-                 3, 4, 3, P, step, values, size)) return true;
-    if(_getValue(getElement(P, _VH, 8, qn, qx, qy, qz),
-                 3, 8, 3, P, step, values, size)) return true;
-    if(_getValue(getElement(P, _VI, 6, qn, qx, qy, qz),
-                 3, 6, 3, P, step, values, size)) return true;
-    if(_getValue(getElement(P, _VY, 5, qn, qx, qy, qz),
-                 3, 5, 3, P, step, values, size)) return true;
-    if(_getValue(getElement(P, _VT, 3, qn, qx, qy, qz),
-                 2, 3, 3, P, step, values, size)) return true;
-    if(_getValue(getElement(P, _VQ, 4, qn, qx, qy, qz),
-                 2, 4, 3, P, step, values, size)) return true;
-    if(_getValue(getElement(P, _VL, 2, qn, qx, qy, qz),
-                 1, 2, 3, P, step, values, size)) return true;
-    if(_getValue(getElement(P, _VPP, 1, qn, qx, qy, qz),
-                 0, 1, 3, P, step, values, size)) return true;
-  }
-  else if(_theViewDataGModel){
-    GModel *m = _theViewDataGModel->getModel((step < 0) ? 0 : step);
-    if(m){
-      if(_getValue(getElement(P, m, qn, qx, qy, qz),
-                   3, P, step, values, size)) return true;
-    }
-  }
+bool OctreePost::searchScalarWithTol(double x, double y, double z, double *values,
+                                     int step, double *size, double tol,
+                                     int qn, double *qx, double *qy, double *qz)
+{
+  double P[3] = {x, y, z};
+  return _searchWithTol(1, P, step, values, size, tol, qn, qx, qy, qz);
+}
 
-  return false;
+bool OctreePost::searchVector(double x, double y, double z, double *values,
+                              int step, double *size,
+                              int qn, double *qx, double *qy, double *qz)
+{
+  double P[3] = {x, y, z};
+  return _search(3, P, step, values, size, qn, qx, qy, qz);
 }
 
 bool OctreePost::searchVectorWithTol(double x, double y, double z, double *values,
                                      int step, double *size, double tol,
                                      int qn, double *qx, double *qy, double *qz)
 {
-  bool a = searchVector(x, y, z, values, step, size, qn, qx, qy, qz);
-  if(!a && tol != 0.){
-    double oldtol1 = element::getTolerance();
-    double oldtol2 = MElement::getTolerance();
-    element::setTolerance(tol);
-    MElement::setTolerance(tol);
-    a = searchVector(x, y, z, values, step, size, qn, qx, qy, qz);
-    element::setTolerance(oldtol1);
-    MElement::setTolerance(oldtol2);
-  }
-  return a;
+  double P[3] = {x, y, z};
+  return _searchWithTol(3, P, step, values, size, tol, qn, qx, qy, qz);
 }
 
 bool OctreePost::searchTensor(double x, double y, double z, double *values,
@@ -627,60 +400,63 @@ bool OctreePost::searchTensor(double x, double y, double z, double *values,
                               int qn, double *qx, double *qy, double *qz)
 {
   double P[3] = {x, y, z};
-
-  if(step < 0){
-    int numSteps = 1;
-    if(_theViewDataList) numSteps = _theViewDataList->getNumTimeSteps();
-    else if(_theViewDataGModel) numSteps = _theViewDataGModel->getNumTimeSteps();
-    for(int i = 0; i < 9 * numSteps; i++)
-      values[i] = 0.0;
-  }
-  else
-    for(int i = 0; i < 9; i++)
-      values[i] = 0.0;
-
-  if(_theViewDataList){
-    if(_getValue(getElement(P, _TS, 4, qn, qx, qy, qz),
-                 3, 4, 9, P, step, values, size)) return true;
-    if(_getValue(getElement(P, _TH, 8, qn, qx, qy, qz),
-                 3, 8, 9, P, step, values, size)) return true;
-    if(_getValue(getElement(P, _TI, 6, qn, qx, qy, qz),
-                 3, 6, 9, P, step, values, size)) return true;
-    if(_getValue(getElement(P, _TY, 5, qn, qx, qy, qz),
-                 3, 5, 9, P, step, values, size)) return true;
-    if(_getValue(getElement(P, _TT, 3, qn, qx, qy, qz),
-                 2, 3, 9, P, step, values, size)) return true;
-    if(_getValue(getElement(P, _TQ, 4, qn, qx, qy, qz),
-                 2, 4, 9, P, step, values, size)) return true;
-    if(_getValue(getElement(P, _TL, 2, qn, qx, qy, qz),
-                 1, 2, 9, P, step, values, size)) return true;
-    if(_getValue(getElement(P, _TPP, 1, qn, qx, qy, qz),
-                 0, 1, 9, P, step, values, size)) return true;
-  }
-  else if(_theViewDataGModel){
-    GModel *m = _theViewDataGModel->getModel((step < 0) ? 0 : step);
-    if(m){
-      if(_getValue(getElement(P, m, qn, qx, qy, qz),
-                   9, P, step, values, size)) return true;
-    }
-  }
-
-  return false;
+  return _search(9, P, step, values, size, qn, qx, qy, qz);
 }
 
 bool OctreePost::searchTensorWithTol(double x, double y, double z, double *values,
                                      int step, double *size, double tol,
                                      int qn, double *qx, double *qy, double *qz)
 {
-  bool a = searchTensor(x, y, z, values, step, size, qn, qx, qy, qz);
-  if(!a && tol != 0.){
-    double oldtol1 = element::getTolerance();
-    double oldtol2 = MElement::getTolerance();
-    element::setTolerance(tol);
-    MElement::setTolerance(tol);
-    a = searchTensor(x, y, z, values, step, size, qn, qx, qy, qz);
-    element::setTolerance(oldtol1);
-    MElement::setTolerance(oldtol2);
+  double P[3] = {x, y, z};
+  return _searchWithTol(9, P, step, values, size, tol, qn, qx, qy, qz);
+}
+
+bool OctreePost::searchScalarWithHint(double x, double y, double z,
+                                      double *values, int step, void **hint)
+{
+  double P[3] = {x, y, z};
+  return _search(1, P, step, values, 0, 0, 0, 0, 0, hint);
+}
+
+bool OctreePost::searchVectorWithHint(double x, double y, double z,
+                                      double *values, int step, void **hint)
+{
+  double P[3] = {x, y, z};
+  return _search(3, P, step, values, 0, 0, 0, 0, 0, hint);
+}
+
+bool OctreePost::searchTensorWithHint(double x, double y, double z,
+                                      double *values, int step, void **hint)
+{
+  double P[3] = {x, y, z};
+  return _search(9, P, step, values, 0, 0, 0, 0, 0, hint);
+}
+
+int OctreePost::search(int nbComp, int n, const double *xyz, double *values,
+                       int step)
+{
+  int numSteps = 1;
+  if(step < 0){
+    if(_theViewDataList) numSteps = _theViewDataList->getNumTimeSteps();
+    else if(_theViewDataGModel) numSteps = _theViewDataGModel->getNumTimeSteps();
   }
-  return a;
+  const int stride = nbComp * numSteps;
+  int found = 0;
+#if defined(_OPENMP)
+  const int numThreads = std::max(1, std::min(Msg::GetMaxThreads(), n / 64));
+#pragma omp parallel reduction(+: found) num_threads(numThreads)
+#endif
+  {
+    // successive points are often close to each other
+    void *hint = 0;
+#if defined(_OPENMP)
+#pragma omp for schedule(dynamic, 64)
+#endif
+    for(int i = 0; i < n; i++){
+      double P[3] = {xyz[3 * i], xyz[3 * i + 1], xyz[3 * i + 2]};
+      if(_search(nbComp, P, step, &values[stride * i], 0, 0, 0, 0, 0, &hint))
+        found++;
+    }
+  }
+  return found;
 }
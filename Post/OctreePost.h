@@ -6,32 +6,50 @@
 #ifndef _OCTREE_POST_H_
 #define _OCTREE_POST_H_
 
-#include "Octree.h"
+#include <vector>
 
 class PView;
 class PViewData;
 class PViewDataList;
 class PViewDataGModel;
+class boundingVolumeHierarchy;
 
 class OctreePost
 {
+ public:
+  // an element of a list-based view: a pointer to its coordinates and
+  // values in the list, its number of nodes, dimension and number of field
+  // components, and its rank in the search order
+  struct postElement {
+    void *ele;
+    int nbNod, dim, nbComp, rank;
+  };
  private:
-  Octree *_SPP, *_VPP, *_TPP; // _SP & co reserved by win32
-  Octree *_SL, *_VL, *_TL;
-  Octree *_ST, *_VT, *_TT;
-  Octree *_SQ, *_VQ, *_TQ;
-  Octree *_SS, *_VS, *_TS;
-  Octree *_SH, *_VH, *_TH;
-  Octree *_SI, *_VI, *_TI;
-  Octree *_SY, *_VY, *_TY;
+  // all the elements of list-based views are stored in a single bounding
+  // volume hierarchy (the elements of model-based views are searched in
+  // the octree of the model, which is created with the OctreePost)
+  std::vector<postElement> _elements;
+  // the lowest rank of the elements with 1, 3 or 9 components
+  int _minRank[10];
+  boundingVolumeHierarchy *_bvh;
   PViewDataList *_theViewDataList;
   PViewDataGModel *_theViewDataGModel;
   void _create(PViewData *data);
+  void _addList(std::vector<double> &l, int nbNod, int dim, int nbComp,
+                int rank, std::vector<double> &boxes);
+  const postElement *_getElement(double P[3], int nbComp, int qn, double *qx,
+                                 double *qy, double *qz);
   bool _getValue(void *in, int dim, int nbNod, int nbComp,
                  double P[3], int step, double *values,
                  double *elementSize);
   bool _getValue(void *in, int nbComp, double P[3], int step,
                  double *values, double *elementSize);
+  bool _search(int nbComp, double P[3], int step, double *values,
+               double *size, int qn=0, double *qx=0, double *qy=0,
+               double *qz=0, void **hint=0);
+  bool _searchWithTol(int nbComp, double P[3], int step, double *values,
+                      double *size, double tol, int qn, double *qx,
+                      double *qy, double *qz);
  public :
   OctreePost(PView *v);
   OctreePost(PViewData *data);
@@ -60,6 +78,23 @@ class OctreePost
   bool searchTensorWithTol(double x, double y, double z, double *values,
                            int step=-1, double *size=0, double tol=1.e-2,
                            int qn=0, double *qx=0, double *qy=0, double *qz=0);
+  // search starting with the element found by the previous search with the
+  // same "hint" (which should be set to 0 before the first search): this is
+  // much faster for successive points that are close to each other, e.g.
+  // along a trajectory. Searches (with different hints) can be done
+  // concurrently by several threads
+  bool searchScalarWithHint(double x, double y, double z, double *values,
+                            int step, void **hint);
+  bool searchVectorWithHint(double x, double y, double z, double *values,
+                            int step, void **hint);
+  bool searchTensorWithHint(double x, double y, double z, double *values,
+                            int step, void **hint);
+  // search for the values of the view (with "nbComp" components) at the
+  // "n" points with coordinates x0 y0 z0 x1 y1 z1 ..., in parallel: the
+  // values at each point are stored consecutively, as for a single point
+  // search; returns the number of points found
+  int search(int nbComp, int n, const double *xyz, double *values,
+             int step=-1);
 };
 
 #endif
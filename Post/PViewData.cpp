@@ -59,6 +59,52 @@ bool PViewData::skipElement(int step, int ent, int ele, bool checkVisibility,
   return ele % samplingRate;
 }
 
+int PViewData::getElementBlock(int step, int ent, int ele, int maxNum,
+                               elementBlock &block, bool checkVisibility,
+                               int samplingRate)
+{
+  block.step = step;
+  block.ent = ent;
+  block.first = ele;
+  block.num = 0;
+  block.xyz.clear();
+  block.val.clear();
+  block.skip.clear();
+  int numEle = getNumElements(step, ent);
+  if(ele < 0 || ele >= numEle || maxNum <= 0) return 0;
+  block.type = getType(step, ent, ele);
+  block.dim = getDimension(step, ent, ele);
+  block.numNodes = getNumNodes(step, ent, ele);
+  block.numEdges = getNumEdges(step, ent, ele);
+  block.numComp = getNumComponents(step, ent, ele);
+  for(int i = ele; i < numEle && block.num < maxNum; i++){
+    if(i > ele && (getType(step, ent, i) != block.type ||
+                   getDimension(step, ent, i) != block.dim ||
+                   getNumNodes(step, ent, i) != block.numNodes ||
+                   getNumEdges(step, ent, i) != block.numEdges ||
+                   getNumComponents(step, ent, i) != block.numComp))
+      break;
+    bool skip = skipElement(step, ent, i, checkVisibility, samplingRate);
+    block.skip.push_back(skip);
+    for(int nod = 0; nod < block.numNodes; nod++){
+      double x = 0., y = 0., z = 0.;
+      if(!skip) getNode(step, ent, i, nod, x, y, z);
+      block.xyz.push_back(x);
+      block.xyz.push_back(y);
+      block.xyz.push_back(z);
+    }
+    for(int nod = 0; nod < block.numNodes; nod++){
+      for(int comp = 0; comp < block.numComp; comp++){
+        double val = 0.;
+        if(!skip) getValue(step, ent, i, nod, comp, val);
+        block.val.push_back(val);
+      }
+    }
+    block.num++;
+  }
+  return block.num;
+}
+
 void PViewData::getScalarValue(int step, int ent, int ele, int nod, double &val,
                                int forceNumComponents, int componentMap[9])
 {
@@ -24,6 +24,28 @@ class OctreePost;
 
 typedef std::map<int, std::vector<fullMatrix<double>*> > interpolationMatrices;
 
+// A block of consecutive elements of an entity, which all have the same
+// type, dimension, number of nodes, edges and components, with the
+// coordinates of their nodes and their values at a given step stored
+// contiguously.
+class elementBlock {
+ public:
+  // the block contains the elements first, ..., first + num - 1
+  int step, ent, first, num;
+  int type, dim, numNodes, numEdges, numComp;
+  // x, y, z of each node of each element (3 * numNodes values per element)
+  std::vector<double> xyz;
+  // components of the values at each node of each element (numNodes *
+  // numComp values per element)
+  std::vector<double> val;
+  // flag the elements that should be skipped (see PViewData::skipElement)
+  std::vector<char> skip;
+  elementBlock() : step(0), ent(0), first(0), num(0), type(0), dim(0),
+                   numNodes(0), numEdges(0), numComp(0) {}
+  double *getXYZ(int i){ return &xyz[3 * numNodes * i]; }
+  double *getValues(int i){ return &val[numNodes * numComp * i]; }
+};
+
 // The abstract interface to post-processing view data.
 class PViewData {
  private:
@@ -163,6 +185,16 @@ class PViewData {
   // return the type of the ele-th element in the ent-th entity
   virtual int getType(int step, int ent, int ele){ return 0; }
 
+  // fill "block" with at most "maxNum" consecutive elements of the ent-th
+  // entity at the step-th time step, starting with the ele-th element and
+  // stopping at the first element with a different type, dimension, number
+  // of nodes, edges or components; return the number of elements in the
+  // block. This is much faster than reading the nodes and values one by
+  // one for the data types that implement it directly.
+  virtual int getElementBlock(int step, int ent, int ele, int maxNum,
+                              elementBlock &block, bool checkVisibility=false,
+                              int samplingRate=1);
+
   // return the number of 2D/3D strings in the view
   virtual int getNumStrings2D(){ return 0; }
   virtual int getNumStrings3D(){ return 0; }
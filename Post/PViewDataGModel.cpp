@@ -463,7 +463,11 @@ int PViewDataGModel::getDimension(int step, int ent, int ele)
 
 int PViewDataGModel::getNumNodes(int step, int ent, int ele)
 {
-  MElement *e = _getElement(step, ent, ele);
+  return _getNumNodes(step, _getElement(step, ent, ele));
+}
+
+int PViewDataGModel::_getNumNodes(int step, MElement *e)
+{
   if(_type == GaussPointData){
     return _steps[step]->getGaussPoints(e->getTypeForMSH()).size() / 3;
   }
@@ -582,14 +586,17 @@ void PViewDataGModel::getValue(int step, int ent, int ele, int idx, double &val)
 
 void PViewDataGModel::getValue(int step, int ent, int ele, int nod, int comp, double &val)
 {
-  MElement *e = _getElement(step, ent, ele);
+  val = _getValue(step, _getElement(step, ent, ele), nod, comp);
+}
+
+double PViewDataGModel::_getValue(int step, MElement *e, int nod, int comp)
+{
   switch(_type){
   case NodeData:
     {
       int num = _getNode(e, nod)->getNum();
-      val = _steps[step]->getData(num)[comp];
+      return _steps[step]->getData(num)[comp];
     }
-    break;
   case ElementNodeData:
   case GaussPointData:
     if(_steps[step]->getMult(e->getNum()) < nod + 1){
@@ -600,18 +607,17 @@ void PViewDataGModel::getValue(int step, int ent, int ele, int nod, int comp, do
         first = false;
       }
     }
-    val = _steps[step]->getData(e->getNum())[_steps[step]->getNumComponents() * nod + comp];
-    break;
+    return _steps[step]->getData(e->getNum())[_steps[step]->getNumComponents() * nod + comp];
   case ElementData:
   default:
-    val = _steps[step]->getData(e->getNum())[comp];
-    break;
+    return _steps[step]->getData(e->getNum())[comp];
   }
 }
 
 void PViewDataGModel::setValue(int step, int ent, int ele, int nod, int comp, double val)
 {
   MElement *e = _getElement(step, ent, ele);
+  _steps[step]->setModified();
   switch(_type){
   case NodeData:
     {
@@ -648,6 +654,72 @@ int PViewDataGModel::getType(int step, int ent, int ele)
   return _getElement(step, ent, ele)->getType();
 }
 
+int PViewDataGModel::getElementBlock(int step, int ent, int ele, int maxNum,
+                                     elementBlock &block, bool checkVisibility,
+                                     int samplingRate)
+{
+  // Gauss points are interpolated in getNode()
+  if(_type == GaussPointData || step < 0 || step >= getNumTimeSteps())
+    return PViewData::getElementBlock(step, ent, ele, maxNum, block,
+                                      checkVisibility, samplingRate);
+
+  block.step = step;
+  block.ent = ent;
+  block.first = ele;
+  block.num = 0;
+  block.xyz.clear();
+  block.val.clear();
+  block.skip.clear();
+  stepData<double> *sd = _steps[step];
+  GEntity *ge = sd->getEntity(ent);
+  int numEle = ge->getNumMeshElements();
+  if(ele < 0 || ele >= numEle || maxNum <= 0) return 0;
+  MElement *e = ge->getMeshElement(ele);
+  block.type = e->getType();
+  block.dim = e->getDim();
+  block.numNodes = _getNumNodes(step, e);
+  block.numEdges = e->getNumEdges();
+  block.numComp = sd->getNumComponents();
+  bool noData = !sd->getNumData();
+  int nn = block.numNodes, nc = block.numComp;
+  for(int i = ele; i < numEle && block.num < maxNum; i++){
+    if(i > ele){
+      e = ge->getMeshElement(i);
+      if(e->getType() != block.type || e->getDim() != block.dim ||
+         _getNumNodes(step, e) != nn || e->getNumEdges() != block.numEdges)
+        break;
+    }
+    // same tests as in skipElement()
+    bool skip = noData || (checkVisibility && !e->getVisibility());
+    if(!skip){
+      if(_type == NodeData){
+        for(int nod = 0; nod < nn; nod++){
+          if(!sd->getData(_getNode(e, nod)->getNum())){
+            skip = true;
+            break;
+          }
+        }
+      }
+      else if(!sd->getData(e->getNum()))
+        skip = true;
+    }
+    if(!skip)
+      skip = PViewData::skipElement(step, ent, i, checkVisibility, samplingRate);
+    block.skip.push_back(skip);
+    for(int nod = 0; nod < nn; nod++){
+      MVertex *v = _getNode(e, nod);
+      block.xyz.push_back(v->x());
+      block.xyz.push_back(v->y());
+      block.xyz.push_back(v->z());
+    }
+    for(int nod = 0; nod < nn; nod++)
+      for(int comp = 0; comp < nc; comp++)
+        block.val.push_back(skip ? 0. : _getValue(step, e, nod, comp));
+    block.num++;
+  }
+  return block.num;
+}
+
 void PViewDataGModel::reverseElement(int step, int ent, int ele)
 {
   if(!step) _getElement(step, ent, ele)->reverse();
@@ -12,6 +12,14 @@
 
 template<class Real>
 class stepData{
+ public:
+  // a block of data records in a MSH file
+  struct fileBlock {
+    std::string fileName;
+    long offset;
+    int numEnt;
+    bool binary, swap, mult;
+  };
  private:
   // a pointer to the underlying model
   GModel *_model;
@@ -35,6 +43,12 @@ class stepData{
   // the data and 2) not to store any additional info in MVertex or
   // MElement)
   std::vector<Real*> *_data;
+  // the values are not allocated one by one, but in large contiguous
+  // chunks (a single chunk if the size of the data is known in advance,
+  // see reserveValues())
+  std::vector<Real*> _chunks;
+  int _chunkSize, _chunkUsed, _nextChunkSize;
+  size_t _numValues;
   // a vector containing the multiplying factor allowing to compute
   // the number of values stored in _data for each index (number of
   // values = getMult() * getNumComponents()). If _mult is empty, a
@@ -45,14 +59,80 @@ class stepData{
   std::vector<std::vector<double> > _gaussPoints;
   // a set of all "partitions" encountered in the data
   std::set<int> _partitions;
+  // the blocks of records in MSH files the data was read from: if the
+  // data has not been modified since, it can be unloaded when the memory
+  // limit (PostProcessing.MemoryLimit) is reached, and is reloaded from
+  // the files on the next access. Steps can be (re)loaded concurrently,
+  // but are only unloaded outside of parallel regions, so that the values
+  // used by other threads remain valid
+  std::vector<fileBlock> _blocks;
+  // last access to the data, for unloading the least recently used steps
+  unsigned long _lastUse;
+  // the step is never unloaded while it is pinned
+  int _pinned;
+  static unsigned long _clock;
+  // all the steps whose data is loaded and can be unloaded
+  static std::set<stepData<Real>*> _loaded;
+  // the data of a step backed by files is published by _load() once all
+  // its values are read: test it with an acquire load
+  bool _isLoaded() const
+  {
+#if defined(_OPENMP) && defined(__ATOMIC_ACQUIRE)
+    return __atomic_load_n(&_data, __ATOMIC_ACQUIRE) != 0;
+#elif defined(_OPENMP)
+    bool loaded = (_data != 0);
+#pragma omp flush
+    return loaded;
+#else
+    return _data != 0;
+#endif
+  }
+  void _loadIfNeeded()
+  {
+    if(!_blocks.empty() && !_isLoaded()) _load();
+  }
+  // record an access to the data of a step backed by files
+  void _touch()
+  {
+#if defined(_OPENMP) && defined(__ATOMIC_RELAXED)
+    __atomic_store_n(&_lastUse, __atomic_add_fetch(&_clock, 1, __ATOMIC_RELAXED),
+                     __ATOMIC_RELAXED);
+#elif defined(_OPENMP)
+#pragma omp critical (stepDataClock)
+    _lastUse = ++_clock;
+#else
+    _lastUse = ++_clock;
+#endif
+  }
+  Real *_allocValues(int n)
+  {
+    if(_chunks.empty() || _chunkUsed + n > _chunkSize){
+      _chunkSize = std::max(n, _nextChunkSize);
+      _chunks.push_back(new Real[_chunkSize]);
+      _chunkUsed = 0;
+      _numValues += _chunkSize;
+      _nextChunkSize = std::min(2 * _chunkSize, 1 << 22);
+    }
+    Real *d = _chunks.back() + _chunkUsed;
+    _chunkUsed += n;
+    for(int i = 0; i < n; i++) d[i] = 0.;
+    return d;
+  }
+  void _load();
+  void _unload();
+  void _checkMemoryLimit();
  public:
   stepData(GModel *model, int numComp, const std::string &fileName="", int fileIndex=-1,
            double time=0., double min=VAL_INF, double max=-VAL_INF)
     : _model(model), _fileName(fileName), _fileIndex(fileIndex), _time(time),
-      _min(min), _max(max), _numComp(numComp), _data(0)
+      _min(min), _max(max), _numComp(numComp), _data(0), _chunkSize(0),
+      _chunkUsed(0), _nextChunkSize(1024), _numValues(0), _lastUse(0),
+      _pinned(0)
   {
   }
-  stepData(stepData<Real> &other) : _data(0)
+  stepData(stepData<Real> &other)
+    : _data(0), _chunkSize(0), _chunkUsed(0), _nextChunkSize(1024),
+      _numValues(0), _lastUse(0), _pinned(0)
   {
     _model = other._model;
     _entities = other._entities;
@@ -63,14 +143,14 @@ class stepData{
     _min = other._min;
     _max = other._max;
     _numComp = other._numComp;
-    if(other._data){
-      int n = other.getNumData();
+    int n = other.getNumData();
+    if(n){
       _data = new std::vector<Real*>(n, (Real*)0);
       for(int i = 0; i < n; i++){
         Real *d = other.getData(i);
         if(d){
           int m = other.getMult(i) * _numComp;
-          (*_data)[i] = new Real[m];
+          (*_data)[i] = _allocValues(m);
           for(int j = 0; j < m; j++) (*_data)[i][j] = d[j];
         }
       }
@@ -89,6 +169,7 @@ class stepData{
   int getNumComponents(){ return _numComp; }
   int getMult(int index)
   {
+    _loadIfNeeded();
     if(index < 0 || index >= (int)_mult.size()) return 1;
     return _mult[index];
   }
@@ -104,24 +185,33 @@ class stepData{
   void setMax(double max){ _max = max; }
   int getNumData()
   {
-    if(!_data) return 0;
-    return _data->size();
+    _loadIfNeeded();
+    return _data ? _data->size() : 0;
   }
   void resizeData(int n)
   {
     if(!_data) _data = new std::vector<Real*>(n, (Real*)0);
     if(n > (int)_data->size()) _data->resize(n, (Real*)0);
   }
+  // allocate the next "n" values contiguously
+  void reserveValues(int n)
+  {
+    if(_chunks.empty() || _chunkUsed + n > _chunkSize)
+      _nextChunkSize = std::max(_nextChunkSize, n);
+  }
   Real *getData(int index, bool allocIfNeeded=false, int mult=1)
   {
+    if(!_blocks.empty()){
+      if(!_isLoaded()) _load();
+      _touch();
+    }
     if(allocIfNeeded){
-      if(index >= getNumData()) resizeData(index + 100); // optimize this
-      if(!(*_data)[index]){
-        (*_data)[index] = new Real[_numComp * mult];
-        for(int i = 0; i < _numComp * mult; i++) (*_data)[index][i] = 0.;
-      }
+      // (std::vector grows geometrically)
+      if(index >= getNumData()) resizeData(index + 1);
+      if(!(*_data)[index])
+        (*_data)[index] = _allocValues(_numComp * mult);
       if(mult > 1){
-        if(index >= (int)_mult.size()) _mult.resize(index + 100, 1); // optimize this
+        if(index >= (int)_mult.size()) _mult.resize(index + 1, 1);
         _mult[index] = mult;
       }
     }
@@ -132,12 +222,38 @@ class stepData{
   }
   void destroyData()
   {
-    if(_data){
-      for(unsigned int i = 0; i < _data->size(); i++)
-        if((*_data)[i]) delete [] (*_data)[i];
-      delete _data;
-      _data = 0;
-    }
+    _unload();
+    _blocks.clear();
+  }
+  // read "numEnt" records of a $NodeData, $ElementData or
+  // $ElementNodeData section of a MSH file (with a multiplying factor if
+  // "mult" is set), updating the min/max of the step
+  bool readMSH(FILE *fp, bool binary, bool swap, int numEnt, bool mult);
+  // read the records of a $DeltaNodeData, $DeltaElementData or
+  // $DeltaElementNodeData section, i.e. the differences with the values
+  // of the "key" step, in units of "tolerance" (the step is laid out
+  // like the key step, so no entity numbers are stored)
+  bool readMSHDelta(FILE *fp, bool binary, stepData<Real> &key,
+                    double tolerance);
+  // record the location of data read with readMSH(), so that it can be
+  // reloaded after the step has been unloaded
+  void addFileBlock(const fileBlock &block);
+  // keep the data in memory while pointers to the values are in use (e.g.
+  // when loading another step could unload this one), until unpin()
+  void pin()
+  {
+    _loadIfNeeded();
+    _pinned++;
+  }
+  void unpin(){ _pinned--; }
+  // the data does not correspond to the files anymore: it will never be
+  // unloaded
+  void setModified()
+  {
+    if(_blocks.empty()) return;
+    _loadIfNeeded();
+    _blocks.clear();
+    _loaded.erase(this);
   }
   std::vector<double> &getGaussPoints(int msh)
   {
@@ -147,6 +263,7 @@ class stepData{
   std::set<int> &getPartitions(){ return _partitions; }
   double getMemoryInMb()
   {
+    if(!_data) return 0.;
     double b = 0.;
     for(int i = 0; i < getNumData(); i++) b += getMult(i);
     return b * getNumComponents() * sizeof(Real) / 1024. / 1024.;
@@ -163,6 +280,14 @@ class PViewDataGModel : public PViewData {
     GaussPointData = 4,
     BeamData = 5
   };
+  // an entry of the index saved at the end of MSH files written
+  // incrementally (see PostProcessing.SaveIncremental): the offset of the
+  // data section of a step, and the key step it is relative to (the step
+  // itself if it is saved in full)
+  struct stepIndex {
+    int step, keyStep;
+    long offset;
+  };
  private:
   // the data, indexed by time step
   std::vector<stepData<double>*> _steps;
@@ -173,6 +298,15 @@ class PViewDataGModel : public PViewData {
   // cache last element to speed up loops
   MElement *_getElement(int step, int ent, int ele);
   MVertex *_getNode(MElement *e, int nod);
+  int _getNumNodes(int step, MElement *e);
+  double _getValue(int step, MElement *e, int nod, int comp);
+  // MSH output of a single step, in full or relative to a key step
+  bool _writeMSHStep(FILE *fp, int step, int numEnt, bool binary,
+                     int partitionNum, bool saveInterpolationMatrices);
+  bool _encodeMSHDelta(int step, int keyStep, double tolerance,
+                       std::vector<int> &delta);
+  void _writeMSHDeltaStep(FILE *fp, int step, int keyStep, double tolerance,
+                          bool binary, std::vector<int> &delta);
  public:
   PViewDataGModel(DataType type=NodeData);
   ~PViewDataGModel();
@@ -216,6 +350,9 @@ class PViewDataGModel : public PViewData {
   void setValue(int step, int ent, int ele, int node, int comp, double val);
   int getNumEdges(int step, int ent, int ele);
   int getType(int step, int ent, int ele);
+  int getElementBlock(int step, int ent, int ele, int maxNum,
+                      elementBlock &block, bool checkVisibility=false,
+                      int samplingRate=1);
   void reverseElement(int step, int ent, int ele);
   void smooth();
   double getMemoryInMb();
@@ -249,6 +386,13 @@ class PViewDataGModel : public PViewData {
                int fileIndex, FILE *fp, bool binary, bool swap, int step,
                double time, int partition, int numComp, int numNodes,
                const std::string &interpolationScheme);
+  bool readMSHDelta(const std::string &viewName, const std::string &fileName,
+                    FILE *fp, bool binary, int step, double time, int keyStep,
+                    double tolerance, int numComp);
+  // read the trailing step index of a MSH file; returns the offset of the
+  // index, or -1 if the file has no (valid) index
+  static long readMSHIndex(const std::string &fileName, std::string &viewName,
+                           bool &binary, std::vector<stepIndex> &index);
   virtual bool writeMSH(const std::string &fileName, double version=2.2, bool binary=false,
                         bool savemesh=true, bool multipleView=false,
                         int partitionNum=0, bool saveInterpolationMatrices=true,
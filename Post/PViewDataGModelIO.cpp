@@ -3,6 +3,10 @@
 // See the LICENSE.txt file for license information. Please report all
 // bugs and problems to the public mailing list <gmsh@geuz.org>.
 
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <algorithm>
 #include "GmshConfig.h"
 #include "GmshMessage.h"
 #include "PViewDataGModel.h"
@@ -11,6 +15,264 @@
 #include "Numeric.h"
 #include "StringUtils.h"
 #include "OS.h"
+#include "OutputBuffer.h"
+#include "Context.h"
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+template<class Real> unsigned long stepData<Real>::_clock = 0;
+template<class Real> std::set<stepData<Real>*> stepData<Real>::_loaded;
+
+template<class Real>
+bool stepData<Real>::readMSH(FILE *fp, bool binary, bool swap, int numEnt,
+                             bool mult)
+{
+  // reading the first block of a step: all its values are stored in one
+  // contiguous array (unless there are several values per entity)
+  if(!getNumData()) reserveValues(numEnt * _numComp);
+  resizeData(numEnt);
+
+  Msg::ResetProgressMeter();
+  for(int i = 0; i < numEnt; i++){
+    int num;
+    if(binary){
+      if(fread(&num, sizeof(int), 1, fp) != 1) return false;
+      if(swap) SwapBytes((char*)&num, sizeof(int), 1);
+    }
+    else{
+      if(fscanf(fp, "%d", &num) != 1) return false;
+    }
+    int m = 1;
+    if(mult){
+      if(binary){
+        if(fread(&m, sizeof(int), 1, fp) != 1) return false;
+        if(swap) SwapBytes((char*)&m, sizeof(int), 1);
+      }
+      else{
+        if(fscanf(fp, "%d", &m) != 1) return false;
+      }
+    }
+    Real *d = getData(num, true, m);
+    if(binary){
+      if((int)fread(d, sizeof(Real), _numComp * m, fp) != _numComp * m)
+        return false;
+      if(swap) SwapBytes((char*)d, sizeof(Real), _numComp * m);
+    }
+    else{
+      for(int j = 0; j < _numComp * m; j++)
+        if(fscanf(fp, "%lf", &d[j]) != 1) return false;
+    }
+    // compute min/max here to avoid calling finalize(true) later:
+    // this would be very slow for large multi-step, multi-partition
+    // datasets (since we would recompute the min/max for all the
+    // previously loaded steps/partitions, and thus loop over all the
+    // elements many times)
+    for(int j = 0; j < m; j++){
+      double val = ComputeScalarRep(_numComp, &d[_numComp * j]);
+      _min = std::min(_min, val);
+      _max = std::max(_max, val);
+    }
+    if(numEnt > 100000)
+      Msg::ProgressMeter(i + 1, numEnt, true, "Reading data");
+  }
+  return true;
+}
+
+// the differences with a key step are stored in binary files as
+// variable-length (7 bits per byte) zigzag-encoded integers: small
+// differences of either sign thus take a single byte
+
+static int sizeDeltaMSH(int q)
+{
+  unsigned int z = ((unsigned int)q << 1) ^ (unsigned int)(q >> 31);
+  int n = 1;
+  while(z >= 0x80){ z >>= 7; n++; }
+  return n;
+}
+
+static void putDeltaMSH(outputBuffer &buf, int q)
+{
+  unsigned int z = ((unsigned int)q << 1) ^ (unsigned int)(q >> 31);
+  while(z >= 0x80){
+    buf.put((char)(z | 0x80));
+    z >>= 7;
+  }
+  buf.put((char)z);
+}
+
+static bool getDeltaMSH(const std::vector<unsigned char> &bytes, size_t &pos,
+                        int &q)
+{
+  unsigned int z = 0;
+  for(int shift = 0; shift < 35; shift += 7){
+    if(pos >= bytes.size()) return false;
+    unsigned char c = bytes[pos++];
+    z |= (unsigned int)(c & 0x7f) << shift;
+    if(!(c & 0x80)){
+      q = (int)(z >> 1) ^ -(int)(z & 1);
+      return true;
+    }
+  }
+  return false;
+}
+
+template<class Real>
+bool stepData<Real>::readMSHDelta(FILE *fp, bool binary, stepData<Real> &key,
+                                  double tolerance)
+{
+  std::vector<unsigned char> bytes;
+  size_t pos = 0;
+  if(binary){
+    int numBytes;
+    if(fscanf(fp, "%d", &numBytes) != 1 || numBytes < 0 || fgetc(fp) != '\n')
+      return false;
+    bytes.resize(numBytes);
+    if(numBytes && (int)fread(&bytes[0], 1, numBytes, fp) != numBytes)
+      return false;
+  }
+
+  int n = key.getNumData(), numVal = 0;
+  for(int i = 0; i < n; i++)
+    if(key.getData(i)) numVal += key.getMult(i) * _numComp;
+  if(!getNumData()) reserveValues(numVal);
+  resizeData(n);
+
+  for(int i = 0; i < n; i++){
+    Real *k = key.getData(i);
+    if(!k) continue;
+    int m = key.getMult(i);
+    Real *d = getData(i, true, m);
+    for(int j = 0; j < _numComp * m; j++){
+      int q;
+      if(binary){
+        if(!getDeltaMSH(bytes, pos, q)) return false;
+      }
+      else{
+        if(fscanf(fp, "%d", &q) != 1) return false;
+      }
+      d[j] = k[j] + q * tolerance;
+    }
+    for(int j = 0; j < m; j++){
+      double val = ComputeScalarRep(_numComp, &d[_numComp * j]);
+      _min = std::min(_min, val);
+      _max = std::max(_max, val);
+    }
+  }
+  return true;
+}
+
+template<class Real>
+void stepData<Real>::addFileBlock(const fileBlock &block)
+{
+  _blocks.push_back(block);
+  if(_data){
+    _loaded.insert(this);
+    _checkMemoryLimit();
+  }
+}
+
+template<class Real>
+void stepData<Real>::_load()
+{
+#if defined(_OPENMP)
+#pragma omp critical (stepDataLoad)
+#endif
+  {
+    // another thread could have loaded the data in the meantime
+    if(!_isLoaded()){
+      int n = 0;
+      for(unsigned int i = 0; i < _blocks.size(); i++)
+        n += _blocks[i].numEnt;
+      Msg::Debug("Reloading %d post-processing records from file '%s'", n,
+                 _blocks[0].fileName.c_str());
+      // read the values in a temporary step (not backed by files, so it is
+      // never reloaded), so that other threads never see partial data
+      stepData<Real> tmp(_model, _numComp);
+      tmp.resizeData(n);
+      tmp.reserveValues(n * _numComp);
+      for(unsigned int i = 0; i < _blocks.size(); i++){
+        const fileBlock &b = _blocks[i];
+        FILE *fp = Fopen(b.fileName.c_str(), "rb");
+        if(!fp){
+          Msg::Error("Unable to open file '%s'", b.fileName.c_str());
+          continue;
+        }
+        if(fseek(fp, b.offset, SEEK_SET) ||
+           !tmp.readMSH(fp, b.binary, b.swap, b.numEnt, b.mult))
+          Msg::Error("Could not reload data from file '%s'", b.fileName.c_str());
+        fclose(fp);
+      }
+      _chunks.swap(tmp._chunks);
+      _chunkSize = tmp._chunkSize;
+      _chunkUsed = tmp._chunkUsed;
+      _nextChunkSize = tmp._nextChunkSize;
+      _numValues = tmp._numValues;
+      _mult.swap(tmp._mult);
+      std::vector<Real*> *data = tmp._data;
+      tmp._data = 0;
+      // publish the data once the values are filled
+#if defined(_OPENMP) && defined(__ATOMIC_RELEASE)
+      __atomic_store_n(&_data, data, __ATOMIC_RELEASE);
+#elif defined(_OPENMP)
+#pragma omp flush
+      _data = data;
+#pragma omp flush
+#else
+      _data = data;
+#endif
+      _loaded.insert(this);
+      _checkMemoryLimit();
+    }
+  }
+}
+
+template<class Real>
+void stepData<Real>::_unload()
+{
+  if(_data){
+    delete _data;
+    _data = 0;
+  }
+  for(unsigned int i = 0; i < _chunks.size(); i++)
+    delete [] _chunks[i];
+  _chunks.clear();
+  _chunkSize = _chunkUsed = 0;
+  _nextChunkSize = 1024;
+  _numValues = 0;
+  std::vector<int>().swap(_mult);
+  if(!_blocks.empty()) _loaded.erase(this);
+}
+
+template<class Real>
+void stepData<Real>::_checkMemoryLimit()
+{
+  double limit = CTX::instance()->post.memoryLimit;
+  if(limit <= 0.) return;
+#if defined(_OPENMP)
+  // other threads could be accessing the data: the loaded steps stay in
+  // memory until the end of the parallel region
+  if(omp_in_parallel()) return;
+#endif
+  while(1){
+    double mb = 0.;
+    stepData<Real> *lru = 0;
+    for(typename std::set<stepData<Real>*>::iterator it = _loaded.begin();
+        it != _loaded.end(); it++){
+      stepData<Real> *s = *it;
+      mb += (s->_numValues * sizeof(Real) + s->_data->size() * sizeof(Real*) +
+             s->_mult.size() * sizeof(int)) / 1024. / 1024.;
+      if(s != this && !s->_pinned && (!lru || s->_lastUse < lru->_lastUse))
+        lru = s;
+    }
+    if(mb <= limit || !lru) return;
+    Msg::Debug("Unloading post-processing step (%g Mb in memory)", mb);
+    lru->_unload();
+  }
+}
+
+template class stepData<double>;
 
 bool PViewDataGModel::addData(GModel *model, std::map<int, std::vector<double> > &data,
                               int step, double time, int partition, int numComp)
@@ -29,6 +291,7 @@ bool PViewDataGModel::addData(GModel *model, std::map<int, std::vector<double> >
   _steps[step]->fillEntities();
   _steps[step]->computeBoundingBox();
   _steps[step]->setTime(time);
+  _steps[step]->setModified();
 
   int numEnt = (_type == NodeData) ? model->getNumMeshVertices() :
     model->getNumMeshElements();
@@ -77,59 +340,302 @@ bool PViewDataGModel::readMSH(const std::string &viewName, const std::string &fi
   if(numSteps > maxSteps) return true;
   */
 
-  _steps[step]->resizeData(numEnt);
+  stepData<double>::fileBlock block;
+  block.fileName = fileName;
+  block.offset = ftell(fp);
+  block.numEnt = numEnt;
+  block.binary = binary;
+  block.swap = swap;
+  block.mult = (_type == ElementNodeData || _type == GaussPointData);
+  if(!_steps[step]->readMSH(fp, binary, swap, numEnt, block.mult))
+    return false;
+  _min = std::min(_min, _steps[step]->getMin());
+  _max = std::max(_max, _steps[step]->getMax());
+  _steps[step]->addFileBlock(block);
 
-  Msg::ResetProgressMeter();
-  for(int i = 0; i < numEnt; i++){
-    int num;
-    if(binary){
-      if(fread(&num, sizeof(int), 1, fp) != 1) return false;
-      if(swap) SwapBytes((char*)&num, sizeof(int), 1);
+  if(partition >= 0)
+    _steps[step]->getPartitions().insert(partition);
+
+  finalize(false, interpolationScheme);
+  return true;
+}
+
+// keeps the data of a step in memory while pointers to its values are in use
+class stepPin{
+ private:
+  stepData<double> *_step;
+ public:
+  stepPin(stepData<double> *step) : _step(step) { _step->pin(); }
+  ~stepPin(){ _step->unpin(); }
+};
+
+bool PViewDataGModel::readMSHDelta(const std::string &viewName,
+                                   const std::string &fileName, FILE *fp,
+                                   bool binary, int step, double time,
+                                   int keyStep, double tolerance, int numComp)
+{
+  Msg::Info("Reading view `%s' step %d (time %g) relative to step %d",
+            viewName.c_str(), step, time, keyStep);
+
+  if(keyStep < 0 || keyStep >= (int)_steps.size() || keyStep == step ||
+     !_steps[keyStep]->getNumData() ||
+     _steps[keyStep]->getNumComponents() != numComp){
+    Msg::Error("Step %d of view `%s' is not available", keyStep,
+               viewName.c_str());
+    return false;
+  }
+
+  while(step >= (int)_steps.size())
+    _steps.push_back(new stepData<double>(GModel::current(), numComp));
+  _steps[step]->fillEntities();
+  _steps[step]->computeBoundingBox();
+  _steps[step]->setFileName(fileName);
+  _steps[step]->setTime(time);
+
+  // no file block is recorded: the step cannot be reloaded independently
+  // of its key step, so it is never unloaded
+  {
+    stepPin pinStep(_steps[step]), pinKey(_steps[keyStep]);
+    if(!_steps[step]->readMSHDelta(fp, binary, *_steps[keyStep], tolerance))
+      return false;
+  }
+  _min = std::min(_min, _steps[step]->getMin());
+  _max = std::max(_max, _steps[step]->getMax());
+  _steps[step]->getPartitions().insert(0);
+
+  finalize(false);
+  return true;
+}
+
+long PViewDataGModel::readMSHIndex(const std::string &fileName,
+                                   std::string &viewName, bool &binary,
+                                   std::vector<stepIndex> &index)
+{
+  index.clear();
+  FILE *fp = Fopen(fileName.c_str(), "rb");
+  if(!fp) return -1;
+
+  char str[256];
+  double version;
+  int format, size;
+  if(!fgets(str, sizeof(str), fp) || strncmp(str, "$MeshFormat", 11) ||
+     fscanf(fp, "%lf %d %d", &version, &format, &size) != 3){
+    fclose(fp);
+    return -1;
+  }
+  binary = format ? true : false;
+
+  // the file ends with the offset of the index, followed by $EndViewIndex
+  char tail[64];
+  long offset = -1;
+  if(!fseek(fp, 0, SEEK_END)){
+    long end = ftell(fp), n = std::min(end, (long)sizeof(tail) - 1);
+    if(!fseek(fp, end - n, SEEK_SET) && (long)fread(tail, 1, n, fp) == n){
+      tail[n] = '\0';
+      char *p = strstr(tail, "$EndViewIndex");
+      if(p){
+        while(p > tail && isspace(p[-1])) p--;
+        while(p > tail && isdigit(p[-1])) p--;
+        offset = atol(p);
+      }
     }
-    else{
-      if(fscanf(fp, "%d", &num) != 1) return false;
+  }
+
+  int num = 0;
+  if(offset <= 0 || fseek(fp, offset, SEEK_SET) ||
+     !fgets(str, sizeof(str), fp) || strncmp(str, "$ViewIndex", 10) ||
+     !fgets(str, sizeof(str), fp) || fscanf(fp, "%d", &num) != 1 || num < 0){
+    fclose(fp);
+    return -1;
+  }
+  viewName = ExtractDoubleQuotedString(str, sizeof(str));
+  index.resize(num);
+  for(int i = 0; i < num; i++){
+    if(fscanf(fp, "%d %d %ld", &index[i].step, &index[i].keyStep,
+              &index[i].offset) != 3){
+      index.clear();
+      fclose(fp);
+      return -1;
     }
-    int mult = 1;
-    if(_type == ElementNodeData || _type == GaussPointData){
-      if(binary){
-        if(fread(&mult, sizeof(int), 1, fp) != 1) return false;
-        if(swap) SwapBytes((char*)&mult, sizeof(int), 1);
+  }
+  fclose(fp);
+  return offset;
+}
+
+bool PViewDataGModel::_writeMSHStep(FILE *fp, int step, int numEnt, bool binary,
+                                    int partitionNum, bool saveInterpolationMatrices)
+{
+  GModel *model = _steps[step]->getModel();
+  int numComp = _steps[step]->getNumComponents();
+  outputBuffer buf;
+  if(_type == NodeData){
+    fprintf(fp, "$NodeData\n");
+    fprintf(fp, "1\n\"%s\"\n", getName().c_str());
+    fprintf(fp, "1\n%.16g\n", _steps[step]->getTime());
+    if(partitionNum)
+      fprintf(fp, "4\n%d\n%d\n%d\n%d\n", step, numComp, numEnt, partitionNum);
+    else
+      fprintf(fp, "3\n%d\n%d\n%d\n", step, numComp, numEnt);
+    for(int i = 0; i < _steps[step]->getNumData(); i++){
+      if(_steps[step]->getData(i)){
+        MVertex *v = _steps[step]->getModel()->getMeshVertexByTag(i);
+        if(!v){
+          Msg::Error("Unknown vertex %d in data", i);
+          return false;
+        }
+        int num = v->getIndex();
+        if(binary){
+          buf.put(&num, sizeof(int));
+          buf.put(_steps[step]->getData(i), numComp * sizeof(double));
+        }
+        else{
+          buf.putInt(num);
+          for(int k = 0; k < numComp; k++){
+            buf.put(' ');
+            buf.putDouble(_steps[step]->getData(i)[k]);
+          }
+          buf.put('\n');
+        }
+        if(buf.size() > (1 << 20)) buf.write(fp);
       }
-      else{
-        if(fscanf(fp, "%d", &mult) != 1) return false;
+    }
+    buf.write(fp);
+    if(binary) fprintf(fp, "\n");
+    fprintf(fp, "$EndNodeData\n");
+  }
+  else{
+    if(_type == ElementNodeData)
+      fprintf(fp, "$ElementNodeData\n");
+    else
+      fprintf(fp, "$ElementData\n");
+    if(saveInterpolationMatrices && haveInterpolationMatrices())
+      fprintf(fp, "2\n\"%s\"\n\"INTERPOLATION_SCHEME\"\n", getName().c_str());
+    else
+      fprintf(fp, "1\n\"%s\"\n", getName().c_str());
+
+    fprintf(fp, "1\n%.16g\n", _steps[step]->getTime());
+    if(partitionNum)
+      fprintf(fp, "4\n%d\n%d\n%d\n%d\n", step, numComp, numEnt, partitionNum);
+    else
+      fprintf(fp, "3\n%d\n%d\n%d\n", step, numComp, numEnt);
+    for(int i = 0; i < _steps[step]->getNumData(); i++){
+      if(_steps[step]->getData(i)){
+        MElement *e = model->getMeshElementByTag(i);
+        if(!e){
+          Msg::Error("Unknown element %d in data", i);
+          return false;
+        }
+        int mult = _steps[step]->getMult(i);
+        int num = model->getMeshElementIndex(e);
+        if(binary){
+          buf.put(&num, sizeof(int));
+          if(_type == ElementNodeData)
+            buf.put(&mult, sizeof(int));
+          buf.put(_steps[step]->getData(i), numComp * mult * sizeof(double));
+        }
+        else{
+          buf.putInt(num);
+          if(_type == ElementNodeData){
+            buf.put(' ');
+            buf.putInt(mult);
+          }
+          for(int k = 0; k < numComp * mult; k++){
+            buf.put(' ');
+            buf.putDouble(_steps[step]->getData(i)[k]);
+          }
+          buf.put('\n');
+        }
+        if(buf.size() > (1 << 20)) buf.write(fp);
       }
     }
-    double *d = _steps[step]->getData(num, true, mult);
-    if(binary){
-      if((int)fread(d, sizeof(double), numComp * mult, fp) != numComp * mult)
-        return false;
-      if(swap) SwapBytes((char*)d, sizeof(double), numComp * mult);
+    buf.write(fp);
+    if(binary) fprintf(fp, "\n");
+    if(_type == ElementNodeData)
+      fprintf(fp, "$EndElementNodeData\n");
+    else
+      fprintf(fp, "$EndElementData\n");
+  }
+  return true;
+}
+
+bool PViewDataGModel::_encodeMSHDelta(int step, int keyStep, double tolerance,
+                                      std::vector<int> &delta)
+{
+  stepData<double> *s = _steps[step], *k = _steps[keyStep];
+  // loading one of the steps must not unload the other one
+  stepPin pinStep(s), pinKey(k);
+  GModel *model = k->getModel();
+  int numComp = k->getNumComponents();
+  if(s->getModel() != model || s->getNumComponents() != numComp) return false;
+
+  // the step must be laid out like the key step; its values are stored in
+  // the order of the entity numbers in the file, which is the order in
+  // which the key step is read back
+  std::vector<std::pair<int, int> > order;
+  int n = std::max(s->getNumData(), k->getNumData());
+  for(int i = 0; i < n; i++){
+    double *ds = s->getData(i), *dk = k->getData(i);
+    if(!ds && !dk) continue;
+    if(!ds || !dk || s->getMult(i) != k->getMult(i)) return false;
+    int num;
+    if(_type == NodeData){
+      MVertex *v = model->getMeshVertexByTag(i);
+      if(!v) return false;
+      num = v->getIndex();
     }
     else{
-      for(int j = 0; j < numComp * mult; j++)
-        if(fscanf(fp, "%lf", &d[j]) != 1) return false;
+      MElement *e = model->getMeshElementByTag(i);
+      if(!e) return false;
+      num = model->getMeshElementIndex(e);
     }
-    // compute min/max here to avoid calling finalize(true) later:
-    // this would be very slow for large multi-step, multi-partition
-    // datasets (since we would recompute the min/max for all the
-    // previously loaded steps/partitions, and thus loop over all the
-    // elements many times)
-    for(int j = 0; j < mult; j++){
-      double val = ComputeScalarRep(numComp, &d[numComp * j]);
-      _steps[step]->setMin(std::min(_steps[step]->getMin(), val));
-      _steps[step]->setMax(std::max(_steps[step]->getMax(), val));
-      _min = std::min(_min, val);
-      _max = std::max(_max, val);
+    order.push_back(std::make_pair(num, i));
+  }
+  std::sort(order.begin(), order.end());
+
+  delta.clear();
+  size_t bytes = 0;
+  for(unsigned int o = 0; o < order.size(); o++){
+    int i = order[o].second;
+    double *ds = s->getData(i), *dk = k->getData(i);
+    for(int j = 0; j < numComp * s->getMult(i); j++){
+      double q = floor((ds[j] - dk[j]) / tolerance + 0.5);
+      if(!(fabs(q) < 2147483647.)) return false;
+      delta.push_back((int)q);
+      bytes += sizeDeltaMSH((int)q);
     }
-    if(numEnt > 100000)
-      Msg::ProgressMeter(i + 1, numEnt, true, "Reading data");
   }
+  // only worth it if the step is close enough to the key step
+  return bytes <= 4 * delta.size();
+}
 
-  if(partition >= 0)
-    _steps[step]->getPartitions().insert(partition);
-
-  finalize(false, interpolationScheme);
-  return true;
+void PViewDataGModel::_writeMSHDeltaStep(FILE *fp, int step, int keyStep,
+                                         double tolerance, bool binary,
+                                         std::vector<int> &delta)
+{
+  const char *name = (_type == NodeData) ? "NodeData" :
+    (_type == ElementNodeData) ? "ElementNodeData" : "ElementData";
+  int numComp = _steps[step]->getNumComponents();
+  fprintf(fp, "$Delta%s\n", name);
+  fprintf(fp, "1\n\"%s\"\n", getName().c_str());
+  fprintf(fp, "2\n%.16g\n%.16g\n", _steps[step]->getTime(), tolerance);
+  fprintf(fp, "4\n%d\n%d\n%d\n%d\n", step, numComp, (int)delta.size(), keyStep);
+  outputBuffer buf;
+  if(binary){
+    for(unsigned int i = 0; i < delta.size(); i++)
+      putDeltaMSH(buf, delta[i]);
+    fprintf(fp, "%d\n", (int)buf.size());
+    buf.write(fp);
+    fprintf(fp, "\n");
+  }
+  else{
+    for(unsigned int i = 0; i < delta.size(); i++){
+      buf.putInt(delta[i]);
+      buf.put(((i + 1) % numComp) ? ' ' : '\n');
+      if(buf.size() > (1 << 20)) buf.write(fp);
+    }
+    buf.write(fp);
+  }
+  fprintf(fp, "$EndDelta%s\n", name);
 }
 
 bool PViewDataGModel::writeMSH(const std::string &fileName, double version, bool binary,
@@ -149,8 +655,35 @@ bool PViewDataGModel::writeMSH(const std::string &fileName, double version, bool
 
   GModel *model = _steps[0]->getModel();
 
+  // when saving incrementally, the steps listed in the index at the end of
+  // an existing file are not saved again: the new steps are written over
+  // the index, followed by the updated index
+  bool incremental = CTX::instance()->post.saveIncremental && !multipleView &&
+    !partitionNum;
+  std::vector<stepIndex> index;
+  long indexOffset = -1;
+  if(incremental){
+    std::string name;
+    bool bin;
+    indexOffset = readMSHIndex(fileName, name, bin, index);
+    if(indexOffset >= 0 && (name != getName() || bin != binary || index.empty() ||
+                            index.back().step >= (int)_steps.size())){
+      indexOffset = -1;
+      index.clear();
+    }
+  }
+
   FILE *fp;
-  if(saveMesh){
+  if(indexOffset >= 0){
+    fp = Fopen(fileName.c_str(), "r+b");
+    if(!fp){
+      Msg::Error("Unable to open file '%s'", fileName.c_str());
+      return false;
+    }
+    fseek(fp, indexOffset, SEEK_SET);
+    Msg::Info("Appending steps after step %d", index.back().step);
+  }
+  else if(saveMesh){
     if(!model->writeMSH(fileName, version, binary, false, false, 1.0, 0,
                         0, multipleView)) return false;
     // append data
@@ -184,8 +717,11 @@ bool PViewDataGModel::writeMSH(const std::string &fileName, double version, bool
       fprintf(fp, "$EndMeshFormat\n");
     }
   }
+  // (the position of files opened in append mode is not defined before
+  // the first write)
+  if(indexOffset < 0) fseek(fp, 0, SEEK_END);
 
-  if(saveInterpolationMatrices && haveInterpolationMatrices()){
+  if(indexOffset < 0 && saveInterpolationMatrices && haveInterpolationMatrices()){
     fprintf(fp, "$InterpolationScheme\n");
     fprintf(fp, "\"INTERPOLATION_SCHEME\"\n");
     fprintf(fp, "%d\n", (int)_interpolation.size());
@@ -207,91 +743,49 @@ bool PViewDataGModel::writeMSH(const std::string &fileName, double version, bool
     fprintf(fp, "$EndInterpolationScheme\n");
   }
 
-  for(unsigned int step = 0; step < _steps.size(); step++){
-    int numEnt = 0, numComp = _steps[step]->getNumComponents();
+  // steps close to the last step saved in full are saved as differences
+  double tolerance = CTX::instance()->post.deltaTolerance;
+  int first = 0, keyStep = -1;
+  if(index.size()){
+    first = index.back().step + 1;
+    keyStep = index.back().keyStep;
+  }
+  std::vector<int> delta;
+  for(unsigned int step = first; step < _steps.size(); step++){
+    int numEnt = 0;
     for(int i = 0; i < _steps[step]->getNumData(); i++)
       if(_steps[step]->getData(i)) numEnt++;
-    if(numEnt){
-      if(_type == NodeData){
-        fprintf(fp, "$NodeData\n");
-        fprintf(fp, "1\n\"%s\"\n", getName().c_str());
-        fprintf(fp, "1\n%.16g\n", _steps[step]->getTime());
-        if(partitionNum)
-          fprintf(fp, "4\n%d\n%d\n%d\n%d\n", step, numComp, numEnt, partitionNum);
-        else
-          fprintf(fp, "3\n%d\n%d\n%d\n", step, numComp, numEnt);
-        for(int i = 0; i < _steps[step]->getNumData(); i++){
-          if(_steps[step]->getData(i)){
-            MVertex *v = _steps[step]->getModel()->getMeshVertexByTag(i);
-            if(!v){
-              Msg::Error("Unknown vertex %d in data", i);
-              fclose(fp);
-              return false;
-            }
-            int num = v->getIndex();
-            if(binary){
-              fwrite(&num, sizeof(int), 1, fp);
-              fwrite(_steps[step]->getData(i), sizeof(double), numComp, fp);
-            }
-            else{
-              fprintf(fp, "%d", num);
-              for(int k = 0; k < numComp; k++)
-                fprintf(fp, " %.16g", _steps[step]->getData(i)[k]);
-              fprintf(fp, "\n");
-            }
-          }
-        }
-        if(binary) fprintf(fp, "\n");
-        fprintf(fp, "$EndNodeData\n");
-      }
-      else{
-        if(_type == ElementNodeData)
-          fprintf(fp, "$ElementNodeData\n");
-        else
-          fprintf(fp, "$ElementData\n");
-        if(saveInterpolationMatrices && haveInterpolationMatrices())
-          fprintf(fp, "2\n\"%s\"\n\"INTERPOLATION_SCHEME\"\n", getName().c_str());
-        else
-          fprintf(fp, "1\n\"%s\"\n", getName().c_str());
-
-        fprintf(fp, "1\n%.16g\n", _steps[step]->getTime());
-        if(partitionNum)
-          fprintf(fp, "4\n%d\n%d\n%d\n%d\n", step, numComp, numEnt, partitionNum);
-        else
-          fprintf(fp, "3\n%d\n%d\n%d\n", step, numComp, numEnt);
-        for(int i = 0; i < _steps[step]->getNumData(); i++){
-          if(_steps[step]->getData(i)){
-            MElement *e = model->getMeshElementByTag(i);
-            if(!e){
-              Msg::Error("Unknown element %d in data", i);
-              fclose(fp);
-              return false;
-            }
-            int mult = _steps[step]->getMult(i);
-            int num = model->getMeshElementIndex(e);
-            if(binary){
-              fwrite(&num, sizeof(int), 1, fp);
-              if(_type == ElementNodeData)
-                fwrite(&mult, sizeof(int), 1, fp);
-              fwrite(_steps[step]->getData(i), sizeof(double), numComp * mult, fp);
-            }
-            else{
-              fprintf(fp, "%d", num);
-              if(_type == ElementNodeData)
-                fprintf(fp, " %d", mult);
-              for(int k = 0; k < numComp * mult; k++)
-                fprintf(fp, " %.16g", _steps[step]->getData(i)[k]);
-              fprintf(fp, "\n");
-            }
-          }
-        }
-        if(binary) fprintf(fp, "\n");
-        if(_type == ElementNodeData)
-          fprintf(fp, "$EndElementNodeData\n");
-        else
-          fprintf(fp, "$EndElementData\n");
+    if(!numEnt) continue;
+    stepIndex si;
+    si.step = step;
+    si.offset = ftell(fp);
+    if(incremental && tolerance > 0. && keyStep >= 0 &&
+       _encodeMSHDelta(step, keyStep, tolerance, delta)){
+      _writeMSHDeltaStep(fp, step, keyStep, tolerance, binary, delta);
+    }
+    else{
+      if(!_writeMSHStep(fp, step, numEnt, binary, partitionNum,
+                        saveInterpolationMatrices)){
+        fclose(fp);
+        return false;
       }
+      keyStep = step;
     }
+    si.keyStep = keyStep;
+    index.push_back(si);
+  }
+
+  if(incremental){
+    // the offset of the index is saved last, so that it can be found from
+    // the end of the file
+    long offset = ftell(fp);
+    fprintf(fp, "$ViewIndex\n");
+    fprintf(fp, "\"%s\"\n", getName().c_str());
+    fprintf(fp, "%d\n", (int)index.size());
+    for(unsigned int i = 0; i < index.size(); i++)
+      fprintf(fp, "%d %d %ld\n", index[i].step, index[i].keyStep, index[i].offset);
+    fprintf(fp, "%020ld\n", offset);
+    fprintf(fp, "$EndViewIndex\n");
   }
 
   fclose(fp);
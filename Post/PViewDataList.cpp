@@ -3,6 +3,7 @@
 // See the LICENSE.txt file for license information. Please report all
 // bugs and problems to the public mailing list <gmsh@geuz.org>.
 
+#include <algorithm>
 #include "PViewDataList.h"
 #include "GmshMessage.h"
 #include "GmshDefines.h"
@@ -427,6 +428,70 @@ int PViewDataList::getType(int step, int ent, int ele)
   return _lastType;
 }
 
+int PViewDataList::getElementBlock(int step, int ent, int ele, int maxNum,
+                                   elementBlock &block, bool checkVisibility,
+                                   int samplingRate)
+{
+  block.step = step;
+  block.ent = ent;
+  block.first = ele;
+  block.num = 0;
+  block.xyz.clear();
+  block.val.clear();
+  block.skip.clear();
+  if(ele < 0 || ele >= getNumElements() || maxNum <= 0) return 0;
+  if(step >= NbTimeStep) step = 0;
+
+  _setLast(ele);
+  block.type = _lastType;
+  block.dim = _lastDimension;
+  block.numNodes = _lastNumNodes;
+  block.numEdges = _lastNumEdges;
+  block.numComp = _lastNumComponents;
+
+  // the elements of the same list have the same type and number of
+  // components, and the same number of nodes except for polygons and
+  // polyhedra
+  int last = ele + 1;
+  for(int i = 0; i < 30; i++){
+    if(_index[i] > ele){
+      last = _index[i];
+      break;
+    }
+  }
+  last = std::min(last, ele + maxNum);
+  if(_lastType == TYPE_POLYG || _lastType == TYPE_POLYH){
+    int t = (_lastType == TYPE_POLYG) ? 0 : 1;
+    int first = _index[t ? 26 : 23];
+    for(int i = ele + 1; i < last; i++){
+      if(polyNumNodes[t][i - first] != _lastNumNodes){
+        last = i;
+        break;
+      }
+    }
+  }
+
+  int n = last - ele, nn = _lastNumNodes, nc = _lastNumComponents;
+  block.xyz.resize(3 * nn * n);
+  block.val.resize(nn * nc * n);
+  block.skip.resize(n);
+  for(int k = 0; k < n; k++){
+    if(k) _setLast(ele + k);
+    const double *val = _lastVal + step * nn * nc;
+    double *xyz = block.getXYZ(k), *v = block.getValues(k);
+    for(int nod = 0; nod < nn; nod++){
+      xyz[3 * nod] = _lastXYZ[nod];
+      xyz[3 * nod + 1] = _lastXYZ[nn + nod];
+      xyz[3 * nod + 2] = _lastXYZ[2 * nn + nod];
+    }
+    for(int i = 0; i < nn * nc; i++) v[i] = val[i];
+    block.skip[k] = PViewData::skipElement(step, ent, ele + k, checkVisibility,
+                                           samplingRate);
+  }
+  block.num = n;
+  return n;
+}
+
 void PViewDataList::_getString(int dim, int i, int step, std::string &str,
                                double &x, double &y, double &z, double &style)
 {
@@ -104,6 +104,9 @@ class PViewDataList : public PViewData {
   void setValue(int step, int ent, int ele, int nod, int comp, double val);
   int getNumEdges(int step, int ent, int ele);
   int getType(int step, int ent, int ele);
+  int getElementBlock(int step, int ent, int ele, int maxNum,
+                      elementBlock &block, bool checkVisibility=false,
+                      int samplingRate=1);
   int getNumStrings2D(){ return NbT2; }
   int getNumStrings3D(){ return NbT3; }
   void getString2D(int i, int step, std::string &str,
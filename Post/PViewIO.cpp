@@ -97,6 +97,25 @@ bool PView::readMSH(const std::string &fileName, int fileIndex)
     return false;
   }
 
+  // with a step index at the end of the file, a single data section is
+  // reached directly (after the section of its key step, if it is saved as
+  // differences with another step)
+  std::vector<PViewDataGModel::stepIndex> entries;
+  std::vector<int> sections;
+  if(fileIndex >= 0){
+    std::string name;
+    bool bin;
+    if(PViewDataGModel::readMSHIndex(fileName, name, bin, entries) >= 0 &&
+       fileIndex < (int)entries.size()){
+      const PViewDataGModel::stepIndex &s = entries[fileIndex];
+      for(int i = 0; i < fileIndex && s.keyStep != s.step; i++)
+        if(entries[i].step == s.keyStep) sections.push_back(i);
+      sections.push_back(fileIndex);
+    }
+  }
+  int keyIndex = (sections.size() > 1) ? sections[0] : -1;
+  unsigned int nextSection = 0;
+
   char str[256] = "XXX";
   int index = -1;
   bool binary = false, swap = false;
@@ -111,6 +130,21 @@ bool PView::readMSH(const std::string &fileName, int fileIndex)
     if(feof(fp))
       break;
 
+    bool delta = !strncmp(&str[1], "Delta", 5);
+    const char *section = delta ? &str[6] : &str[1];
+    bool data = (!strncmp(section, "NodeData", 8) ||
+                 !strncmp(section, "ElementData", 11) ||
+                 !strncmp(section, "ElementNodeData", 15));
+
+    if(data && sections.size()){
+      if(nextSection == sections.size()) break;
+      index = sections[nextSection] - 1;
+      if(fseek(fp, entries[sections[nextSection++]].offset, SEEK_SET) ||
+         !fgets(str, sizeof(str), fp)){ fclose(fp); return false; }
+      delta = !strncmp(&str[1], "Delta", 5);
+      section = delta ? &str[6] : &str[1];
+    }
+
     if(!strncmp(&str[1], "MeshFormat", 10)) {
       double version;
       if(!fgets(str, sizeof(str), fp)){ fclose(fp); return false; }
@@ -156,15 +190,13 @@ bool PView::readMSH(const std::string &fileName, int fileIndex)
         }
       }
     }
-    else if(!strncmp(&str[1], "NodeData", 8) ||
-            !strncmp(&str[1], "ElementData", 11) ||
-            !strncmp(&str[1], "ElementNodeData", 15)) {
+    else if(data) {
       index++;
-      if(fileIndex < 0 || fileIndex == index){
+      if(fileIndex < 0 || fileIndex == index || keyIndex == index){
         PViewDataGModel::DataType type;
-        if(!strncmp(&str[1], "NodeData", 8))
+        if(!strncmp(section, "NodeData", 8))
           type = PViewDataGModel::NodeData;
-        else if(!strncmp(&str[1], "ElementData", 11))
+        else if(!strncmp(section, "ElementData", 11))
           type = PViewDataGModel::ElementData;
         else
           type = PViewDataGModel::ElementNodeData;
@@ -181,7 +213,7 @@ bool PView::readMSH(const std::string &fileName, int fileIndex)
             interpolationScheme = ExtractDoubleQuotedString(str, sizeof(str));
         }
         // double tags
-        double time = 0.;
+        double time = 0., tolerance = 0.;
         if(!fgets(str, sizeof(str), fp)){ fclose(fp); return false; }
         if(sscanf(str, "%d", &numTags) != 1){ fclose(fp); return false; }
         for(int i = 0; i < numTags; i++){
@@ -189,6 +221,9 @@ bool PView::readMSH(const std::string &fileName, int fileIndex)
           if(i == 0){
             if(sscanf(str, "%lf", &time) != 1){ fclose(fp); return false; }
           }
+          else if(i == 1){
+            if(sscanf(str, "%lf", &tolerance) != 1){ fclose(fp); return false; }
+          }
         }
         // integer tags
         int timeStep = 0, numComp = 0, numEnt = 0, partition = 0;
@@ -209,24 +244,39 @@ bool PView::readMSH(const std::string &fileName, int fileIndex)
             if(sscanf(str, "%d", &partition) != 1){ fclose(fp); return false; }
           }
         }
+        // the last integer tag of steps saved as differences is the step
+        // they are relative to
+        int keyStep = delta ? partition : -1;
+        if(delta) partition = 0;
         // either get existing viewData, or create new one
         PView *p = getViewByName(viewName, timeStep, partition);
         PViewDataGModel *d = 0;
         if(p) d = dynamic_cast<PViewDataGModel*>(p->getData());
-        bool create = d ? false : true;
-        if(create) d = new PViewDataGModel(type);
-        if(!d->readMSH(viewName, fileName, fileIndex, fp, binary, swap, timeStep,
-                       time, partition, numComp, numEnt, interpolationScheme)){
-          Msg::Error("Could not read data in msh file");
-          if(create) delete d;
-          fclose(fp);
-          return false;
+        if(delta){
+          if(!d || d->getType() != type ||
+             !d->readMSHDelta(viewName, fileName, fp, binary, timeStep, time,
+                              keyStep, tolerance, numComp)){
+            Msg::Error("Could not read data in msh file");
+            fclose(fp);
+            return false;
+          }
         }
         else{
-          d->setName(viewName);
-          d->setFileName(fileName);
-          d->setFileIndex(index);
-          if(create) new PView(d);
+          bool create = d ? false : true;
+          if(create) d = new PViewDataGModel(type);
+          if(!d->readMSH(viewName, fileName, fileIndex, fp, binary, swap, timeStep,
+                         time, partition, numComp, numEnt, interpolationScheme)){
+            Msg::Error("Could not read data in msh file");
+            if(create) delete d;
+            fclose(fp);
+            return false;
+          }
+          else{
+            d->setName(viewName);
+            d->setFileName(fileName);
+            d->setFileIndex(index);
+            if(create) new PView(d);
+          }
         }
       }
     }
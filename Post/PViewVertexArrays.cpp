@@ -23,6 +23,46 @@
 #include "Options.h"
 #include "StringUtils.h"
 
+// per-thread chunks of the vertex arrays of a view, filled concurrently by
+// addElementsInArrays() and appended in order to the arrays of the view
+class vertexArrayChunk {
+ public:
+  VertexArray points, lines, triangles, vectors, ellipses;
+  // contributions to the smoothed normals (x, y, z, nx, ny, nz), which are
+  // averaged in order when the chunk is appended
+  std::vector<double> normals;
+  vertexArrayChunk()
+    : points(1, 0, true), lines(2, 0, true), triangles(3, 0, true),
+      vectors(2, 0, true), ellipses(4, 0, true) {}
+  void appendTo(PView *p)
+  {
+    p->va_points->appendChunk(&points);
+    p->va_lines->appendChunk(&lines);
+    p->va_triangles->appendChunk(&triangles);
+    p->va_vectors->appendChunk(&vectors);
+    p->va_ellipses->appendChunk(&ellipses);
+    for(unsigned int i = 0; i < normals.size(); i += 6)
+      p->normals->add(normals[i], normals[i + 1], normals[i + 2],
+                      normals[i + 3], normals[i + 4], normals[i + 5]);
+    normals.clear();
+  }
+};
+
+static vertexArrayChunk *chunks = 0;
+
+static vertexArrayChunk &chunk()
+{
+  return chunks[Msg::GetThreadNum()];
+}
+
+static void addSmoothNormal(double x, double y, double z,
+                            double nx, double ny, double nz)
+{
+  std::vector<double> &n = chunk().normals;
+  n.push_back(x); n.push_back(y); n.push_back(z);
+  n.push_back(nx); n.push_back(ny); n.push_back(nz);
+}
+
 static void saturate(int nb, double **val, double vmin, double vmax,
                      int i0=0, int i1=1, int i2=2, int i3=3,
                      int i4=4, int i5=5, int i6=6, int i7=7)
@@ -329,11 +369,11 @@ static void addOutlinePoint(PView *p, double **xyz, unsigned int color,
 {
   if(pre) return;
   SVector3 n = getPointNormal(p, 1.);
-  p->va_points->add(&xyz[i0][0], &xyz[i0][1], &xyz[i0][2], &n, &color, 0, true);
+  chunk().points.add(&xyz[i0][0], &xyz[i0][1], &xyz[i0][2], &n, &color, 0, true);
 }
 
 static void addScalarPoint(PView *p, double **xyz,
-                           double **val, bool pre, int i0=0,
+                           double **val, bool pre, int boundary, int i0=0,
                            bool unique=false)
 {
   if(pre) return;
@@ -348,7 +388,7 @@ static void addScalarPoint(PView *p, double **xyz,
                                      (opt->intervalsType == PViewOptions::Discrete) ?
                                      opt->nbIso : -1);
     SVector3 n = getPointNormal(p, val[i0][0]);
-    p->va_points->add(&xyz[i0][0], &xyz[i0][1], &xyz[i0][2], &n, &col, 0, unique);
+    chunk().points.add(&xyz[i0][0], &xyz[i0][1], &xyz[i0][2], &n, &col, 0, unique);
   }
 }
 
@@ -366,22 +406,20 @@ static void addOutlineLine(PView *p, double **xyz, unsigned int color,
   }
   SVector3 n[2];
   getLineNormal(p, x, y, z, 0, n, true);
-  p->va_lines->add(x, y, z, n, col, 0, true);
+  chunk().lines.add(x, y, z, n, col, 0, true);
 }
 
 static void addScalarLine(PView *p, double **xyz,
-                          double **val, bool pre, int i0=0, int i1=1,
-                          bool unique=false)
+                          double **val, bool pre, int boundary, int i0=0,
+                          int i1=1, bool unique=false)
 {
   if(pre) return;
 
   PViewOptions *opt = p->getOptions();
 
-  if(opt->boundary > 0){
-    opt->boundary--;
-    addScalarPoint(p, xyz, val, pre, i0, true);
-    addScalarPoint(p, xyz, val, pre, i1, true);
-    opt->boundary++;
+  if(boundary > 0){
+    addScalarPoint(p, xyz, val, pre, boundary - 1, i0, true);
+    addScalarPoint(p, xyz, val, pre, boundary - 1, i1, true);
     return;
   }
 
@@ -401,7 +439,7 @@ static void addScalarLine(PView *p, double **xyz,
       unsigned int col[2];
       for(int i = 0; i < 2; i++)
         col[i] = opt->getColor(v[i], vmin, vmax);
-      p->va_lines->add(x, y, z, n, col, 0, unique);
+      chunk().lines.add(x, y, z, n, col, 0, unique);
     }
     else{
       double x2[2], y2[2], z2[2], v2[2];
@@ -410,7 +448,7 @@ static void addScalarLine(PView *p, double **xyz,
         unsigned int col[2];
         for(int i = 0; i < 2; i++)
           col[i] = opt->getColor(v2[i], vmin, vmax);
-        p->va_lines->add(x2, y2, z2, n, col, 0, unique);
+        chunk().lines.add(x2, y2, z2, n, col, 0, unique);
       }
     }
   }
@@ -427,7 +465,7 @@ static void addScalarLine(PView *p, double **xyz,
         unsigned int col[2] = {color, color};
         SVector3 n[2];
         getLineNormal(p, x2, y2, z2, v2, n, true);
-        p->va_lines->add(x2, y2, z2, n, col, 0, unique);
+        chunk().lines.add(x2, y2, z2, n, col, 0, unique);
       }
       if(vmin == vmax) break;
     }
@@ -442,7 +480,7 @@ static void addScalarLine(PView *p, double **xyz,
       if(nb == 1){
         unsigned int color = opt->getColor(k, opt->nbIso);
         SVector3 n = getPointNormal(p, iso);
-        p->va_points->add(x2, y2, z2, &n, &color, 0, unique);
+        chunk().points.add(x2, y2, z2, &n, &color, 0, unique);
       }
       if(vmin == vmax) break;
     }
@@ -467,28 +505,26 @@ static void addOutlineTriangle(PView *p, double **xyz,
     unsigned int col[2] = {color, color};
     if(opt->smoothNormals){
       for(int j = 0; j < 2; j++){
-        if(pre) p->normals->add(x[j], y[j], z[j], n[j][0], n[j][1], n[j][2]);
+        if(pre) addSmoothNormal(x[j], y[j], z[j], n[j][0], n[j][1], n[j][2]);
         else p->normals->get(x[j], y[j], z[j], n[j][0], n[j][1], n[j][2]);
       }
     }
     getLineNormal(p, x, y, z, 0, n, false);
-    if(!pre) p->va_lines->add(x, y, z, n, col, 0, true);
+    if(!pre) chunk().lines.add(x, y, z, n, col, 0, true);
   }
 }
 
 static void addScalarTriangle(PView *p, double **xyz, double **val,
-                              bool pre, int i0=0, int i1=1, int i2=2,
-                              bool unique=false, bool skin=false)
+                              bool pre, int boundary, int i0=0, int i1=1,
+                              int i2=2, bool unique=false, bool skin=false)
 {
   PViewOptions *opt = p->getOptions();
 
   const int il[3][2] = {{i0, i1}, {i1, i2}, {i2, i0}};
 
-  if(opt->boundary > 0){
-    opt->boundary--;
+  if(boundary > 0){
     for(int i = 0; i < 3; i++)
-      addScalarLine(p, xyz, val, pre, il[i][0], il[i][1], true);
-    opt->boundary++;
+      addScalarLine(p, xyz, val, pre, boundary - 1, il[i][0], il[i][1], true);
     return;
   }
 
@@ -510,12 +546,12 @@ static void addScalarTriangle(PView *p, double **xyz, double **val,
       unsigned int col[3];
       for(int i = 0; i < 3; i++){
         if(opt->smoothNormals){
-          if(pre) p->normals->add(x[i], y[i], z[i], n[i][0], n[i][1], n[i][2]);
+          if(pre) addSmoothNormal(x[i], y[i], z[i], n[i][0], n[i][1], n[i][2]);
           else p->normals->get(x[i], y[i], z[i], n[i][0], n[i][1], n[i][2]);
         }
         col[i] = opt->getColor(v[i], vmin, vmax);
       }
-      if(!pre) p->va_triangles->add(x, y, z, n, col, 0, unique, skin);
+      if(!pre) chunk().triangles.add(x, y, z, n, col, 0, unique, skin);
     }
     else{
       double x2[10], y2[10], z2[10], v2[10];
@@ -530,12 +566,12 @@ static void addScalarTriangle(PView *p, double **xyz, double **val,
           unsigned int col[3];
           for(int i = 0; i < 3; i++){
             if(opt->smoothNormals){
-              if(pre) p->normals->add(x3[i], y3[i], z3[i], n[i][0], n[i][1], n[i][2]);
+              if(pre) addSmoothNormal(x3[i], y3[i], z3[i], n[i][0], n[i][1], n[i][2]);
               else p->normals->get(x3[i], y3[i], z3[i], n[i][0], n[i][1], n[i][2]);
             }
             col[i] = opt->getColor(v3[i], vmin, vmax);
           }
-          if(!pre) p->va_triangles->add(x3, y3, z3, n, col, 0, unique, skin);
+          if(!pre) chunk().triangles.add(x3, y3, z3, n, col, 0, unique, skin);
         }
       }
     }
@@ -558,11 +594,11 @@ static void addScalarTriangle(PView *p, double **xyz, double **val,
           SVector3 n[3] = {nfac, nfac, nfac};
           if(opt->smoothNormals){
             for(int i = 0; i < 3; i++){
-              if(pre) p->normals->add(x3[i], y3[i], z3[i], n[i][0], n[i][1], n[i][2]);
+              if(pre) addSmoothNormal(x3[i], y3[i], z3[i], n[i][0], n[i][1], n[i][2]);
               else p->normals->get(x3[i], y3[i], z3[i], n[i][0], n[i][1], n[i][2]);
             }
           }
-          if(!pre) p->va_triangles->add(x3, y3, z3, n, col, 0, unique, skin);
+          if(!pre) chunk().triangles.add(x3, y3, z3, n, col, 0, unique, skin);
         }
       }
       if(vmin == vmax) break;
@@ -581,13 +617,13 @@ static void addScalarTriangle(PView *p, double **xyz, double **val,
         SVector3 n[2] = {nfac, nfac};
         if(opt->smoothNormals){
           for(int i = 0; i < 2; i++){
-            if(pre) p->normals->add(x2[i], y2[i], z2[i], n[i][0], n[i][1], n[i][2]);
+            if(pre) addSmoothNormal(x2[i], y2[i], z2[i], n[i][0], n[i][1], n[i][2]);
             else p->normals->get(x2[i], y2[i], z2[i], n[i][0], n[i][1], n[i][2]);
           }
         }
         double v[2] = {iso, iso};
         getLineNormal(p, x, y, z, v, n, false);
-        if(!pre) p->va_lines->add(x2, y2, z2, n, col, 0, unique);
+        if(!pre) chunk().lines.add(x2, y2, z2, n, col, 0, unique);
       }
       if(vmin == vmax) break;
     }
@@ -612,34 +648,30 @@ static void addOutlineQuadrangle(PView *p, double **xyz,
     unsigned int col[2] = {color, color};
     if(opt->smoothNormals){
       for(int j = 0; j < 2; j++){
-        if(pre) p->normals->add(x[j], y[j], z[j], n[j][0], n[j][1], n[j][2]);
+        if(pre) addSmoothNormal(x[j], y[j], z[j], n[j][0], n[j][1], n[j][2]);
         else p->normals->get(x[j], y[j], z[j], n[j][0], n[j][1], n[j][2]);
       }
     }
     getLineNormal(p, x, y, z, 0, n, false);
-    if(!pre) p->va_lines->add(x, y, z, n, col, 0, true);
+    if(!pre) chunk().lines.add(x, y, z, n, col, 0, true);
   }
 }
 
 static void addScalarQuadrangle(PView *p, double **xyz,
-                                double **val, bool pre, int i0=0,
+                                double **val, bool pre, int boundary, int i0=0,
                                 int i1=1, int i2=2, int i3=3, bool unique=false)
 {
-  PViewOptions *opt = p->getOptions();
-
   const int il[4][2] = {{i0, i1}, {i1, i2}, {i2, i3}, {i3, i0}};
   const int it[2][3] = {{i0, i1, i2}, {i0, i2, i3}};
 
-  if(opt->boundary > 0){
-    opt->boundary--;
+  if(boundary > 0){
     for(int i = 0; i < 4; i++)
-      addScalarLine(p, xyz, val, pre, il[i][0], il[i][1], true);
-    opt->boundary++;
+      addScalarLine(p, xyz, val, pre, boundary - 1, il[i][0], il[i][1], true);
     return;
   }
 
   for(int i = 0; i < 2; i++)
-    addScalarTriangle(p, xyz, val, pre, it[i][0], it[i][1], it[i][2], unique);
+    addScalarTriangle(p, xyz, val, pre, boundary, it[i][0], it[i][1], it[i][2], unique);
 }
 
 static void addOutlinePolygon(PView *p, double **xyz,
@@ -650,11 +682,10 @@ static void addOutlinePolygon(PView *p, double **xyz,
 }
 
 static void addScalarPolygon(PView *p, double **xyz,
-                             double **val, bool pre, int numNodes)
+                             double **val, bool pre, int boundary,
+                             int numNodes)
 {
-  PViewOptions *opt = p->getOptions();
-
-  if(opt->boundary > 0){
+  if(boundary > 0){
     const int il[3][2] = {{0, 1}, {1, 2}, {2, 0}};
     std::map<MEdge, int, Less_Edge> edges;
     std::vector<MVertex *> verts;
@@ -672,14 +703,12 @@ static void addScalarPolygon(PView *p, double **xyz,
       }
     }
 
-    opt->boundary--;
     for(std::map<MEdge, int, Less_Edge>::iterator ite = edges.begin();
         ite != edges.end(); ite++){
       int i = (int) (*ite).second / 100;
       int j = (*ite).second % 100;
-      addScalarLine(p, xyz, val, pre, 3*i+il[j][0], 3*i+il[j][0], true);
+      addScalarLine(p, xyz, val, pre, boundary - 1, 3*i+il[j][0], 3*i+il[j][0], true);
     }
-    opt->boundary++;
 
     for(int i = 0; i < numNodes; i++)
       delete verts[i];
@@ -687,7 +716,7 @@ static void addScalarPolygon(PView *p, double **xyz,
   }
 
   for(int i = 0; i < numNodes / 3; i++)
-    addScalarTriangle(p, xyz, val, pre, 3*i, 3*i+1, 3*i+2);
+    addScalarTriangle(p, xyz, val, pre, boundary, 3*i, 3*i+1, 3*i+2);
 }
 
 static void addOutlineTetrahedron(PView *p, double **xyz,
@@ -699,21 +728,19 @@ static void addOutlineTetrahedron(PView *p, double **xyz,
 }
 
 static void addScalarTetrahedron(PView *p, double **xyz,
-                                 double **val, bool pre, int i0=0,
+                                 double **val, bool pre, int boundary, int i0=0,
                                  int i1=1, int i2=2, int i3=3)
 {
   PViewOptions *opt = p->getOptions();
 
   const int it[4][3] = {{i0, i2, i1}, {i0, i1, i3}, {i0, i3, i2}, {i3, i1, i2}};
 
-  if(opt->boundary > 0 ||
+  if(boundary > 0 ||
      opt->intervalsType == PViewOptions::Continuous ||
      opt->intervalsType == PViewOptions::Discrete){
-    bool skin = (opt->boundary > 0) ? false : opt->drawSkinOnly;
-    opt->boundary--;
+    bool skin = (boundary > 0) ? false : opt->drawSkinOnly;
     for(int i = 0; i < 4; i++)
-      addScalarTriangle(p, xyz, val, pre, it[i][0], it[i][1], it[i][2], true, skin);
-    opt->boundary++;
+      addScalarTriangle(p, xyz, val, pre, boundary - 1, it[i][0], it[i][1], it[i][2], true, skin);
     return;
   }
 
@@ -742,11 +769,11 @@ static void addScalarTetrahedron(PView *p, double **xyz,
           for(int i = 0; i < 3; i++){
             n[i][0] = nn[0]; n[i][1] = nn[1]; n[i][2] = nn[2];
             if(opt->smoothNormals){
-              if(pre) p->normals->add(x3[i], y3[i], z3[i], n[i][0], n[i][1], n[i][2]);
+              if(pre) addSmoothNormal(x3[i], y3[i], z3[i], n[i][0], n[i][1], n[i][2]);
               else p->normals->get(x3[i], y3[i], z3[i], n[i][0], n[i][1], n[i][2]);
             }
           }
-          if(!pre) p->va_triangles->add(x3, y3, z3, n, col, 0, false, false);
+          if(!pre) chunk().triangles.add(x3, y3, z3, n, col, 0, false, false);
         }
       }
       if(vmin == vmax) break;
@@ -766,25 +793,21 @@ static void addOutlineHexahedron(PView *p, double **xyz,
 }
 
 static void addScalarHexahedron(PView *p, double **xyz,
-                                double **val, bool pre)
+                                double **val, bool pre, int boundary)
 {
-  PViewOptions *opt = p->getOptions();
-
   const int iq[6][4] = {{0, 3, 2, 1}, {0, 1, 5, 4}, {0, 4, 7, 3},
                         {1, 2, 6, 5}, {2, 3, 7, 6}, {4, 5, 6, 7}};
   const int is[6][4] = {{0, 1, 3, 4}, {1, 3, 4, 5}, {3, 4, 5, 7},
                         {1, 2, 3, 6}, {3, 1, 6, 5}, {6, 3, 5, 7}};
 
-  if(opt->boundary > 0){
-    opt->boundary--;
+  if(boundary > 0){
     for(int i = 0; i < 6; i++)
-      addScalarQuadrangle(p, xyz, val, pre, iq[i][0], iq[i][1], iq[i][2], iq[i][3], true);
-    opt->boundary++;
+      addScalarQuadrangle(p, xyz, val, pre, boundary - 1, iq[i][0], iq[i][1], iq[i][2], iq[i][3], true);
     return;
   }
 
   for(int i = 0; i < 6; i++)
-    addScalarTetrahedron(p, xyz, val, pre, is[i][0], is[i][1], is[i][2], is[i][3]);
+    addScalarTetrahedron(p, xyz, val, pre, boundary, is[i][0], is[i][1], is[i][2], is[i][3]);
 }
 
 static void addOutlinePrism(PView *p, double **xyz, unsigned int color,
@@ -799,25 +822,23 @@ static void addOutlinePrism(PView *p, double **xyz, unsigned int color,
     addOutlineTriangle(p, xyz, color, pre, it[i][0], it[i][1], it[i][2]);
 }
 
-static void addScalarPrism(PView *p, double **xyz, double **val, bool pre)
+static void addScalarPrism(PView *p, double **xyz, double **val, bool pre,
+                           int boundary)
 {
-  PViewOptions *opt = p->getOptions();
   const int iq[3][4] = {{0, 1, 4, 3}, {0, 3, 5, 2}, {1, 2, 5, 4}};
   const int it[2][3] = {{0, 2, 1}, {3, 4, 5}};
   const int is[3][4] = {{0, 1, 2, 3}, {3, 4, 5, 2}, {1, 2, 4, 3}};
 
-  if(opt->boundary > 0){
-    opt->boundary--;
+  if(boundary > 0){
     for(int i = 0; i < 3; i++)
-      addScalarQuadrangle(p, xyz, val, pre, iq[i][0], iq[i][1], iq[i][2], iq[i][3], true);
+      addScalarQuadrangle(p, xyz, val, pre, boundary - 1, iq[i][0], iq[i][1], iq[i][2], iq[i][3], true);
     for(int i = 0; i < 2; i++)
-      addScalarTriangle(p, xyz, val, pre, it[i][0], it[i][1], it[i][2], true);
-    opt->boundary++;
+      addScalarTriangle(p, xyz, val, pre, boundary - 1, it[i][0], it[i][1], it[i][2], true);
     return;
   }
 
   for(int i = 0; i < 3; i++)
-    addScalarTetrahedron(p, xyz, val, pre, is[i][0], is[i][1], is[i][2], is[i][3]);
+    addScalarTetrahedron(p, xyz, val, pre, boundary, is[i][0], is[i][1], is[i][2], is[i][3]);
 }
 
 static void addOutlinePyramid(PView *p, double **xyz,
@@ -831,24 +852,20 @@ static void addOutlinePyramid(PView *p, double **xyz,
 }
 
 static void addScalarPyramid(PView *p, double **xyz,
-                             double **val, bool pre)
+                             double **val, bool pre, int boundary)
 {
-  PViewOptions *opt = p->getOptions();
-
   const int it[4][3] = {{0, 1, 4}, {3, 0, 4}, {1, 2, 4}, {2, 3, 4}};
   const int is[2][4] = {{0, 1, 2, 4}, {2, 3, 0, 4}};
 
-  if(opt->boundary > 0){
-    opt->boundary--;
-    addScalarQuadrangle(p, xyz, val, pre, 0, 3, 2, 1, true);
+  if(boundary > 0){
+    addScalarQuadrangle(p, xyz, val, pre, boundary - 1, 0, 3, 2, 1, true);
     for(int i = 0; i < 4; i++)
-      addScalarTriangle(p, xyz, val, pre, it[i][0], it[i][1], it[i][2], true);
-    opt->boundary++;
+      addScalarTriangle(p, xyz, val, pre, boundary - 1, it[i][0], it[i][1], it[i][2], true);
     return;
   }
 
   for(int i = 0; i < 2; i++)
-    addScalarTetrahedron(p, xyz, val, pre, is[i][0], is[i][1], is[i][2], is[i][3]);
+    addScalarTetrahedron(p, xyz, val, pre, boundary, is[i][0], is[i][1], is[i][2], is[i][3]);
 }
 
 static void addOutlinePolyhedron(PView *p, double **xyz,
@@ -881,16 +898,15 @@ static void addOutlinePolyhedron(PView *p, double **xyz,
 }
 
 static void addScalarPolyhedron(PView *p, double **xyz,
-                                double **val, bool pre, int numNodes)
+                                double **val, bool pre, int boundary,
+                                int numNodes)
 {
-  PViewOptions *opt = p->getOptions();
-
-  if(opt->boundary > 0){
+  if(boundary > 0){
     return;
   }
 
   for(int i = 0; i < numNodes / 4; i++)
-    addScalarTetrahedron(p, xyz, val, pre, 4*i, 4*i + 1, 4*i + 2, 4*i + 3);
+    addScalarTetrahedron(p, xyz, val, pre, boundary, 4*i, 4*i + 1, 4*i + 2, 4*i + 3);
 }
 
 static void addOutlineElement(PView *p, int type, double **xyz,
@@ -914,17 +930,18 @@ static void addOutlineElement(PView *p, int type, double **xyz,
 static void addScalarElement(PView *p, int type, double **xyz,
                              double **val, bool pre, int numNodes)
 {
+  int boundary = p->getOptions()->boundary;
   switch(type){
-  case TYPE_PNT: addScalarPoint(p, xyz, val, pre); break;
-  case TYPE_LIN: addScalarLine(p, xyz, val, pre); break;
-  case TYPE_TRI: addScalarTriangle(p, xyz, val, pre); break;
-  case TYPE_QUA: addScalarQuadrangle(p, xyz, val, pre); break;
-  case TYPE_POLYG: addScalarPolygon(p, xyz, val, pre, numNodes); break;
-  case TYPE_TET: addScalarTetrahedron(p, xyz, val, pre); break;
-  case TYPE_HEX: addScalarHexahedron(p, xyz, val, pre); break;
-  case TYPE_PRI: addScalarPrism(p, xyz, val, pre); break;
-  case TYPE_PYR: addScalarPyramid(p, xyz, val, pre); break;
-  case TYPE_POLYH: addScalarPolyhedron(p, xyz, val, pre, numNodes); break;
+  case TYPE_PNT: addScalarPoint(p, xyz, val, pre, boundary); break;
+  case TYPE_LIN: addScalarLine(p, xyz, val, pre, boundary); break;
+  case TYPE_TRI: addScalarTriangle(p, xyz, val, pre, boundary); break;
+  case TYPE_QUA: addScalarQuadrangle(p, xyz, val, pre, boundary); break;
+  case TYPE_POLYG: addScalarPolygon(p, xyz, val, pre, boundary, numNodes); break;
+  case TYPE_TET: addScalarTetrahedron(p, xyz, val, pre, boundary); break;
+  case TYPE_HEX: addScalarHexahedron(p, xyz, val, pre, boundary); break;
+  case TYPE_PRI: addScalarPrism(p, xyz, val, pre, boundary); break;
+  case TYPE_PYR: addScalarPyramid(p, xyz, val, pre, boundary); break;
+  case TYPE_POLYH: addScalarPolyhedron(p, xyz, val, pre, boundary, numNodes); break;
   }
 }
 
@@ -984,7 +1001,7 @@ static void addVectorElement(PView *p, int ient, int iele, int numNodes,
         }
         SVector3 n[2];
         getLineNormal(p, dxyz[0], dxyz[1], dxyz[2], norm, n, true);
-        p->va_lines->add(dxyz[0], dxyz[1], dxyz[2], n, col, 0, false);
+        chunk().lines.add(dxyz[0], dxyz[1], dxyz[2], n, col, 0, false);
       }
     }
     for(int i = 0; i < numNodes; i++)
@@ -1015,7 +1032,7 @@ static void addVectorElement(PView *p, int ient, int iele, int numNodes,
           dxyz[j][0] = xyz[i][j];
           dxyz[j][1] = val[i][j];
         }
-        p->va_vectors->add(dxyz[0], dxyz[1], dxyz[2], 0, col, 0, false);
+        chunk().vectors.add(dxyz[0], dxyz[1], dxyz[2], 0, col, 0, false);
       }
     }
   }
@@ -1051,7 +1068,7 @@ static void addVectorElement(PView *p, int ient, int iele, int numNodes,
         dxyz[i][0] = pc[i];
         dxyz[i][1] = d[i];
       }
-      p->va_vectors->add(dxyz[0], dxyz[1], dxyz[2], 0, col, 0, false);
+      chunk().vectors.add(dxyz[0], dxyz[1], dxyz[2], 0, col, 0, false);
     }
   }
   for(int i = 0; i < numNodes; i++)
@@ -1096,7 +1113,7 @@ static void addTensorElement(PView *p, int iEnt, int iEle, int numNodes, int typ
           (lmax, opt->tmpMin, opt->tmpMax, false,
            (opt->intervalsType == PViewOptions::Discrete) ?  opt->nbIso : -1);
         unsigned int col[4] = {color, color, color, color};
-        p->va_ellipses->add(vval[0], vval[1], vval[2], 0, col, 0, false);
+        chunk().ellipses.add(vval[0], vval[1], vval[2], 0, col, 0, false);
       }
     }
     else if(opt->glyphLocation == PViewOptions::COG){
@@ -1122,7 +1139,7 @@ static void addTensorElement(PView *p, int iEnt, int iEle, int numNodes, int typ
         (lmax, opt->tmpMin, opt->tmpMax, false,
          (opt->intervalsType == PViewOptions::Discrete) ?  opt->nbIso : -1);
       unsigned int col[4] = {color, color, color, color};
-      p->va_ellipses->add(vval[0], vval[1], vval[2], 0, col, 0, false);
+      chunk().ellipses.add(vval[0], vval[1], vval[2], 0, col, 0, false);
     }
   }
   else {
@@ -1167,6 +1184,126 @@ static void addTensorElement(PView *p, int iEnt, int iEle, int numNodes, int typ
   }
 }
 
+static void addElement(PView *p, elementBlock &block, int b, double **xyz,
+                       double **val, SBoundingBox3d &bbox, bool pre)
+{
+  // use adaptive data if available
+  PViewData *data = p->getData(true);
+  PViewOptions *opt = p->getOptions();
+
+  int ent = block.ent, i = block.first + b, type = block.type;
+  int numNodes = block.numNodes, numComp = block.numComp;
+  const double *bxyz = block.getXYZ(b), *bval = block.getValues(b);
+  for(int j = 0; j < numNodes; j++){
+    for(int k = 0; k < 3; k++)
+      xyz[j][k] = bxyz[3 * j + k];
+    if(opt->forceNumComponents){
+      for(int k = 0; k < opt->forceNumComponents; k++){
+        int comp = opt->componentMap[k];
+        if(comp >= 0 && comp < numComp)
+          val[j][k] = bval[numComp * j + comp];
+        else
+          val[j][k] = 0.;
+      }
+    }
+    else
+      for(int k = 0; k < numComp; k++)
+        val[j][k] = bval[numComp * j + k];
+  }
+  if(opt->forceNumComponents) numComp = opt->forceNumComponents;
+
+  changeCoordinates(p, ent, i, numNodes, type, numComp, xyz, val);
+  if(!isElementVisible(opt, block.dim, numNodes, xyz)) return;
+
+  for(int j = 0; j < numNodes; j++)
+    bbox += SPoint3(xyz[j][0], xyz[j][1], xyz[j][2]);
+
+  if(opt->showElement && !data->useGaussPoints())
+    addOutlineElement(p, type, xyz, pre, numNodes);
+
+  if(opt->intervalsType != PViewOptions::Numeric){
+    if(data->useGaussPoints()){
+      for(int j = 0; j < numNodes; j++){
+        double *x2 = new double[3]; double **xyz2 = &x2;
+        double *v2 = new double[9]; double **val2 = &v2;
+        xyz2[0][0] = xyz[j][0];
+        xyz2[0][1] = xyz[j][1];
+        xyz2[0][2] = xyz[j][2];
+        for(int k = 0; k < numComp; k++)
+          val2[0][k] = val[j][k];
+        if(numComp == 1 && opt->drawScalars)
+          addScalarElement(p, TYPE_PNT, xyz2, val2, pre, numNodes);
+        else if(numComp == 3 && opt->drawVectors)
+          addVectorElement(p, ent, i, 1, TYPE_PNT, xyz2, val2, pre);
+        else if(numComp == 9 && opt->drawTensors)
+          addTensorElement(p, ent, i, 1, TYPE_PNT, xyz2, val2, pre);
+        delete [] x2;
+        delete [] v2;
+      }
+    }
+    else if(numComp == 1 && opt->drawScalars)
+      addScalarElement(p, type, xyz, val, pre, numNodes);
+    else if(numComp == 3 && opt->drawVectors)
+      addVectorElement(p, ent, i, numNodes, type, xyz, val, pre);
+    else if(numComp == 9 && opt->drawTensors)
+      addTensorElement(p, ent, i, numNodes, type, xyz, val, pre);
+  }
+}
+
+static void addBlocksInArrays(PView *p, std::vector<elementBlock> &blocks,
+                              int numBlocks, SBoundingBox3d *bbox, bool pre)
+{
+  // the elements are processed concurrently, unless the display options
+  // access other views or modify the options while processing an element
+  // (general raise, vectors and tensor eigenvectors)
+#if defined(_OPENMP)
+  PViewOptions *opt = p->getOptions();
+  bool parallel = !opt->useGenRaise;
+#endif
+  int maxNodes = 1;
+  std::vector<std::pair<int, int> > items;
+  for(int i = 0; i < numBlocks; i++){
+    const elementBlock &block = blocks[i];
+#if defined(_OPENMP)
+    int numComp = opt->forceNumComponents ? opt->forceNumComponents :
+      block.numComp;
+    if((numComp == 3 && opt->drawVectors) ||
+       (numComp == 9 && opt->drawTensors &&
+        opt->tensorType == PViewOptions::EigenVectors))
+      parallel = false;
+#endif
+    maxNodes = std::max(maxNodes, block.numNodes);
+    for(int b = 0; b < block.num; b++)
+      if(!block.skip[b]) items.push_back(std::make_pair(i, b));
+  }
+  int numItems = items.size();
+
+#if defined(_OPENMP)
+#pragma omp parallel if(parallel)
+#endif
+  {
+    std::vector<double> xyzMem(3 * maxNodes), valMem(9 * maxNodes);
+    std::vector<double*> xyz(maxNodes), val(maxNodes);
+    for(int j = 0; j < maxNodes; j++){
+      xyz[j] = &xyzMem[3 * j];
+      val[j] = &valMem[9 * j];
+    }
+    SBoundingBox3d &bb = bbox[Msg::GetThreadNum()];
+    // static schedule: each thread processes a contiguous range of
+    // elements, so that appending the chunks in thread order gives the
+    // same arrays as processing the elements serially
+#if defined(_OPENMP)
+#pragma omp for schedule(static)
+#endif
+    for(int i = 0; i < numItems; i++)
+      addElement(p, blocks[items[i].first], items[i].second, &xyz[0], &val[0],
+                 bb, pre);
+  }
+
+  for(int i = 0; i < Msg::GetMaxThreads(); i++)
+    chunks[i].appendTo(p);
+}
+
 static void addElementsInArrays(PView *p, bool preprocessNormalsOnly)
 {
   static int numNodesError = 0, numCompError = 0;
@@ -1177,120 +1314,57 @@ static void addElementsInArrays(PView *p, bool preprocessNormalsOnly)
 
   opt->tmpBBox.reset();
 
-  int NMAX = PVIEW_NMAX;
-  double **xyz = new double*[NMAX];
-  double **val = new double*[NMAX];
-  for(int i = 0; i < NMAX; i++){
-    xyz[i] = new double[3];
-    val[i] = new double[9];
-  }
+  int numThreads = Msg::GetMaxThreads();
+  chunks = new vertexArrayChunk[numThreads];
+  std::vector<SBoundingBox3d> bbox(numThreads);
+
+  // read the elements by blocks of elements of the same type, and process
+  // them by batches of blocks
+  std::vector<elementBlock> blocks(16);
+  int numBlocks = 0;
   for(int ent = 0; ent < data->getNumEntities(opt->timeStep); ent++){
     if(data->skipEntity(opt->timeStep, ent)) continue;
-    for(int i = 0; i < data->getNumElements(opt->timeStep, ent); i++){
-      if(data->skipElement(opt->timeStep, ent, i, true, opt->sampling)) continue;
-      int type = data->getType(opt->timeStep, ent, i);
+    int numEle = data->getNumElements(opt->timeStep, ent);
+    for(int first = 0; first < numEle; ){
+      elementBlock &block = blocks[numBlocks];
+      if(!data->getElementBlock(opt->timeStep, ent, first, 1024, block, true,
+                                opt->sampling)) break;
+      first += block.num;
+      int type = block.type;
       if(opt->skipElement(type)) continue;
-      int numComp = data->getNumComponents(opt->timeStep, ent, i);
-      int numNodes = data->getNumNodes(opt->timeStep, ent, i);
-      if(numNodes > PVIEW_NMAX){
-        if(type == TYPE_POLYG || type == TYPE_POLYH){
-          if(numNodes > NMAX){
-            for(int j = 0; j < NMAX; j++){
-              delete [] xyz[j];
-              delete [] val[j];
-            }
-            delete [] xyz;
-            delete [] val;
-            NMAX = numNodes;
-            xyz = new double*[NMAX];
-            val = new double*[NMAX];
-            for(int j = 0; j < NMAX; j++){
-              xyz[j] = new double[3];
-              val[j] = new double[9];
-            }
-          }
-        }
-        else {
-          if(numNodesError != numNodes){
-            numNodesError = numNodes;
-            Msg::Warning("Fields with %d nodes per element cannot be displayed: "
-                         "either force the field type or select 'Adapt visualization "
-                         "grid' if the field is high-order", numNodes);
-          }
-          continue;
+      int numNodes = block.numNodes;
+      if(numNodes > PVIEW_NMAX && type != TYPE_POLYG && type != TYPE_POLYH){
+        if(numNodesError != numNodes){
+          numNodesError = numNodes;
+          Msg::Warning("Fields with %d nodes per element cannot be displayed: "
+                       "either force the field type or select 'Adapt visualization "
+                       "grid' if the field is high-order", numNodes);
         }
+        continue;
       }
-      if((numComp > 9 && !opt->forceNumComponents) || opt->forceNumComponents > 9){
-        if(numCompError != numComp) {
-          numCompError = numComp;
+      if((block.numComp > 9 && !opt->forceNumComponents) ||
+         opt->forceNumComponents > 9){
+        if(numCompError != block.numComp) {
+          numCompError = block.numComp;
           Msg::Warning("Fields with %d components cannot be displayed: "
                        "either force the field type or select 'Adapt visualization "
-                       "grid' if the field is high-order", numComp);
+                       "grid' if the field is high-order", block.numComp);
         }
         continue;
       }
-      for(int j = 0; j < numNodes; j++){
-        data->getNode(opt->timeStep, ent, i, j, xyz[j][0], xyz[j][1], xyz[j][2]);
-        if(opt->forceNumComponents){
-          for(int k = 0; k < opt->forceNumComponents; k++){
-            int comp = opt->componentMap[k];
-            if(comp >= 0 && comp < numComp)
-              data->getValue(opt->timeStep, ent, i, j, comp, val[j][k]);
-            else
-              val[j][k] = 0.;
-          }
-        }
-        else
-          for(int k = 0; k < numComp; k++)
-            data->getValue(opt->timeStep, ent, i, j, k, val[j][k]);
-      }
-      if(opt->forceNumComponents) numComp = opt->forceNumComponents;
-
-      changeCoordinates(p, ent, i, numNodes, type, numComp, xyz, val);
-      int dim = data->getDimension(opt->timeStep, ent, i);
-      if(!isElementVisible(opt, dim, numNodes, xyz)) continue;
-
-      for(int j = 0; j < numNodes; j++)
-        opt->tmpBBox += SPoint3(xyz[j][0], xyz[j][1], xyz[j][2]);
-
-      if(opt->showElement && !data->useGaussPoints())
-        addOutlineElement(p, type, xyz, preprocessNormalsOnly, numNodes);
-
-      if(opt->intervalsType != PViewOptions::Numeric){
-        if(data->useGaussPoints()){
-          for(int j = 0; j < numNodes; j++){
-            double *x2 = new double[3]; double **xyz2 = &x2;
-            double *v2 = new double[9]; double **val2 = &v2;
-            xyz2[0][0] = xyz[j][0];
-            xyz2[0][1] = xyz[j][1];
-            xyz2[0][2] = xyz[j][2];
-            for(int k = 0; k < numComp; k++)
-              val2[0][k] = val[j][k];
-            if(numComp == 1 && opt->drawScalars)
-              addScalarElement(p, TYPE_PNT, xyz2, val2, preprocessNormalsOnly, numNodes);
-            else if(numComp == 3 && opt->drawVectors)
-              addVectorElement(p, ent, i, 1, TYPE_PNT, xyz2, val2, preprocessNormalsOnly);
-            else if(numComp == 9 && opt->drawTensors)
-              addTensorElement(p, ent, i, 1, TYPE_PNT, xyz2, val2, preprocessNormalsOnly);
-            delete [] x2;
-            delete [] v2;
-          }
-        }
-        else if(numComp == 1 && opt->drawScalars)
-          addScalarElement(p, type, xyz, val, preprocessNormalsOnly, numNodes);
-        else if(numComp == 3 && opt->drawVectors)
-          addVectorElement(p, ent, i, numNodes, type, xyz, val, preprocessNormalsOnly);
-        else if(numComp == 9 && opt->drawTensors)
-          addTensorElement(p, ent, i, numNodes, type, xyz, val, preprocessNormalsOnly);
+      if(++numBlocks == (int)blocks.size()){
+        addBlocksInArrays(p, blocks, numBlocks, &bbox[0], preprocessNormalsOnly);
+        numBlocks = 0;
       }
     }
   }
-  for(int j = 0; j < NMAX; j++){
-    delete [] xyz[j];
-    delete [] val[j];
-  }
-  delete [] xyz;
-  delete [] val;
+  if(numBlocks)
+    addBlocksInArrays(p, blocks, numBlocks, &bbox[0], preprocessNormalsOnly);
+
+  for(int i = 0; i < numThreads; i++)
+    if(!bbox[i].empty()) opt->tmpBBox += bbox[i];
+  delete [] chunks;
+  chunks = 0;
 }
 
 class initPView {
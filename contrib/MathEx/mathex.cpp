@@ -674,6 +674,117 @@
       #endif
          return evalstack[0];
       } // eval()
+
+   // block evaluation: the stack holds blocks of values, one per point
+       void mathex::eval(unsigned n, double const *base, double const *vals,
+                         unsigned stride, double *res)
+      {
+         const unsigned B = 64; // number of points per block
+
+         if(status == notparsed) parse();
+         if(status == invalid) throw error("eval()", "invalid expression");
+         if(!n) return;
+
+         // maximum stack depth; functions with side effects (rand) are
+         // evaluated point by point to get the same sequence as eval()
+         unsigned depth = 0, maxdepth = 0;
+         vector<unsigned> varoffset(vartable.size());
+         for(unsigned i=0; i<vartable.size(); i++) {
+            if(vartable[i].var < base || vartable[i].var >= base + stride)
+               throw error("eval()", "variable out of range");
+            varoffset[i] = vartable[i].var - base;
+         }
+         for(unsigned i=0; i<bytecode.size(); i++) {
+            switch(bytecode[i].state) {
+               case CODETOKEN::VALUE: case CODETOKEN::VARIABLE: depth++; break;
+               case CODETOKEN::FUNCTION: break;
+               case CODETOKEN::BINOP: depth--; break;
+               case CODETOKEN::USERFUNC:
+                  if(functable[bytecode[i].idx].f == p_rand) {
+                     for(unsigned k=0; k<n; k++) {
+                        for(unsigned j=0; j<vartable.size(); j++)
+                           *vartable[j].var = vals[k * stride + varoffset[j]];
+                        res[k] = eval();
+                     }
+                     return;
+                  }
+                  if(bytecode[i].numargs > 0)
+                     depth -= static_cast<unsigned>(bytecode[i].numargs) - 1;
+                  else depth++;
+                  break;
+               default: throw error("eval()", "invalid code token");
+            }
+            maxdepth = max(maxdepth, depth);
+         }
+
+         vector<double> stack(maxdepth * B), x;
+         for(unsigned i0=0; i0<n; i0+=B) {
+            const unsigned m = min(B, n - i0);
+            unsigned sp = 0; // number of blocks on the stack
+            for(unsigned i=0; i<bytecode.size(); i++) {
+               const CODETOKEN &tok = bytecode[i];
+               switch(tok.state) {
+                  case CODETOKEN::VALUE:
+                  {
+                     double *top = &stack[B * sp++];
+                     for(unsigned k=0; k<m; k++) top[k] = tok.value;
+                     break;
+                  }
+                  case CODETOKEN::VARIABLE:
+                  {
+                     double *top = &stack[B * sp++];
+                     double const *v = vals + i0 * stride + varoffset[tok.idx];
+                     for(unsigned k=0; k<m; k++) top[k] = v[k * stride];
+                     break;
+                  }
+                  case CODETOKEN::FUNCTION:
+                  {
+                     double *top = &stack[B * (sp - 1)];
+                     double (*f)(double) = cfunctable[tok.idx].f;
+                     if(f == unary_minus)
+                        for(unsigned k=0; k<m; k++) top[k] = -top[k];
+                     else
+                        for(unsigned k=0; k<m; k++) top[k] = f(top[k]);
+                     break;
+                  }
+                  case CODETOKEN::BINOP:
+                  {
+                     double (*f)(double, double) = binoptable[tok.idx].f;
+                     double *top = &stack[B * (sp - 1)], *a = &stack[B * (sp - 2)];
+                     if(f == binary_plus)
+                        for(unsigned k=0; k<m; k++) a[k] = a[k] + top[k];
+                     else if(f == binary_minus)
+                        for(unsigned k=0; k<m; k++) a[k] = a[k] - top[k];
+                     else if(f == binary_times)
+                        for(unsigned k=0; k<m; k++) a[k] = a[k] * top[k];
+                     else
+                        for(unsigned k=0; k<m; k++) a[k] = f(a[k], top[k]);
+                     sp--;
+                     break;
+                  }
+                  case CODETOKEN::USERFUNC:
+                     if(tok.numargs > 0) {
+                        sp -= tok.numargs - 1;
+                        double *top = &stack[B * (sp - 1)];
+                        x.resize(tok.numargs);
+                        for(unsigned k=0; k<m; k++) {
+                           for(unsigned j=0; j<tok.numargs; j++)
+                              x[j] = top[j * B + k];
+                           top[k] = functable[tok.idx].f(x);
+                        }
+                     }
+                     else {
+                        double *top = &stack[B * sp++];
+                        x.clear();
+                        for(unsigned k=0; k<m; k++)
+                           top[k] = functable[tok.idx].f(x);
+                     }
+                     break;
+               }
+            }
+            for(unsigned k=0; k<m; k++) res[i0 + k] = stack[k];
+         }
+      } // eval()
    
    /////////////////
    // parser
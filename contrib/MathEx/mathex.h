@@ -255,6 +255,14 @@ using namespace std;
          return pos; }
       void parse(); /// < parse expression 
       double eval(); /// < eval expression
+      /// eval expression for n points at once: the variables must all be
+      /// registered with addresses in [base, base + stride), and the value
+      /// of the variable registered with address base + j is
+      /// vals[i * stride + j] for point i. The bytecode is interpreted
+      /// once per block of points, and the results are the same as with
+      /// eval()
+      void eval(unsigned n, double const *base, double const *vals,
+                unsigned stride, double *res);
       void reset(); /// < reset all
        mathex() /// < default constructor
       {reset();}
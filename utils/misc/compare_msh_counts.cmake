@@ -0,0 +1,29 @@
+# Gmsh - Copyright (C) 1997-2013 C. Geuzaine, J.-F. Remacle
+#
+# See the LICENSE.txt file for license information. Please report all
+# bugs and problems to the public mailing list <gmsh@geuz.org>.
+
+# check that two ASCII MSH files contain the same number of nodes and
+# elements, e.g.
+#   cmake -DFILE1=a.msh -DFILE2=b.msh -P compare_msh_counts.cmake
+
+function(msh_counts FILE NODES ELEMENTS)
+  if(NOT EXISTS ${FILE})
+    message(FATAL_ERROR "File '${FILE}' does not exist")
+  endif(NOT EXISTS ${FILE})
+  file(READ ${FILE} CONTENT)
+  string(REGEX MATCH "\\$Nodes\r?\n([0-9]+)" TMP "${CONTENT}")
+  set(${NODES} "${CMAKE_MATCH_1}" PARENT_SCOPE)
+  string(REGEX MATCH "\\$Elements\r?\n([0-9]+)" TMP "${CONTENT}")
+  set(${ELEMENTS} "${CMAKE_MATCH_1}" PARENT_SCOPE)
+endfunction(msh_counts)
+
+msh_counts(${FILE1} NODES1 ELEMENTS1)
+msh_counts(${FILE2} NODES2 ELEMENTS2)
+if(NOT NODES1 OR NOT ELEMENTS1)
+  message(FATAL_ERROR "No nodes or elements in '${FILE1}'")
+endif(NOT NODES1 OR NOT ELEMENTS1)
+if(NOT NODES1 EQUAL NODES2 OR NOT ELEMENTS1 EQUAL ELEMENTS2)
+  message(FATAL_ERROR "'${FILE1}' has ${NODES1} nodes and ${ELEMENTS1} elements, "
+          "'${FILE2}' has ${NODES2} nodes and ${ELEMENTS2} elements")
+endif(NOT NODES1 EQUAL NODES2 OR NOT ELEMENTS1 EQUAL ELEMENTS2)